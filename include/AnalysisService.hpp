@@ -0,0 +1,132 @@
+// AnalysisService.hpp
+#ifndef ANALYSIS_SERVICE_HPP
+#define ANALYSIS_SERVICE_HPP
+#include "ConfigReader.hpp"
+#include "MoveEncoding.hpp"
+#include "PositionNotation.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class TranspositionTable;
+
+// In-process analysis of many positions of one config at once. Callers
+// submit a position with a search budget and a priority, and get the result
+// through a future, a callback, or both.
+//
+// Jobs wait in one queue ordered by priority (then by submission) and are
+// taken by a fixed set of worker threads. Each worker keeps one warm game
+// (board, move generator, search) that it resets for every job, and all of
+// them share one transposition table, so positions that recur across jobs
+// (the same opening, a line analysed again deeper) are not searched twice.
+//
+// A queued job can be cancelled before it starts; a running one is stopped
+// within one node and reports the best move of its last finished iteration.
+class AnalysisService {
+public:
+  struct Options {
+    unsigned threads = std::thread::hardware_concurrency();
+    size_t hash_mb = 16;  // shared transposition table; 0 searches without one
+  };
+
+  struct Request {
+    std::string position;             // PositionNotation of config piece types; empty for the setup
+    std::vector<std::string> moves;   // played from the position first (moveToNotation text)
+    // Search::Limits; with no limit at all the search goes to depth 3
+    int depth = 0;
+    int64_t movetime_ms = 0;
+    size_t nodes = 0;
+    int priority = 0;                 // higher runs first
+    int multipv = 1;                  // best root moves to report (Analysis::lines)
+  };
+
+  enum class Status { Done, Cancelled, Invalid };
+
+  // One of the best root moves; pv is ChessBoard::lineToNotation text, so
+  // portal moves in it name their portal
+  struct Line {
+    std::string move_text;
+    int score = 0;
+    std::string pv;
+    bool portal = false;  // the move itself ends in a portal
+  };
+
+  struct Analysis {
+    Status status = Status::Done;
+    std::string error;      // why the request was Invalid
+    EncodedMove move;
+    std::string move_text;  // moveToNotation of move
+    bool has_move = false;  // false when the side to move has no legal move
+    int score = 0;          // centipawns for the side to move
+    int depth = 0;          // last completed iteration
+    size_t nodes = 0;       // searched by this job
+    int64_t queued_ms = 0;  // from submit() to a worker taking the job
+    int64_t elapsed_ms = 0; // searching
+    std::vector<Line> lines;  // Request::multipv of them, best first
+  };
+
+  // Called once per job, on the thread that finished it (a worker, or the
+  // caller of cancel() for a job that never started), before the future is
+  // ready
+  using Callback = std::function<void(uint64_t id, const Analysis& analysis)>;
+
+  struct Ticket {
+    uint64_t id = 0;
+    std::future<Analysis> result;
+  };
+
+  AnalysisService(const GameConfig& config, const Options& options);
+  // Cancels every job still queued or running
+  ~AnalysisService();
+  AnalysisService(const AnalysisService&) = delete;
+  AnalysisService& operator=(const AnalysisService&) = delete;
+
+  Ticket submit(Request request, Callback callback = nullptr);
+  // False if the job already finished (or never existed)
+  bool cancel(uint64_t id);
+
+  // Jobs queued or running
+  size_t pending() const;
+  size_t completed() const;
+  // Nodes searched by every finished job
+  size_t totalNodes() const;
+  // nullptr when Options::hash_mb is 0
+  const TranspositionTable* transpositionTable() const { return table_.get(); }
+
+private:
+  struct Job;
+  struct Worker;
+  struct Later {
+    bool operator()(const std::shared_ptr<Job>& a, const std::shared_ptr<Job>& b) const;
+  };
+
+  void workerLoop(Worker& worker);
+  Analysis analyse(Worker& worker, const Request& request);
+  static void finish(Job& job, Analysis analysis);
+
+  const GameConfig& config_;
+  PositionNotation notation_;
+  std::unique_ptr<TranspositionTable> table_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::priority_queue<std::shared_ptr<Job>, std::vector<std::shared_ptr<Job>>, Later> queue_;
+  std::unordered_map<uint64_t, std::shared_ptr<Job>> jobs_;  // queued and running
+  uint64_t next_id_ = 1;
+  size_t completed_ = 0;
+  size_t total_nodes_ = 0;
+  bool stopping_ = false;
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+};
+
+#endif
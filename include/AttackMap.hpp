@@ -0,0 +1,36 @@
+// AttackMap.hpp
+#ifndef ATTACK_MAP_HPP
+#define ATTACK_MAP_HPP
+#include "ChessBoard.hpp"
+#include <array>
+#include <cstdint>
+
+class PortalSystem;
+
+// Every square attacked by one side, stored as one 32-bit mask per rank.
+// Built from the board's row masks: leaper spreads and rank slides are
+// computed for 8 ranks at a time with AVX2 when the CPU has it, file and
+// diagonal rays with a bit-parallel sweep over the ranks.
+// Only for boards with line masks (ChessBoard::hasLineMasks()).
+class AttackMap {
+public:
+  // include_king = false leaves out the king's own squares, matching the
+  // move validator, which never treats the king as a checking piece
+  void build(const ChessBoard& board, bool is_white, const PortalSystem& portal_system,
+             bool include_king = true);
+  bool isAttacked(const Position& pos) const { return (ranks_[kPad + pos.y] >> pos.x) & 1u; }
+  uint32_t rank(int y) const { return ranks_[kPad + y]; }
+
+  // Attacks along one line from the slider bit `slider`, given the line's
+  // occupancy and the line's valid squares (hyperbola quintessence)
+  static uint32_t lineAttacks(uint32_t occupied, uint32_t slider, uint32_t line);
+
+  static bool avx2Enabled();
+
+private:
+  // Knight and king spreads reach two ranks past the board on either side
+  static constexpr int kPad = 2;
+  std::array<uint32_t, ChessBoard::kMaxMaskedBoardSize + 2 * kPad> ranks_{};
+};
+
+#endif
@@ -2,46 +2,199 @@
 #ifndef CHESS_BOARD_HPP
 #define CHESS_BOARD_HPP
 #include "ConfigReader.hpp"
-#include <unordered_map>
+#include "MoveEncoding.hpp"
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 
 class MoveValidator;
 class PortalSystem;
 class GameManager;
 
+enum class PieceKind : uint8_t { None, King, Queen, Rook, Bishop, Knight, Pawn, Custom };
+constexpr int kPieceKindCount = 8;
+
 class ChessBoard {
 public:
   struct Square {
-    std::string piece;
+    uint8_t type;   // index into the board's piece type table, 0 = empty
+    PieceKind kind;
     bool is_white;
-    //piece""
-    Square() : piece(""), is_white(false) {}
-    Square(const std::string& p, bool w) : piece(p), is_white(w) {}
-    bool is_empty() const { return piece.empty(); }
+    Square() : type(0), kind(PieceKind::None), is_white(false) {}
+    Square(uint8_t t, PieceKind k, bool w) : type(t), kind(k), is_white(w) {}
+    bool is_empty() const { return type == 0; }
+  };
+
+  // A piece to put down with placePieces()
+  struct Placement {
+    int index;
+    Square square;
+  };
+
+  struct PieceType {
+    std::string name;  // as spelled in the config, e.g. "Knight"
+    PieceKind kind;
   };
 
+  // Boards up to this size keep 32-bit occupancy masks per line; larger ones
+  // store only their pieces (sparse backend)
+  static constexpr int kMaxMaskedBoardSize = 32;
+  // EncodedMove holds 14-bit square indexes
+  static constexpr int kMaxBoardSize = 128;
+  // Square::type is one byte, and type 0 is the empty square
+  static constexpr size_t kMaxPieceTypes = 256;
+
+  // Castling right bits
+  static constexpr uint8_t kWhiteKingside = 1;
+  static constexpr uint8_t kWhiteQueenside = 2;
+  static constexpr uint8_t kBlackKingside = 4;
+  static constexpr uint8_t kBlackQueenside = 8;
+
   ChessBoard(int size, const std::string& display_format = "detailed"); 
   int getBoardSize() const;
   void initializeBoard(const std::vector<PieceConfig>& piece_configs);
+  // Empties the board: white to move, no castling rights, no en passant.
+  // Piece types stay registered, and a warm board does not allocate.
+  void clearPieces();
+  // Puts pieces on distinct empty squares in one go; sparse boards sort their
+  // indexes once instead of inserting piece by piece
+  void placePieces(const Placement* placements, size_t count);
   void placePiece(const std::string& piece, bool is_white, int x, int y);
   void printBoard() const;
   bool isInBounds(const Position& pos) const;
   const Square& getSquare(const Position& pos) const;
+  void setSquare(const Position& pos, const Square& square);
   void movePiece(const Position& start, const Position& end, MoveValidator& validator, 
                  PortalSystem& portal_system, GameManager& game_manager);
+
+  // Piece types
+  const std::string& pieceName(const Square& square) const;
+  PieceKind pieceKind(uint8_t type) const { return piece_types[type].kind; }
+  // Registers `name` if it is new; throws std::length_error past kMaxPieceTypes
+  uint8_t pieceTypeId(const std::string& name);
+  // 0 if `name` is not registered
+  uint8_t findPieceType(std::string_view name) const;
+  // The config's piece types, custom ones included, then the standard ones
+  // (which notation and promotions may add), so every board of one config
+  // numbers its types alike
+  void registerPieceTypes(const GameConfig& config);
+  // Forgets the types registered after the first `count` (the empty type
+  // counts); the board must not hold any of them
+  void truncatePieceTypes(size_t count);
+  size_t pieceTypeCount() const { return piece_types.size(); }
+  const PieceType& pieceType(uint8_t type) const { return piece_types[type]; }
+  // Kind a type name gets when registered (Custom for non-standard names)
+  static PieceKind kindOfName(const std::string& name);
+
+  // Square indexes used by EncodedMove
+  int squareIndex(const Position& pos) const { return pos.y * board_size + pos.x; }
+  Position squarePosition(int index) const { return Position{index % board_size, index / board_size}; }
+
+  // Game state carried by the board
+  bool isWhiteToMove() const { return white_to_move; }
+  // For setting up positions piece by piece (tablebases); games flip it in applyMove
+  void setWhiteToMove(bool is_white) { white_to_move = is_white; }
+  uint8_t getCastlingRights() const { return castling_rights; }
+  void setCastlingRights(uint8_t rights) { castling_rights = rights; }
+  bool hasCastlingRight(bool is_white, bool kingside) const;
+  int getEnPassantSquare() const { return en_passant_square; }
+  void setEnPassantSquare(int index) { en_passant_square = index; }
+
+  // Occupancy masks (only when hasLineMasks()). Rank and diagonal masks are
+  // indexed by x, file masks by y. Diagonal d = x - y + size - 1 runs up-right,
+  // anti-diagonal a = x + y runs up-left.
+  bool hasLineMasks() const { return board_size <= kMaxMaskedBoardSize; }
+  bool isSparse() const { return !hasLineMasks(); }
+  uint32_t lineMask() const { return board_size >= 32 ? ~0u : (1u << board_size) - 1; }
+  uint32_t rankOccupancy(int y) const { return rank_occupancy[y]; }
+  uint32_t fileOccupancy(int x) const { return file_occupancy[x]; }
+  uint32_t diagonalOccupancy(int d) const { return diagonal_occupancy[d]; }
+  uint32_t antiDiagonalOccupancy(int a) const { return anti_diagonal_occupancy[a]; }
+  // board_size consecutive rank masks of one color and kind
+  const uint32_t* pieceRanks(bool is_white, PieceKind kind) const {
+    return &piece_rank_masks[(static_cast<size_t>(is_white) * kPieceKindCount + static_cast<size_t>(kind)) * board_size];
+  }
+
+  // Squares a slider at `from` reaches in direction (dx, dy), counting the
+  // first occupied square. Sparse boards binary-search their line indexes.
+  int rayLength(const Position& from, int dx, int dy) const;
+
+  // Calls f(Position, const Square&) for every occupied square in rank order
+  // until f returns true; returns whether it did
+  template <typename F>
+  bool forEachPiece(F&& f) const {
+    if (isSparse()) {
+      for (const auto& occupant : pieces) {
+        if (f(squarePosition(occupant.index), occupant.square)) return true;
+      }
+      return false;
+    }
+    for (size_t i = 0; i < squares.size(); ++i) {
+      if (!squares[i].is_empty() && f(squarePosition(static_cast<int>(i)), squares[i])) return true;
+    }
+    return false;
+  }
+
+  // Zobrist key of the piece placement only, maintained incrementally
+  uint64_t getPlacementHash() const { return placement_hash; }
+  // Full position key: placement, side to move, castling, en passant and portal cooldowns
+  uint64_t positionKey(const PortalSystem& portal_system) const;
+
+  // Encoded moves: applyMove records what undoMove needs to restore the exact prior state
+  EncodedMove encodeMove(const Position& start, const Position& end,
+                         PromotionPiece promotion = PromotionPiece::Queen) const;
+  void applyMove(EncodedMove move, PortalSystem& portal_system, UndoRecord& undo);
+  void undoMove(EncodedMove move, const UndoRecord& undo, PortalSystem& portal_system);
   
   // Special moves
   Position notationToPosition(const std::string& notation) const;
+  static bool parseNotation(const std::string& notation, Position& pos);
+  static std::string fileName(int x);
+  std::string moveToNotation(EncodedMove move) const;
+  // Parses moveToNotation() text against this position; false if malformed
+  bool parseMove(const std::string& text, EncodedMove& move) const;
+  // The moves played in turn from this position, space separated. A move
+  // that ends in a portal names it and its exit: d1h5[portal:P1>a6]. The
+  // position is the same afterwards.
+  std::string lineToNotation(const std::vector<EncodedMove>& moves, PortalSystem& portal_system);
   std::string positionToNotation(const Position& pos) const;
-  void handlePawnPromotion(const Position& pos, bool is_white);
-  void handleCastling(const Position& king_start, const Position& king_end);
+  bool isPromotionRank(int y, bool is_white) const;
 
 private:
-  std::unordered_map<std::string, Square> board;
+  struct Occupant {
+    int index;
+    Square square;
+  };
+  enum class Line : uint8_t { Rank, File, Diagonal, AntiDiagonal };
+  static constexpr int kLineCount = 4;
+
+  std::vector<Square> squares;  // board_size * board_size, row-major from a1 (dense boards only)
+  // Sparse boards: occupied squares sorted by index (which is also rank order),
+  // and sorted lineKey()s for files and both diagonals. Index 0 (ranks) is unused.
+  std::vector<Occupant> pieces;
+  std::vector<int> line_keys[kLineCount];
+  std::vector<PieceType> piece_types;  // index 0 is the empty square
   int board_size;
+  bool white_to_move = true;
+  uint8_t castling_rights = 0;
+  int en_passant_square = -1;
+  uint64_t placement_hash = 0;
+  std::vector<uint32_t> rank_occupancy;
+  std::vector<uint32_t> file_occupancy;
+  std::vector<uint32_t> diagonal_occupancy;
+  std::vector<uint32_t> anti_diagonal_occupancy;
+  std::vector<uint32_t> piece_rank_masks;  // [color][kind][rank]
   std::string board_display_format; 
-  std::string posToString(const Position& pos) const;
+  void clearLineMasks();
+  void toggleLineMasks(int index, const Square& square);
+  const Square& at(int index) const;
+  void put(int index, Square square);
+  void putSparse(int index, const Square& old, const Square& square);
+  int lineKey(Line line, int x, int y) const;
+  PromotionPiece promptPromotion() const;
+  uint8_t promotionType(PromotionPiece promotion);
+  uint8_t castlingMask(int index) const;
 };
 
-#endif
\ No newline at end of file
+#endif
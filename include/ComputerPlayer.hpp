@@ -0,0 +1,93 @@
+// ComputerPlayer.hpp
+#ifndef COMPUTER_PLAYER_HPP
+#define COMPUTER_PLAYER_HPP
+#include "ChessBoard.hpp"
+#include "ConfigReader.hpp"
+#include "GameManager.hpp"
+#include "MoveValidator.hpp"
+#include "PortalSystem.hpp"
+#include "Search.hpp"
+#include "TranspositionTable.hpp"
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+// The computer side of an interactive game. Every search runs on a
+// background thread over a private copy of the game, so the input loop is
+// never blocked; a finished move is announced on an eventfd the loop can
+// poll together with stdin.
+//
+// While the human thinks, the player ponders: it guesses the reply with a
+// short search, then searches the position after it with no time limit.
+// If the human plays the guess, the same search carries on under the move
+// time (Search::ponderhit), keeping every iteration it has finished;
+// otherwise it is stopped and a fresh search starts.
+//
+// Every search goes through one transposition table that lives as long as
+// the player, so a ponderhit keeps it warm and the search for the next move
+// starts from what the last ones found.
+class ComputerPlayer {
+public:
+  static constexpr size_t kHashMb = 16;
+
+  ComputerPlayer(const GameConfig& config, int64_t movetime_ms);
+  ~ComputerPlayer();
+  ComputerPlayer(const ComputerPlayer&) = delete;
+  ComputerPlayer& operator=(const ComputerPlayer&) = delete;
+
+  // Readable once takeMove() has a move
+  int readyFd() const { return ready_fd_; }
+
+  // Starts choosing a move for the side to move in the game
+  void think(const ChessBoard& board, const PortalSystem& portal_system, const GameManager& game_manager);
+  // Starts pondering the game, the opponent to move
+  void ponder(const ChessBoard& board, const PortalSystem& portal_system, const GameManager& game_manager);
+  // The opponent's move was played in the game: turns a ponder search
+  // that guessed it into the search for the reply, or starts a new one
+  void opponentMoved(EncodedMove move, const ChessBoard& board, const PortalSystem& portal_system,
+                     const GameManager& game_manager);
+  // Moves now with the best move found so far
+  void moveNow();
+  // Abandons any search
+  void cancel();
+
+  // The chosen move; false if the side to move has none. Call once readyFd()
+  // is readable.
+  bool takeMove(EncodedMove& move);
+
+  // Ponder searches whose guess was played, out of all ponder searches
+  size_t ponderHits() const { return ponder_hits_; }
+  size_t ponderSearches() const { return ponder_searches_; }
+
+  // Thread-safe, so the game's own searches (hint) can share it while the
+  // player searches on its thread
+  TranspositionTable& transpositionTable() { return table_; }
+
+private:
+  // Stops and joins the background thread
+  void join();
+  void copyGame(const ChessBoard& board, const PortalSystem& portal_system, const GameManager& game_manager);
+  void signalReady();
+
+  int64_t movetime_ms_;
+  ChessBoard board_;
+  MoveValidator validator_;
+  PortalSystem portal_system_;
+  GameManager game_manager_;
+  TranspositionTable table_;
+  Search search_;
+  std::thread thread_;
+  int ready_fd_ = -1;
+
+  std::mutex mutex_;
+  Search::Result result_;
+  bool finished_ = false;         // the search returned, result_ is set
+  bool pondering_ = false;        // a ponder search is running or done
+  bool guessed_ = false;          // guess_ is set and played on the copy
+  EncodedMove guess_;
+  bool hit_ = false;              // the opponent played guess_
+  size_t ponder_hits_ = 0;
+  size_t ponder_searches_ = 0;
+};
+
+#endif
@@ -1,6 +1,6 @@
 #pragma once
+#include <cstdint>
 #include <memory>
-#include <nlohmann/json.hpp>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -13,6 +13,7 @@ struct PieceConfig;
 struct PortalProperties;
 struct PortalConfig;
 struct GameConfig;
+class JsonReader;
 
 // Position on the chess board
 struct Position {
@@ -41,10 +42,20 @@ struct SpecialAbilities {
   std::unordered_map<std::string, bool> custom_abilities;
 };
 
+// Start squares of a piece type, per color
+struct PiecePositions {
+  std::vector<Position> white;
+  std::vector<Position> black;
+
+  bool empty() const { return white.empty() && black.empty(); }
+  std::vector<Position> &of(bool is_white) { return is_white ? white : black; }
+  const std::vector<Position> &of(bool is_white) const { return is_white ? white : black; }
+};
+
 // Configuration for a chess piece
 struct PieceConfig {
   std::string type;
-  std::unordered_map<std::string, std::vector<Position>> positions;
+  PiecePositions positions;
   Movement movement;
   SpecialAbilities special_abilities;
   int count;
@@ -52,9 +63,9 @@ struct PieceConfig {
 
 // Properties for portals
 struct PortalProperties {
-  bool preserve_direction;
+  bool preserve_direction = true;
   std::vector<std::string> allowed_colors;
-  int cooldown;
+  int cooldown = 0;
 };
 
 // Configuration for a portal
@@ -81,14 +92,24 @@ struct GameConfig {
   std::vector<PortalConfig> portals;
 };
 
+// Fingerprint of everything that decides positions and their keys: board
+// size, piece types in config order, start squares and portals. Files that
+// store positions or moves (opening books, game records) carry it so they
+// are only used with the config they were made for.
+uint64_t configHash(const GameConfig &config);
+
 class ConfigReader {
 public:
   // Constructor
   ConfigReader();
 
-  // Load configuration from a file
+  // Load configuration from a file. A compiled image of it (see
+  // writeCompiled) is used instead of the JSON as long as it is fresh.
   bool loadFromFile(const std::string &filePath);
 
+  // Load configuration from a JSON file, ignoring any compiled image
+  bool loadFromJsonFile(const std::string &filePath);
+
   // Load configuration from a JSON string
   bool loadFromString(const std::string &jsonString);
 
@@ -98,22 +119,48 @@ public:
   // Validate the configuration
   bool validateConfig();
 
+  // Why the last load or validation failed. Line and column (1-based) are
+  // set for errors in the JSON text, 0 otherwise.
+  struct LoadError {
+    std::string message;
+    size_t line = 0;
+    size_t column = 0;
+  };
+  const LoadError &getLastError() const { return m_lastError; }
+  // Keep errors out of std::cerr (batch tools report getLastError instead)
+  void setQuiet(bool quiet) { m_quiet = quiet; }
+
+  // Compiled images: the loaded (and validated) configuration in a
+  // versioned, checksummed binary file next to its JSON source, stamped with
+  // the source's size and modification time. Short-lived processes map it
+  // instead of parsing the JSON; once the source changes it is stale and
+  // ignored until compiled again.
+  static std::string compiledPath(const std::string &sourcePath);
+  bool writeCompiled(const std::string &sourcePath) const;
+  // Whether the last load came from a compiled image
+  bool loadedFromCompiled() const { return m_fromCompiled; }
+
 private:
   GameConfig m_config;
-
-  // Parse game settings from JSON
-  void parseGameSettings(const nlohmann::json &json);
-
-  // Parse pieces from JSON
-  void parsePieces(const nlohmann::json &json);
-
-  // Parse custom pieces from JSON
-  void parseCustomPieces(const nlohmann::json &json);
-
-  // Parse portals from JSON
-  void parsePortals(const nlohmann::json &json);
-
-  // Parse special abilities from JSON
-  void parseSpecialAbilities(const nlohmann::json &abilities,
+  bool m_fromCompiled = false;
+  bool m_quiet = false;
+  LoadError m_lastError;
+
+  // Records (and unless quiet, prints) an error; always returns false
+  bool reportError(const std::string &message);
+
+  // Load a fresh compiled image of `sourcePath`; false if there is none
+  bool loadCompiled(const std::string &sourcePath);
+
+  // JSON is read in one streaming pass (JsonReader) straight into
+  // m_config; nothing else is built for the document
+  bool parse(JsonReader &reader);
+  void parseGameSettings(JsonReader &reader);
+  // Shared by "pieces" and "custom_pieces"
+  void parsePieces(JsonReader &reader, std::vector<PieceConfig> &pieces);
+  void parsePositions(JsonReader &reader, PiecePositions &positions);
+  void parseMovement(JsonReader &reader, Movement &movement);
+  void parseSpecialAbilities(JsonReader &reader,
                              SpecialAbilities &specialAbilities);
+  void parsePortals(JsonReader &reader);
 };
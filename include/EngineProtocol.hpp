@@ -0,0 +1,102 @@
+// EngineProtocol.hpp
+#ifndef ENGINE_PROTOCOL_HPP
+#define ENGINE_PROTOCOL_HPP
+#include "ChessBoard.hpp"
+#include "ConfigReader.hpp"
+#include "GameManager.hpp"
+#include "Mcts.hpp"
+#include "MoveValidator.hpp"
+#include "OpeningBook.hpp"
+#include "PortalSystem.hpp"
+#include "PositionNotation.hpp"
+#include "Search.hpp"
+#include "Tablebase.hpp"
+#include <condition_variable>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Line protocol for driving the engine from other programs, modelled on UCI.
+// Moves use ChessBoard::moveToNotation ("e2e4", "e7e8q", "ab12ab14"), which
+// also covers portal moves and boards past 8x8; custom pieces take their
+// letters in XFEN from the config.
+//
+// go starts the search on a background thread and the input thread keeps
+// reading, so stop, ponderhit and isready are answered while it runs; stop
+// brings the bestmove within a node of search. Any other command waits for
+// a running search to finish first, stopping it if it is infinite or
+// pondering, so scripted sessions play out in order.
+//   uci                      -> id and option lines, uciok
+//   isready                  -> readyok
+//   ucinewgame               reset to the config's start position
+//   setoption name Engine value alphabeta|mcts
+//   setoption name Threads value N      (MCTS search threads)
+//   setoption name Tablebase value FILE (alpha-beta probes it; repeat for more tables)
+//   setoption name Book value FILE      (go answers from the book while it has the position)
+//   setoption name Ponder value true|false  (accepted; go ponder always works)
+//   position startpos [moves m1 m2 ...]
+//   position fen XFEN [moves m1 m2 ...]  (PositionNotation; trailing fields optional)
+//   go [depth N] [nodes N] [movetime MS] [wtime MS] [btime MS] [winc MS] [binc MS]
+//      [infinite] [ponder]   -> info lines per iteration, then bestmove; MCTS
+//                               reads nodes as playouts and ignores depth.
+//                               infinite searches until stop; ponder searches
+//                               the position after the predicted move with no
+//                               limit until ponderhit. Neither sends its
+//                               bestmove before stop (or ponderhit, for ponder)
+//   stop                     -> bestmove now
+//   ponderhit                the predicted move was played: the go's limits
+//                            start counting
+//   quit
+class EngineProtocol {
+public:
+  explicit EngineProtocol(const GameConfig& config);
+  ~EngineProtocol();
+  int run(std::istream& in, std::ostream& out);
+
+private:
+  // Back to the start position, or to `position` (PositionNotation) if not
+  // empty; false if it does not parse
+  bool resetGame(const std::string& position = "");
+  void handlePosition(std::istream& args, std::ostream& out);
+  void handleSetOption(std::istream& args, std::ostream& out);
+  void handleGo(std::istream& args, std::ostream& out);
+  // Body of the search thread: think, hold the bestmove while infinite or
+  // pondering, then send it
+  void searchThread(Search::Limits limits, bool infinite, std::ostream& out);
+  // Stops a running search and waits for its bestmove
+  void stopSearch();
+  // Waits for a running search to reach its limits; an infinite or
+  // pondering one, which never would, is stopped
+  void finishSearch();
+  void ponderhit();
+  std::string formatScore(int score) const;
+
+  const GameConfig& config_;
+  ChessBoard board_;
+  MoveValidator validator_;
+  PortalSystem portal_system_;
+  GameManager game_manager_;
+  Search search_;
+  Mcts mcts_;
+  bool use_mcts_ = false;
+  PositionNotation notation_;
+  std::string start_position_;       // PositionNotation text, empty for startpos
+  std::vector<std::string> played_;  // moves of the current position, as received
+  std::vector<EncodedMove> legal_;   // reused by move checks
+  std::vector<std::unique_ptr<Tablebase>> tablebases_;
+  OpeningBook book_;
+  std::mt19937_64 book_rng_{std::random_device{}()};
+
+  std::thread search_thread_;
+  std::mutex search_mutex_;
+  std::condition_variable released_;
+  bool infinite_ = false;   // hold the bestmove until stop
+  bool pondering_ = false;  // hold the bestmove until stop or ponderhit
+  std::mutex out_mutex_;    // the search thread writes info and bestmove lines
+};
+
+#endif
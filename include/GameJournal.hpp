@@ -0,0 +1,83 @@
+// GameJournal.hpp
+#ifndef GAME_JOURNAL_HPP
+#define GAME_JOURNAL_HPP
+#include "ConfigReader.hpp"
+#include "MoveEncoding.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ChessBoard;
+class GameManager;
+class PortalSystem;
+
+// Crash-safe storage for one game session: a binary snapshot of the whole
+// session (pieces, side to move, castling, en passant, portal cooldowns, and
+// the move history with its undo records) in PATH.snap, plus an append-only
+// write-ahead log of moves, undos and redos in PATH.wal. Every log record is
+// written with its own write() as it happens, so a crashed process loses
+// nothing; recover() loads the snapshot and replays only the log records made
+// after it.
+//
+// Both files carry a generation number. snapshot() writes PATH.snap under a
+// temporary name, renames it over the old one and then starts an empty log
+// of the new generation, so a crash at any point leaves either the old
+// snapshot with its log, or the new snapshot with a log it already covers.
+// Log records carry a checksum of their generation and position; a torn or
+// stale record ends the log and is cut off on recovery.
+class GameJournal {
+public:
+  GameJournal() = default;
+  ~GameJournal() { close(); }
+  GameJournal(const GameJournal&) = delete;
+  GameJournal& operator=(const GameJournal&) = delete;
+
+  // Whether PATH.snap exists, i.e. there is a session to recover
+  static bool exists(const std::string& path);
+
+  // Starts a new journal for the session as it is now; false if the files
+  // cannot be written
+  bool create(const std::string& path, const GameConfig& config, const ChessBoard& board,
+              const PortalSystem& portal_system, const GameManager& game_manager);
+  // Restores the session into `board` (with the config's piece types),
+  // `portal_system` and `game_manager`, then keeps the journal open for
+  // appending. The game manager is detached while the log is replayed;
+  // call setJournal() after.
+  // On failure `error` (if given) points to a static description.
+  bool recover(const std::string& path, const GameConfig& config, ChessBoard& board, PortalSystem& portal_system,
+               GameManager& game_manager, const char** error = nullptr);
+  // Writes a new snapshot and empties the log
+  bool snapshot(const ChessBoard& board, const PortalSystem& portal_system, const GameManager& game_manager);
+  void close();
+  bool isOpen() const { return log_fd_ >= 0; }
+
+  // Log records, fed by GameManager once attached with setJournal()
+  void logMove(EncodedMove move) { append(Op::Move, move); }
+  void logUndo() { append(Op::Undo, EncodedMove{}); }
+  void logRedo() { append(Op::Redo, EncodedMove{}); }
+
+  // Records in the current log, and how many recover() replayed
+  size_t logRecords() const { return records_; }
+  size_t replayedRecords() const { return replayed_; }
+  // fdatasync() every record and snapshot, to survive power loss as well as
+  // a crashed process (off by default)
+  void setSync(bool sync) { sync_ = sync; }
+
+private:
+  enum class Op : uint8_t { Move = 1, Undo = 2, Redo = 3 };
+
+  void append(Op op, EncodedMove move);
+  bool startLog();
+
+  std::string path_;
+  uint64_t config_hash_ = 0;
+  uint64_t generation_ = 0;
+  int log_fd_ = -1;
+  size_t records_ = 0;
+  size_t replayed_ = 0;
+  bool sync_ = false;
+  std::vector<uint8_t> buffer_;  // reused for snapshots and reading the log
+};
+
+#endif
@@ -1,37 +1,113 @@
-//#ifndef GAME_MANAGER_HPP
+#ifndef GAME_MANAGER_HPP
 #define GAME_MANAGER_HPP
-#include <stack>
+#include <atomic>
+#include <memory>
+#include <memory_resource>
+#include <vector>
 #include "ConfigReader.hpp"
+#include "MoveEncoding.hpp"
+#include "RepetitionHistory.hpp"
+#include "ThreadPool.hpp"
 
 
 class ChessBoard;
 class MoveValidator;
 class PortalSystem;
+class GameRecordWriter;
+class GameJournal;
 
 class GameManager {
 public:
-    struct Move {
-    Position start;
-    Position end;
-    std::string moved_piece;
-    bool moved_piece_color; // true white, false black
-    std::string captured_piece;
-    bool captured_piece_color;
-};
+    // Boards at least this wide split legal-move searches across the status
+    // pool; smaller boards finish faster on the calling thread than it takes
+    // to wake the workers. Where that crossing lies depends on the machine,
+    // so unless setParallelStatusThreshold() overrides it the cut-over is
+    // measured once per process (see measuredParallelStatusMinBoardSize()).
+    static constexpr int kMeasuredParallelStatusThreshold = -1;
 
+    // Plies without a capture, pawn move or castling-rights change before a draw
+    static constexpr int kFiftyMoveRulePlies = 100;
 
     GameManager(ChessBoard& board, MoveValidator& validator, PortalSystem& portal_system);
     bool isInCheck(bool is_white_turn) const;
     bool isCheckmate(bool is_white_turn);
     bool isStalemate(bool is_white_turn) const;
-    void addToMoveHistory(const Move& move);
-    void undoMove(); 
+    bool hasLegalMove(bool is_white_turn) const;
+    // Every move the side can make that leaves its king safe, by the same
+    // rules as hasLegalMove(); promotions appear once per promotion piece
+    void generateLegalMoves(bool is_white_turn, std::vector<EncodedMove>& moves) const;
+    // The same, polling `cancel` between candidate moves; once it is raised,
+    // returns false with `moves` incomplete
+    bool generateLegalMoves(bool is_white_turn, std::vector<EncodedMove>& moves,
+                            const std::atomic<bool>& cancel) const;
+    // Whether `move` is among generateLegalMoves() for the side to move,
+    // checked without generating the others
+    bool isLegalMove(EncodedMove move) const;
+
+    // Move history: played moves are [0, history_ply); anything after that
+    // is the redo tail, dropped as soon as a different move is made.
+    void makeMove(EncodedMove move);
+    bool undoMove(bool verbose = true);
+    bool redoMove(bool verbose = true);
+    size_t getHistorySize() const { return history_ply; }
+    const std::vector<EncodedMove>& getMoveHistory() const { return move_history; }
+    // Undo records of the played moves, [0, getHistorySize())
+    const std::vector<UndoRecord>& getUndoHistory() const { return undo_history; }
+    const UndoRecord& lastUndoRecord() const { return undo_history[history_ply - 1]; }
+    // Takes over a saved history for the board as it stands after its first
+    // `ply` moves; `undos` holds their undo records. Repetition keys are
+    // rebuilt by stepping the board back to the start and forward again.
+    void restoreHistory(std::vector<EncodedMove> moves, std::vector<UndoRecord> undos, size_t ply);
+
+    // Draw detection. The turn limit counts plies (one player's move each);
+    // 0 disables it. Returns nullptr when the game is not drawn.
+    void setTurnLimit(int limit) { turn_limit = limit; }
+    const char* getDrawReason() const;
+    bool isThreefoldRepetition() const { return repetition.isThreefold(); }
+    int getHalfmoveClock() const { return repetition.halfmoveClock(); }
+    const RepetitionHistory& getRepetitionHistory() const { return repetition; }
+    // Forget the history and start counting from the board as it is now
+    void resetHistory();
+
+    // Whether `move`, just applied with `undo`, restarts the halfmove clock
+    // (no earlier position can repeat across it)
+    bool isIrreversible(EncodedMove move, const UndoRecord& undo) const;
+
+    // Override the serial/parallel cut-over (used by benchmarks)
+    void setParallelStatusThreshold(int min_board_size) { parallel_status_min_board_size = min_board_size; }
+    // The worst case `bench status` times (every piece blocked, no legal
+    // move), run serially and on the pool at growing widths up to the masked
+    // board limit: the first width from which the pool is 10% faster twice in
+    // a row, or kMaxBoardSize + 1 (never) with one hardware thread or no such
+    // win. Measured on first use, in well under 0.1 s, and kept for the process.
+    static int measuredParallelStatusMinBoardSize();
+    // Moves made, undone and redone from now on are passed on to `writer` (null to stop)
+    void setRecorder(GameRecordWriter* writer) { recorder = writer; }
+    // The same for a session's write-ahead log
+    void setJournal(GameJournal* log) { journal = log; }
+
+    static bool isKingAttacked(const ChessBoard& board, bool is_white, const MoveValidator& validator,
+                               const PortalSystem& portal_system);
 
 private:
     ChessBoard& chess_board;
     MoveValidator& validator;
     PortalSystem& portal_system; 
-    std::stack<Move> move_history;
+    std::vector<EncodedMove> move_history;
+    std::vector<UndoRecord> undo_history;
+    size_t history_ply = 0;
+    RepetitionHistory repetition;
+    int turn_limit = 0;
+    int parallel_status_min_board_size = kMeasuredParallelStatusThreshold;
+    mutable std::unique_ptr<ThreadPool> status_pool;
+    GameRecordWriter* recorder = nullptr;
+    GameJournal* journal = nullptr;
+
+    bool hasLegalMoveInRange(ChessBoard& board, bool is_white_turn, const std::pmr::vector<Position>& pieces,
+                             size_t begin, size_t end, const std::atomic<bool>& cancel) const;
+    bool leavesKingSafe(ChessBoard& board, const Position& start, const Position& target,
+                        bool is_white_turn) const;
+    ThreadPool& statusPool() const;
 };
 
-//#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,105 @@
+// GameRecord.hpp
+#ifndef GAME_RECORD_HPP
+#define GAME_RECORD_HPP
+#include "ConfigReader.hpp"
+#include "MappedFile.hpp"
+#include "MoveEncoding.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+enum class GameResult : uint8_t { WhiteWin, BlackWin, Draw, Unknown };
+
+// "1-0", "0-1", "1/2-1/2" or "*"
+const char* resultText(GameResult result);
+bool parseResult(const std::string& text, GameResult& result);
+
+// Binary game archives. A file starts with a 24-byte header (magic,
+// configHash of the config the games were played with, board size); every
+// game follows as varints for its ply count and the byte length of its moves,
+// a result byte, then one varint per move: (from * squares + to) << 2 |
+// MoveKind, plus a byte for the piece of a promotion. On 8x8 boards a move
+// takes two bytes. Games always start from the config's start position.
+
+// Appends games to an archive, one game at a time. Moves of the game in
+// progress are kept until finishGame(), so undone moves never reach the file;
+// GameManager feeds it from makeMove/undoMove/redoMove once attached with
+// setRecorder().
+class GameRecordWriter {
+public:
+  // Creates the archive, or appends to it if it already holds games for the
+  // same config; false if it cannot be written or belongs to another config
+  bool open(const std::string& path, const GameConfig& config);
+  bool isOpen() const { return out_.is_open(); }
+
+  void addMove(EncodedMove move) { current_.push_back(move); }
+  void removeLastMove() {
+    if (!current_.empty()) current_.pop_back();
+  }
+  size_t currentPlies() const { return current_.size(); }
+  // Writes the game in progress (if it has moves) and starts a new one
+  void finishGame(GameResult result);
+  void writeGame(const std::vector<EncodedMove>& moves, GameResult result);
+  void flush() { out_.flush(); }
+  size_t games() const { return games_; }
+
+private:
+  std::ofstream out_;
+  int squares_ = 0;
+  std::vector<EncodedMove> current_;
+  std::vector<uint8_t> buffer_;  // reused for encoding
+  size_t games_ = 0;
+};
+
+// Reads an archive in place from a memory mapping. Games and moves are
+// decoded on the fly from the mapped bytes, so iterating allocates nothing.
+class GameRecordReader {
+public:
+  struct Game {
+    GameResult result = GameResult::Unknown;
+    uint32_t plies = 0;
+    const uint8_t* moves = nullptr;  // encoded moves, up to `end`
+    const uint8_t* end = nullptr;
+  };
+
+  // Decodes one game's moves
+  class MoveCursor {
+  public:
+    MoveCursor(const Game& game, int board_size)
+        : next_(game.moves), end_(game.end), left_(game.plies), squares_(board_size * board_size) {}
+    // False after the last move or on corrupt data
+    bool next(EncodedMove& move);
+
+  private:
+    const uint8_t* next_;
+    const uint8_t* end_;
+    uint32_t left_;
+    int squares_;
+  };
+
+  // False if the file is missing, not an archive, or made with another config
+  bool open(const std::string& path, const GameConfig& config);
+  bool isOpen() const { return file_.isOpen(); }
+  int boardSize() const { return board_size_; }
+  size_t bytes() const { return file_.size(); }
+  // Moves to the next game; false at the end of the file or on a truncated game
+  bool next(Game& game);
+  void rewind() { next_ = begin_; }
+  // Byte offset of the next game, for splitting an archive between readers
+  size_t tell() const { return static_cast<size_t>(next_ - begin_); }
+  void seek(size_t offset) { next_ = begin_ + std::min(offset, static_cast<size_t>(end_ - begin_)); }
+  // Whether next() stopped before the end of the file
+  bool truncated() const { return next_ != end_; }
+
+private:
+  MappedFile file_;
+  const uint8_t* begin_ = nullptr;
+  const uint8_t* next_ = nullptr;
+  const uint8_t* end_ = nullptr;
+  int board_size_ = 0;
+};
+
+#endif
@@ -0,0 +1,127 @@
+// GameServer.hpp
+#ifndef GAME_SERVER_HPP
+#define GAME_SERVER_HPP
+#include "ConfigReader.hpp"
+#include "PositionNotation.hpp"
+#include "ThreadPool.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Hosts many games of one config in a single process: one game per
+// connection, over a line protocol on a Unix domain socket or 127.0.0.1
+// TCP. A single epoll loop owns every socket and session; searches run on a
+// worker pool and hand their replies back to the loop through an eventfd.
+//
+// Sessions (board, portal system, game manager and search) come from a pool
+// and go back to it when their connection closes. A reused session keeps
+// the storage it grew (move lists, history, scratch vectors), so a
+// steady-state server does not allocate per game, and the memory and
+// latency of one game do not depend on how many others are running.
+//
+// Every request is one line and gets one reply line:
+//   new [XFEN]       start over from the config's setup or a position -> ok
+//   move MOVE        play a move (ChessBoard::moveToNotation text)
+//                    -> ok [check | checkmate | stalemate | draw REASON]
+//   undo             take back the last move -> ok
+//   position         -> position XFEN
+//   legal            -> legal MOVE...
+//   go [depth N] [movetime MS] [nodes N]
+//                    search on the worker pool (depth 3 with no limit);
+//                    -> bestmove MOVE score CP depth D nodes N, or bestmove 0000
+//   stop             cut a running go short; only its bestmove replies
+//   isready          -> readyok
+//   quit             -> bye, then the server closes the connection
+// Failures reply "error ...". While a go runs, only stop, isready and quit
+// are accepted; anything else gets "error busy". A client that shuts down
+// its side (end of file) still gets every reply, a running go's included,
+// before the server closes the connection.
+class GameServer {
+public:
+  struct Options {
+    std::string unix_path;  // listen on this Unix domain socket ...
+    int tcp_port = -1;      // ... or on 127.0.0.1:port (0 picks a free port)
+    unsigned workers = std::thread::hardware_concurrency();
+    size_t max_sessions = 10000;
+  };
+
+  GameServer(const GameConfig& config, const Options& options);
+  ~GameServer();
+  GameServer(const GameServer&) = delete;
+  GameServer& operator=(const GameServer&) = delete;
+
+  // Binds and listens; false (with `error`) if the address cannot be used
+  bool start(std::string* error = nullptr);
+  // The bound TCP port, after start()
+  int port() const { return port_; }
+  // Serves until stop(); call after start()
+  void run();
+  // Safe from any thread (and from signal handlers)
+  void stop();
+
+  size_t activeSessions() const { return active_sessions_.load(std::memory_order_relaxed); }
+  // Sessions ever created: the pool's high-water mark
+  size_t pooledSessions() const { return pooled_sessions_.load(std::memory_order_relaxed); }
+
+private:
+  struct Session;
+  struct Connection;
+  struct Completion {
+    uint64_t connection;
+    std::string reply;
+  };
+
+  Session* acquireSession();
+  void releaseSession(Session* session);
+
+  void acceptConnections();
+  void readFrom(Connection& connection);
+  // Replies `error ...` to a request that throws, so one client cannot
+  // take down the others
+  void handleLine(Connection& connection, const std::string& line);
+  void handleCommand(Connection& connection, const std::string& line);
+  void handleGo(Connection& connection, std::istream& args);
+  void cancelSearch(Connection& connection);
+  void send(Connection& connection, const std::string& reply);
+  void flush(Connection& connection);
+  // Closes the socket; the connection (and its session) is dropped by
+  // sweepClosed() once no search is using it
+  void close(Connection& connection);
+  void sweepClosed();
+  void drainCompletions();
+  void watch(Connection& connection, bool want_write);
+
+  const GameConfig& config_;
+  Options options_;
+  PositionNotation notation_;
+  int listen_fd_ = -1;
+  int epoll_fd_ = -1;
+  int wake_fd_ = -1;  // eventfd: stop() and finished searches
+  int port_ = -1;
+  std::atomic<bool> stopping_{false};
+
+  std::vector<std::unique_ptr<Session>> sessions_;  // every session ever made
+  std::vector<Session*> free_sessions_;
+  std::atomic<size_t> active_sessions_{0};
+  std::atomic<size_t> pooled_sessions_{0};
+
+  std::unordered_map<uint64_t, std::unique_ptr<Connection>> connections_;
+  uint64_t next_connection_id_ = 2;  // 0 and 1 tag the listener and the eventfd
+  std::vector<uint64_t> closed_;      // closed connections not yet dropped
+
+  std::mutex completions_mutex_;
+  std::vector<Completion> completions_;
+  std::vector<Completion> drained_;  // swapped with completions_ by the loop
+
+  // Last member: destroyed (and joined) first, while sessions still exist
+  std::unique_ptr<ThreadPool> workers_;
+};
+
+#endif
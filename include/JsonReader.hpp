@@ -0,0 +1,83 @@
+// JsonReader.hpp
+#ifndef JSON_READER_HPP
+#define JSON_READER_HPP
+#include <cstddef>
+#include <istream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Streaming JSON reader. The caller pulls the document one value at a time
+// in the order it appears (SAX style, driven by the caller's schema) while
+// the text flows through a fixed buffer, so nothing is built for the
+// document as a whole and memory stays flat however large it is. Every
+// error, syntax or schema, is reported with the line and column it was
+// found at.
+//
+//   reader.beginObject();
+//   while (reader.nextKey(key)) {
+//     if (key == "size") size = reader.readInt();
+//     else reader.skipValue();
+//   }
+class JsonReader {
+public:
+  enum class Type { Object, Array, String, Number, Bool, Null };
+
+  struct Error : std::runtime_error {
+    Error(const std::string& message, size_t line, size_t column);
+    std::string message;  // what() without the location
+    size_t line;
+    size_t column;
+  };
+
+  explicit JsonReader(std::istream& in);
+  explicit JsonReader(std::string_view text);
+
+  // Type of the next value
+  Type peek();
+
+  void beginObject();
+  // Reads the next key of the current object; false at its closing brace
+  bool nextKey(std::string& key);
+  void beginArray();
+  // Whether the current array has another element
+  bool nextElement();
+
+  std::string readString();
+  int readInt();  // fractions are truncated; fails outside the range of int
+  double readNumber();
+  bool readBool();
+  void skipValue();
+  // After the top-level value: only whitespace may follow
+  void finish();
+
+  // Throws an Error at the start of the next token
+  [[noreturn]] void fail(const std::string& message);
+
+private:
+  static constexpr size_t kBufferSize = 1 << 16;
+
+  int peekChar();
+  int getChar();
+  void skipWhitespace();
+  void expect(char c, const char* what);
+  void readStringTo(std::string& out);
+  void readNumberText();
+  void readLiteral(const char* word);
+  std::string describe(int c) const;
+  // Closes the innermost container at `close`, or moves past the ',' before
+  // its next item; false once closed
+  bool nextItem(char close);
+
+  std::istream* in_ = nullptr;
+  const char* next_ = nullptr;
+  const char* end_ = nullptr;
+  char buffer_[kBufferSize];
+  size_t line_ = 1;
+  size_t column_ = 1;
+  std::string scratch_;     // number text and skipped strings
+  std::vector<bool> open_;  // per open container: no member or element read yet
+};
+
+#endif
@@ -0,0 +1,31 @@
+// MappedFile.hpp
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file. The mapping lives as long as the
+// object; pages are loaded by the OS on first touch, so opening a large file
+// costs nothing until it is read.
+class MappedFile {
+public:
+  MappedFile() = default;
+  ~MappedFile() { close(); }
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool open(const std::string& path);
+  void close();
+  bool isOpen() const { return data_ != nullptr; }
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+private:
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+#endif
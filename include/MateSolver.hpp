@@ -0,0 +1,69 @@
+// MateSolver.hpp
+#ifndef MATE_SOLVER_HPP
+#define MATE_SOLVER_HPP
+#include "MoveEncoding.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ChessBoard;
+class GameManager;
+class PortalSystem;
+
+// Depth-first proof-number search (df-pn) for forced mates: the side to move
+// attacks, and every node is keyed by its position and the attacker moves
+// left, so proofs and disproofs from one branch are reused wherever the
+// position recurs. Mate lengths are tried from 1 up, so the first proof is
+// the shortest mate. Repetition and fifty-move draws are not considered; a
+// mate within N moves never needs them. Moves are played on the game board
+// and undone, as in Search.
+class MateSolver {
+public:
+  enum class Status { Mate, NoMate, Unknown };
+
+  struct Result {
+    Status status = Status::Unknown;
+    int mate_in = 0;                // attacker moves, when status is Mate
+    std::vector<EncodedMove> line;  // attacker and defender moves up to the mate
+    bool line_complete = false;     // false if the budget ran out while reading the line back
+    size_t nodes = 0;
+  };
+
+  static constexpr uint32_t kInfinite = 1u << 30;
+
+  MateSolver(ChessBoard& board, GameManager& game_manager, PortalSystem& portal_system, size_t table_mb = 64);
+
+  // Mate in at most max_moves attacker moves. Unknown when node_budget runs out
+  // first; the mating line is read back from the table afterwards, with a
+  // budget of its own, and may stop short (line_complete) even though the
+  // mate itself is proven.
+  Result solve(int max_moves, size_t node_budget);
+
+private:
+  struct Entry {
+    uint64_t key = 0;
+    uint32_t phi = 1;
+    uint32_t delta = 1;
+  };
+
+  Status prove(int moves_left, bool attacker_to_move);
+  int mateDistance(int max_moves);
+  void search(int moves_left, bool attacker_to_move, uint32_t th_phi, uint32_t th_delta, int ply);
+  bool evaluateLeaf(int moves_left, bool attacker_to_move, std::vector<EncodedMove>& moves, uint32_t& phi,
+                    uint32_t& delta);
+  bool extractLine(int moves_left, std::vector<EncodedMove>& line);
+  uint64_t nodeKey(int moves_left, bool attacker_to_move) const;
+  Entry lookup(uint64_t key) const;
+  void store(uint64_t key, uint32_t phi, uint32_t delta);
+
+  ChessBoard& board_;
+  GameManager& game_manager_;
+  PortalSystem& portal_system_;
+  std::vector<Entry> table_;  // power-of-two size, always-replace
+  std::vector<std::vector<EncodedMove>> moves_by_ply_;
+  std::vector<std::vector<uint64_t>> keys_by_ply_;  // child node keys, parallel to the moves
+  size_t nodes_ = 0;
+  size_t budget_ = 0;
+};
+
+#endif
@@ -0,0 +1,112 @@
+// Mcts.hpp
+#ifndef MCTS_HPP
+#define MCTS_HPP
+#include "MoveEncoding.hpp"
+#include "ThreadPool.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+class ChessBoard;
+class GameManager;
+class PortalSystem;
+
+// Monte Carlo tree search over GameManager::generateLegalMoves, as an
+// alternative to alpha-beta for configs whose portals blow up the branching
+// factor. Nodes come from a fixed pool handed out with an atomic cursor, and
+// threads share one tree without locks: a node is expanded by whichever
+// thread wins a compare-and-swap on its state, and a virtual loss on every
+// node of a thread's path steers the others elsewhere until it backs up its
+// result. Each thread plays on a private copy of the position, so the game
+// board is never touched. One Mcts per game; only stop() and ponderhit() may
+// be called from another thread while it runs.
+class Mcts {
+public:
+  enum class Selection { Uct, Puct };
+  enum class Rollout { Random, Light };
+
+  struct Config {
+    Selection selection = Selection::Puct;
+    Rollout rollout = Rollout::Light;
+    double exploration = 1.4;
+    int rollout_plies = 60;  // then the material balance decides the playout
+    unsigned threads = 1;
+    size_t node_capacity = size_t(1) << 20;
+    uint64_t seed = 1;
+  };
+
+  // 0 means no limit of that kind; with neither the search runs until stop()
+  struct Limits {
+    size_t playouts = 0;
+    int64_t movetime_ms = 0;
+    bool ponder = false;  // the limits only apply from ponderhit()
+  };
+
+  struct Result {
+    EncodedMove move;
+    bool has_move = false;
+    double value = 0.5;  // expected score of `move` for the side to move, 0..1
+    size_t visits = 0;   // playouts through `move`
+    size_t playouts = 0;
+    size_t nodes = 0;    // pool nodes in use
+  };
+
+  Mcts(ChessBoard& board, GameManager& game_manager, PortalSystem& portal_system);
+  Mcts(ChessBoard& board, GameManager& game_manager, PortalSystem& portal_system, const Config& config);
+  ~Mcts();
+
+  Result think(const Limits& limits);
+  // Ends the search in progress after the current playouts. As with Search,
+  // a stop() before think() holds until clearStop().
+  void stop();
+  // Also forgets an earlier ponderhit()
+  void clearStop();
+  // The predicted move was played: the limits apply from now on. Like stop(),
+  // it holds for a think() that has not started yet.
+  void ponderhit();
+  void setThreads(unsigned threads) { config_.threads = threads > 0 ? threads : 1; }
+  const Config& config() const { return config_; }
+
+  // Light-policy weight: captures by victim value, promotions and landing on
+  // a portal entry are favoured; every move keeps some weight
+  static double policyWeight(EncodedMove move, const ChessBoard& board, const PortalSystem& portal_system);
+  // Expected score to centipawns on the Elo logistic, for reporting
+  static int valueToCentipawns(double value);
+
+private:
+  struct Node;
+  struct FreeNodes {
+    void operator()(Node* nodes) const;
+  };
+  struct Worker;
+
+  void runWorker(unsigned index, const Limits& limits);
+  void playout(Worker& worker);
+  void expand(Worker& worker, Node& node);
+  Node& select(const Node& node) const;
+  double rollout(Worker& worker, bool leaf_white);
+  int64_t elapsedMs() const;
+  // As Search::limitedMs()
+  int64_t limitedMs(const Limits& limits) const;
+
+  ChessBoard& board_;
+  GameManager& game_manager_;
+  PortalSystem& portal_system_;
+  Config config_;
+  // Raw storage; each node is constructed when it is handed out, so a new
+  // pool costs no time (and no memory) up front
+  std::unique_ptr<Node[], FreeNodes> nodes_;
+  size_t capacity_ = 0;
+  std::atomic<size_t> used_{0};
+  std::atomic<size_t> started_playouts_{0};
+  std::atomic<size_t> finished_playouts_{0};
+  std::atomic<bool> stop_requested_{false};
+  std::atomic<bool> ponderhit_{false};
+  std::atomic<int64_t> ponderhit_at_{0};  // steady_clock ticks at ponderhit()
+  std::chrono::steady_clock::time_point started_;
+  std::unique_ptr<ThreadPool> pool_;
+};
+
+#endif
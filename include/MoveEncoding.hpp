@@ -0,0 +1,54 @@
+// MoveEncoding.hpp
+#ifndef MOVE_ENCODING_HPP
+#define MOVE_ENCODING_HPP
+#include <cstdint>
+
+enum class MoveKind : uint32_t { Normal = 0, Castle = 1, EnPassant = 2, Promotion = 3 };
+enum class PromotionPiece : uint32_t { Queen = 0, Rook = 1, Bishop = 2, Knight = 3 };
+
+// A move packed into 32 bits:
+//   bits  0-13  from square index (y * board_size + x)
+//   bits 14-27  to square index
+//   bits 28-29  MoveKind
+//   bits 30-31  PromotionPiece (only meaningful for MoveKind::Promotion)
+// 14 bits per square covers boards up to 128x128.
+struct EncodedMove {
+  uint32_t bits = 0;
+
+  static constexpr int kSquareBits = 14;
+  static constexpr uint32_t kSquareMask = (1u << kSquareBits) - 1;
+
+  static constexpr EncodedMove make(int from, int to, MoveKind kind = MoveKind::Normal,
+                                    PromotionPiece promotion = PromotionPiece::Queen) {
+    return EncodedMove{(static_cast<uint32_t>(from) & kSquareMask) |
+                       ((static_cast<uint32_t>(to) & kSquareMask) << kSquareBits) |
+                       (static_cast<uint32_t>(kind) << 28) |
+                       (static_cast<uint32_t>(promotion) << 30)};
+  }
+
+  constexpr int from() const { return static_cast<int>(bits & kSquareMask); }
+  constexpr int to() const { return static_cast<int>((bits >> kSquareBits) & kSquareMask); }
+  constexpr MoveKind kind() const { return static_cast<MoveKind>((bits >> 28) & 3u); }
+  constexpr PromotionPiece promotion() const { return static_cast<PromotionPiece>(bits >> 30); }
+
+  constexpr bool operator==(const EncodedMove& other) const { return bits == other.bits; }
+  constexpr bool operator!=(const EncodedMove& other) const { return bits != other.bits; }
+};
+
+// Everything needed to take an EncodedMove back exactly. Filled by
+// ChessBoard::applyMove and consumed by ChessBoard::undoMove.
+struct UndoRecord {
+  int32_t portal_ready_at = 0; // cooldown stamp of `portal` before the move
+  int16_t en_passant = -1;     // en passant square before the move
+  int16_t portal = -1;         // portal taken after landing, -1 if none
+  uint8_t moved = 0;           // piece type that moved (pawn before promotion)
+  uint8_t captured = 0;        // piece type captured, 0 if none
+  uint8_t exit_captured = 0;   // piece type displaced at the portal exit
+  uint8_t castling_rights = 0; // castling rights before the move
+  bool captured_white = false;
+  bool exit_captured_white = false;
+};
+
+static_assert(sizeof(EncodedMove) == 4, "EncodedMove must stay 32 bits");
+
+#endif
@@ -3,24 +3,27 @@
 #define MOVE_VALIDATOR_HPP
 #include "ChessBoard.hpp"
 #include "PortalSystem.hpp"
+#include "ScratchArena.hpp"
+#include <memory_resource>
 #include <string>
 #include <vector>
-#include <queue>
-#include <unordered_set>
 
 class MoveValidator {
 public:
   MoveValidator() = default;
   bool isValidMove(const std::string& piece, const Position& start, const Position& end,
-                   bool is_white, const ChessBoard& board, const PortalSystem& portal_system) const;
+                   bool is_white, const ChessBoard& board, const PortalSystem& portal_system,
+                   bool verbose = true) const;
 
   std::string toLowerCase(const std::string& str) const;
+
+  // Appends pseudo-legal destinations to `edges`, which callers allocate
+  // from the thread's ScratchArena. Sliders read the board's line masks
+  // when it has them.
+  void getMoveEdges(PieceKind kind, const Position& pos, bool is_white,
+                    const ChessBoard& board, std::pmr::vector<Position>& edges) const;
 private:
   
- 
-  std::vector<Position> getMoveEdges(const std::string& piece_lower, const Position& pos, 
-                                     bool is_white, const ChessBoard& board) const;
-  
   bool bfsValidateMove(const std::string& piece_lower, const Position& start, 
                        const Position& end, bool is_white, const ChessBoard& board, 
                        const PortalSystem& portal_system) const;
@@ -0,0 +1,91 @@
+// OpeningBook.hpp
+#ifndef OPENING_BOOK_HPP
+#define OPENING_BOOK_HPP
+#include "ChessBoard.hpp"
+#include "ConfigReader.hpp"
+#include "GameManager.hpp"
+#include "GameRecord.hpp"
+#include "MappedFile.hpp"
+#include "MoveValidator.hpp"
+#include "PortalSystem.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Book moves for positions near the start, in a file of (position key, move,
+// weight) entries sorted by key. The file is memory-mapped and searched in
+// place, so opening a book parses nothing and every process using the same
+// book shares its pages. Keys are ChessBoard::positionKey values; a book only
+// opens with the config it was built from (configHash in the header).
+class OpeningBook {
+public:
+  // One entry as stored in the file
+  struct Entry {
+    uint64_t key;
+    uint32_t move;    // EncodedMove bits
+    uint32_t weight;
+  };
+
+  struct Candidate {
+    EncodedMove move;
+    uint32_t weight;
+  };
+
+  // Game logs are one game per line: moves in ChessBoard::moveToNotation form,
+  // optionally followed by 1-0, 0-1, 1/2-1/2 or *. Blank and '#' lines are skipped.
+  static bool parseGameLine(const std::string& line, std::vector<std::string>& moves, GameResult& result);
+
+  // Replays games from the config's start position and counts the moves
+  // played in each position. A move's weight is 2 per win and 1 per draw or
+  // unknown result for the side that played it, 0 per loss.
+  class Builder {
+  public:
+    Builder(const GameConfig& config, int max_plies);
+    // False (and the game is only counted up to there) at the first illegal move
+    bool addGame(const std::vector<std::string>& moves, GameResult result);
+    size_t games() const { return games_; }
+    // Writes entries seen at least min_count times with nonzero weight;
+    // returns how many. Throws std::runtime_error if the file cannot be written.
+    size_t write(const std::string& path, uint32_t min_count) const;
+
+  private:
+    struct Counts {
+      uint32_t weight = 0;
+      uint32_t count = 0;
+    };
+    struct PairHash {
+      size_t operator()(const std::pair<uint64_t, uint32_t>& p) const { return p.first ^ (p.second * 0x9e3779b9u); }
+    };
+
+    const GameConfig& config_;
+    int max_plies_;
+    ChessBoard board_;
+    MoveValidator validator_;
+    PortalSystem portal_system_;
+    GameManager game_manager_;
+    std::vector<EncodedMove> legal_;
+    std::unordered_map<std::pair<uint64_t, uint32_t>, Counts, PairHash> counts_;
+    size_t games_ = 0;
+  };
+
+  bool open(const std::string& path, const GameConfig& config);
+  bool isOpen() const { return entries_ != nullptr; }
+  size_t size() const { return count_; }
+  // Book moves for `key`, heaviest first; `out` is cleared first
+  void lookup(uint64_t key, std::vector<Candidate>& out) const;
+  // Picks a move with probability proportional to its weight, using `random`
+  // as the dice; false when the position is not in the book
+  bool pick(uint64_t key, uint64_t random, EncodedMove& move) const;
+
+private:
+  // The entries for `key` as [first, last)
+  std::pair<const Entry*, const Entry*> range(uint64_t key) const;
+
+  MappedFile file_;
+  const Entry* entries_ = nullptr;
+  size_t count_ = 0;
+};
+
+#endif
@@ -2,25 +2,35 @@
 #define PORTAL_SYSTEM_HPP
 #include "ChessBoard.hpp"
 #include "ConfigReader.hpp"
-#include <queue>
-#include <unordered_map>
 #include <string>
+#include <vector>
 
 class PortalSystem {
 public:
     PortalSystem(const std::vector<PortalConfig>& portals);
     bool isPortalMove(const Position& start, const Position& end) const;
     bool validatePortalMove(const std::string& piece, const Position& start, 
-                           const Position& end, bool is_white_turn, const ChessBoard& board) const;
-    void handlePortalMove(const Position& start, const Position& end, ChessBoard& board);
-    void updateCooldowns();
-    bool isPortalInCooldown(const Position& start, const Position& end) const;
+                           const Position& end, bool is_white_turn, const ChessBoard& board,
+                           bool verbose = true) const;
+    bool isPortalInCooldown(const Position& start, const Position& end, bool verbose = true) const;
     const std::vector<PortalConfig>& getPortals() const { return portals_; }
 
+    // Cooldowns are stored as the ply at which each portal is ready again,
+    // so moving forward or back in the game only changes the ply counter.
+    void updateCooldowns();   // advance one ply
+    void rewindCooldowns();   // step back one ply (undo)
+    void startCooldown(size_t portal_index);
+    int getReadyAt(size_t portal_index) const { return ready_at_[portal_index]; }
+    void setReadyAt(size_t portal_index, int ply) { ready_at_[portal_index] = ply; }
+    int getRemainingCooldown(size_t portal_index) const;
+    int getPly() const { return ply_; }
+    void setPly(int ply) { ply_ = ply; }
+    void reportCooldowns() const;
+
 private:
     std::vector<PortalConfig> portals_;
-    std::queue<std::string> cooldown_queue_;
-    std::unordered_map<std::string, int> cooldowns_;
+    std::vector<int> ready_at_;
+    int ply_ = 0;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,71 @@
+// PositionIndex.hpp
+#ifndef POSITION_INDEX_HPP
+#define POSITION_INDEX_HPP
+#include "ConfigReader.hpp"
+#include "GameRecord.hpp"
+#include "MappedFile.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+// Which games of an archive passed through a position. The index file holds
+// one (position key, game, ply) entry per position a game reached (the first
+// time it reached it), sorted by key, with every kFenceStride-th key copied
+// into a small fence array after the entries. A lookup binary-searches the
+// fences, then one block of entries, all in the memory mapping, so it touches
+// a handful of pages however large the archive is. The index also keeps each
+// game's result and archive offset, so hits can be scored and read back
+// without scanning the archive.
+class PositionIndex {
+public:
+  static constexpr uint32_t kFenceStride = 256;
+
+  // One entry as stored in the file; games are numbered from 0 in archive order
+  struct Entry {
+    uint64_t key;
+    uint32_t game;
+    uint32_t ply;  // moves played before the position; 0 is the start position
+  };
+
+  struct Summary {
+    size_t games = 0;
+    size_t entries = 0;  // after dropping repeats within a game
+    size_t runs = 0;     // sorted runs merged into the file
+    double seconds = 0.0;
+  };
+
+  // Replays every game of `archive` on `threads` workers, `chunk_games` games
+  // per sorted run (spilled next to `path` and merged into it). Throws
+  // std::runtime_error if the archive cannot be read or the index written.
+  static Summary build(const GameConfig& config, const std::string& archive, const std::string& path,
+                       unsigned threads, size_t chunk_games);
+
+  // False if the file is missing, damaged, or built with another config
+  bool open(const std::string& path, const GameConfig& config);
+  bool isOpen() const { return entries_ != nullptr; }
+  size_t size() const { return count_; }
+  size_t games() const { return games_; }
+  // Size of the archive the index was built from, to spot a stale index
+  uint64_t archiveBytes() const { return archive_bytes_; }
+
+  const Entry& entry(size_t i) const { return entries_[i]; }
+  // Entries for `key` as [first, last), ordered by game
+  std::pair<const Entry*, const Entry*> find(uint64_t key) const;
+  GameResult result(uint32_t game) const { return static_cast<GameResult>(results_[game]); }
+  // Byte offset of the game in the archive, for GameRecordReader::seek
+  uint64_t gameOffset(uint32_t game) const { return offsets_[game]; }
+
+private:
+  MappedFile file_;
+  const Entry* entries_ = nullptr;
+  const uint64_t* fences_ = nullptr;
+  const uint64_t* offsets_ = nullptr;
+  const uint8_t* results_ = nullptr;
+  size_t count_ = 0;
+  size_t fence_count_ = 0;
+  size_t games_ = 0;
+  uint64_t archive_bytes_ = 0;
+};
+
+#endif
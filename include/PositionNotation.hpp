@@ -0,0 +1,64 @@
+// PositionNotation.hpp
+#ifndef POSITION_NOTATION_HPP
+#define POSITION_NOTATION_HPP
+#include "ConfigReader.hpp"
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class ChessBoard;
+class PortalSystem;
+
+// FEN extended for this variant: any board size, config piece types, and
+// portal cooldowns. Five space-separated fields:
+//
+//   rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0,1
+//
+// 1. Ranks from the top one down, '/' between them. Letters are pieces
+//    (uppercase white), numbers are runs of empty squares; there must be
+//    board_size ranks of board_size squares each.
+// 2. Side to move, w or b.
+// 3. Castling rights, a subset of KQkq, or -.
+// 4. En passant target square such as e3, or -.
+// 5. Remaining cooldown plies of each portal in config order, comma
+//    separated; - when there are no portals.
+// Fields 2-5 may be left off when parsing (w, -, -, no cooldowns).
+//
+// The standard pieces are K Q R B N P. Every other config piece type takes
+// the first letter of its name that is still free (else the first free
+// letter of the alphabet), in config order. A type left without a letter
+// is written as its name in brackets, [AMAZON] for white and [amazon] for
+// black; names with a space, '/' or a bracket, or without a letter, cannot
+// be written at all.
+//
+// Parsing and writing do not allocate once the board has seen its piece
+// types, so tools can stream millions of positions through one board.
+class PositionNotation {
+public:
+  // Only the standard pieces
+  PositionNotation();
+  explicit PositionNotation(const std::vector<PieceConfig>& pieces);
+
+  // The letter (lowercase) of a piece type, or 0 if it has none
+  char letter(const std::string& type) const;
+
+  // Sets up `board` and the cooldowns of `portal_system` from `text`. On a
+  // malformed text the board is left untouched, and `error` (if given)
+  // points to a static description of the first problem.
+  bool parse(std::string_view text, ChessBoard& board, PortalSystem& portal_system,
+             const char** error = nullptr) const;
+  // Writes the position without a terminator; returns its length, or 0 if
+  // it needs more than `capacity` bytes or has a piece type that cannot be
+  // written
+  size_t write(const ChessBoard& board, const PortalSystem& portal_system, char* out, size_t capacity) const;
+  // Empty when write() would fail
+  std::string toString(const ChessBoard& board, const PortalSystem& portal_system) const;
+
+private:
+  void addType(const std::string& name);
+
+  std::vector<std::string> names_;  // by letter - 'a', empty if the letter is free
+};
+
+#endif
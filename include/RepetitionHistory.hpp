@@ -0,0 +1,38 @@
+// RepetitionHistory.hpp
+#ifndef REPETITION_HISTORY_HPP
+#define REPETITION_HISTORY_HPP
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Position keys of the game (or search line) so far, one per ply, kept in a
+// fixed ring together with the halfmove clock at that ply. Repetition checks
+// only walk back to the last irreversible move, so they cost O(k) in the
+// number of reversible plies rather than the game length.
+class RepetitionHistory {
+public:
+  // Power of two; positions further back than this are never compared.
+  static constexpr size_t kCapacity = 1024;
+
+  void reset(uint64_t key);
+  void push(uint64_t key, bool irreversible);
+  void pop();
+
+  uint64_t currentKey() const { return keys_[ply_ & kMask]; }
+  int halfmoveClock() const { return clocks_[ply_ & kMask]; }
+  size_t ply() const { return ply_; }
+
+  // Earlier occurrences of the current position with the same side to move
+  int repetitionCount() const;
+  bool isThreefold() const { return repetitionCount() >= 2; }
+
+private:
+  static constexpr size_t kMask = kCapacity - 1;
+  static_assert((kCapacity & kMask) == 0, "kCapacity must be a power of two");
+
+  std::array<uint64_t, kCapacity> keys_{};
+  std::array<uint16_t, kCapacity> clocks_{};
+  size_t ply_ = 0;
+};
+
+#endif
@@ -0,0 +1,52 @@
+// ScratchArena.hpp
+#ifndef SCRATCH_ARENA_HPP
+#define SCRATCH_ARENA_HPP
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+// Per-thread bump allocator for short-lived scratch data (move lists, BFS
+// frontiers) during a search or status evaluation. Deallocation is a no-op;
+// memory is reclaimed in O(1) by rewinding to a mark, normally through a
+// Scope at the top of each node. Requests that do not fit fall back to the
+// global heap, so overflow is slow but never fails.
+class ScratchArena : public std::pmr::memory_resource {
+public:
+  static constexpr size_t kDefaultCapacity = 256 * 1024;
+
+  explicit ScratchArena(size_t capacity = kDefaultCapacity);
+
+  // The calling thread's arena
+  static ScratchArena& forThread();
+
+  size_t mark() const { return used_; }
+  void rewind(size_t mark) { used_ = mark; }
+  void reset() { used_ = 0; }
+  size_t capacity() const { return capacity_; }
+  size_t highWater() const { return high_water_; }
+
+  // Rewinds the arena to where it was when the scope was opened
+  class Scope {
+  public:
+    explicit Scope(ScratchArena& arena) : arena_(arena), mark_(arena.mark()) {}
+    ~Scope() { arena_.rewind(mark_); }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    ScratchArena& arena_;
+    size_t mark_;
+  };
+
+private:
+  void* do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+  std::unique_ptr<std::byte[]> buffer_;
+  size_t capacity_;
+  size_t used_ = 0;
+  size_t high_water_ = 0;
+};
+
+#endif
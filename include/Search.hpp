@@ -0,0 +1,122 @@
+// Search.hpp
+#ifndef SEARCH_HPP
+#define SEARCH_HPP
+#include "MoveEncoding.hpp"
+#include "RepetitionHistory.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class ChessBoard;
+class GameManager;
+class PortalSystem;
+class Tablebase;
+class TranspositionTable;
+enum class PieceKind : uint8_t;
+
+// Alpha-beta search over GameManager::generateLegalMoves with a material
+// evaluation, either to a fixed depth or by iterative deepening under a
+// time or node budget. Moves are played on the game's own board with
+// applyMove/undoMove, so the position is unchanged when a search returns.
+// With Limits::multipv above 1 the root keeps the best K moves instead of
+// one: a move is searched with a window whose floor is the K-th best score
+// so far, so it only gets an exact score if it enters the top K, and a
+// single pass scores all K lines.
+// One Search per game; only stop() and ponderhit() may be called from
+// another thread while it runs.
+class Search {
+public:
+  static constexpr int kMateScore = 100000;
+  static constexpr int kMaxDepth = 64;
+
+  // One scored root move and the line the search expects after it
+  struct Line {
+    EncodedMove move;
+    int score = 0;
+    std::vector<EncodedMove> pv;  // starts with move
+  };
+
+  struct Result {
+    EncodedMove move;
+    int score = 0;          // centipawns for the side to move
+    bool has_move = false;  // false when the side to move has no legal move
+    int depth = 0;          // last completed iteration
+    std::vector<Line> lines;  // the best Limits::multipv root moves, best first
+  };
+
+  // 0 means no limit of that kind; with no limit at all the search runs to
+  // kMaxDepth or until stop()
+  struct Limits {
+    int depth = 0;
+    int64_t movetime_ms = 0;
+    size_t nodes = 0;
+    bool iterate = true;  // false: search `depth` directly, no shallower passes
+    bool ponder = false;  // the node and time limits only apply from ponderhit()
+    int multipv = 1;      // root moves to score exactly (Result::lines)
+  };
+
+  // Called after every completed iteration with its result, nodes and elapsed ms
+  using InfoCallback = std::function<void(const Result&, size_t, int64_t)>;
+
+  Search(ChessBoard& board, GameManager& game_manager, PortalSystem& portal_system);
+
+  Result bestMove(int depth);
+  Result think(const Limits& limits);
+  // Ends the search in progress within one node. A stop() before think()
+  // starts makes it return at once with its first legal move, until
+  // clearStop(); clear it before handing a search to another thread.
+  void stop();
+  // Also forgets an earlier ponderhit()
+  void clearStop();
+  // The predicted move was played: the limits apply from now on. Like stop(),
+  // it holds for a think() that has not started yet.
+  void ponderhit();
+  void setInfoCallback(InfoCallback info) { info_ = std::move(info); }
+  // Positions a table covers get its exact result instead of a search; the
+  // table must outlive the Search
+  void addTablebase(const Tablebase* table) { tablebases_.push_back(table); }
+  // Results are stored in and reused from the table, which may be shared
+  // with other Search instances on other threads and must outlive them;
+  // nullptr (the default) searches without one
+  void setTranspositionTable(TranspositionTable* table) { transposition_table_ = table; }
+  // Material balance from the side to move's point of view
+  int evaluate() const;
+  static int pieceValue(PieceKind kind);
+  size_t nodes() const { return nodes_; }
+
+private:
+  // Power of two; how often the search looks at the clock and node budget
+  static constexpr size_t kCheckInterval = 128;
+
+  Result searchRoot(int depth);
+  int negamax(int depth, int alpha, int beta, int ply);
+  bool probeTablebases(int ply, int& score) const;
+  bool shouldAbort();
+  int64_t elapsedMs() const;
+  // Time the limits have been running: since the start, or since ponderhit()
+  // for a ponder search; -1 while still pondering
+  int64_t limitedMs() const;
+  int moveOrderScore(EncodedMove move) const;
+
+  ChessBoard& board_;
+  GameManager& game_manager_;
+  PortalSystem& portal_system_;
+  RepetitionHistory line_;  // game history plus the line being searched
+  std::vector<std::vector<EncodedMove>> moves_by_ply_;  // reused between searches
+  std::vector<std::vector<EncodedMove>> pv_by_ply_;     // best line found from each ply
+  size_t nodes_ = 0;
+  Limits limits_;
+  std::chrono::steady_clock::time_point started_;
+  std::atomic<bool> stop_requested_{false};
+  std::atomic<bool> ponderhit_{false};
+  std::atomic<int64_t> ponderhit_at_{0};  // steady_clock ticks at ponderhit()
+  bool aborted_ = false;
+  InfoCallback info_;
+  std::vector<const Tablebase*> tablebases_;
+  TranspositionTable* transposition_table_ = nullptr;
+};
+
+#endif
@@ -0,0 +1,104 @@
+// Tablebase.hpp
+#ifndef TABLEBASE_HPP
+#define TABLEBASE_HPP
+#include "ConfigReader.hpp"
+#include "MappedFile.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ChessBoard;
+class PortalSystem;
+enum class PieceKind : uint8_t;
+
+// Exact results for every position of one material signature (e.g. KQvK) on
+// one board size and portal layout, with portal cooldowns and side to move
+// part of the position. Tables are solved by retrograde analysis and stored
+// one byte per position in a file that is memory-mapped for probing, so a
+// probe is an index computation and one load. Castling, repetition and the
+// fifty-move rule are outside the tables, and pawns are not supported.
+class Tablebase {
+public:
+  struct Piece {
+    PieceKind kind;
+    bool is_white;
+  };
+
+  enum class Outcome { Win, Loss, Draw };
+
+  struct Probe {
+    Outcome outcome = Outcome::Draw;
+    int plies = 0;  // plies to mate for Win and Loss
+  };
+
+  // Stored per position: kDraw, 1..kMaxPlies = win in that many plies,
+  // kLossBase + n = loss in n plies, kIllegal = not a reachable position
+  static constexpr uint8_t kDraw = 0;
+  static constexpr uint8_t kLossBase = 128;
+  static constexpr uint8_t kIllegal = 255;
+  static constexpr int kMaxPlies = 126;
+  static constexpr size_t kMaxPieces = 6;
+
+  struct Summary {
+    std::string name;
+    uint64_t positions = 0;
+    uint64_t wins = 0;
+    uint64_t losses = 0;
+    uint64_t draws = 0;
+    uint64_t illegal = 0;
+    int longest_plies = 0;
+    int symmetries = 1;  // board transforms the table is reduced by
+    double seconds = 0.0;
+  };
+
+  // Position <-> index mapping, shared by the generator and probes. The first
+  // piece is restricted to one square per symmetry orbit; symmetries are the
+  // 8 board transforms (bit t of `symmetries`) that leave the portal layout
+  // and the move rules unchanged.
+  struct Layout {
+    static constexpr uint64_t kNoIndex = ~0ull;
+
+    int board_size = 0;
+    std::vector<Piece> pieces;
+    uint8_t symmetries = 1;
+    std::vector<int> domain;          // squares the first piece is reduced to
+    std::vector<int> domain_index;    // square -> position in `domain`, -1 outside
+    std::vector<int> cooldown_radix;  // per portal, number of remaining-cooldown values
+    uint64_t square_span = 1;         // squares ^ (pieces - 1)
+    uint64_t size = 0;
+
+    void build(int side, const std::vector<Piece>& signature, const std::vector<PortalConfig>& portals,
+               uint8_t symmetry_mask);
+    static Position transform(int t, const Position& pos, int size);
+    // kNoIndex when the position is not in this table
+    uint64_t indexOf(const ChessBoard& board, const PortalSystem& portal_system) const;
+    // Clears the squares in `placed`, then sets up `index`; false if two pieces share a square
+    bool setUp(uint64_t index, ChessBoard& board, PortalSystem& portal_system, std::vector<Position>& placed) const;
+  };
+
+  // "KQvK": white pieces, 'v', black pieces, using K Q R B N
+  static bool parseSignature(const std::string& text, std::vector<Piece>& pieces);
+  static std::string signatureName(const std::vector<Piece>& pieces);
+  // Board size and portal layout; a table is only valid for the layout it was built for
+  static uint64_t layoutHash(const GameConfig& config);
+
+  // Solves `signature` and every table its captures lead to, writing
+  // <dir>/<name>.tb for each. Throws std::runtime_error on bad input.
+  static std::vector<Summary> generate(const GameConfig& config, const std::string& signature,
+                                       const std::string& dir, unsigned threads);
+
+  bool open(const std::string& path, const GameConfig& config);
+  const std::string& name() const { return name_; }
+  size_t pieceCount() const { return layout_.pieces.size(); }
+  // False when the position is not covered (other material, castling rights)
+  bool probe(const ChessBoard& board, const PortalSystem& portal_system, Probe& result) const;
+
+private:
+  Layout layout_;
+  MappedFile file_;
+  const uint8_t* values_ = nullptr;
+  std::string name_;
+};
+
+#endif
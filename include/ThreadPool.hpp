@@ -0,0 +1,36 @@
+// ThreadPool.hpp
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads. Workers are started once and reused
+// for every submitted task, so callers can fan out short jobs without
+// paying thread creation cost each time.
+class ThreadPool {
+public:
+  explicit ThreadPool(unsigned thread_count = std::thread::hardware_concurrency());
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  std::future<void> submit(std::function<void()> task);
+  unsigned size() const { return static_cast<unsigned>(workers_.size()); }
+
+private:
+  void workerLoop();
+
+  std::vector<std::thread> workers_;
+  std::queue<std::packaged_task<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stopping_ = false;
+};
+
+#endif
@@ -0,0 +1,54 @@
+// TranspositionTable.hpp
+#ifndef TRANSPOSITION_TABLE_HPP
+#define TRANSPOSITION_TABLE_HPP
+#include "MoveEncoding.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Search results by position key, shared by any number of Search threads
+// without locks. An entry is two 64-bit words, the packed data and the key
+// XOR the data; a reader accepts an entry only if the two still agree, so
+// a torn write from another thread reads as a miss instead of as another
+// position's result.
+class TranspositionTable {
+public:
+  enum class Bound : uint8_t { None = 0, Exact = 1, Lower = 2, Upper = 3 };
+
+  struct Entry {
+    EncodedMove move;  // best or refuting move; bits == 0 if none
+    int score = 0;
+    int depth = 0;
+    Bound bound = Bound::None;
+  };
+
+  // Rounded down to a power of two entries; at least one
+  explicit TranspositionTable(size_t megabytes);
+
+  bool probe(uint64_t key, Entry& entry) const;
+  // Replaces the slot's entry unless it holds a deeper result for the same position
+  void store(uint64_t key, EncodedMove move, int score, int depth, Bound bound);
+  void clear();
+
+  size_t capacity() const { return mask_ + 1; }
+  // Probes that found their position, out of all probes
+  size_t hits() const { return hits_.load(std::memory_order_relaxed); }
+  size_t probes() const { return probes_.load(std::memory_order_relaxed); }
+
+private:
+  struct Slot {
+    std::atomic<uint64_t> check{0};  // key ^ data
+    std::atomic<uint64_t> data{0};
+  };
+
+  // move 32 bits | score + kScoreBias 24 bits | depth 6 bits | bound 2 bits
+  static constexpr int kScoreBias = 1 << 23;
+
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_ = 0;
+  mutable std::atomic<size_t> hits_{0};
+  mutable std::atomic<size_t> probes_{0};
+};
+
+#endif
@@ -0,0 +1,60 @@
+// WorkStealingPool.hpp
+#ifndef WORK_STEALING_POOL_HPP
+#define WORK_STEALING_POOL_HPP
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs batches of independent tasks on a fixed set of workers. Every worker
+// starts a batch with its own contiguous slice of the tasks, takes them from
+// the back of its deque, and once that is empty steals from the front of the
+// others' deques. Uneven tasks (long games, big files) balance out without
+// all workers contending on one shared queue as ThreadPool's do.
+class WorkStealingPool {
+public:
+  // Called with the task index and the worker running it (0 .. size() - 1)
+  using Task = std::function<void(size_t index, unsigned worker)>;
+
+  explicit WorkStealingPool(unsigned thread_count = std::thread::hardware_concurrency());
+  ~WorkStealingPool();
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  unsigned size() const { return static_cast<unsigned>(workers_.size()); }
+  // Runs task(i, worker) for every i in [0, count) and returns once all have
+  // finished; rethrows the first exception a task threw
+  void run(size_t count, const Task& task);
+  // Tasks taken from another worker's deque during the last run
+  size_t steals() const { return steals_.load(std::memory_order_relaxed); }
+
+private:
+  struct Deque {
+    std::mutex mutex;
+    std::deque<size_t> tasks;
+  };
+
+  void workerLoop(unsigned worker);
+  bool take(unsigned worker, size_t& index);
+
+  std::vector<std::thread> workers_;
+  std::vector<std::unique_ptr<Deque>> deques_;
+  std::mutex mutex_;
+  std::condition_variable start_cv_;
+  std::condition_variable done_cv_;
+  const Task* task_ = nullptr;
+  size_t generation_ = 0;  // batches started; workers wait for it to change
+  unsigned running_ = 0;   // workers still busy with the current batch
+  bool stopping_ = false;
+  std::exception_ptr error_;
+  std::atomic<size_t> steals_{0};
+};
+
+#endif
@@ -0,0 +1,40 @@
+// Zobrist.hpp
+#ifndef ZOBRIST_HPP
+#define ZOBRIST_HPP
+#include <cstddef>
+#include <cstdint>
+
+// Zobrist keys derived from a fixed mixing function rather than a random
+// table, so they cost no memory on large boards and are identical across
+// processes (position keys can be stored on disk and compared later).
+struct Zobrist {
+  static constexpr uint64_t mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+  }
+
+  static constexpr uint64_t piece(uint8_t type, bool is_white, int square) {
+    return type == 0 ? 0 : mix((static_cast<uint64_t>(square) << 16) | (static_cast<uint64_t>(type) << 1) |
+                               (is_white ? 1u : 0u));
+  }
+
+  static constexpr uint64_t blackToMove() { return mix(0x5a17'0000'0000'0001ull); }
+
+  static constexpr uint64_t castling(uint8_t rights) {
+    return rights == 0 ? 0 : mix(0xca57'0000'0000'0000ull | rights);
+  }
+
+  static constexpr uint64_t enPassant(int square) {
+    return square < 0 ? 0 : mix(0xe9a5'0000'0000'0000ull | static_cast<uint64_t>(square));
+  }
+
+  static constexpr uint64_t portalCooldown(size_t portal, int remaining) {
+    return remaining <= 0 ? 0
+                          : mix(0x9047'0000'0000'0000ull | (static_cast<uint64_t>(portal) << 16) |
+                                static_cast<uint64_t>(remaining));
+  }
+};
+
+#endif
@@ -0,0 +1,273 @@
+// AnalysisService.cpp
+#include "AnalysisService.hpp"
+#include "ChessBoard.hpp"
+#include "GameManager.hpp"
+#include "MoveValidator.hpp"
+#include "PortalSystem.hpp"
+#include "Search.hpp"
+#include "TranspositionTable.hpp"
+#include <chrono>
+
+namespace {
+constexpr int kDefaultDepth = 3;
+
+int64_t msBetween(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(to - from).count();
+}
+} // namespace
+
+struct AnalysisService::Job {
+  enum class State { Queued, Running, Done };
+
+  uint64_t id = 0;
+  uint64_t sequence = 0;
+  Request request;
+  Callback callback;
+  std::promise<Analysis> promise;
+  std::chrono::steady_clock::time_point submitted;
+  // Guarded by the service mutex
+  State state = State::Queued;
+  Search* search = nullptr;  // the worker's, while Running
+  bool cancelled = false;
+};
+
+// One warm game per thread; only its own thread touches it, except
+// search.stop() from cancel()
+struct AnalysisService::Worker {
+  Worker(const GameConfig& config, TranspositionTable* table)
+      : board(config.game_settings.board_size, "simple"),
+        portal_system(config.portals),
+        game_manager(board, validator, portal_system),
+        search(board, game_manager, portal_system) {
+    game_manager.setParallelStatusThreshold(ChessBoard::kMaxBoardSize + 1);
+    game_manager.setTurnLimit(config.game_settings.turn_limit);
+    search.setTranspositionTable(table);
+    // Piece type ids go into the position keys, so every worker registers
+    // the same types in the same order, and analyse() refuses positions
+    // that name any other
+    board.initializeBoard(config.pieces);
+    board.registerPieceTypes(config);
+    config_types = board.pieceTypeCount();
+  }
+
+  ChessBoard board;
+  MoveValidator validator;
+  PortalSystem portal_system;
+  GameManager game_manager;
+  Search search;
+  std::thread thread;
+  size_t config_types = 0;
+};
+
+bool AnalysisService::Later::operator()(const std::shared_ptr<Job>& a, const std::shared_ptr<Job>& b) const {
+  if (a->request.priority != b->request.priority) {
+    return a->request.priority < b->request.priority;
+  }
+  return a->sequence > b->sequence;
+}
+
+AnalysisService::AnalysisService(const GameConfig& config, const Options& options)
+    : config_(config), notation_(config.pieces) {
+  if (options.hash_mb > 0) {
+    table_ = std::make_unique<TranspositionTable>(options.hash_mb);
+  }
+  const unsigned thread_count = options.threads == 0 ? 1 : options.threads;
+  workers_.reserve(thread_count);
+  for (unsigned i = 0; i < thread_count; ++i) {
+    workers_.push_back(std::make_unique<Worker>(config, table_.get()));
+  }
+  for (auto& worker : workers_) {
+    worker->thread = std::thread(&AnalysisService::workerLoop, this, std::ref(*worker));
+  }
+}
+
+AnalysisService::~AnalysisService() {
+  std::vector<std::shared_ptr<Job>> never_started;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    for (auto& entry : jobs_) {
+      Job& job = *entry.second;
+      job.cancelled = true;
+      if (job.state == Job::State::Queued) {
+        job.state = Job::State::Done;
+        never_started.push_back(entry.second);
+      } else {
+        job.search->stop();
+      }
+    }
+  }
+  cv_.notify_all();
+  for (auto& worker : workers_) {
+    worker->thread.join();
+  }
+  for (auto& job : never_started) {
+    Analysis analysis;
+    analysis.status = Status::Cancelled;
+    finish(*job, std::move(analysis));
+  }
+}
+
+AnalysisService::Ticket AnalysisService::submit(Request request, Callback callback) {
+  auto job = std::make_shared<Job>();
+  job->request = std::move(request);
+  job->callback = std::move(callback);
+  job->submitted = std::chrono::steady_clock::now();
+  Ticket ticket;
+  ticket.result = job->promise.get_future();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    job->id = next_id_++;
+    job->sequence = job->id;
+    ticket.id = job->id;
+    jobs_.emplace(job->id, job);
+    queue_.push(std::move(job));
+  }
+  cv_.notify_one();
+  return ticket;
+}
+
+bool AnalysisService::cancel(uint64_t id) {
+  std::shared_ptr<Job> job;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = jobs_.find(id);
+    if (found == jobs_.end() || found->second->cancelled) {
+      return false;
+    }
+    job = found->second;
+    job->cancelled = true;
+    if (job->state == Job::State::Running) {
+      job->search->stop();
+      return true;
+    }
+    // Left in the queue; the worker that pops it skips it
+    job->state = Job::State::Done;
+    jobs_.erase(found);
+    ++completed_;
+  }
+  Analysis analysis;
+  analysis.status = Status::Cancelled;
+  analysis.queued_ms = msBetween(job->submitted, std::chrono::steady_clock::now());
+  finish(*job, std::move(analysis));
+  return true;
+}
+
+size_t AnalysisService::pending() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return jobs_.size();
+}
+
+size_t AnalysisService::completed() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return completed_;
+}
+
+size_t AnalysisService::totalNodes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return total_nodes_;
+}
+
+void AnalysisService::finish(Job& job, Analysis analysis) {
+  if (job.callback) {
+    job.callback(job.id, analysis);
+  }
+  job.promise.set_value(std::move(analysis));
+}
+
+void AnalysisService::workerLoop(Worker& worker) {
+  while (true) {
+    std::shared_ptr<Job> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (stopping_) {
+        return;  // the destructor cancelled whatever is still queued
+      }
+      job = queue_.top();
+      queue_.pop();
+      if (job->state != Job::State::Queued) {
+        continue;  // cancelled while queued
+      }
+      job->state = Job::State::Running;
+      // Cleared before cancel() can see the search, so its stop() is never lost
+      worker.search.clearStop();
+      job->search = &worker.search;
+    }
+
+    const auto started = std::chrono::steady_clock::now();
+    Analysis analysis = analyse(worker, job->request);
+    analysis.queued_ms = msBetween(job->submitted, started);
+    analysis.elapsed_ms = msBetween(started, std::chrono::steady_clock::now());
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      job->state = Job::State::Done;
+      job->search = nullptr;
+      if (job->cancelled && analysis.status == Status::Done) {
+        analysis.status = Status::Cancelled;
+      }
+      jobs_.erase(job->id);
+      ++completed_;
+      total_nodes_ += analysis.nodes;
+    }
+    finish(*job, std::move(analysis));
+  }
+}
+
+AnalysisService::Analysis AnalysisService::analyse(Worker& worker, const Request& request) {
+  Analysis analysis;
+  worker.board.initializeBoard(config_.pieces);
+  for (size_t i = 0; i < config_.portals.size(); ++i) {
+    worker.portal_system.setReadyAt(i, 0);
+  }
+  worker.portal_system.setPly(0);
+  const char* error = nullptr;
+  if (!request.position.empty() && !notation_.parse(request.position, worker.board, worker.portal_system, &error)) {
+    analysis.status = Status::Invalid;
+    analysis.error = std::string("invalid position: ") + error;
+    return analysis;
+  }
+  // A type the config does not define would get an id in whatever order
+  // each worker met it, and the same key would mean different positions
+  // in the shared table
+  if (worker.board.pieceTypeCount() > worker.config_types) {
+    worker.board.clearPieces();
+    worker.board.truncatePieceTypes(worker.config_types);
+    analysis.status = Status::Invalid;
+    analysis.error = "invalid position: piece type the config does not define";
+    return analysis;
+  }
+  worker.game_manager.resetHistory();
+  for (const std::string& text : request.moves) {
+    EncodedMove move;
+    if (!worker.board.parseMove(text, move) || !worker.game_manager.isLegalMove(move)) {
+      analysis.status = Status::Invalid;
+      analysis.error = "illegal move " + text;
+      return analysis;
+    }
+    worker.game_manager.makeMove(move);
+  }
+
+  Search::Limits limits;
+  limits.depth = request.depth;
+  limits.movetime_ms = request.movetime_ms;
+  limits.nodes = request.nodes;
+  limits.multipv = request.multipv;
+  if (limits.depth <= 0 && limits.movetime_ms <= 0 && limits.nodes == 0) limits.depth = kDefaultDepth;
+  const Search::Result result = worker.search.think(limits);
+  analysis.move = result.move;
+  analysis.has_move = result.has_move;
+  if (result.has_move) analysis.move_text = worker.board.moveToNotation(result.move);
+  analysis.score = result.score;
+  analysis.depth = result.depth;
+  analysis.nodes = worker.search.nodes();
+  for (const Search::Line& line : result.lines) {
+    Line reported;
+    reported.move_text = worker.board.moveToNotation(line.move);
+    reported.score = line.score;
+    reported.pv = worker.board.lineToNotation(line.pv, worker.portal_system);
+    reported.portal = reported.pv.compare(reported.move_text.size(), 8, "[portal:") == 0;
+    analysis.lines.push_back(std::move(reported));
+  }
+  return analysis;
+}
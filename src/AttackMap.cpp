@@ -0,0 +1,226 @@
+// AttackMap.cpp
+#include "AttackMap.hpp"
+#include "PortalSystem.hpp"
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ATTACK_MAP_AVX2 1
+#endif
+
+namespace {
+
+constexpr int kMaxRanks = ChessBoard::kMaxMaskedBoardSize;
+
+uint32_t reverseBits(uint32_t v) {
+  v = ((v >> 1) & 0x55555555u) | ((v & 0x55555555u) << 1);
+  v = ((v >> 2) & 0x33333333u) | ((v & 0x33333333u) << 2);
+  v = ((v >> 4) & 0x0f0f0f0fu) | ((v & 0x0f0f0f0fu) << 4);
+  v = ((v >> 8) & 0x00ff00ffu) | ((v & 0x00ff00ffu) << 8);
+  return (v >> 16) | (v << 16);
+}
+
+// dst[i] |= ((src[i] << shift) | (src[i] >> shift)) & line
+void orSpreadScalar(const uint32_t* src, uint32_t* dst, int count, int shift, uint32_t line) {
+  for (int i = 0; i < count; ++i) {
+    dst[i] |= ((src[i] << shift) | (src[i] >> shift)) & line;
+  }
+}
+
+// dst[i] |= squares reached east and west from the sliders in src[i],
+// stopping at the first occupied square (Kogge-Stone occluded fill)
+void rankSlidesScalar(const uint32_t* src, const uint32_t* occupied, uint32_t* dst, int count,
+                      uint32_t line) {
+  for (int i = 0; i < count; ++i) {
+    const uint32_t empty = ~occupied[i] & line;
+    uint32_t east = src[i], pro = empty;
+    east |= pro & (east << 1); pro &= pro << 1;
+    east |= pro & (east << 2); pro &= pro << 2;
+    east |= pro & (east << 4); pro &= pro << 4;
+    east |= pro & (east << 8); pro &= pro << 8;
+    east |= pro & (east << 16);
+    uint32_t west = src[i];
+    pro = empty;
+    west |= pro & (west >> 1); pro &= pro >> 1;
+    west |= pro & (west >> 2); pro &= pro >> 2;
+    west |= pro & (west >> 4); pro &= pro >> 4;
+    west |= pro & (west >> 8); pro &= pro >> 8;
+    west |= pro & (west >> 16);
+    dst[i] |= ((east << 1) | (west >> 1)) & line;
+  }
+}
+
+#ifdef ATTACK_MAP_AVX2
+__attribute__((target("avx2")))
+void orSpreadAvx2(const uint32_t* src, uint32_t* dst, int count, int shift, uint32_t line) {
+  const __m256i mask = _mm256_set1_epi32(static_cast<int>(line));
+  const __m128i amount = _mm_cvtsi32_si128(shift);
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    __m256i spread = _mm256_or_si256(_mm256_sll_epi32(v, amount), _mm256_srl_epi32(v, amount));
+    __m256i out = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+    out = _mm256_or_si256(out, _mm256_and_si256(spread, mask));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), out);
+  }
+  orSpreadScalar(src + i, dst + i, count - i, shift, line);
+}
+
+__attribute__((target("avx2")))
+void rankSlidesAvx2(const uint32_t* src, const uint32_t* occupied, uint32_t* dst, int count,
+                    uint32_t line) {
+  const __m256i mask = _mm256_set1_epi32(static_cast<int>(line));
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m256i gen = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    const __m256i occ = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(occupied + i));
+    const __m256i empty = _mm256_andnot_si256(occ, mask);
+
+    __m256i east = gen, pro = empty;
+    east = _mm256_or_si256(east, _mm256_and_si256(pro, _mm256_slli_epi32(east, 1)));
+    pro = _mm256_and_si256(pro, _mm256_slli_epi32(pro, 1));
+    east = _mm256_or_si256(east, _mm256_and_si256(pro, _mm256_slli_epi32(east, 2)));
+    pro = _mm256_and_si256(pro, _mm256_slli_epi32(pro, 2));
+    east = _mm256_or_si256(east, _mm256_and_si256(pro, _mm256_slli_epi32(east, 4)));
+    pro = _mm256_and_si256(pro, _mm256_slli_epi32(pro, 4));
+    east = _mm256_or_si256(east, _mm256_and_si256(pro, _mm256_slli_epi32(east, 8)));
+    pro = _mm256_and_si256(pro, _mm256_slli_epi32(pro, 8));
+    east = _mm256_or_si256(east, _mm256_and_si256(pro, _mm256_slli_epi32(east, 16)));
+
+    __m256i west = gen;
+    pro = empty;
+    west = _mm256_or_si256(west, _mm256_and_si256(pro, _mm256_srli_epi32(west, 1)));
+    pro = _mm256_and_si256(pro, _mm256_srli_epi32(pro, 1));
+    west = _mm256_or_si256(west, _mm256_and_si256(pro, _mm256_srli_epi32(west, 2)));
+    pro = _mm256_and_si256(pro, _mm256_srli_epi32(pro, 2));
+    west = _mm256_or_si256(west, _mm256_and_si256(pro, _mm256_srli_epi32(west, 4)));
+    pro = _mm256_and_si256(pro, _mm256_srli_epi32(pro, 4));
+    west = _mm256_or_si256(west, _mm256_and_si256(pro, _mm256_srli_epi32(west, 8)));
+    pro = _mm256_and_si256(pro, _mm256_srli_epi32(pro, 8));
+    west = _mm256_or_si256(west, _mm256_and_si256(pro, _mm256_srli_epi32(west, 16)));
+
+    __m256i attacks = _mm256_or_si256(_mm256_slli_epi32(east, 1), _mm256_srli_epi32(west, 1));
+    __m256i out = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+    out = _mm256_or_si256(out, _mm256_and_si256(attacks, mask));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), out);
+  }
+  rankSlidesScalar(src + i, occupied + i, dst + i, count - i, line);
+}
+#endif
+
+void orSpread(const uint32_t* src, uint32_t* dst, int count, int shift, uint32_t line) {
+#ifdef ATTACK_MAP_AVX2
+  if (AttackMap::avx2Enabled()) {
+    orSpreadAvx2(src, dst, count, shift, line);
+    return;
+  }
+#endif
+  orSpreadScalar(src, dst, count, shift, line);
+}
+
+void rankSlides(const uint32_t* src, const uint32_t* occupied, uint32_t* dst, int count, uint32_t line) {
+#ifdef ATTACK_MAP_AVX2
+  if (AttackMap::avx2Enabled()) {
+    rankSlidesAvx2(src, occupied, dst, count, line);
+    return;
+  }
+#endif
+  rankSlidesScalar(src, occupied, dst, count, line);
+}
+
+} // namespace
+
+bool AttackMap::avx2Enabled() {
+#ifdef ATTACK_MAP_AVX2
+  static const bool enabled = __builtin_cpu_supports("avx2");
+  return enabled;
+#else
+  return false;
+#endif
+}
+
+uint32_t AttackMap::lineAttacks(uint32_t occupied, uint32_t slider, uint32_t line) {
+  const uint32_t others = line & ~slider;
+  uint32_t forward = occupied & others;
+  uint32_t reverse = reverseBits(forward);
+  forward -= slider;
+  reverse -= reverseBits(slider);
+  forward ^= reverseBits(reverse);
+  return forward & others;
+}
+
+void AttackMap::build(const ChessBoard& board, bool is_white, const PortalSystem& portal_system,
+                      bool include_king) {
+  ranks_.fill(0);
+  const int n = board.getBoardSize();
+  const uint32_t line = board.lineMask();
+  uint32_t* att = ranks_.data() + kPad;
+
+  // Leapers: each spread covers all ranks in one pass
+  const uint32_t* pawns = board.pieceRanks(is_white, PieceKind::Pawn);
+  orSpread(pawns, att + (is_white ? 1 : -1), n, 1, line);
+
+  const uint32_t* knights = board.pieceRanks(is_white, PieceKind::Knight);
+  orSpread(knights, att + 1, n, 2, line);
+  orSpread(knights, att - 1, n, 2, line);
+  orSpread(knights, att + 2, n, 1, line);
+  orSpread(knights, att - 2, n, 1, line);
+
+  if (include_king) {
+    const uint32_t* kings = board.pieceRanks(is_white, PieceKind::King);
+    orSpread(kings, att - 1, n, 1, line);
+    orSpread(kings, att, n, 1, line);
+    orSpread(kings, att + 1, n, 1, line);
+    orSpread(kings, att - 1, n, 0, line);
+    orSpread(kings, att + 1, n, 0, line);
+  }
+
+  // Sliders grouped by the lines they move along
+  uint32_t straight[kMaxRanks];
+  uint32_t diagonal[kMaxRanks];
+  uint32_t occupied[kMaxRanks];
+  const uint32_t* queens = board.pieceRanks(is_white, PieceKind::Queen);
+  const uint32_t* rooks = board.pieceRanks(is_white, PieceKind::Rook);
+  const uint32_t* bishops = board.pieceRanks(is_white, PieceKind::Bishop);
+  for (int y = 0; y < n; ++y) {
+    straight[y] = rooks[y] | queens[y];
+    diagonal[y] = bishops[y] | queens[y];
+    occupied[y] = board.rankOccupancy(y);
+  }
+  rankSlides(straight, occupied, att, n, line);
+
+  // File and diagonal rays: carry every ray one rank at a time, all files at once
+  uint32_t north = 0, north_east = 0, north_west = 0;
+  for (int y = 0; y < n; ++y) {
+    att[y] |= north | north_east | north_west;
+    const uint32_t empty = ~occupied[y] & line;
+    north = (north & empty) | straight[y];
+    north_east = (((north_east & empty) | diagonal[y]) << 1) & line;
+    north_west = ((north_west & empty) | diagonal[y]) >> 1;
+  }
+  uint32_t south = 0, south_east = 0, south_west = 0;
+  for (int y = n - 1; y >= 0; --y) {
+    att[y] |= south | south_east | south_west;
+    const uint32_t empty = ~occupied[y] & line;
+    south = (south & empty) | straight[y];
+    south_east = (((south_east & empty) | diagonal[y]) << 1) & line;
+    south_west = ((south_west & empty) | diagonal[y]) >> 1;
+  }
+
+  // A piece standing on a usable portal entry also attacks the exit
+  const auto& portals = portal_system.getPortals();
+  for (size_t i = 0; i < portals.size(); ++i) {
+    const Position entry = portals[i].positions.entry;
+    const Position exit = portals[i].positions.exit;
+    const auto& square = board.getSquare(entry);
+    if (square.is_empty() || square.is_white != is_white || square.kind == PieceKind::Custom) continue;
+    // The validator never lets a pawn take a portal onto its promotion rank
+    if (square.kind == PieceKind::Pawn && exit.y == (is_white ? 7 : 0)) continue;
+    if (!portal_system.validatePortalMove(board.pieceName(square), entry, exit, is_white, board, false)) continue;
+    att[exit.y] |= 1u << exit.x;
+  }
+
+  for (int y = 0; y < n; ++y) {
+    att[y] &= line;
+  }
+}
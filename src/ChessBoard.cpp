@@ -3,19 +3,90 @@
 #include "MoveValidator.hpp"
 #include "PortalSystem.hpp"
 #include "GameManager.hpp"
+#include "Zobrist.hpp"
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 #include <cctype>
+#include <cstring>
+
+namespace {
+
+std::string lowerCopy(const std::string& str) {
+  std::string lower = str;
+  std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) {
+    return std::tolower(c);
+  });
+  return lower;
+}
+
+bool sameName(std::string_view a, std::string_view b) {
+  return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](unsigned char x, unsigned char y) {
+           return std::tolower(x) == std::tolower(y);
+         });
+}
+
+PieceKind kindFromName(const std::string& name) {
+  std::string lower = lowerCopy(name);
+  if (lower == "king") return PieceKind::King;
+  if (lower == "queen") return PieceKind::Queen;
+  if (lower == "rook") return PieceKind::Rook;
+  if (lower == "bishop") return PieceKind::Bishop;
+  if (lower == "knight") return PieceKind::Knight;
+  if (lower == "pawn") return PieceKind::Pawn;
+  return PieceKind::Custom;
+}
+
+const char* promotionName(PromotionPiece promotion) {
+  switch (promotion) {
+    case PromotionPiece::Rook: return "Rook";
+    case PromotionPiece::Bishop: return "Bishop";
+    case PromotionPiece::Knight: return "Knight";
+    default: return "Queen";
+  }
+}
+
+} // namespace
 
 ChessBoard::ChessBoard(int size, const std::string& display_format) 
-    : board_size(size), board_display_format(display_format) {}
+    : piece_types{{"", PieceKind::None}}, board_size(size),
+      board_display_format(display_format) {
+  if (!isSparse()) {
+    squares.resize(static_cast<size_t>(size) * size);
+  }
+  clearLineMasks();
+}
 
-int ChessBoard::getBoardSize() const {
-  return board_size;
+void ChessBoard::clearLineMasks() {
+  if (!hasLineMasks()) {
+    return;
+  }
+  size_t lines = static_cast<size_t>(board_size);
+  size_t diagonals = lines > 0 ? 2 * lines - 1 : 0;
+  rank_occupancy.assign(lines, 0);
+  file_occupancy.assign(lines, 0);
+  diagonal_occupancy.assign(diagonals, 0);
+  anti_diagonal_occupancy.assign(diagonals, 0);
+  piece_rank_masks.assign(2 * kPieceKindCount * lines, 0);
+}
+
+// Flip the bits of `square` at `index` in every occupancy mask
+void ChessBoard::toggleLineMasks(int index, const Square& square) {
+  if (square.is_empty()) {
+    return;
+  }
+  const int x = index % board_size;
+  const int y = index / board_size;
+  rank_occupancy[y] ^= 1u << x;
+  file_occupancy[x] ^= 1u << y;
+  diagonal_occupancy[x - y + board_size - 1] ^= 1u << x;
+  anti_diagonal_occupancy[x + y] ^= 1u << x;
+  piece_rank_masks[(static_cast<size_t>(square.is_white) * kPieceKindCount +
+                    static_cast<size_t>(square.kind)) * board_size + y] ^= 1u << x;
 }
 
-std::string ChessBoard::posToString(const Position& pos) const {
-  return std::to_string(pos.x) + "," + std::to_string(pos.y);
+int ChessBoard::getBoardSize() const {
+  return board_size;
 }
 
 bool ChessBoard::isInBounds(const Position& pos) const {
@@ -26,41 +97,448 @@ const ChessBoard::Square& ChessBoard::getSquare(const Position& pos) const {
   if (!isInBounds(pos)) {
     throw std::out_of_range("Position out of board bounds.");
   }
-  static const Square empty_square;
-  auto it = board.find(posToString(pos));
-  return it != board.end() ? it->second : empty_square;
+  return at(squareIndex(pos));
+}
+
+void ChessBoard::setSquare(const Position& pos, const Square& square) {
+  if (!isInBounds(pos)) {
+    throw std::invalid_argument("Invalid position.");
+  }
+  put(squareIndex(pos), square);
+}
+
+// Every square write goes through here to keep the placement hash current
+void ChessBoard::put(int index, Square square) {
+  const Square old = at(index);
+  placement_hash ^= Zobrist::piece(old.type, old.is_white, index) ^
+                    Zobrist::piece(square.type, square.is_white, index);
+  if (isSparse()) {
+    putSparse(index, old, square);
+    return;
+  }
+  if (hasLineMasks()) {
+    toggleLineMasks(index, old);
+    toggleLineMasks(index, square);
+  }
+  squares[index] = square;
+}
+
+const ChessBoard::Square& ChessBoard::at(int index) const {
+  if (!isSparse()) {
+    return squares[index];
+  }
+  static const Square kEmpty;
+  auto it = std::lower_bound(pieces.begin(), pieces.end(), index,
+                             [](const Occupant& o, int key) { return o.index < key; });
+  return it != pieces.end() && it->index == index ? it->square : kEmpty;
+}
+
+// Sort keys of a square within each line index: (line * size + offset along the line)
+int ChessBoard::lineKey(Line line, int x, int y) const {
+  switch (line) {
+    case Line::Rank: return y * board_size + x;
+    case Line::File: return x * board_size + y;
+    case Line::Diagonal: return (x - y + board_size - 1) * board_size + x;
+    case Line::AntiDiagonal: return (x + y) * board_size + x;
+  }
+  return 0;
+}
+
+void ChessBoard::putSparse(int index, const Square& old, const Square& square) {
+  auto it = std::lower_bound(pieces.begin(), pieces.end(), index,
+                             [](const Occupant& o, int key) { return o.index < key; });
+  if (!old.is_empty() && !square.is_empty()) {
+    it->square = square;  // same square stays occupied, the line indexes do not change
+    return;
+  }
+  const Position pos = squarePosition(index);
+  if (!old.is_empty()) {
+    pieces.erase(it);
+    for (int line = 1; line < kLineCount; ++line) {
+      auto& keys = line_keys[line];
+      keys.erase(std::lower_bound(keys.begin(), keys.end(), lineKey(static_cast<Line>(line), pos.x, pos.y)));
+    }
+  } else if (!square.is_empty()) {
+    pieces.insert(it, Occupant{index, square});
+    for (int line = 1; line < kLineCount; ++line) {
+      auto& keys = line_keys[line];
+      const int key = lineKey(static_cast<Line>(line), pos.x, pos.y);
+      keys.insert(std::lower_bound(keys.begin(), keys.end(), key), key);
+    }
+  }
+}
+
+// Squares a slider can reach from `from` in direction (dx, dy): up to and
+// including the first occupied square, or to the edge of the board
+int ChessBoard::rayLength(const Position& from, int dx, int dy) const {
+  int to_edge = board_size;
+  if (dx > 0) to_edge = std::min(to_edge, board_size - 1 - from.x);
+  if (dx < 0) to_edge = std::min(to_edge, from.x);
+  if (dy > 0) to_edge = std::min(to_edge, board_size - 1 - from.y);
+  if (dy < 0) to_edge = std::min(to_edge, from.y);
+  if (!isSparse()) {
+    for (int i = 1; i <= to_edge; ++i) {
+      if (!at(squareIndex({from.x + i * dx, from.y + i * dy})).is_empty()) return i;
+    }
+    return to_edge;
+  }
+
+  // Binary search the line index for the nearest occupied key in the ray's direction
+  const Line line = dy == 0 ? Line::Rank : dx == 0 ? Line::File : dx == dy ? Line::Diagonal : Line::AntiDiagonal;
+  const int offset = line == Line::File ? from.y : from.x;
+  const int step = line == Line::File ? dy : dx;
+  const int key = lineKey(line, from.x, from.y);
+  const int line_start = key - offset;
+  int blocker_offset = -1;
+  if (line == Line::Rank) {
+    auto it = step > 0 ? std::upper_bound(pieces.begin(), pieces.end(), key,
+                                          [](int k, const Occupant& o) { return k < o.index; })
+                       : std::lower_bound(pieces.begin(), pieces.end(), key,
+                                          [](const Occupant& o, int k) { return o.index < k; });
+    if (step > 0 && it != pieces.end() && it->index < line_start + board_size) {
+      blocker_offset = it->index - line_start;
+    } else if (step < 0 && it != pieces.begin() && std::prev(it)->index >= line_start) {
+      blocker_offset = std::prev(it)->index - line_start;
+    }
+  } else {
+    const auto& keys = line_keys[static_cast<int>(line)];
+    auto it = step > 0 ? std::upper_bound(keys.begin(), keys.end(), key)
+                       : std::lower_bound(keys.begin(), keys.end(), key);
+    if (step > 0 && it != keys.end() && *it < line_start + board_size) {
+      blocker_offset = *it - line_start;
+    } else if (step < 0 && it != keys.begin() && *std::prev(it) >= line_start) {
+      blocker_offset = *std::prev(it) - line_start;
+    }
+  }
+  if (blocker_offset < 0) {
+    return to_edge;
+  }
+  return std::min(to_edge, std::abs(blocker_offset - offset));
+}
+
+uint64_t ChessBoard::positionKey(const PortalSystem& portal_system) const {
+  uint64_t key = placement_hash ^ Zobrist::castling(castling_rights) ^ Zobrist::enPassant(en_passant_square);
+  if (!white_to_move) {
+    key ^= Zobrist::blackToMove();
+  }
+  for (size_t i = 0; i < portal_system.getPortals().size(); ++i) {
+    key ^= Zobrist::portalCooldown(i, portal_system.getRemainingCooldown(i));
+  }
+  return key;
+}
+
+const std::string& ChessBoard::pieceName(const Square& square) const {
+  return piece_types[square.type].name;
+}
+
+PieceKind ChessBoard::kindOfName(const std::string& name) { return kindFromName(name); }
+
+uint8_t ChessBoard::pieceTypeId(const std::string& name) {
+  if (const uint8_t type = findPieceType(name)) {
+    return type;
+  }
+  if (piece_types.size() >= kMaxPieceTypes) {
+    throw std::length_error("Too many piece types.");
+  }
+  piece_types.push_back({name, kindFromName(name)});
+  return static_cast<uint8_t>(piece_types.size() - 1);
+}
+
+uint8_t ChessBoard::findPieceType(std::string_view name) const {
+  // Names usually come back spelled as they were registered
+  for (size_t i = 1; i < piece_types.size(); ++i) {
+    if (piece_types[i].name == name) {
+      return static_cast<uint8_t>(i);
+    }
+  }
+  for (size_t i = 1; i < piece_types.size(); ++i) {
+    if (sameName(piece_types[i].name, name)) {
+      return static_cast<uint8_t>(i);
+    }
+  }
+  return 0;
+}
+
+void ChessBoard::registerPieceTypes(const GameConfig& config) {
+  for (const auto* pieces : {&config.pieces, &config.custom_pieces}) {
+    for (const auto& piece : *pieces) {
+      pieceTypeId(piece.type);
+    }
+  }
+  for (const char* name : {"King", "Queen", "Rook", "Bishop", "Knight", "Pawn"}) {
+    pieceTypeId(name);
+  }
+}
+
+void ChessBoard::truncatePieceTypes(size_t count) {
+  if (count >= 1 && count < piece_types.size()) {
+    piece_types.resize(count);
+  }
 }
 
 void ChessBoard::placePiece(const std::string& piece, bool is_white, int x, int y) {
   if (!isInBounds({x, y})) {
     throw std::invalid_argument("Invalid position.");
   }
-  std::string pos_str = posToString({x, y});
   if (piece.empty()) {
-    board.erase(pos_str);
+    put(squareIndex({x, y}), Square());
   } else {
-    board[pos_str] = Square(piece, is_white);
+    uint8_t type = pieceTypeId(piece);
+    put(squareIndex({x, y}), Square(type, piece_types[type].kind, is_white));
+  }
+}
+
+void ChessBoard::clearPieces() {
+  std::fill(squares.begin(), squares.end(), Square());
+  pieces.clear();
+  for (auto& keys : line_keys) {
+    keys.clear();
+  }
+  clearLineMasks();
+  placement_hash = 0;
+  white_to_move = true;
+  castling_rights = 0;
+  en_passant_square = -1;
+}
+
+void ChessBoard::placePieces(const Placement* placements, size_t count) {
+  if (!isSparse()) {
+    // The squares are empty, so there is nothing to take off first
+    for (size_t i = 0; i < count; ++i) {
+      const int index = placements[i].index;
+      const Square& square = placements[i].square;
+      placement_hash ^= Zobrist::piece(square.type, square.is_white, index);
+      toggleLineMasks(index, square);
+      squares[index] = square;
+    }
+    return;
+  }
+  const bool was_empty = pieces.empty();
+  for (size_t i = 0; i < count; ++i) {
+    const Square& square = placements[i].square;
+    placement_hash ^= Zobrist::piece(square.type, square.is_white, placements[i].index);
+    pieces.push_back(Occupant{placements[i].index, square});
+  }
+  const auto by_index = [](const Occupant& a, const Occupant& b) { return a.index < b.index; };
+  if (!was_empty || !std::is_sorted(pieces.begin(), pieces.end(), by_index)) {
+    std::sort(pieces.begin(), pieces.end(), by_index);
+    for (int line = 1; line < kLineCount; ++line) {
+      auto& keys = line_keys[line];
+      keys.clear();
+      for (const Occupant& occupant : pieces) {
+        const Position pos = squarePosition(occupant.index);
+        keys.push_back(lineKey(static_cast<Line>(line), pos.x, pos.y));
+      }
+      std::sort(keys.begin(), keys.end());
+    }
+    return;
+  }
+  // Pieces in index order are already in order along every file and
+  // diagonal (anti-diagonals when walked backwards), so a counting sort by
+  // line number sorts each line index in linear time
+  int starts[2 * kMaxBoardSize];
+  for (int line = 1; line < kLineCount; ++line) {
+    const int lines = line == static_cast<int>(Line::File) ? board_size : 2 * board_size - 1;
+    std::fill(starts, starts + lines, 0);
+    for (const Occupant& occupant : pieces) {
+      const Position pos = squarePosition(occupant.index);
+      ++starts[lineKey(static_cast<Line>(line), pos.x, pos.y) / board_size];
+    }
+    for (int i = 0, total = 0; i < lines; ++i) {
+      const int n = starts[i];
+      starts[i] = total;
+      total += n;
+    }
+    auto& keys = line_keys[line];
+    keys.resize(pieces.size());
+    const bool backwards = line == static_cast<int>(Line::AntiDiagonal);
+    for (size_t i = 0; i < pieces.size(); ++i) {
+      const Position pos = squarePosition(pieces[backwards ? pieces.size() - 1 - i : i].index);
+      const int key = lineKey(static_cast<Line>(line), pos.x, pos.y);
+      keys[starts[key / board_size]++] = key;
+    }
   }
 }
 
 void ChessBoard::initializeBoard(const std::vector<PieceConfig>& piece_configs) {
-  board.clear();
+  clearPieces();
+  castling_rights = kWhiteKingside | kWhiteQueenside | kBlackKingside | kBlackQueenside;
   for (const auto& config : piece_configs) {
-    if (config.positions.find("white") != config.positions.end()) {
-      for (const auto& pos : config.positions.at("white")) {
+    pieceTypeId(config.type);
+    for (bool is_white : {true, false}) {
+      for (const auto& pos : config.positions.of(is_white)) {
         if (isInBounds(pos)) {
-          placePiece(config.type, true, pos.x, pos.y);
+          placePiece(config.type, is_white, pos.x, pos.y);
         }
       }
     }
-    if (config.positions.find("black") != config.positions.end()) {
-      for (const auto& pos : config.positions.at("black")) {
-        if (isInBounds(pos)) {
-          placePiece(config.type, false, pos.x, pos.y);
-        }
-      }
+  }
+}
+
+bool ChessBoard::hasCastlingRight(bool is_white, bool kingside) const {
+  uint8_t right = is_white ? (kingside ? kWhiteKingside : kWhiteQueenside)
+                           : (kingside ? kBlackKingside : kBlackQueenside);
+  return (castling_rights & right) != 0;
+}
+
+bool ChessBoard::isPromotionRank(int y, bool is_white) const {
+  return is_white ? y == board_size - 1 : y == 0;
+}
+
+// Rights lost when a piece leaves or lands on the given square
+uint8_t ChessBoard::castlingMask(int index) const {
+  const Position pos = squarePosition(index);
+  if (pos.y != 0 && pos.y != 7) return 0;
+  uint8_t kingside = pos.y == 0 ? kWhiteKingside : kBlackKingside;
+  uint8_t queenside = pos.y == 0 ? kWhiteQueenside : kBlackQueenside;
+  if (pos.x == 4) return kingside | queenside;
+  if (pos.x == 7) return kingside;
+  if (pos.x == 0) return queenside;
+  return 0;
+}
+
+EncodedMove ChessBoard::encodeMove(const Position& start, const Position& end,
+                                   PromotionPiece promotion) const {
+  const Square& moving = getSquare(start);
+  const int from = squareIndex(start);
+  const int to = squareIndex(end);
+  if (moving.kind == PieceKind::King && std::abs(end.x - start.x) == 2 && end.y == start.y) {
+    return EncodedMove::make(from, to, MoveKind::Castle);
+  }
+  if (moving.kind == PieceKind::Pawn) {
+    if (end.x != start.x && to == en_passant_square && getSquare(end).is_empty()) {
+      return EncodedMove::make(from, to, MoveKind::EnPassant);
+    }
+    if (isPromotionRank(end.y, moving.is_white)) {
+      return EncodedMove::make(from, to, MoveKind::Promotion, promotion);
     }
   }
+  return EncodedMove::make(from, to);
+}
+
+uint8_t ChessBoard::promotionType(PromotionPiece promotion) {
+  return pieceTypeId(promotionName(promotion));
+}
+
+void ChessBoard::applyMove(EncodedMove move, PortalSystem& portal_system, UndoRecord& undo) {
+  const int from = move.from();
+  const int to = move.to();
+  const Position start = squarePosition(from);
+  const Position end = squarePosition(to);
+  const Square moving = at(from);
+
+  undo.moved = moving.type;
+  undo.captured = at(to).type;
+  undo.captured_white = at(to).is_white;
+  undo.castling_rights = castling_rights;
+  undo.en_passant = static_cast<int16_t>(en_passant_square);
+  undo.portal = -1;
+  undo.exit_captured = 0;
+  undo.exit_captured_white = false;
+
+  put(to, moving);
+  put(from, Square());
+
+  switch (move.kind()) {
+    case MoveKind::EnPassant: {
+      int captured_index = squareIndex({end.x, start.y});
+      undo.captured = at(captured_index).type;
+      undo.captured_white = at(captured_index).is_white;
+      put(captured_index, Square());
+      break;
+    }
+    case MoveKind::Castle: {
+      bool is_kingside = end.x > start.x;
+      int rook_from = squareIndex({is_kingside ? 7 : 0, start.y});
+      int rook_to = squareIndex({is_kingside ? 5 : 3, start.y});
+      put(rook_to, at(rook_from));
+      put(rook_from, Square());
+      break;
+    }
+    case MoveKind::Promotion: {
+      uint8_t type = promotionType(move.promotion());
+      put(to, Square(type, piece_types[type].kind, moving.is_white));
+      break;
+    }
+    case MoveKind::Normal:
+      break;
+  }
+
+  en_passant_square = -1;
+  if (moving.kind == PieceKind::Pawn && start.x == end.x && std::abs(end.y - start.y) == 2) {
+    en_passant_square = squareIndex({start.x, (start.y + end.y) / 2});
+  }
+  castling_rights &= ~(castlingMask(from) | castlingMask(to));
+
+  // Landing on a ready portal entry teleports the piece to the exit
+  const auto& portals = portal_system.getPortals();
+  for (size_t i = 0; i < portals.size(); ++i) {
+    const auto& portal = portals[i];
+    if (end.x != portal.positions.entry.x || end.y != portal.positions.entry.y) continue;
+    const Position portal_exit = portal.positions.exit;
+    if (portal_system.isPortalInCooldown(end, portal_exit, false) ||
+        !portal_system.validatePortalMove(pieceName(at(to)), end, portal_exit,
+                                          moving.is_white, *this, false)) {
+      continue;
+    }
+    int exit_index = squareIndex(portal_exit);
+    undo.portal = static_cast<int16_t>(i);
+    undo.portal_ready_at = portal_system.getReadyAt(i);
+    undo.exit_captured = at(exit_index).type;
+    undo.exit_captured_white = at(exit_index).is_white;
+    put(exit_index, at(to));
+    put(to, Square());
+    castling_rights &= ~castlingMask(exit_index);
+    portal_system.startCooldown(i);
+    break;
+  }
+
+  white_to_move = !white_to_move;
+  portal_system.updateCooldowns();
+}
+
+void ChessBoard::undoMove(EncodedMove move, const UndoRecord& undo, PortalSystem& portal_system) {
+  const int from = move.from();
+  const int to = move.to();
+  const Position start = squarePosition(from);
+  const Position end = squarePosition(to);
+
+  portal_system.rewindCooldowns();
+
+  if (undo.portal >= 0) {
+    const auto& portal = portal_system.getPortals()[undo.portal];
+    int exit_index = squareIndex(portal.positions.exit);
+    put(to, at(exit_index));
+    put(exit_index, undo.exit_captured == 0
+        ? Square()
+        : Square(undo.exit_captured, piece_types[undo.exit_captured].kind, undo.exit_captured_white));
+    portal_system.setReadyAt(undo.portal, undo.portal_ready_at);
+  }
+
+  const bool is_white = at(to).is_white;
+  put(from, Square(undo.moved, piece_types[undo.moved].kind, is_white));
+  const Square captured = undo.captured == 0
+      ? Square()
+      : Square(undo.captured, piece_types[undo.captured].kind, undo.captured_white);
+
+  if (move.kind() == MoveKind::EnPassant) {
+    put(to, Square());
+    put(squareIndex({end.x, start.y}), captured);
+  } else {
+    put(to, captured);
+  }
+
+  if (move.kind() == MoveKind::Castle) {
+    bool is_kingside = end.x > start.x;
+    int rook_from = squareIndex({is_kingside ? 7 : 0, start.y});
+    int rook_to = squareIndex({is_kingside ? 5 : 3, start.y});
+    put(rook_from, at(rook_to));
+    put(rook_to, Square());
+  }
+
+  castling_rights = undo.castling_rights;
+  en_passant_square = undo.en_passant;
+  white_to_move = !white_to_move;
 }
 
 void ChessBoard::movePiece(const Position& start, const Position& end, 
@@ -70,135 +548,59 @@ void ChessBoard::movePiece(const Position& start, const Position& end,
         throw std::invalid_argument("Invalid position.");
     }
 
-    const auto& start_square = getSquare(start);
+    const Square moving = getSquare(start);
+    if (moving.is_empty()) {
+        throw std::invalid_argument("No piece at starting position.");
+    }
 
-    if (!validator.isValidMove(start_square.piece, start, end, start_square.is_white, 
+    if (!validator.isValidMove(pieceName(moving), start, end, moving.is_white, 
                               *this, portal_system)) {
         throw std::invalid_argument("Invalid move.");
     }
 
-    std::string captured_piece = getSquare(end).piece;
-    bool captured_piece_color = getSquare(end).is_white;
-
-    
-    std::string start_str = posToString(start);
-    std::string end_str = posToString(end);
-    if (board.find(start_str) == board.end()) {
-        throw std::invalid_argument("No piece at starting position.");
+    EncodedMove move = encodeMove(start, end);
+    if (move.kind() == MoveKind::Promotion) {
+        move = encodeMove(start, end, promptPromotion());
     }
-    board[end_str] = board[start_str];
-    board.erase(start_str);
 
+    game_manager.makeMove(move);
+    const UndoRecord& undo = game_manager.lastUndoRecord();
 
-    if (validator.toLowerCase(start_square.piece) == "pawn") {
-        bool is_promotion_rank = (start_square.is_white && end.y == 7) || 
-                               (!start_square.is_white && end.y == 0);
-        if (is_promotion_rank) {
-            handlePawnPromotion(end, start_square.is_white);
-        }
+    if (move.kind() == MoveKind::Promotion) {
+        std::cout << (moving.is_white ? "White" : "Black") << " pawn promoted to "
+                  << promotionName(move.promotion()) << "!" << std::endl;
     }
-
-    // En passant
-    if (validator.toLowerCase(start_square.piece) == "pawn" && 
-        abs(end.x - start.x) == 1 && getSquare(end).is_empty()) {
-        Position captured_pawn_pos = {end.x, start.y};
-        if (!getSquare(captured_pawn_pos).is_empty()) {
-            std::string captured_str = posToString(captured_pawn_pos);
-            captured_piece = board[captured_str].piece;
-            captured_piece_color = board[captured_str].is_white;
-            board.erase(captured_str);
-            std::cout << "\nPawn captured via en passant." << std::endl;
-        }
+    if (move.kind() == MoveKind::EnPassant) {
+        std::cout << "\nPawn captured via en passant." << std::endl;
     }
-
-    // Castling
-    if (validator.toLowerCase(start_square.piece) == "king" && 
-        abs(end.x - start.x) == 2) {
-        handleCastling(start, end);
-    }
-
-    // Add to move history for undo
-    game_manager.addToMoveHistory({start, end, start_square.piece, start_square.is_white, 
-                                  captured_piece, captured_piece_color});
-
-    // Portal check
-    for (const auto& portal : portal_system.getPortals()) {
-        if (end.x == portal.positions.entry.x && end.y == portal.positions.entry.y) {
-            // Piece teleported
-            Position portal_exit = portal.positions.exit;
-            
-            
-            if (!portal_system.isPortalInCooldown(end, portal_exit) &&
-                portal_system.validatePortalMove(start_square.piece, end, portal_exit, 
-                                               start_square.is_white, *this)) {
-                std::cout << "\n!!Portal!!" << std::endl;
-                
-                
-                std::string exit_str = posToString(portal_exit);
-                board[exit_str] = board[end_str];
-                board.erase(end_str);
-                
-                // Add portal move to stack
-                game_manager.addToMoveHistory({end, portal_exit, start_square.piece, 
-                                             start_square.is_white, "", false});
-                
-                
-                portal_system.handlePortalMove(end, portal_exit, *this);
-                break;
-            }
-        }
+    if (move.kind() == MoveKind::Castle) {
+        std::cout << "\nCastling performed!" << std::endl;
+    }
+    if (undo.portal >= 0) {
+        std::cout << "\n!!Portal!!" << std::endl;
     }
 
-   
-    portal_system.updateCooldowns();
+    portal_system.reportCooldowns();
 }
 
-void ChessBoard::handlePawnPromotion(const Position& pos, bool is_white) {
+PromotionPiece ChessBoard::promptPromotion() const {
     std::string promoted_piece;
     std::cout << "\nPawn promotion! Options: Queen, Rook, Bishop, Knight" << std::endl;
     std::cout << "Select piece to promote to: ";
-    std::cin >> promoted_piece;
-
-    // Capitalize first letter, lowercase the rest
-    promoted_piece[0] = std::toupper(promoted_piece[0]);
-    for (size_t i = 1; i < promoted_piece.length(); ++i) {
-        promoted_piece[i] = std::tolower(promoted_piece[i]);
-    }
 
     // Check if valid selection
-    std::vector<std::string> valid_pieces = {"Queen", "Rook", "Bishop", "Knight"};
-    while (std::find(valid_pieces.begin(), valid_pieces.end(), promoted_piece) == valid_pieces.end()) {
-        std::cout << "Invalid selection. Please try again: ";
-        std::cin >> promoted_piece;
-        promoted_piece[0] = std::toupper(promoted_piece[0]);
-        for (size_t i = 1; i < promoted_piece.length(); ++i) {
-            promoted_piece[i] = std::tolower(promoted_piece[i]);
+    const PromotionPiece options[] = {PromotionPiece::Queen, PromotionPiece::Rook,
+                                      PromotionPiece::Bishop, PromotionPiece::Knight};
+    while (std::cin >> promoted_piece) {
+        std::string lower = lowerCopy(promoted_piece);
+        for (PromotionPiece option : options) {
+            if (lowerCopy(promotionName(option)) == lower) {
+                return option;
+            }
         }
+        std::cout << "Invalid selection. Please try again: ";
     }
-
-    // Promote pawn
-    std::string pos_str = posToString(pos);
-    board[pos_str] = Square(promoted_piece, is_white);
-    std::cout << (is_white ? "White" : "Black") << " pawn promoted to " << promoted_piece << "!" << std::endl;
-}
-
-void ChessBoard::handleCastling(const Position& king_start, const Position& king_end) {
-    // Determine if kingside or queenside castling
-    bool is_kingside = king_end.x > king_start.x;
-    
-    // Calculate rook start and end positions
-    int rook_start_x = is_kingside ? 7 : 0;
-    int rook_end_x = is_kingside ? 5 : 3;
-    Position rook_start = {rook_start_x, king_start.y};
-    Position rook_end = {rook_end_x, king_start.y};
-    
-    // Move the rook
-    std::string rook_start_str = posToString(rook_start);
-    std::string rook_end_str = posToString(rook_end);
-    board[rook_end_str] = board[rook_start_str];
-    board.erase(rook_start_str);
-    
-    std::cout << "\nCastling performed!" << std::endl;
+    return PromotionPiece::Queen;
 }
 
 void ChessBoard::printBoard() const {
@@ -210,7 +612,7 @@ void ChessBoard::printBoard() const {
         if (square.is_empty()) {
           std::cout << ". ";
         } else {
-          char symbol = square.piece[0];
+          char symbol = pieceName(square)[0];
           if (square.is_white) {
             symbol = std::toupper(symbol);
           }
@@ -223,25 +625,26 @@ void ChessBoard::printBoard() const {
     // Display columns (a-h) and rows (1-8)
     std::cout << "   ";
     for (int x = 0; x < board_size; ++x) {
-      std::cout << (char)('a' + x) << "  ";
+      const std::string file = fileName(x);
+      std::cout << file << std::string(file.size() < 3 ? 3 - file.size() : 1, ' ');
     }
     std::cout << std::endl;
 
     for (int y = board_size - 1; y >= 0; --y) {
       std::cout << (y + 1) << "  ";
       for (int x = 0; x < board_size; ++x) {
-        Position pos{x, y};
-        std::string key = posToString(pos);
-        if (board.find(key) != board.end() && !board.at(key).is_empty()) {
-          const auto& square = board.at(key);
+        const Square& square = getSquare({x, y});
+        if (!square.is_empty()) {
           std::string piece_short;
-          if (square.piece == "King") piece_short = square.is_white ? "WK" : "BK";
-          else if (square.piece == "Queen") piece_short = square.is_white ? "WQ" : "BQ";
-          else if (square.piece == "Rook") piece_short = square.is_white ? "WR" : "BR";
-          else if (square.piece == "Bishop") piece_short = square.is_white ? "WB" : "BB";
-          else if (square.piece == "Knight") piece_short = square.is_white ? "WA" : "BA";
-          else if (square.piece == "Pawn") piece_short = square.is_white ? "WP" : "BP";
-          else piece_short = square.is_white ? "XX" : "xx";
+          switch (square.kind) {
+            case PieceKind::King: piece_short = square.is_white ? "WK" : "BK"; break;
+            case PieceKind::Queen: piece_short = square.is_white ? "WQ" : "BQ"; break;
+            case PieceKind::Rook: piece_short = square.is_white ? "WR" : "BR"; break;
+            case PieceKind::Bishop: piece_short = square.is_white ? "WB" : "BB"; break;
+            case PieceKind::Knight: piece_short = square.is_white ? "WA" : "BA"; break;
+            case PieceKind::Pawn: piece_short = square.is_white ? "WP" : "BP"; break;
+            default: piece_short = square.is_white ? "XX" : "xx"; break;
+          }
           std::cout << piece_short << " ";
         } else {
           std::cout << " . ";
@@ -252,31 +655,111 @@ void ChessBoard::printBoard() const {
 
     std::cout << "   ";
     for (int x = 0; x < board_size; ++x) {
-      std::cout << (char)('a' + x) << "  ";
+      const std::string file = fileName(x);
+      std::cout << file << std::string(file.size() < 3 ? 3 - file.size() : 1, ' ');
     }
     std::cout << std::endl;
   }
 }
 
+// Files run a..z, then aa, ab, ... (bijective base 26), so 128 files end at "dx"
+std::string ChessBoard::fileName(int x) {
+    std::string name;
+    for (int n = x + 1; n > 0; n = (n - 1) / 26) {
+        name.insert(name.begin(), static_cast<char>('a' + (n - 1) % 26));
+    }
+    return name;
+}
+
+// Letters for the file, then the 1-based rank, e.g. "e4" or "ab12"
+bool ChessBoard::parseNotation(const std::string& notation, Position& pos) {
+    size_t i = 0;
+    int x = 0;
+    while (i < notation.size() && std::isalpha(static_cast<unsigned char>(notation[i]))) {
+        x = x * 26 + (std::tolower(static_cast<unsigned char>(notation[i])) - 'a' + 1);
+        if (++i > 2) return false;  // three letters would be past any supported board
+    }
+    if (i == 0 || i == notation.size() || notation.size() - i > 3) {
+        return false;
+    }
+    int y = 0;
+    for (; i < notation.size(); ++i) {
+        if (!std::isdigit(static_cast<unsigned char>(notation[i]))) return false;
+        y = y * 10 + (notation[i] - '0');
+    }
+    pos = Position{x - 1, y - 1};
+    return true;
+}
+
 // Convert notation to position coordinates
 Position ChessBoard::notationToPosition(const std::string& notation) const {
-    if (notation.length() != 2) {
+    Position pos;
+    if (!parseNotation(notation, pos)) {
         throw std::invalid_argument("Invalid notation.");
     }
-    
-    int x = std::tolower(notation[0]) - 'a';
-    int y = notation[1] - '1';
-    
-    return Position{x, y};
+    return pos;
 }
 
 std::string ChessBoard::positionToNotation(const Position& pos) const {
     if (!isInBounds(pos)) {
         throw std::invalid_argument("Invalid position.");
     }
-    
-    char file = 'a' + pos.x;
-    char rank = '1' + pos.y;
-    
-    return std::string(1, file) + std::string(1, rank);
-}
\ No newline at end of file
+    return fileName(pos.x) + std::to_string(pos.y + 1);
+}
+
+// Coordinate move notation: from square, to square, then q/r/b/n for a
+// promotion, e.g. "e2e4", "e7e8q", "ab12ab14"
+std::string ChessBoard::moveToNotation(EncodedMove move) const {
+    std::string text = positionToNotation(squarePosition(move.from())) +
+                       positionToNotation(squarePosition(move.to()));
+    if (move.kind() == MoveKind::Promotion) {
+        text += "qrbn"[static_cast<int>(move.promotion())];
+    }
+    return text;
+}
+
+bool ChessBoard::parseMove(const std::string& text, EncodedMove& move) const {
+    // Split after the digits that end the first square
+    size_t split = 0;
+    while (split < text.size() && std::isalpha(static_cast<unsigned char>(text[split]))) ++split;
+    while (split < text.size() && std::isdigit(static_cast<unsigned char>(text[split]))) ++split;
+    std::string rest = text.substr(split);
+    PromotionPiece promotion = PromotionPiece::Queen;
+    if (!rest.empty() && std::isalpha(static_cast<unsigned char>(rest.back()))) {
+        const char* promotions = "qrbn";
+        const char* found = std::strchr(promotions, std::tolower(static_cast<unsigned char>(rest.back())));
+        // The promotion letter must follow the rank digits of the target square
+        if (found == nullptr || rest.size() < 3 ||
+            !std::isdigit(static_cast<unsigned char>(rest[rest.size() - 2]))) {
+            return false;
+        }
+        promotion = static_cast<PromotionPiece>(found - promotions);
+        rest.pop_back();
+    }
+    Position start, end;
+    if (!parseNotation(text.substr(0, split), start) || !parseNotation(rest, end) ||
+        !isInBounds(start) || !isInBounds(end) || getSquare(start).is_empty()) {
+        return false;
+    }
+    move = encodeMove(start, end, promotion);
+    return true;
+}
+
+std::string ChessBoard::lineToNotation(const std::vector<EncodedMove>& moves, PortalSystem& portal_system) {
+    std::string text;
+    std::vector<UndoRecord> undos(moves.size());
+    for (size_t i = 0; i < moves.size(); ++i) {
+        if (i > 0) text += ' ';
+        text += moveToNotation(moves[i]);
+        applyMove(moves[i], portal_system, undos[i]);
+        if (undos[i].portal >= 0) {
+            const PortalConfig& portal = portal_system.getPortals()[undos[i].portal];
+            text += "[portal:" + (portal.id.empty() ? std::to_string(undos[i].portal) : portal.id) + ">" +
+                    positionToNotation(portal.positions.exit) + "]";
+        }
+    }
+    for (size_t i = moves.size(); i-- > 0;) {
+        undoMove(moves[i], undos[i], portal_system);
+    }
+    return text;
+}
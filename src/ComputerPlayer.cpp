@@ -0,0 +1,150 @@
+// ComputerPlayer.cpp
+#include "ComputerPlayer.hpp"
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace {
+// Depth of the search that guesses the opponent's reply before pondering
+constexpr int kGuessDepth = 2;
+} // namespace
+
+ComputerPlayer::ComputerPlayer(const GameConfig& config, int64_t movetime_ms)
+    : movetime_ms_(movetime_ms),
+      board_(config.game_settings.board_size, "simple"),
+      portal_system_(config.portals),
+      game_manager_(board_, validator_, portal_system_),
+      table_(kHashMb),
+      search_(board_, game_manager_, portal_system_),
+      ready_fd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+  // The background thread is the player's one thread
+  game_manager_.setParallelStatusThreshold(ChessBoard::kMaxBoardSize + 1);
+  search_.setTranspositionTable(&table_);
+}
+
+ComputerPlayer::~ComputerPlayer() {
+  join();
+  if (ready_fd_ >= 0) ::close(ready_fd_);
+}
+
+void ComputerPlayer::join() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  search_.stop();
+  thread_.join();
+  // Drop an announcement nobody took
+  uint64_t value;
+  [[maybe_unused]] ssize_t got = ::read(ready_fd_, &value, sizeof(value));
+}
+
+void ComputerPlayer::signalReady() {
+  const uint64_t one = 1;
+  [[maybe_unused]] ssize_t written = ::write(ready_fd_, &one, sizeof(one));
+}
+
+void ComputerPlayer::copyGame(const ChessBoard& board, const PortalSystem& portal_system,
+                              const GameManager& game_manager) {
+  board_ = board;
+  portal_system_ = portal_system;
+  const size_t ply = game_manager.getHistorySize();
+  const auto& moves = game_manager.getMoveHistory();
+  const auto& undos = game_manager.getUndoHistory();
+  game_manager_.restoreHistory(std::vector<EncodedMove>(moves.begin(), moves.begin() + ply),
+                               std::vector<UndoRecord>(undos.begin(), undos.begin() + ply), ply);
+}
+
+void ComputerPlayer::think(const ChessBoard& board, const PortalSystem& portal_system,
+                           const GameManager& game_manager) {
+  join();
+  copyGame(board, portal_system, game_manager);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_ = false;
+    pondering_ = false;
+    guessed_ = false;
+    hit_ = false;
+  }
+  search_.clearStop();
+  thread_ = std::thread([this] {
+    Search::Limits limits;
+    limits.movetime_ms = movetime_ms_;
+    const Search::Result result = search_.think(limits);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      result_ = result;
+      finished_ = true;
+    }
+    signalReady();
+  });
+}
+
+void ComputerPlayer::ponder(const ChessBoard& board, const PortalSystem& portal_system,
+                            const GameManager& game_manager) {
+  join();
+  copyGame(board, portal_system, game_manager);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_ = false;
+    pondering_ = true;
+    guessed_ = false;
+    hit_ = false;
+  }
+  search_.clearStop();
+  thread_ = std::thread([this] {
+    const Search::Result guess = search_.bestMove(kGuessDepth);
+    if (!guess.has_move) {
+      return;  // the opponent cannot move: the game is over
+    }
+    game_manager_.makeMove(guess.move);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      guess_ = guess.move;
+      guessed_ = true;
+      ++ponder_searches_;
+    }
+    // A ponderhit() that comes before think() starts still counts
+    Search::Limits limits;
+    limits.movetime_ms = movetime_ms_;
+    limits.ponder = true;
+    const Search::Result result = search_.think(limits);
+    bool announce;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      result_ = result;
+      finished_ = true;
+      announce = hit_;
+    }
+    if (announce) signalReady();
+  });
+}
+
+void ComputerPlayer::opponentMoved(EncodedMove move, const ChessBoard& board, const PortalSystem& portal_system,
+                                   const GameManager& game_manager) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (thread_.joinable() && pondering_ && guessed_ && guess_ == move) {
+      hit_ = true;
+      ++ponder_hits_;
+      if (finished_) {
+        signalReady();  // it already searched as deep as it goes
+      } else {
+        search_.ponderhit();
+      }
+      return;
+    }
+  }
+  think(board, portal_system, game_manager);
+}
+
+void ComputerPlayer::moveNow() { search_.stop(); }
+
+void ComputerPlayer::cancel() { join(); }
+
+bool ComputerPlayer::takeMove(EncodedMove& move) {
+  if (thread_.joinable()) thread_.join();
+  uint64_t value;
+  [[maybe_unused]] ssize_t got = ::read(ready_fd_, &value, sizeof(value));
+  std::lock_guard<std::mutex> lock(mutex_);
+  move = result_.move;
+  return finished_ && result_.has_move;
+}
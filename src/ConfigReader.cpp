@@ -1,341 +1,696 @@
 #include "ConfigReader.hpp"
+#include "JsonReader.hpp"
+#include "MappedFile.hpp"
+#include "Zobrist.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <sys/stat.h>
+
+namespace {
+
+uint64_t hashString(uint64_t hash, const std::string &text) {
+  for (char c : text) {
+    hash = Zobrist::mix(hash ^ static_cast<uint8_t>(std::tolower(static_cast<unsigned char>(c))));
+  }
+  return Zobrist::mix(hash ^ 0xff);
+}
+
+uint64_t hashPosition(uint64_t hash, const Position &pos) {
+  return Zobrist::mix(hash ^ (static_cast<uint64_t>(static_cast<uint32_t>(pos.x)) << 32 |
+                              static_cast<uint32_t>(pos.y)));
+}
+
+constexpr char kCompiledMagic[8] = {'C', 'W', 'P', 'C', 'F', 'G', '0', '\0'};
+// Bump whenever GameConfig or the layout below changes
+constexpr uint32_t kCompiledVersion = 2;
+
+struct CompiledHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t body_bytes;
+  uint64_t checksum; // FNV-1a of the body
+  uint64_t source_size;
+  int64_t source_mtime_ns;
+  uint64_t config_hash;
+};
+static_assert(sizeof(CompiledHeader) == 48,
+              "CompiledHeader layout is part of the file format");
+
+// The body is the config field by field in declaration order: integers as
+// 32 bits, flags as bytes, strings and lists prefixed with a 32-bit count.
+// Start squares are the white list then the black list; custom abilities
+// are written sorted by key.
+
+uint64_t checksum(const uint8_t *data, size_t size) {
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ data[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+bool sourceStamp(const std::string &path, uint64_t &size, int64_t &mtime_ns) {
+  struct stat info;
+  if (::stat(path.c_str(), &info) != 0) {
+    return false;
+  }
+  size = static_cast<uint64_t>(info.st_size);
+  mtime_ns = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 +
+             info.st_mtim.tv_nsec;
+  return true;
+}
+
+class ImageWriter {
+public:
+  std::vector<uint8_t> bytes;
+
+  void u32(uint32_t value) { raw(&value, sizeof(value)); }
+  void i32(int value) {
+    const int32_t v = value;
+    raw(&v, sizeof(v));
+  }
+  void flag(bool value) { bytes.push_back(value ? 1 : 0); }
+  void str(const std::string &text) {
+    u32(static_cast<uint32_t>(text.size()));
+    raw(text.data(), text.size());
+  }
+  void pos(const Position &p) {
+    i32(p.x);
+    i32(p.y);
+  }
+
+private:
+  void raw(const void *data, size_t size) {
+    const auto *begin = static_cast<const uint8_t *>(data);
+    bytes.insert(bytes.end(), begin, begin + size);
+  }
+};
+
+// Reads the body back; any overrun clears `ok` and yields zeroes
+class ImageReader {
+public:
+  ImageReader(const uint8_t *begin, const uint8_t *end)
+      : m_next(begin), m_end(end) {}
+  bool ok = true;
+  bool atEnd() const { return m_next == m_end; }
+
+  uint32_t u32() {
+    uint32_t value = 0;
+    raw(&value, sizeof(value));
+    return value;
+  }
+  int i32() {
+    int32_t value = 0;
+    raw(&value, sizeof(value));
+    return value;
+  }
+  bool flag() {
+    uint8_t value = 0;
+    raw(&value, sizeof(value));
+    return value != 0;
+  }
+  std::string str() {
+    const uint32_t size = u32();
+    if (static_cast<size_t>(m_end - m_next) < size) {
+      ok = false;
+      return {};
+    }
+    std::string text(reinterpret_cast<const char *>(m_next), size);
+    m_next += size;
+    return text;
+  }
+  Position pos() {
+    Position p;
+    p.x = i32();
+    p.y = i32();
+    return p;
+  }
+  // A count of items that each take at least `item_bytes`
+  uint32_t count(size_t item_bytes) {
+    const uint32_t n = u32();
+    if (static_cast<size_t>(m_end - m_next) / item_bytes < n) {
+      ok = false;
+      return 0;
+    }
+    return n;
+  }
+
+private:
+  const uint8_t *m_next;
+  const uint8_t *m_end;
+
+  void raw(void *out, size_t size) {
+    if (static_cast<size_t>(m_end - m_next) < size) {
+      ok = false;
+      m_next = m_end;
+      return;
+    }
+    std::memcpy(out, m_next, size);
+    m_next += size;
+  }
+};
+
+void writePiece(ImageWriter &out, const PieceConfig &piece) {
+  out.str(piece.type);
+  out.i32(piece.count);
+  for (bool white : {true, false}) {
+    const auto &positions = piece.positions.of(white);
+    out.u32(static_cast<uint32_t>(positions.size()));
+    for (const auto &pos : positions) {
+      out.pos(pos);
+    }
+  }
+  const Movement &movement = piece.movement;
+  out.i32(movement.forward);
+  out.i32(movement.sideways);
+  out.i32(movement.diagonal);
+  out.flag(movement.l_shape);
+  out.i32(movement.diagonal_capture);
+  out.i32(movement.first_move_forward);
+  const SpecialAbilities &abilities = piece.special_abilities;
+  out.flag(abilities.castling);
+  out.flag(abilities.royal);
+  out.flag(abilities.jump_over);
+  out.flag(abilities.promotion);
+  out.flag(abilities.en_passant);
+  std::vector<std::pair<std::string, bool>> custom(
+      abilities.custom_abilities.begin(), abilities.custom_abilities.end());
+  std::sort(custom.begin(), custom.end());
+  out.u32(static_cast<uint32_t>(custom.size()));
+  for (const auto &ability : custom) {
+    out.str(ability.first);
+    out.flag(ability.second);
+  }
+}
+
+void readPiece(ImageReader &in, PieceConfig &piece) {
+  piece.type = in.str();
+  piece.count = in.i32();
+  for (bool white : {true, false}) {
+    auto &positions = piece.positions.of(white);
+    const uint32_t size = in.count(8);
+    positions.reserve(size);
+    for (uint32_t n = size; n > 0 && in.ok; --n) {
+      positions.push_back(in.pos());
+    }
+  }
+  Movement &movement = piece.movement;
+  movement.forward = in.i32();
+  movement.sideways = in.i32();
+  movement.diagonal = in.i32();
+  movement.l_shape = in.flag();
+  movement.diagonal_capture = in.i32();
+  movement.first_move_forward = in.i32();
+  SpecialAbilities &abilities = piece.special_abilities;
+  abilities.castling = in.flag();
+  abilities.royal = in.flag();
+  abilities.jump_over = in.flag();
+  abilities.promotion = in.flag();
+  abilities.en_passant = in.flag();
+  for (uint32_t n = in.count(5); n > 0 && in.ok; --n) {
+    std::string key = in.str();
+    abilities.custom_abilities[key] = in.flag();
+  }
+}
+
+void writePieces(ImageWriter &out, const std::vector<PieceConfig> &pieces) {
+  out.u32(static_cast<uint32_t>(pieces.size()));
+  for (const auto &piece : pieces) {
+    writePiece(out, piece);
+  }
+}
+
+void readPieces(ImageReader &in, std::vector<PieceConfig> &pieces) {
+  for (uint32_t n = in.count(4); n > 0 && in.ok; --n) {
+    pieces.emplace_back();
+    readPiece(in, pieces.back());
+  }
+}
+
+} // namespace
+
+uint64_t configHash(const GameConfig &config) {
+  uint64_t hash = Zobrist::mix(static_cast<uint64_t>(config.game_settings.board_size));
+  for (const auto &piece : config.pieces) {
+    hash = hashString(hash, piece.type);
+    for (bool white : {true, false}) {
+      const auto &positions = piece.positions.of(white);
+      if (positions.empty()) {
+        continue;
+      }
+      hash = hashString(hash, white ? "white" : "black");
+      for (const auto &pos : positions) {
+        hash = hashPosition(hash, pos);
+      }
+    }
+  }
+  for (const auto &portal : config.portals) {
+    hash = hashPosition(hashPosition(hash, portal.positions.entry), portal.positions.exit);
+    hash = Zobrist::mix(hash ^ (static_cast<uint64_t>(portal.properties.cooldown) << 1 |
+                                (portal.properties.preserve_direction ? 1u : 0u)));
+    for (const auto &color : portal.properties.allowed_colors) {
+      hash = hashString(hash, color);
+    }
+  }
+  return hash;
+}
 
 ConfigReader::ConfigReader() {}
 
 bool ConfigReader::loadFromFile(const std::string &filePath) {
+  if (loadCompiled(filePath)) {
+    return true;
+  }
+  return loadFromJsonFile(filePath);
+}
+
+bool ConfigReader::loadFromJsonFile(const std::string &filePath) {
+  m_fromCompiled = false;
   try {
-    std::ifstream file(filePath);
+    std::ifstream file(filePath, std::ios::binary);
     if (!file.is_open()) {
-      std::cerr << "Failed to open config file: " << filePath << std::endl;
-      return false;
+      return reportError("Failed to open config file: " + filePath);
     }
 
-    nlohmann::json jsonData;
-    file >> jsonData;
-
-    parseGameSettings(jsonData);
-    parsePieces(jsonData);
-    parseCustomPieces(jsonData);
-    parsePortals(jsonData);
-
-    return validateConfig();
-  } catch (const std::exception &e) {
-    std::cerr << "Error parsing config file: " << e.what() << std::endl;
+    JsonReader reader(file);
+    return parse(reader);
+  } catch (const JsonReader::Error &e) {
+    reportError("Error parsing config file: " + filePath + ": " + e.what());
+    m_lastError = LoadError{e.message, e.line, e.column};
     return false;
+  } catch (const std::exception &e) {
+    return reportError("Error parsing config file: " + filePath + ": " +
+                       e.what());
   }
 }
 
 bool ConfigReader::loadFromString(const std::string &jsonString) {
+  m_fromCompiled = false;
   try {
-    nlohmann::json jsonData = nlohmann::json::parse(jsonString);
+    JsonReader reader(jsonString);
+    return parse(reader);
+  } catch (const JsonReader::Error &e) {
+    reportError(std::string("Error parsing config string: ") + e.what());
+    m_lastError = LoadError{e.message, e.line, e.column};
+    return false;
+  } catch (const std::exception &e) {
+    return reportError(std::string("Error parsing config string: ") +
+                       e.what());
+  }
+}
 
-    parseGameSettings(jsonData);
-    parsePieces(jsonData);
-    parseCustomPieces(jsonData);
-    parsePortals(jsonData);
+bool ConfigReader::reportError(const std::string &message) {
+  m_lastError = LoadError{message, 0, 0};
+  if (!m_quiet) {
+    std::cerr << message << std::endl;
+  }
+  return false;
+}
 
-    return validateConfig();
-  } catch (const std::exception &e) {
-    std::cerr << "Error parsing config string: " << e.what() << std::endl;
+const GameConfig &ConfigReader::getConfig() const { return m_config; }
+
+std::string ConfigReader::compiledPath(const std::string &sourcePath) {
+  return sourcePath + ".compiled";
+}
+
+bool ConfigReader::writeCompiled(const std::string &sourcePath) const {
+  CompiledHeader header{};
+  std::memcpy(header.magic, kCompiledMagic, sizeof(kCompiledMagic));
+  header.version = kCompiledVersion;
+  if (!sourceStamp(sourcePath, header.source_size, header.source_mtime_ns)) {
     return false;
   }
+
+  ImageWriter out;
+  out.str(m_config.game_settings.name);
+  out.i32(m_config.game_settings.board_size);
+  out.i32(m_config.game_settings.turn_limit);
+  writePieces(out, m_config.pieces);
+  writePieces(out, m_config.custom_pieces);
+  out.u32(static_cast<uint32_t>(m_config.portals.size()));
+  for (const auto &portal : m_config.portals) {
+    out.str(portal.type);
+    out.str(portal.id);
+    out.pos(portal.positions.entry);
+    out.pos(portal.positions.exit);
+    out.flag(portal.properties.preserve_direction);
+    out.i32(portal.properties.cooldown);
+    out.u32(static_cast<uint32_t>(portal.properties.allowed_colors.size()));
+    for (const auto &color : portal.properties.allowed_colors) {
+      out.str(color);
+    }
+  }
+  header.body_bytes = static_cast<uint32_t>(out.bytes.size());
+  header.checksum = checksum(out.bytes.data(), out.bytes.size());
+  header.config_hash = configHash(m_config);
+
+  // Written aside and renamed, so a reader never maps a half-written image
+  const std::string path = compiledPath(sourcePath);
+  const std::string temporary = path + ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(out.bytes.data()),
+               static_cast<std::streamsize>(out.bytes.size()));
+    if (!file.flush()) {
+      std::remove(temporary.c_str());
+      return false;
+    }
+  }
+  return std::rename(temporary.c_str(), path.c_str()) == 0;
 }
 
-const GameConfig &ConfigReader::getConfig() const { return m_config; }
+bool ConfigReader::loadCompiled(const std::string &sourcePath) {
+  m_fromCompiled = false;
+  uint64_t source_size = 0;
+  int64_t source_mtime_ns = 0;
+  MappedFile image;
+  if (!sourceStamp(sourcePath, source_size, source_mtime_ns) ||
+      !image.open(compiledPath(sourcePath)) ||
+      image.size() < sizeof(CompiledHeader)) {
+    return false;
+  }
+  CompiledHeader header;
+  std::memcpy(&header, image.data(), sizeof(header));
+  const uint8_t *body = image.data() + sizeof(header);
+  if (std::memcmp(header.magic, kCompiledMagic, sizeof(kCompiledMagic)) != 0 ||
+      header.version != kCompiledVersion ||
+      header.source_size != source_size ||
+      header.source_mtime_ns != source_mtime_ns ||
+      header.body_bytes != image.size() - sizeof(header) ||
+      checksum(body, header.body_bytes) != header.checksum) {
+    return false;
+  }
+
+  GameConfig config;
+  ImageReader in(body, body + header.body_bytes);
+  config.game_settings.name = in.str();
+  config.game_settings.board_size = in.i32();
+  config.game_settings.turn_limit = in.i32();
+  readPieces(in, config.pieces);
+  readPieces(in, config.custom_pieces);
+  for (uint32_t n = in.count(4); n > 0 && in.ok; --n) {
+    PortalConfig portal;
+    portal.type = in.str();
+    portal.id = in.str();
+    portal.positions.entry = in.pos();
+    portal.positions.exit = in.pos();
+    portal.properties.preserve_direction = in.flag();
+    portal.properties.cooldown = in.i32();
+    for (uint32_t colors = in.count(4); colors > 0 && in.ok; --colors) {
+      portal.properties.allowed_colors.push_back(in.str());
+    }
+    config.portals.push_back(std::move(portal));
+  }
+  if (!in.ok || !in.atEnd() || configHash(config) != header.config_hash) {
+    return false;
+  }
+  m_config = std::move(config);
+  m_fromCompiled = true;
+  return true;
+}
 
 bool ConfigReader::validateConfig() {
   // Basic validation
   if (m_config.game_settings.name.empty()) {
-    std::cerr << "Game name is missing" << std::endl;
-    return false;
+    return reportError("Game name is missing");
   }
 
   if (m_config.game_settings.board_size <= 0) {
-    std::cerr << "Invalid board size" << std::endl;
-    return false;
+    return reportError("Invalid board size");
   }
 
   if (m_config.game_settings.turn_limit <= 0) {
-    std::cerr << "Invalid turn limit" << std::endl;
-    return false;
+    return reportError("Invalid turn limit");
   }
 
   if (m_config.pieces.empty()) {
-    std::cerr << "No pieces defined" << std::endl;
-    return false;
+    return reportError("No pieces defined");
   }
 
   // Check that each piece has a valid type and position
   for (const auto &piece : m_config.pieces) {
     if (piece.type.empty()) {
-      std::cerr << "Piece is missing type" << std::endl;
-      return false;
+      return reportError("Piece is missing type");
     }
 
     if (piece.positions.empty()) {
-      std::cerr << "Piece " << piece.type << " has no positions" << std::endl;
-      return false;
+      return reportError("Piece " + piece.type + " has no positions");
     }
   }
 
   // Validate custom pieces if any exist
   for (const auto &piece : m_config.custom_pieces) {
     if (piece.type.empty()) {
-      std::cerr << "Custom piece is missing type" << std::endl;
-      return false;
+      return reportError("Custom piece is missing type");
     }
 
     if (piece.positions.empty()) {
-      std::cerr << "Custom piece " << piece.type << " has no positions"
-                << std::endl;
-      return false;
+      return reportError("Custom piece " + piece.type + " has no positions");
     }
   }
 
   // Validate portal positions are within board bounds
   for (const auto &portal : m_config.portals) {
     if (portal.id.empty()) {
-      std::cerr << "Portal is missing ID" << std::endl;
-      return false;
+      return reportError("Portal is missing ID");
     }
 
     if (portal.positions.entry.x < 0 ||
         portal.positions.entry.x >= m_config.game_settings.board_size ||
         portal.positions.entry.y < 0 ||
         portal.positions.entry.y >= m_config.game_settings.board_size) {
-      std::cerr << "Portal " << portal.id
-                << " entry position is outside board bounds" << std::endl;
-      return false;
+      return reportError("Portal " + portal.id + " entry position is outside board bounds");
     }
 
     if (portal.positions.exit.x < 0 ||
         portal.positions.exit.x >= m_config.game_settings.board_size ||
         portal.positions.exit.y < 0 ||
         portal.positions.exit.y >= m_config.game_settings.board_size) {
-      std::cerr << "Portal " << portal.id
-                << " exit position is outside board bounds" << std::endl;
-      return false;
+      return reportError("Portal " + portal.id + " exit position is outside board bounds");
     }
   }
 
   return true;
 }
 
-void ConfigReader::parseGameSettings(const nlohmann::json &json) {
-  if (json.contains("game_settings")) {
-    const auto &settings = json["game_settings"];
-
-    m_config.game_settings.name = settings.value("name", "Custom Chess");
-    m_config.game_settings.board_size = settings.value("board_size", 8);
-    m_config.game_settings.turn_limit = settings.value("turn_limit", 100);
-  } else {
-    // Default values if no settings specified
-    m_config.game_settings.name = "Custom Chess";
-    m_config.game_settings.board_size = 8;
-    m_config.game_settings.turn_limit = 100;
+bool ConfigReader::parse(JsonReader &reader) {
+  m_config = GameConfig{};
+  // Default values for anything not specified
+  m_config.game_settings.name = "Custom Chess";
+  m_config.game_settings.board_size = 8;
+  m_config.game_settings.turn_limit = 100;
+
+  std::string key;
+  reader.beginObject();
+  while (reader.nextKey(key)) {
+    if (key == "game_settings") {
+      parseGameSettings(reader);
+    } else if (key == "pieces" && reader.peek() == JsonReader::Type::Array) {
+      parsePieces(reader, m_config.pieces);
+    } else if (key == "custom_pieces" &&
+               reader.peek() == JsonReader::Type::Array) {
+      parsePieces(reader, m_config.custom_pieces);
+    } else if (key == "portals" && reader.peek() == JsonReader::Type::Array) {
+      parsePortals(reader);
+    } else {
+      reader.skipValue();
+    }
   }
+  reader.finish();
+
+  return validateConfig();
 }
 
-void ConfigReader::parseSpecialAbilities(const nlohmann::json &abilities,
-                                         SpecialAbilities &specialAbilities) {
-  if (abilities.is_object()) {
-    // Parse standard abilities
-    specialAbilities.castling = abilities.value("castling", false);
-    specialAbilities.royal = abilities.value("royal", false);
-    specialAbilities.jump_over = abilities.value("jump_over", false);
-    specialAbilities.promotion = abilities.value("promotion", false);
-    specialAbilities.en_passant = abilities.value("en_passant", false);
-
-    // Parse any additional custom abilities
-    for (auto it = abilities.begin(); it != abilities.end(); ++it) {
-      const std::string &key = it.key();
-
-      // Skip standard abilities
-      if (key != "castling" && key != "royal" && key != "jump_over" &&
-          key != "promotion" && key != "en_passant") {
-
-        // Add to custom abilities map if it's a boolean value
-        if (it.value().is_boolean()) {
-          specialAbilities.custom_abilities[key] = it.value().get<bool>();
-        }
-      }
+void ConfigReader::parseGameSettings(JsonReader &reader) {
+  std::string key;
+  reader.beginObject();
+  while (reader.nextKey(key)) {
+    if (key == "name") {
+      m_config.game_settings.name = reader.readString();
+    } else if (key == "board_size") {
+      m_config.game_settings.board_size = reader.readInt();
+    } else if (key == "turn_limit") {
+      m_config.game_settings.turn_limit = reader.readInt();
+    } else {
+      reader.skipValue();
     }
   }
 }
 
-void ConfigReader::parsePieces(const nlohmann::json &json) {
-  if (!json.contains("pieces") || !json["pieces"].is_array()) {
-    return;
-  }
-
-  for (const auto &pieceJson : json["pieces"]) {
-    PieceConfig piece;
-
-    // Parse basic properties
-    piece.type = pieceJson.value("type", "");
-    piece.count = pieceJson.value("count", 0);
-
-    // Parse positions
-    if (pieceJson.contains("positions")) {
-      const auto &positions = pieceJson["positions"];
-
-      // Parse white piece positions
-      if (positions.contains("white") && positions["white"].is_array()) {
-        for (const auto &posJson : positions["white"]) {
-          Position pos;
-          pos.x = posJson.value("x", 0);
-          pos.y = posJson.value("y", 0);
-          piece.positions["white"].push_back(pos);
-        }
-      }
-
-      // Parse black piece positions
-      if (positions.contains("black") && positions["black"].is_array()) {
-        for (const auto &posJson : positions["black"]) {
-          Position pos;
-          pos.x = posJson.value("x", 0);
-          pos.y = posJson.value("y", 0);
-          piece.positions["black"].push_back(pos);
-        }
-      }
-    }
-
-    // Parse movement
-    if (pieceJson.contains("movement")) {
-      const auto &movement = pieceJson["movement"];
-
-      // Set all movement properties with default 0 if not specified
-      piece.movement.forward = movement.value("forward", 0);
-      piece.movement.sideways = movement.value("sideways", 0);
-      piece.movement.diagonal = movement.value("diagonal", 0);
-      piece.movement.l_shape = movement.value("l_shape", false);
-      piece.movement.diagonal_capture = movement.value("diagonal_capture", 0);
-      piece.movement.first_move_forward =
-          movement.value("first_move_forward", 0);
-    }
-
-    // Parse special abilities
-    if (pieceJson.contains("special_abilities")) {
-      parseSpecialAbilities(pieceJson["special_abilities"],
-                            piece.special_abilities);
+void ConfigReader::parseSpecialAbilities(JsonReader &reader,
+                                         SpecialAbilities &specialAbilities) {
+  std::string key;
+  reader.beginObject();
+  while (reader.nextKey(key)) {
+    // Standard abilities
+    if (key == "castling") {
+      specialAbilities.castling = reader.readBool();
+    } else if (key == "royal") {
+      specialAbilities.royal = reader.readBool();
+    } else if (key == "jump_over") {
+      specialAbilities.jump_over = reader.readBool();
+    } else if (key == "promotion") {
+      specialAbilities.promotion = reader.readBool();
+    } else if (key == "en_passant") {
+      specialAbilities.en_passant = reader.readBool();
+    } else if (reader.peek() == JsonReader::Type::Bool) {
+      // Any other boolean is a custom ability
+      specialAbilities.custom_abilities[key] = reader.readBool();
+    } else {
+      reader.skipValue();
     }
-
-    m_config.pieces.push_back(piece);
   }
 }
 
-void ConfigReader::parseCustomPieces(const nlohmann::json &json) {
-  if (!json.contains("custom_pieces") || !json["custom_pieces"].is_array()) {
-    return;
-  }
-
-  for (const auto &pieceJson : json["custom_pieces"]) {
-    PieceConfig piece;
-
-    // Parse basic properties
-    piece.type = pieceJson.value("type", "");
-    piece.count = pieceJson.value("count", 0);
-
-    // Parse positions
-    if (pieceJson.contains("positions")) {
-      const auto &positions = pieceJson["positions"];
-
-      // Parse white piece positions
-      if (positions.contains("white") && positions["white"].is_array()) {
-        for (const auto &posJson : positions["white"]) {
-          Position pos;
-          pos.x = posJson.value("x", 0);
-          pos.y = posJson.value("y", 0);
-          piece.positions["white"].push_back(pos);
-        }
-      }
-
-      // Parse black piece positions
-      if (positions.contains("black") && positions["black"].is_array()) {
-        for (const auto &posJson : positions["black"]) {
-          Position pos;
-          pos.x = posJson.value("x", 0);
-          pos.y = posJson.value("y", 0);
-          piece.positions["black"].push_back(pos);
+void ConfigReader::parsePositions(JsonReader &reader,
+                                  PiecePositions &positions) {
+  std::string key;
+  reader.beginObject();
+  while (reader.nextKey(key)) {
+    if ((key != "white" && key != "black") ||
+        reader.peek() != JsonReader::Type::Array) {
+      reader.skipValue();
+      continue;
+    }
+    std::vector<Position> &list = positions.of(key == "white");
+    reader.beginArray();
+    while (reader.nextElement()) {
+      Position pos{};
+      reader.beginObject();
+      while (reader.nextKey(key)) {
+        if (key == "x") {
+          pos.x = reader.readInt();
+        } else if (key == "y") {
+          pos.y = reader.readInt();
+        } else {
+          reader.skipValue();
         }
       }
+      list.push_back(pos);
     }
-
-    // Parse movement
-    if (pieceJson.contains("movement")) {
-      const auto &movement = pieceJson["movement"];
-
-      // Set all movement properties with default 0 if not specified
-      piece.movement.forward = movement.value("forward", 0);
-      piece.movement.sideways = movement.value("sideways", 0);
-      piece.movement.diagonal = movement.value("diagonal", 0);
-      piece.movement.l_shape = movement.value("l_shape", false);
-      piece.movement.diagonal_capture = movement.value("diagonal_capture", 0);
-      piece.movement.first_move_forward =
-          movement.value("first_move_forward", 0);
-    }
-
-    // Parse special abilities
-    if (pieceJson.contains("special_abilities")) {
-      parseSpecialAbilities(pieceJson["special_abilities"],
-                            piece.special_abilities);
-    }
-
-    m_config.custom_pieces.push_back(piece);
   }
 }
 
-void ConfigReader::parsePortals(const nlohmann::json &json) {
-  if (!json.contains("portals") || !json["portals"].is_array()) {
-    return;
+void ConfigReader::parseMovement(JsonReader &reader, Movement &movement) {
+  std::string key;
+  reader.beginObject();
+  while (reader.nextKey(key)) {
+    if (key == "forward") {
+      movement.forward = reader.readInt();
+    } else if (key == "sideways") {
+      movement.sideways = reader.readInt();
+    } else if (key == "diagonal") {
+      movement.diagonal = reader.readInt();
+    } else if (key == "l_shape") {
+      movement.l_shape = reader.readBool();
+    } else if (key == "diagonal_capture") {
+      movement.diagonal_capture = reader.readInt();
+    } else if (key == "first_move_forward") {
+      movement.first_move_forward = reader.readInt();
+    } else {
+      reader.skipValue();
+    }
   }
+}
 
-  for (const auto &portalJson : json["portals"]) {
-    PortalConfig portal;
-
-    // Parse basic properties
-    portal.type = portalJson.value("type", "Portal");
-    portal.id = portalJson.value("id", "");
-
-    // Parse positions
-    if (portalJson.contains("positions")) {
-      const auto &positions = portalJson["positions"];
-
-      // Parse entry position
-      if (positions.contains("entry")) {
-        portal.positions.entry.x = positions["entry"].value("x", 0);
-        portal.positions.entry.y = positions["entry"].value("y", 0);
-      }
-
-      // Parse exit position
-      if (positions.contains("exit")) {
-        portal.positions.exit.x = positions["exit"].value("x", 0);
-        portal.positions.exit.y = positions["exit"].value("y", 0);
+void ConfigReader::parsePieces(JsonReader &reader,
+                               std::vector<PieceConfig> &pieces) {
+  std::string key;
+  reader.beginArray();
+  while (reader.nextElement()) {
+    // Movement is all zero and abilities all false unless specified
+    pieces.emplace_back();
+    PieceConfig &piece = pieces.back();
+    piece.count = 0;
+
+    reader.beginObject();
+    while (reader.nextKey(key)) {
+      if (key == "type") {
+        piece.type = reader.readString();
+      } else if (key == "count") {
+        piece.count = reader.readInt();
+      } else if (key == "positions" &&
+                 reader.peek() == JsonReader::Type::Object) {
+        parsePositions(reader, piece.positions);
+      } else if (key == "movement") {
+        parseMovement(reader, piece.movement);
+      } else if (key == "special_abilities" &&
+                 reader.peek() == JsonReader::Type::Object) {
+        parseSpecialAbilities(reader, piece.special_abilities);
+      } else {
+        reader.skipValue();
       }
     }
+  }
+}
 
-    // Parse properties
-    if (portalJson.contains("properties")) {
-      const auto &properties = portalJson["properties"];
-
-      portal.properties.preserve_direction =
-          properties.value("preserve_direction", true);
-      portal.properties.cooldown = properties.value("cooldown", 0);
-
-      // Parse allowed colors
-      if (properties.contains("allowed_colors") &&
-          properties["allowed_colors"].is_array()) {
-        for (const auto &color : properties["allowed_colors"]) {
-          portal.properties.allowed_colors.push_back(color);
+void ConfigReader::parsePortals(JsonReader &reader) {
+  std::string key;
+  reader.beginArray();
+  while (reader.nextElement()) {
+    PortalConfig portal{};
+    portal.type = "Portal";
+
+    reader.beginObject();
+    while (reader.nextKey(key)) {
+      if (key == "type") {
+        portal.type = reader.readString();
+      } else if (key == "id") {
+        portal.id = reader.readString();
+      } else if (key == "positions") {
+        reader.beginObject();
+        while (reader.nextKey(key)) {
+          if (key != "entry" && key != "exit") {
+            reader.skipValue();
+            continue;
+          }
+          Position &pos =
+              key == "entry" ? portal.positions.entry : portal.positions.exit;
+          reader.beginObject();
+          while (reader.nextKey(key)) {
+            if (key == "x") {
+              pos.x = reader.readInt();
+            } else if (key == "y") {
+              pos.y = reader.readInt();
+            } else {
+              reader.skipValue();
+            }
+          }
+        }
+      } else if (key == "properties") {
+        // Both colors may use the portal unless allowed_colors says otherwise
+        bool colorsGiven = false;
+        reader.beginObject();
+        while (reader.nextKey(key)) {
+          if (key == "preserve_direction") {
+            portal.properties.preserve_direction = reader.readBool();
+          } else if (key == "cooldown") {
+            portal.properties.cooldown = reader.readInt();
+          } else if (key == "allowed_colors" &&
+                     reader.peek() == JsonReader::Type::Array) {
+            colorsGiven = true;
+            portal.properties.allowed_colors.clear();
+            reader.beginArray();
+            while (reader.nextElement()) {
+              portal.properties.allowed_colors.push_back(reader.readString());
+            }
+          } else {
+            reader.skipValue();
+          }
+        }
+        if (!colorsGiven) {
+          portal.properties.allowed_colors = {"white", "black"};
         }
       } else {
-        // Default to allowing both colors if not specified
-        portal.properties.allowed_colors = {"white", "black"};
+        reader.skipValue();
       }
     }
 
-    m_config.portals.push_back(portal);
+    m_config.portals.push_back(std::move(portal));
   }
 }
@@ -0,0 +1,317 @@
+// EngineProtocol.cpp
+#include "EngineProtocol.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+namespace {
+// Keep this much of the clock in reserve for process and pipe latency
+constexpr int64_t kClockMarginMs = 30;
+// Share of the remaining clock spent on one move when no movetime is given
+constexpr int64_t kMovesToGo = 30;
+// MCTS playouts for a bare "go" with no limit
+constexpr size_t kDefaultPlayouts = 20000;
+} // namespace
+
+EngineProtocol::EngineProtocol(const GameConfig& config)
+    : config_(config), board_(config.game_settings.board_size, "simple"), portal_system_(config.portals),
+      game_manager_(board_, validator_, portal_system_), search_(board_, game_manager_, portal_system_),
+      mcts_(board_, game_manager_, portal_system_), notation_(config.pieces) {
+  // The engine searches one game at a time; status checks stay on this thread
+  game_manager_.setParallelStatusThreshold(ChessBoard::kMaxBoardSize + 1);
+  resetGame();
+}
+
+EngineProtocol::~EngineProtocol() { stopSearch(); }
+
+bool EngineProtocol::resetGame(const std::string& position) {
+  board_.initializeBoard(config_.pieces);
+  portal_system_ = PortalSystem(config_.portals);
+  const bool parsed = position.empty() || notation_.parse(position, board_, portal_system_);
+  start_position_ = parsed ? position : "";
+  game_manager_.resetHistory();
+  played_.clear();
+  return parsed;
+}
+
+int EngineProtocol::run(std::istream& in, std::ostream& out) {
+  std::string line;
+  bool quit = false;
+  while (std::getline(in, line)) {
+    std::istringstream args(line);
+    std::string command;
+    args >> command;
+    if (command.empty()) {
+      continue;
+    }
+    // Answered while a search runs
+    if (command == "isready") {
+      std::lock_guard<std::mutex> lock(out_mutex_);
+      out << "readyok" << std::endl;
+      continue;
+    }
+    if (command == "stop") {
+      stopSearch();
+      continue;
+    }
+    if (command == "ponderhit") {
+      ponderhit();
+      continue;
+    }
+    if (command == "quit") {
+      quit = true;
+      break;
+    }
+    finishSearch();
+    if (command == "uci") {
+      out << "id name " << (config_.game_settings.name.empty() ? "Chess with Portals" : config_.game_settings.name)
+          << "\nid author Chess with Portals\noption name Ponder type check default false\nuciok" << std::endl;
+    } else if (command == "ucinewgame") {
+      resetGame();
+    } else if (command == "setoption") {
+      handleSetOption(args, out);
+    } else if (command == "position") {
+      handlePosition(args, out);
+    } else if (command == "go") {
+      handleGo(args, out);
+    } else {
+      out << "info string unknown command " << command << std::endl;
+    }
+  }
+  // quit stops the search; the end of the input lets it finish
+  if (quit) {
+    stopSearch();
+  } else {
+    finishSearch();
+  }
+  return 0;
+}
+
+void EngineProtocol::finishSearch() {
+  if (!search_thread_.joinable()) {
+    return;
+  }
+  bool unlimited;
+  {
+    std::lock_guard<std::mutex> lock(search_mutex_);
+    unlimited = infinite_ || pondering_;
+  }
+  if (unlimited) {
+    stopSearch();
+  } else {
+    search_thread_.join();
+  }
+}
+
+void EngineProtocol::stopSearch() {
+  if (!search_thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(search_mutex_);
+    infinite_ = false;
+    pondering_ = false;
+  }
+  released_.notify_one();
+  search_.stop();
+  mcts_.stop();
+  search_thread_.join();
+}
+
+void EngineProtocol::ponderhit() {
+  if (!search_thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(search_mutex_);
+    if (!pondering_) {
+      return;
+    }
+    pondering_ = false;
+  }
+  search_.ponderhit();
+  mcts_.ponderhit();
+  released_.notify_one();
+}
+
+void EngineProtocol::handlePosition(std::istream& args, std::ostream& out) {
+  std::string token, position;
+  args >> token;
+  if (token == "fen") {
+    while (args >> token && token != "moves") {
+      position += position.empty() ? token : " " + token;
+    }
+  } else if (token == "startpos") {
+    args >> token;
+  } else {
+    out << "info string position needs startpos or fen" << std::endl;
+    return;
+  }
+  std::vector<std::string> moves;
+  if (token == "moves") {
+    while (args >> token) {
+      moves.push_back(token);
+    }
+  }
+
+  // A game in progress sends the same moves plus one or two more; only
+  // apply the new tail instead of replaying from the start
+  bool extends = position == start_position_ && moves.size() >= played_.size() &&
+                 std::equal(played_.begin(), played_.end(), moves.begin());
+  if (!extends && !resetGame(position)) {
+    out << "info string invalid position " << position << std::endl;
+    return;
+  }
+  for (size_t i = played_.size(); i < moves.size(); ++i) {
+    EncodedMove move;
+    game_manager_.generateLegalMoves(board_.isWhiteToMove(), legal_);
+    if (!board_.parseMove(moves[i], move) || std::find(legal_.begin(), legal_.end(), move) == legal_.end()) {
+      out << "info string illegal move " << moves[i] << std::endl;
+      return;
+    }
+    game_manager_.makeMove(move);
+    played_.push_back(moves[i]);
+  }
+}
+
+std::string EngineProtocol::formatScore(int score) const {
+  if (std::abs(score) >= Search::kMateScore - Search::kMaxDepth) {
+    int plies = Search::kMateScore - std::abs(score);
+    int moves = (plies + 1) / 2;
+    return "mate " + std::to_string(score > 0 ? moves : -moves);
+  }
+  return "cp " + std::to_string(score);
+}
+
+void EngineProtocol::handleSetOption(std::istream& args, std::ostream& out) {
+  std::string word, name, value;
+  args >> word >> name >> word >> value;
+  if (name == "Engine" && (value == "alphabeta" || value == "mcts")) {
+    use_mcts_ = value == "mcts";
+  } else if (name == "Threads" && std::atoi(value.c_str()) > 0) {
+    mcts_.setThreads(static_cast<unsigned>(std::atoi(value.c_str())));
+  } else if (name == "Book") {
+    if (!book_.open(value, config_)) {
+      out << "info string cannot use book " << value << " with this config" << std::endl;
+      return;
+    }
+    out << "info string book " << book_.size() << " entries" << std::endl;
+  } else if (name == "Ponder") {
+    // Nothing to set up: pondering is asked for per search, with go ponder
+  } else if (name == "Tablebase") {
+    auto table = std::make_unique<Tablebase>();
+    if (!table->open(value, config_)) {
+      out << "info string cannot use tablebase " << value << " with this config" << std::endl;
+      return;
+    }
+    search_.addTablebase(table.get());
+    out << "info string tablebase " << table->name() << std::endl;
+    tablebases_.push_back(std::move(table));
+  } else {
+    out << "info string unsupported option " << name << std::endl;
+  }
+}
+
+void EngineProtocol::handleGo(std::istream& args, std::ostream& out) {
+  Search::Limits limits;
+  int64_t wtime = -1, btime = -1, winc = 0, binc = 0;
+  bool infinite = false;
+  bool ponder = false;
+  std::string key;
+  while (args >> key) {
+    if (key == "infinite") {
+      infinite = true;
+      continue;
+    }
+    if (key == "ponder") {
+      ponder = true;
+      continue;
+    }
+    int64_t value = 0;
+    if (!(args >> value)) break;
+    if (key == "depth") limits.depth = static_cast<int>(value);
+    else if (key == "nodes") limits.nodes = static_cast<size_t>(value);
+    else if (key == "movetime") limits.movetime_ms = value;
+    else if (key == "wtime") wtime = value;
+    else if (key == "btime") btime = value;
+    else if (key == "winc") winc = value;
+    else if (key == "binc") binc = value;
+  }
+  const bool white = board_.isWhiteToMove();
+  const int64_t clock = white ? wtime : btime;
+  if (limits.movetime_ms == 0 && clock >= 0) {
+    const int64_t increment = white ? winc : binc;
+    const int64_t usable = std::max<int64_t>(clock - kClockMarginMs, 1);
+    limits.movetime_ms = std::min(usable, usable / kMovesToGo + increment * 3 / 4);
+    limits.movetime_ms = std::max<int64_t>(limits.movetime_ms, 1);
+  }
+
+  if (infinite) {
+    limits = Search::Limits();
+  }
+  limits.ponder = ponder;
+
+  // Only a search that answers right away takes its move from the book
+  EncodedMove book_move;
+  if (!infinite && !ponder && book_.pick(board_.positionKey(portal_system_), book_rng_(), book_move)) {
+    game_manager_.generateLegalMoves(white, legal_);
+    if (std::find(legal_.begin(), legal_.end(), book_move) != legal_.end()) {
+      out << "info string book move" << std::endl;
+      out << "bestmove " << board_.moveToNotation(book_move) << std::endl;
+      return;
+    }
+  }
+
+  infinite_ = infinite;
+  pondering_ = limits.ponder;
+  // Cleared here, not on the search thread, so a stop that comes right
+  // after this go is never lost
+  search_.clearStop();
+  mcts_.clearStop();
+  search_thread_ = std::thread(&EngineProtocol::searchThread, this, limits, infinite, std::ref(out));
+}
+
+void EngineProtocol::searchThread(Search::Limits limits, bool infinite, std::ostream& out) {
+  std::string info;
+  std::string best = "0000";
+  if (use_mcts_) {
+    Mcts::Limits mcts_limits;
+    mcts_limits.playouts = limits.nodes;
+    mcts_limits.movetime_ms = limits.movetime_ms;
+    mcts_limits.ponder = limits.ponder;
+    if (mcts_limits.playouts == 0 && mcts_limits.movetime_ms == 0 && !infinite) {
+      mcts_limits.playouts = kDefaultPlayouts;
+    }
+    auto begin = std::chrono::steady_clock::now();
+    Mcts::Result result = mcts_.think(mcts_limits);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin);
+    if (result.has_move) {
+      best = board_.moveToNotation(result.move);
+      info = "info score cp " + std::to_string(Mcts::valueToCentipawns(result.value)) + " nodes " +
+             std::to_string(result.playouts) + " time " + std::to_string(elapsed.count()) + " pv " + best;
+    }
+  } else {
+    search_.setInfoCallback([&](const Search::Result& result, size_t nodes, int64_t elapsed_ms) {
+      std::lock_guard<std::mutex> lock(out_mutex_);
+      out << "info depth " << result.depth << " score " << formatScore(result.score) << " nodes " << nodes
+          << " time " << elapsed_ms << " pv " << board_.moveToNotation(result.move) << std::endl;
+    });
+    Search::Result result = search_.think(limits);
+    search_.setInfoCallback(nullptr);
+    if (result.has_move) {
+      best = board_.moveToNotation(result.move);
+    }
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(search_mutex_);
+    released_.wait(lock, [this] { return !infinite_ && !pondering_; });
+  }
+  std::lock_guard<std::mutex> lock(out_mutex_);
+  if (!info.empty()) {
+    out << info << "\n";
+  }
+  out << "bestmove " << best << std::endl;
+}
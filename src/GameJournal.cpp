@@ -0,0 +1,419 @@
+// GameJournal.cpp
+#include "GameJournal.hpp"
+#include "ChessBoard.hpp"
+#include "GameManager.hpp"
+#include "PortalSystem.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char kSnapshotMagic[8] = {'C', 'W', 'P', 'S', 'N', '0', '1', '\0'};
+constexpr char kLogMagic[8] = {'C', 'W', 'P', 'W', 'L', '0', '1', '\0'};
+
+struct SnapshotHeader {
+  char magic[8];
+  uint64_t config_hash;
+  uint64_t generation;
+  uint32_t body_bytes;
+  uint32_t checksum;     // of the body
+  uint32_t history_ply;  // moves played; the rest of `moves` is the redo tail
+  uint32_t moves;
+  uint32_t pieces;
+  int32_t portal_ply;
+  uint16_t piece_types;  // including the empty type 0
+  uint16_t portals;
+  int16_t en_passant;
+  uint8_t white_to_move;
+  uint8_t castling_rights;
+};
+static_assert(sizeof(SnapshotHeader) == 56, "SnapshotHeader layout is part of the file format");
+static_assert(sizeof(UndoRecord) == 16, "UndoRecord layout is part of the snapshot format");
+
+// The body follows the header:
+//   piece type names 1..piece_types-1, each a length byte and the name
+//   int32 ready-at ply per portal
+//   pieces as (uint16 square, uint8 type, uint8 white)
+//   uint32 moves, then the UndoRecords of the history_ply played ones
+
+struct LogHeader {
+  char magic[8];
+  uint64_t config_hash;
+  uint64_t generation;
+};
+static_assert(sizeof(LogHeader) == 24, "LogHeader layout is part of the file format");
+
+struct LogRecord {
+  uint32_t move;
+  uint8_t op;
+  uint8_t reserved;
+  uint16_t check;
+};
+static_assert(sizeof(LogRecord) == 8, "LogRecord layout is part of the file format");
+
+uint32_t checksum(const uint8_t* data, size_t size) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ data[i]) * 16777619u;
+  }
+  return hash;
+}
+
+// Ties a record to its generation and place in the log, so leftovers of an
+// older log never pass for new records
+uint16_t recordCheck(uint64_t generation, size_t index, uint32_t move, uint8_t op) {
+  uint64_t z = generation * 0x9e3779b97f4a7c15ull ^ (static_cast<uint64_t>(index) << 8 | op) ^
+               static_cast<uint64_t>(move) << 32;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return static_cast<uint16_t>(z ^ (z >> 31));
+}
+
+// Whether `move` can be played on `board` as encoded: both squares on the
+// board, a piece of the side to move on the first, and the kind the board
+// gives that move. The rules were checked when the move was logged, and the
+// record's check word ties it to that move, so replay does not check them
+// again (that check was most of the recovery time).
+bool playable(const ChessBoard& board, EncodedMove move) {
+  const int squares = board.getBoardSize() * board.getBoardSize();
+  if (move.from() >= squares || move.to() >= squares || move.from() == move.to()) {
+    return false;
+  }
+  const Position start = board.squarePosition(move.from());
+  const Position target = board.squarePosition(move.to());
+  const ChessBoard::Square& moving = board.getSquare(start);
+  return !moving.is_empty() && moving.is_white == board.isWhiteToMove() &&
+         board.encodeMove(start, target, move.promotion()) == move;
+}
+
+template <typename T>
+void put(std::vector<uint8_t>& out, const T& value) {
+  const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+bool get(const uint8_t*& next, const uint8_t* end, T& value) {
+  if (static_cast<size_t>(end - next) < sizeof(T)) return false;
+  std::memcpy(&value, next, sizeof(T));
+  next += sizeof(T);
+  return true;
+}
+
+bool writeAll(int fd, const uint8_t* data, size_t size) {
+  while (size > 0) {
+    const ssize_t written = ::write(fd, data, size);
+    if (written <= 0) return false;
+    data += written;
+    size -= static_cast<size_t>(written);
+  }
+  return true;
+}
+
+// Reads the whole open file into `out`
+bool readAll(int fd, std::vector<uint8_t>& out) {
+  struct stat info;
+  if (::fstat(fd, &info) != 0) {
+    return false;
+  }
+  out.resize(static_cast<size_t>(info.st_size));
+  size_t done = 0;
+  while (done < out.size()) {
+    const ssize_t got = ::read(fd, out.data() + done, out.size() - done);
+    if (got <= 0) break;
+    done += static_cast<size_t>(got);
+  }
+  out.resize(done);
+  return true;
+}
+
+} // namespace
+
+bool GameJournal::exists(const std::string& path) {
+  struct stat info;
+  return ::stat((path + ".snap").c_str(), &info) == 0;
+}
+
+bool GameJournal::create(const std::string& path, const GameConfig& config, const ChessBoard& board,
+                         const PortalSystem& portal_system, const GameManager& game_manager) {
+  close();
+  path_ = path;
+  config_hash_ = configHash(config);
+  generation_ = 0;
+  return snapshot(board, portal_system, game_manager);
+}
+
+bool GameJournal::snapshot(const ChessBoard& board, const PortalSystem& portal_system,
+                           const GameManager& game_manager) {
+  if (path_.empty()) {
+    return false;
+  }
+  const std::vector<EncodedMove>& moves = game_manager.getMoveHistory();
+  const size_t played = game_manager.getHistorySize();
+  const size_t portals = portal_system.getPortals().size();
+
+  buffer_.assign(sizeof(SnapshotHeader), 0);
+  for (size_t type = 1; type < board.pieceTypeCount(); ++type) {
+    const std::string& name = board.pieceType(static_cast<uint8_t>(type)).name;
+    buffer_.push_back(static_cast<uint8_t>(std::min<size_t>(name.size(), 255)));
+    buffer_.insert(buffer_.end(), name.begin(), name.begin() + std::min<size_t>(name.size(), 255));
+  }
+  for (size_t i = 0; i < portals; ++i) {
+    put(buffer_, static_cast<int32_t>(portal_system.getReadyAt(i)));
+  }
+  uint32_t pieces = 0;
+  board.forEachPiece([&](const Position& pos, const ChessBoard::Square& square) {
+    put(buffer_, static_cast<uint16_t>(board.squareIndex(pos)));
+    buffer_.push_back(square.type);
+    buffer_.push_back(square.is_white ? 1 : 0);
+    ++pieces;
+    return false;
+  });
+  for (EncodedMove move : moves) {
+    put(buffer_, move.bits);
+  }
+  const auto* undo = reinterpret_cast<const uint8_t*>(game_manager.getUndoHistory().data());
+  buffer_.insert(buffer_.end(), undo, undo + played * sizeof(UndoRecord));
+
+  SnapshotHeader header{};
+  std::memcpy(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic));
+  header.config_hash = config_hash_;
+  header.generation = generation_ + 1;
+  header.body_bytes = static_cast<uint32_t>(buffer_.size() - sizeof(header));
+  header.checksum = checksum(buffer_.data() + sizeof(header), header.body_bytes);
+  header.history_ply = static_cast<uint32_t>(played);
+  header.moves = static_cast<uint32_t>(moves.size());
+  header.pieces = pieces;
+  header.portal_ply = portal_system.getPly();
+  header.piece_types = static_cast<uint16_t>(board.pieceTypeCount());
+  header.portals = static_cast<uint16_t>(portals);
+  header.en_passant = static_cast<int16_t>(board.getEnPassantSquare());
+  header.white_to_move = board.isWhiteToMove() ? 1 : 0;
+  header.castling_rights = board.getCastlingRights();
+  std::memcpy(buffer_.data(), &header, sizeof(header));
+
+  const std::string temporary = path_ + ".snap.tmp";
+  const int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  const bool written = writeAll(fd, buffer_.data(), buffer_.size()) && (!sync_ || ::fdatasync(fd) == 0);
+  ::close(fd);
+  if (!written || std::rename(temporary.c_str(), (path_ + ".snap").c_str()) != 0) {
+    std::remove(temporary.c_str());
+    return false;
+  }
+  generation_ = header.generation;
+  return startLog();
+}
+
+bool GameJournal::startLog() {
+  if (log_fd_ >= 0) {
+    ::close(log_fd_);
+  }
+  log_fd_ = ::open((path_ + ".wal").c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+  if (log_fd_ < 0) {
+    return false;
+  }
+  LogHeader header{};
+  std::memcpy(header.magic, kLogMagic, sizeof(kLogMagic));
+  header.config_hash = config_hash_;
+  header.generation = generation_;
+  records_ = 0;
+  if (!writeAll(log_fd_, reinterpret_cast<const uint8_t*>(&header), sizeof(header)) ||
+      (sync_ && ::fdatasync(log_fd_) != 0)) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void GameJournal::append(Op op, EncodedMove move) {
+  if (log_fd_ < 0) {
+    return;
+  }
+  LogRecord record{move.bits, static_cast<uint8_t>(op), 0, 0};
+  record.check = recordCheck(generation_, records_, record.move, record.op);
+  if (writeAll(log_fd_, reinterpret_cast<const uint8_t*>(&record), sizeof(record))) {
+    ++records_;
+    if (sync_) {
+      ::fdatasync(log_fd_);
+    }
+  }
+}
+
+void GameJournal::close() {
+  if (log_fd_ >= 0) {
+    ::close(log_fd_);
+    log_fd_ = -1;
+  }
+}
+
+bool GameJournal::recover(const std::string& path, const GameConfig& config, ChessBoard& board,
+                          PortalSystem& portal_system, GameManager& game_manager, const char** error) {
+  auto fail = [&](const char* message) {
+    if (error) *error = message;
+    return false;
+  };
+  close();
+  game_manager.setJournal(nullptr);
+  path_ = path;
+  config_hash_ = configHash(config);
+  replayed_ = 0;
+
+  // Snapshot
+  const int snapshot_fd = ::open((path + ".snap").c_str(), O_RDONLY);
+  const bool has_snapshot = snapshot_fd >= 0 && readAll(snapshot_fd, buffer_);
+  if (snapshot_fd >= 0) {
+    ::close(snapshot_fd);
+  }
+  if (!has_snapshot) {
+    return fail("no snapshot");
+  }
+  SnapshotHeader header;
+  const uint8_t* next = buffer_.data();
+  const uint8_t* end = next + buffer_.size();
+  if (!get(next, end, header) || std::memcmp(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0) {
+    return fail("not a snapshot");
+  }
+  if (header.config_hash != config_hash_ || header.portals != portal_system.getPortals().size()) {
+    return fail("snapshot of another configuration");
+  }
+  // The checksum covers only the body, so the header's counts are checked
+  // before they size anything
+  if (header.body_bytes != static_cast<size_t>(end - next) || checksum(next, header.body_bytes) != header.checksum ||
+      header.history_ply > header.moves || header.piece_types == 0 ||
+      header.piece_types > ChessBoard::kMaxPieceTypes) {
+    return fail("damaged snapshot");
+  }
+  // Names are read in full, and the ones the board lacks counted, before
+  // any is registered, so a table that would overflow fails here
+  std::string_view names[ChessBoard::kMaxPieceTypes];
+  size_t unseen = 0;
+  for (uint16_t type = 1; type < header.piece_types; ++type) {
+    uint8_t length = 0;
+    if (!get(next, end, length) || length == 0 || static_cast<size_t>(end - next) < length) {
+      return fail("damaged snapshot");
+    }
+    names[type] = std::string_view(reinterpret_cast<const char*>(next), length);
+    unseen += board.findPieceType(names[type]) == 0;
+    next += length;
+  }
+  if (board.pieceTypeCount() + unseen > ChessBoard::kMaxPieceTypes) {
+    return fail("damaged snapshot");
+  }
+  uint8_t types[ChessBoard::kMaxPieceTypes] = {};
+  for (uint16_t type = 1; type < header.piece_types; ++type) {
+    types[type] = board.pieceTypeId(std::string(names[type]));
+  }
+  if (static_cast<size_t>(end - next) < header.portals * sizeof(int32_t)) {
+    return fail("damaged snapshot");
+  }
+  const uint8_t* ready_at = next;
+  next += header.portals * sizeof(int32_t);
+  const int squares = board.getBoardSize() * board.getBoardSize();
+  std::vector<ChessBoard::Placement> placements;
+  placements.reserve(header.pieces);
+  for (uint32_t i = 0; i < header.pieces; ++i) {
+    uint16_t index = 0;
+    uint8_t type = 0, white = 0;
+    if (!get(next, end, index) || !get(next, end, type) || !get(next, end, white) ||
+        index >= squares || type == 0 || type >= header.piece_types) {
+      return fail("damaged snapshot");
+    }
+    placements.push_back({index, ChessBoard::Square(types[type], board.pieceKind(types[type]), white != 0)});
+  }
+  if (static_cast<size_t>(end - next) != header.moves * sizeof(uint32_t) + header.history_ply * sizeof(UndoRecord)) {
+    return fail("damaged snapshot");
+  }
+
+  // The snapshot is whole; only now is the session touched
+  board.clearPieces();
+  board.placePieces(placements.data(), placements.size());
+  board.setWhiteToMove(header.white_to_move != 0);
+  board.setCastlingRights(header.castling_rights);
+  board.setEnPassantSquare(header.en_passant);
+  for (uint16_t i = 0; i < header.portals; ++i) {
+    int32_t value;
+    std::memcpy(&value, ready_at + i * sizeof(int32_t), sizeof(value));
+    portal_system.setReadyAt(i, value);
+  }
+  portal_system.setPly(header.portal_ply);
+  std::vector<EncodedMove> moves(header.moves);
+  for (EncodedMove& move : moves) {
+    get(next, end, move.bits);
+  }
+  std::vector<UndoRecord> undos(header.history_ply);
+  std::memcpy(undos.data(), next, undos.size() * sizeof(UndoRecord));
+  for (UndoRecord& undo : undos) {
+    // Piece types are renumbered for this board like the pieces above
+    undo.moved = types[undo.moved];
+    undo.captured = types[undo.captured];
+    undo.exit_captured = types[undo.exit_captured];
+  }
+  game_manager.restoreHistory(std::move(moves), std::move(undos), header.history_ply);
+  generation_ = header.generation;
+
+  // Log tail; the file stays open to append to after the last good record
+  LogHeader log_header{};
+  log_fd_ = ::open((path + ".wal").c_str(), O_RDWR | O_APPEND);
+  const bool has_log = log_fd_ >= 0 && readAll(log_fd_, buffer_) && buffer_.size() >= sizeof(LogHeader);
+  if (has_log) {
+    std::memcpy(&log_header, buffer_.data(), sizeof(log_header));
+    if (std::memcmp(log_header.magic, kLogMagic, sizeof(kLogMagic)) != 0 || log_header.config_hash != config_hash_) {
+      close();
+      return fail("not a log of this session");
+    }
+  }
+  // No log yet, or one generation behind: the process died before the new
+  // log was started, and the snapshot already holds every record
+  if (!has_log || log_header.generation + 1 == generation_) {
+    return startLog();
+  }
+  if (log_header.generation != generation_) {
+    close();
+    return fail("log does not match the snapshot");
+  }
+  size_t valid = 0;
+  const size_t records = (buffer_.size() - sizeof(LogHeader)) / sizeof(LogRecord);
+  for (; valid < records; ++valid) {
+    LogRecord record;
+    std::memcpy(&record, buffer_.data() + sizeof(LogHeader) + valid * sizeof(LogRecord), sizeof(record));
+    if (record.check != recordCheck(generation_, valid, record.move, record.op)) {
+      break;
+    }
+    const EncodedMove move{record.move};
+    bool applied = false;
+    switch (static_cast<Op>(record.op)) {
+      case Op::Move:
+        applied = playable(board, move);
+        if (applied) game_manager.makeMove(move);
+        break;
+      case Op::Undo:
+        applied = game_manager.undoMove(false);
+        break;
+      case Op::Redo:
+        applied = game_manager.redoMove(false);
+        break;
+    }
+    if (!applied) {
+      close();
+      return fail("log record does not fit the game");
+    }
+  }
+  replayed_ = valid;
+
+  // Cut off a torn or stale tail
+  const size_t length = sizeof(LogHeader) + valid * sizeof(LogRecord);
+  if (length != buffer_.size() && ::ftruncate(log_fd_, static_cast<off_t>(length)) != 0) {
+    close();
+    return fail("cannot append to the log");
+  }
+  records_ = valid;
+  return true;
+}
@@ -1,170 +1,489 @@
 #include "GameManager.hpp"
+#include "AttackMap.hpp"
 #include "ChessBoard.hpp"
+#include "GameJournal.hpp"
+#include "GameRecord.hpp"
 #include "MoveValidator.hpp"
 #include "PortalSystem.hpp"
+#include "ScratchArena.hpp"
+#include <algorithm>
+#include <chrono>
 #include <stdexcept>
 #include <iostream>
 
+namespace {
+// Enough for a long game without growing the history buffers
+constexpr size_t kInitialHistoryCapacity = 512;
+
+// Per-thread board for trying moves. Copy-assignment reuses its storage, so
+// after the first status evaluation on a thread no allocation happens here.
+ChessBoard& scratchBoardFor(const ChessBoard& source) {
+    thread_local ChessBoard scratch(0);
+    scratch = source;
+    return scratch;
+}
+
+// Every square the validator could accept for `moving`: its own move edges
+// plus castling, en passant and portal exits
+void candidateTargets(const ChessBoard& board, const Position& start, const ChessBoard::Square& moving,
+                      bool is_white_turn, const MoveValidator& validator, const PortalSystem& portal_system,
+                      std::pmr::vector<Position>& targets) {
+    validator.getMoveEdges(moving.kind, start, is_white_turn, board, targets);
+    if (moving.kind == PieceKind::King) {
+        targets.push_back({start.x + 2, start.y});
+        targets.push_back({start.x - 2, start.y});
+    } else if (moving.kind == PieceKind::Pawn) {
+        const int forward = is_white_turn ? 1 : -1;
+        targets.push_back({start.x + 1, start.y + forward});
+        targets.push_back({start.x - 1, start.y + forward});
+    }
+    for (const auto& portal : portal_system.getPortals()) {
+        if (portal.positions.entry.x == start.x && portal.positions.entry.y == start.y) {
+            targets.push_back(portal.positions.exit);
+        }
+    }
+}
+
+// Look outward from `target` instead of trying every opposing piece: the first
+// piece on each ray (one binary search each), then the knight and pawn squares.
+// Kings and custom pieces never give check, as in the validator scan.
+bool isAttackedOnSparseBoard(const ChessBoard& board, const Position& target, bool by_white) {
+    auto holds = [&](const Position& pos, PieceKind a, PieceKind b) {
+        if (!board.isInBounds(pos)) return false;
+        const auto& square = board.getSquare(pos);
+        return !square.is_empty() && square.is_white == by_white && (square.kind == a || square.kind == b);
+    };
+    for (int dx = -1; dx <= 1; ++dx) {
+        for (int dy = -1; dy <= 1; ++dy) {
+            if (dx == 0 && dy == 0) continue;
+            const int reach = board.rayLength(target, dx, dy);
+            if (reach == 0) continue;
+            const PieceKind slider = dx != 0 && dy != 0 ? PieceKind::Bishop : PieceKind::Rook;
+            if (holds({target.x + reach * dx, target.y + reach * dy}, slider, PieceKind::Queen)) {
+                return true;
+            }
+        }
+    }
+    static constexpr Position kKnightSteps[] = {
+        {2, 1}, {2, -1}, {-2, 1}, {-2, -1}, {1, 2}, {1, -2}, {-1, 2}, {-1, -2}
+    };
+    for (const auto& step : kKnightSteps) {
+        if (holds({target.x + step.x, target.y + step.y}, PieceKind::Knight, PieceKind::Knight)) {
+            return true;
+        }
+    }
+    // A pawn captures toward its own forward direction
+    const int pawn_y = target.y - (by_white ? 1 : -1);
+    return holds({target.x - 1, pawn_y}, PieceKind::Pawn, PieceKind::Pawn) ||
+           holds({target.x + 1, pawn_y}, PieceKind::Pawn, PieceKind::Pawn);
+}
+
+// An opponent piece on the entry of a portal leading to `king` reaches it only
+// under the portal rules, which the attack map does not model exactly
+bool isPortalExitContested(const ChessBoard& board, bool is_white, const Position& king,
+                           const PortalSystem& portal_system) {
+    for (const auto& portal : portal_system.getPortals()) {
+        const Position exit = portal.positions.exit;
+        if (exit.x != king.x || exit.y != king.y) continue;
+        const auto& square = board.getSquare(portal.positions.entry);
+        if (!square.is_empty() && square.is_white != is_white) {
+            return true;
+        }
+    }
+    return false;
+}
+}
+
 GameManager::GameManager(ChessBoard& board, MoveValidator& validator, PortalSystem& portal_system)
     : chess_board(board), validator(validator), portal_system(portal_system) {
+    move_history.reserve(kInitialHistoryCapacity);
+    undo_history.reserve(kInitialHistoryCapacity);
+    repetition.reset(chess_board.positionKey(portal_system));
+}
+
+void GameManager::resetHistory() {
+    move_history.clear();
+    undo_history.clear();
+    history_ply = 0;
+    repetition.reset(chess_board.positionKey(portal_system));
 }
 
 bool GameManager::isInCheck(bool is_white_turn) const {
-    
+    return isKingAttacked(chess_board, is_white_turn, validator, portal_system);
+}
+
+bool GameManager::isKingAttacked(const ChessBoard& board, bool is_white, const MoveValidator& validator,
+                                 const PortalSystem& portal_system) {
     Position king_position;
     bool king_found = false;
 
-    // Find the king
-    for (int y = 0; y < chess_board.getBoardSize() && !king_found; ++y) {
-        for (int x = 0; x < chess_board.getBoardSize() && !king_found; ++x) {
-            const auto& square = chess_board.getSquare({x, y});
-            if (validator.toLowerCase(square.piece) == "king" && square.is_white == is_white_turn) {
-                king_position = {x, y};
+    if (board.hasLineMasks()) {
+        const uint32_t* kings = board.pieceRanks(is_white, PieceKind::King);
+        for (int y = 0; y < board.getBoardSize(); ++y) {
+            if (kings[y]) {
+                king_position = {__builtin_ctz(kings[y]), y};
+                if (!isPortalExitContested(board, is_white, king_position, portal_system)) {
+                    // One attack map of the opponent answers the same question as the scan below
+                    AttackMap attacks;
+                    attacks.build(board, !is_white, portal_system, false);
+                    return attacks.isAttacked(king_position);
+                }
                 king_found = true;
+                break;
             }
         }
+        if (!king_found) {
+            return false;
+        }
+    }
+
+    // Find the king
+    if (!king_found) {
+        king_found = board.forEachPiece([&](const Position& pos, const ChessBoard::Square& square) {
+            if (square.kind == PieceKind::King && square.is_white == is_white) {
+                king_position = pos;
+                return true;
+            }
+            return false;
+        });
     }
 
     if (!king_found) {
         return false;
     }
 
+    if (board.isSparse() && !isPortalExitContested(board, is_white, king_position, portal_system)) {
+        return isAttackedOnSparseBoard(board, king_position, !is_white);
+    }
+
     // Check for threats
-    const std::vector<std::string> threatening_pieces = {"queen", "rook", "bishop", "knight", "pawn"};
-    
-    for (int y = 0; y < chess_board.getBoardSize(); ++y) {
-        for (int x = 0; x < chess_board.getBoardSize(); ++x) {
-            const auto& square = chess_board.getSquare({x, y});
-            // Only check opponent pieces
-            if (!square.is_empty() && square.is_white != is_white_turn) {
-                std::string piece_lower = validator.toLowerCase(square.piece);
-                // Check only threatening pieces
-                if (std::find(threatening_pieces.begin(), threatening_pieces.end(), piece_lower) != threatening_pieces.end()) {
-                    Position start = {x, y};
-                    // Check if piece threatens the king
-                    if (validator.isValidMove(square.piece, start, king_position, !is_white_turn, 
-                                           chess_board, portal_system)) {
-                        return true;
-                    }
-                }
-            }
+    return board.forEachPiece([&](const Position& start, const ChessBoard::Square& square) {
+        // Only check opponent pieces, and only threatening ones
+        if (square.is_white == is_white || square.kind == PieceKind::King || square.kind == PieceKind::Custom) {
+            return false;
+        }
+        // Check if piece threatens the king
+        return validator.isValidMove(board.pieceName(square), start, king_position, !is_white,
+                                     board, portal_system, false);
+    });
+}
+
+bool GameManager::isCheckmate(bool is_white_turn) {
+    return isInCheck(is_white_turn) && !hasLegalMove(is_white_turn);
+}
+
+bool GameManager::isStalemate(bool is_white_turn) const {
+    return !isInCheck(is_white_turn) && !hasLegalMove(is_white_turn);
+}
+
+bool GameManager::hasLegalMove(bool is_white_turn) const {
+    ScratchArena& arena = ScratchArena::forThread();
+    ScratchArena::Scope scope(arena);
+    std::pmr::vector<Position> pieces(&arena);
+    chess_board.forEachPiece([&](const Position& pos, const ChessBoard::Square& square) {
+        if (square.is_white == is_white_turn) {
+            pieces.push_back(pos);
         }
+        return false;
+    });
+
+    std::atomic<bool> found{false};
+    if (pieces.size() < 2 || std::thread::hardware_concurrency() < 2 ||
+        chess_board.getBoardSize() < (parallel_status_min_board_size == kMeasuredParallelStatusThreshold
+                                          ? measuredParallelStatusMinBoardSize()
+                                          : parallel_status_min_board_size)) {
+        return hasLegalMoveInRange(scratchBoardFor(chess_board), is_white_turn, pieces, 0, pieces.size(), found);
+    }
+
+    // One chunk of the piece list per worker, each searching its own board copy.
+    // The first worker to find a saving move raises `found`, which the others
+    // poll between candidate moves.
+    ThreadPool& pool = statusPool();
+    size_t chunks = std::min<size_t>(pool.size(), pieces.size());
+    size_t chunk_size = (pieces.size() + chunks - 1) / chunks;
+    std::vector<std::future<void>> pending;
+    for (size_t begin = 0; begin < pieces.size(); begin += chunk_size) {
+        size_t end = std::min(begin + chunk_size, pieces.size());
+        pending.push_back(pool.submit([this, is_white_turn, &pieces, &found, begin, end] {
+            if (hasLegalMoveInRange(scratchBoardFor(chess_board), is_white_turn, pieces, begin, end, found)) {
+                found.store(true, std::memory_order_relaxed);
+            }
+        }));
+    }
+    for (auto& task : pending) {
+        task.get();
     }
+    return found.load();
+}
 
+bool GameManager::hasLegalMoveInRange(ChessBoard& board, bool is_white_turn,
+                                      const std::pmr::vector<Position>& pieces, size_t begin, size_t end,
+                                      const std::atomic<bool>& cancel) const {
+    for (size_t i = begin; i < end; ++i) {
+        const Position start = pieces[i];
+        const ChessBoard::Square moving = board.getSquare(start);
+
+        ScratchArena::Scope scope(ScratchArena::forThread());
+        std::pmr::vector<Position> targets(&ScratchArena::forThread());
+        candidateTargets(board, start, moving, is_white_turn, validator, portal_system, targets);
+        for (const Position& target : targets) {
+            if (cancel.load(std::memory_order_relaxed)) {
+                return false;
+            }
+            if (!board.isInBounds(target) || (start.x == target.x && start.y == target.y)) continue;
+            if (validator.isValidMove(board.pieceName(moving), start, target, is_white_turn,
+                                      board, portal_system, false) &&
+                leavesKingSafe(board, start, target, is_white_turn)) {
+                return true; // Saving move exists
+            }
+        }
+    }
     return false;
 }
 
-bool GameManager::isCheckmate(bool is_white_turn) {
-    // First check if in check
-    if (!isInCheck(is_white_turn)) {
+// Play the move on the scratch board, test, then take it back
+bool GameManager::leavesKingSafe(ChessBoard& board, const Position& start, const Position& target,
+                                 bool is_white_turn) const {
+    const ChessBoard::Square moving = board.getSquare(start);
+    const ChessBoard::Square captured = board.getSquare(target);
+    board.setSquare(target, moving);
+    board.setSquare(start, ChessBoard::Square());
+    bool safe = !isKingAttacked(board, is_white_turn, validator, portal_system);
+    board.setSquare(start, moving);
+    board.setSquare(target, captured);
+    return safe;
+}
+
+void GameManager::generateLegalMoves(bool is_white_turn, std::vector<EncodedMove>& moves) const {
+    static const std::atomic<bool> never{false};
+    generateLegalMoves(is_white_turn, moves, never);
+}
+
+bool GameManager::generateLegalMoves(bool is_white_turn, std::vector<EncodedMove>& moves,
+                                     const std::atomic<bool>& cancel) const {
+    moves.clear();
+    ScratchArena& arena = ScratchArena::forThread();
+    ScratchArena::Scope scope(arena);
+    ChessBoard& board = scratchBoardFor(chess_board);
+    std::pmr::vector<Position> pieces(&arena);
+    chess_board.forEachPiece([&](const Position& pos, const ChessBoard::Square& square) {
+        if (square.is_white == is_white_turn) {
+            pieces.push_back(pos);
+        }
         return false;
-    }
+    });
 
-    // Check all pieces and possible moves
-    for (int y = 0; y < chess_board.getBoardSize(); ++y) {
-        for (int x = 0; x < chess_board.getBoardSize(); ++x) {
-            const auto& square = chess_board.getSquare({x, y});
-            if (!square.is_empty() && square.is_white == is_white_turn) {
-                Position start = {x, y};
-                
-                // Check all possible destination squares
-                for (int dy = 0; dy < chess_board.getBoardSize(); ++dy) {
-                    for (int dx = 0; dx < chess_board.getBoardSize(); ++dx) {
-                        Position end = {dx, dy};
-                        if (start.x == end.x && start.y == end.y) continue;
-                        
-                        // Check if move is valid
-                        if (validator.isValidMove(square.piece, start, end, is_white_turn,
-                                               chess_board, portal_system)) {
-                            // Create temporary board
-                            ChessBoard temp_board = chess_board;
-                            try {
-                                // Make the move
-                                auto captured_piece = temp_board.getSquare(end);
-                                temp_board.placePiece(square.piece, square.is_white, end.x, end.y);
-                                temp_board.placePiece("", false, start.x, start.y);
-                                
-                                // Check if still in check after move
-                                GameManager temp_manager(temp_board, validator, portal_system);
-                                if (!temp_manager.isInCheck(is_white_turn)) {
-                                    return false; // Saving move exists
-                                }
-                            } catch (const std::exception& e) {
-                                continue;
-                            }
-                        }
-                    }
+    std::pmr::vector<Position> targets(&arena);
+    for (const Position& start : pieces) {
+        const ChessBoard::Square moving = board.getSquare(start);
+        targets.clear();
+        candidateTargets(board, start, moving, is_white_turn, validator, portal_system, targets);
+        for (const Position& target : targets) {
+            // Each candidate costs a king-safety check, which on large
+            // boards is what a stopped search would otherwise wait for
+            if (cancel.load(std::memory_order_relaxed)) {
+                return false;
+            }
+            if (!board.isInBounds(target) || (start.x == target.x && start.y == target.y)) continue;
+            // Candidates can repeat (a pawn capture is also a move edge)
+            const EncodedMove move = chess_board.encodeMove(start, target);
+            if (std::find(moves.begin(), moves.end(), move) != moves.end()) continue;
+            if (!validator.isValidMove(board.pieceName(moving), start, target, is_white_turn,
+                                       board, portal_system, false) ||
+                !leavesKingSafe(board, start, target, is_white_turn)) {
+                continue;
+            }
+            if (move.kind() == MoveKind::Promotion) {
+                for (PromotionPiece promotion : {PromotionPiece::Queen, PromotionPiece::Rook,
+                                                 PromotionPiece::Bishop, PromotionPiece::Knight}) {
+                    moves.push_back(chess_board.encodeMove(start, target, promotion));
                 }
+            } else {
+                moves.push_back(move);
             }
         }
     }
-
-    return true; // No saving move found
+    return true;
 }
 
-bool GameManager::isStalemate(bool is_white_turn) const {
-    if (isInCheck(is_white_turn)) {
+bool GameManager::isLegalMove(EncodedMove move) const {
+    const int squares = chess_board.getBoardSize() * chess_board.getBoardSize();
+    if (move.from() >= squares || move.to() >= squares || move.from() == move.to()) {
         return false;
     }
+    const bool is_white_turn = chess_board.isWhiteToMove();
+    const Position start = chess_board.squarePosition(move.from());
+    const Position target = chess_board.squarePosition(move.to());
+    const ChessBoard::Square moving = chess_board.getSquare(start);
+    if (moving.is_empty() || moving.is_white != is_white_turn ||
+        chess_board.encodeMove(start, target, move.promotion()) != move) {
+        return false;
+    }
+    ChessBoard& board = scratchBoardFor(chess_board);
+    return validator.isValidMove(board.pieceName(moving), start, target, is_white_turn,
+                                 board, portal_system, false) &&
+           leavesKingSafe(board, start, target, is_white_turn);
+}
 
-    for (int y = 0; y < chess_board.getBoardSize(); ++y) {
-        for (int x = 0; x < chess_board.getBoardSize(); ++x) {
-            const auto& square = chess_board.getSquare({x, y});
-            if (!square.is_empty() && square.is_white == is_white_turn) {
-                Position start = {x, y};
-                for (int dy = -chess_board.getBoardSize(); dy <= chess_board.getBoardSize(); ++dy) {
-                    for (int dx = -chess_board.getBoardSize(); dx <= chess_board.getBoardSize(); ++dx) {
-                        if (dx == 0 && dy == 0) continue;
-                        Position end = {x + dx, y + dy};
-                        if (chess_board.isInBounds(end) && 
-                            validator.isValidMove(square.piece, start, end, is_white_turn, 
-                                                 chess_board, portal_system)) {
-                            return false;
-                        }
-                    }
+int GameManager::measuredParallelStatusMinBoardSize() {
+    static const int measured = [] {
+        constexpr int kNever = ChessBoard::kMaxBoardSize + 1;
+        constexpr int kRuns = 5;
+        if (std::thread::hardware_concurrency() < 2) {
+            return kNever;
+        }
+        MoveValidator validator;
+        PortalSystem portal_system({});
+        int first_win = kNever;
+        for (int size = 8; size <= ChessBoard::kMaxMaskedBoardSize; size += 2) {
+            // Pawns blocked head to head: no legal move, so nothing stops early
+            ChessBoard board(size);
+            for (int y = 1; y + 1 < size; y += 2) {
+                for (int x = 0; x < size; x += 2) {
+                    board.placePiece("Pawn", true, x, y);
+                    board.placePiece("Pawn", false, x, y + 1);
                 }
             }
+            GameManager manager(board, validator, portal_system);
+            auto best = [&](int threshold) {
+                manager.setParallelStatusThreshold(threshold);
+                auto fastest = std::chrono::steady_clock::duration::max();
+                for (int run = 0; run < kRuns; ++run) {
+                    const auto begin = std::chrono::steady_clock::now();
+                    manager.hasLegalMove(true);
+                    fastest = std::min(fastest, std::chrono::steady_clock::now() - begin);
+                }
+                return fastest;
+            };
+            // A win must be clear of timing noise: at least 10% faster
+            const auto serial = best(kNever);
+            if (best(0) * 10 < serial * 9) {
+                if (first_win != kNever) {
+                    return first_win;
+                }
+                first_win = size;
+            } else {
+                first_win = kNever;
+            }
         }
+        return kNever;
+    }();
+    return measured;
+}
+
+ThreadPool& GameManager::statusPool() const {
+    if (!status_pool) {
+        status_pool = std::make_unique<ThreadPool>();
     }
+    return *status_pool;
+}
 
-    return true;
+void GameManager::restoreHistory(std::vector<EncodedMove> moves, std::vector<UndoRecord> undos, size_t ply) {
+    move_history = std::move(moves);
+    undo_history = std::move(undos);
+    history_ply = std::min(ply, move_history.size());
+    undo_history.resize(move_history.size());
+    for (size_t i = history_ply; i-- > 0;) {
+        chess_board.undoMove(move_history[i], undo_history[i], portal_system);
+    }
+    repetition.reset(chess_board.positionKey(portal_system));
+    for (size_t i = 0; i < history_ply; ++i) {
+        chess_board.applyMove(move_history[i], portal_system, undo_history[i]);
+        repetition.push(chess_board.positionKey(portal_system), isIrreversible(move_history[i], undo_history[i]));
+    }
 }
 
-void GameManager::addToMoveHistory(const Move& move) {
-    move_history.push(move);
+void GameManager::makeMove(EncodedMove move) {
+    // A new move invalidates the redo tail
+    move_history.resize(history_ply);
+    undo_history.resize(history_ply);
+    move_history.push_back(move);
+    undo_history.emplace_back();
+    chess_board.applyMove(move, portal_system, undo_history.back());
+    ++history_ply;
+    repetition.push(chess_board.positionKey(portal_system), isIrreversible(move, undo_history.back()));
+    if (recorder) {
+        recorder->addMove(move);
+    }
+    if (journal) {
+        journal->logMove(move);
+    }
 }
 
-void GameManager::undoMove() {
-    if (move_history.empty()) {
-        std::cout << "No moves to undo." << std::endl;
-        return;
+bool GameManager::undoMove(bool verbose) {
+    if (history_ply == 0) {
+        if (verbose) {
+            std::cout << "No moves to undo." << std::endl;
+        }
+        return false;
     }
 
-    Move last_move = move_history.top();
-    move_history.pop();
+    --history_ply;
+    const EncodedMove last_move = move_history[history_ply];
+    chess_board.undoMove(last_move, undo_history[history_ply], portal_system);
+    repetition.pop();
+    if (recorder) {
+        recorder->removeLastMove();
+    }
+    if (journal) {
+        journal->logUndo();
+    }
+    if (!verbose) {
+        return true;
+    }
+
+    Position start = chess_board.squarePosition(last_move.from());
+    Position end = chess_board.squarePosition(last_move.to());
+    std::cout << "Move undone: " << chess_board.pieceName(chess_board.getSquare(start)) << " from "
+              << end.x << "," << end.y << " to " << start.x << "," << start.y << std::endl;
+    return true;
+}
 
-    try {
-        // Restore the moved piece to its original position
-        chess_board.placePiece(last_move.moved_piece, last_move.moved_piece_color, 
-                             last_move.start.x, last_move.start.y);
-        
-        // If a piece was captured, restore it
-        if (!last_move.captured_piece.empty()) {
-            chess_board.placePiece(last_move.captured_piece, last_move.captured_piece_color, 
-                                 last_move.end.x, last_move.end.y);
-        } else {
-            // If no piece was captured, clear the destination square
-            chess_board.placePiece("", false, last_move.end.x, last_move.end.y);
+bool GameManager::redoMove(bool verbose) {
+    if (history_ply == move_history.size()) {
+        if (verbose) {
+            std::cout << "No moves to redo." << std::endl;
         }
+        return false;
+    }
 
-        std::cout << "Move undone: " << last_move.moved_piece << " from " 
-                  << last_move.end.x << "," << last_move.end.y << " to "
-                  << last_move.start.x << "," << last_move.start.y << std::endl;
+    const EncodedMove move = move_history[history_ply];
+    chess_board.applyMove(move, portal_system, undo_history[history_ply]);
+    repetition.push(chess_board.positionKey(portal_system), isIrreversible(move, undo_history[history_ply]));
+    ++history_ply;
+    if (recorder) {
+        recorder->addMove(move);
+    }
+    if (journal) {
+        journal->logRedo();
+    }
+    if (!verbose) {
+        return true;
+    }
 
-        portal_system.updateCooldowns();
-    } catch (const std::exception& e) {
-        // On error, restore the move to history and report the error
-        move_history.push(last_move);
-        std::cerr << "Error undoing move: " << e.what() << std::endl;
+    Position start = chess_board.squarePosition(move.from());
+    Position end = chess_board.squarePosition(move.to());
+    std::cout << "Move redone: " << start.x << "," << start.y << " to "
+              << end.x << "," << end.y << std::endl;
+    return true;
+}
+
+// Moves after which no earlier position can come back
+bool GameManager::isIrreversible(EncodedMove move, const UndoRecord& undo) const {
+    return move.kind() != MoveKind::Normal || undo.captured != 0 || undo.exit_captured != 0 ||
+           chess_board.pieceKind(undo.moved) == PieceKind::Pawn ||
+           undo.castling_rights != chess_board.getCastlingRights();
+}
+
+const char* GameManager::getDrawReason() const {
+    if (repetition.isThreefold()) {
+        return "threefold repetition";
     }
-}
\ No newline at end of file
+    if (repetition.halfmoveClock() >= kFiftyMoveRulePlies) {
+        return "fifty-move rule";
+    }
+    if (turn_limit > 0 && history_ply >= static_cast<size_t>(turn_limit)) {
+        return "turn limit";
+    }
+    return nullptr;
+}
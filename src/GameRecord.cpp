@@ -0,0 +1,161 @@
+// GameRecord.cpp
+#include "GameRecord.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr char kMagic[8] = {'C', 'W', 'P', 'G', 'R', '0', '1', '\0'};
+
+struct FileHeader {
+  char magic[8];
+  uint64_t config_hash;
+  uint32_t board_size;
+  uint32_t reserved;
+};
+static_assert(sizeof(FileHeader) == 24, "FileHeader layout is part of the file format");
+
+void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+bool getVarint(const uint8_t*& next, const uint8_t* end, uint64_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 64 && next != end; shift += 7) {
+    const uint8_t byte = *next++;
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) return true;
+  }
+  return false;
+}
+
+} // namespace
+
+const char* resultText(GameResult result) {
+  switch (result) {
+    case GameResult::WhiteWin: return "1-0";
+    case GameResult::BlackWin: return "0-1";
+    case GameResult::Draw: return "1/2-1/2";
+    default: return "*";
+  }
+}
+
+bool parseResult(const std::string& text, GameResult& result) {
+  if (text == "1-0") result = GameResult::WhiteWin;
+  else if (text == "0-1") result = GameResult::BlackWin;
+  else if (text == "1/2-1/2") result = GameResult::Draw;
+  else if (text == "*") result = GameResult::Unknown;
+  else return false;
+  return true;
+}
+
+bool GameRecordWriter::open(const std::string& path, const GameConfig& config) {
+  out_.close();
+  current_.clear();
+  games_ = 0;
+  FileHeader expected{};
+  std::memcpy(expected.magic, kMagic, sizeof(kMagic));
+  expected.config_hash = configHash(config);
+  expected.board_size = static_cast<uint32_t>(config.game_settings.board_size);
+
+  std::ifstream existing(path, std::ios::binary);
+  FileHeader header{};
+  const bool has_header = existing.read(reinterpret_cast<char*>(&header), sizeof(header)).gcount() == sizeof(header);
+  existing.close();
+  if (has_header) {
+    if (std::memcmp(&header, &expected, sizeof(header)) != 0) {
+      return false;
+    }
+    out_.open(path, std::ios::binary | std::ios::app);
+  } else {
+    out_.open(path, std::ios::binary | std::ios::trunc);
+    out_.write(reinterpret_cast<const char*>(&expected), sizeof(expected));
+  }
+  squares_ = config.game_settings.board_size * config.game_settings.board_size;
+  return out_.good();
+}
+
+void GameRecordWriter::finishGame(GameResult result) {
+  if (!current_.empty()) {
+    writeGame(current_, result);
+  }
+  current_.clear();
+}
+
+void GameRecordWriter::writeGame(const std::vector<EncodedMove>& moves, GameResult result) {
+  buffer_.clear();
+  for (EncodedMove move : moves) {
+    putVarint(buffer_, (static_cast<uint64_t>(move.from()) * squares_ + move.to()) << 2 |
+                           static_cast<uint64_t>(move.kind()));
+    if (move.kind() == MoveKind::Promotion) {
+      buffer_.push_back(static_cast<uint8_t>(move.promotion()));
+    }
+  }
+  const size_t move_bytes = buffer_.size();
+  putVarint(buffer_, moves.size());
+  putVarint(buffer_, move_bytes);
+  buffer_.push_back(static_cast<uint8_t>(result));
+  // The game header was appended after the moves; write it first
+  out_.write(reinterpret_cast<const char*>(buffer_.data() + move_bytes),
+             static_cast<std::streamsize>(buffer_.size() - move_bytes));
+  out_.write(reinterpret_cast<const char*>(buffer_.data()), static_cast<std::streamsize>(move_bytes));
+  ++games_;
+}
+
+bool GameRecordReader::MoveCursor::next(EncodedMove& move) {
+  uint64_t value;
+  if (left_ == 0 || !getVarint(next_, end_, value)) {
+    return false;
+  }
+  const uint64_t squares = static_cast<uint64_t>(squares_);
+  const uint64_t pair = value >> 2;
+  if (pair >= squares * squares) {
+    return false;
+  }
+  const MoveKind kind = static_cast<MoveKind>(value & 3);
+  PromotionPiece promotion = PromotionPiece::Queen;
+  if (kind == MoveKind::Promotion) {
+    if (next_ == end_ || *next_ > 3) return false;
+    promotion = static_cast<PromotionPiece>(*next_++);
+  }
+  move = EncodedMove::make(static_cast<int>(pair / squares), static_cast<int>(pair % squares), kind, promotion);
+  --left_;
+  return true;
+}
+
+bool GameRecordReader::open(const std::string& path, const GameConfig& config) {
+  begin_ = next_ = end_ = nullptr;
+  if (!file_.open(path) || file_.size() < sizeof(FileHeader)) {
+    return false;
+  }
+  FileHeader header;
+  std::memcpy(&header, file_.data(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.config_hash != configHash(config) ||
+      header.board_size != static_cast<uint32_t>(config.game_settings.board_size)) {
+    file_.close();
+    return false;
+  }
+  board_size_ = static_cast<int>(header.board_size);
+  begin_ = next_ = file_.data() + sizeof(FileHeader);
+  end_ = file_.data() + file_.size();
+  return true;
+}
+
+bool GameRecordReader::next(Game& game) {
+  const uint8_t* cursor = next_;
+  uint64_t plies, move_bytes;
+  if (!getVarint(cursor, end_, plies) || !getVarint(cursor, end_, move_bytes) || cursor == end_ ||
+      plies > UINT32_MAX || move_bytes > static_cast<uint64_t>(end_ - cursor - 1)) {
+    return false;
+  }
+  game.result = static_cast<GameResult>(std::min<uint8_t>(*cursor++, static_cast<uint8_t>(GameResult::Unknown)));
+  game.plies = static_cast<uint32_t>(plies);
+  game.moves = cursor;
+  game.end = cursor + move_bytes;
+  next_ = game.end;
+  return true;
+}
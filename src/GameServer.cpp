@@ -0,0 +1,485 @@
+// GameServer.cpp
+#include "GameServer.hpp"
+#include "ChessBoard.hpp"
+#include "GameManager.hpp"
+#include "MoveValidator.hpp"
+#include "PortalSystem.hpp"
+#include "Search.hpp"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+constexpr uint64_t kListenerTag = 0;
+constexpr uint64_t kWakeTag = 1;
+constexpr int kDefaultDepth = 3;
+// A client that sends a longer line, or stops reading this much output, is
+// dropped rather than buffered without bound
+constexpr size_t kMaxLineBytes = 64 * 1024;
+constexpr size_t kMaxPendingOutput = 1 << 20;
+} // namespace
+
+// One game. The loop thread owns it, except while a go runs: then only the
+// worker searching it touches it, and the loop only calls search.stop().
+struct GameServer::Session {
+  explicit Session(const GameConfig& config)
+      : board(config.game_settings.board_size, "simple"),
+        portal_system(config.portals),
+        game_manager(board, validator, portal_system),
+        search(board, game_manager, portal_system) {
+    // One thread per game; the worker pool is the parallelism
+    game_manager.setParallelStatusThreshold(ChessBoard::kMaxBoardSize + 1);
+    game_manager.setTurnLimit(config.game_settings.turn_limit);
+    board.registerPieceTypes(config);
+    config_types = board.pieceTypeCount();
+  }
+
+  ChessBoard board;
+  MoveValidator validator;
+  PortalSystem portal_system;
+  GameManager game_manager;
+  Search search;
+  std::vector<EncodedMove> legal;  // reused by legal
+  size_t config_types = 0;         // piece types the config and the standard pieces take
+
+  // Back to the config's setup, or to `position` (PositionNotation) if not
+  // empty. Cooldowns are reset in place, so a pooled session does not allocate.
+  // Piece types an earlier position named are forgotten, so a pooled session
+  // does not hand one client's names on to the next.
+  bool reset(const GameConfig& config, const PositionNotation& notation, const std::string& position,
+             const char** error) {
+    board.initializeBoard(config.pieces);
+    board.truncatePieceTypes(config_types);
+    for (size_t i = 0; i < config.portals.size(); ++i) {
+      portal_system.setReadyAt(i, 0);
+    }
+    portal_system.setPly(0);
+    const bool parsed = position.empty() || notation.parse(position, board, portal_system, error);
+    game_manager.resetHistory();
+    return parsed;
+  }
+};
+
+struct GameServer::Connection {
+  uint64_t id = 0;
+  int fd = -1;
+  Session* session = nullptr;
+  std::string in;
+  std::string out;
+  bool busy = false;         // a go is running on the session
+  bool closed = false;
+  bool reading = true;       // EPOLLIN is armed
+  bool writing = false;      // EPOLLOUT is armed
+  bool close_after_flush = false;
+  // The client shut its side down: no more input, but a go still running
+  // replies before the connection closes
+  bool read_closed = false;
+};
+
+GameServer::GameServer(const GameConfig& config, const Options& options)
+    : config_(config), options_(options), notation_(config.pieces) {}
+
+GameServer::~GameServer() {
+  for (auto& entry : connections_) {
+    if (entry.second->busy) cancelSearch(*entry.second);
+  }
+  workers_.reset();  // joins, finishing the stopped searches
+  for (auto& entry : connections_) {
+    if (entry.second->fd >= 0) ::close(entry.second->fd);
+  }
+  if (listen_fd_ >= 0) {
+    ::close(listen_fd_);
+    if (!options_.unix_path.empty()) ::unlink(options_.unix_path.c_str());
+  }
+  if (wake_fd_ >= 0) ::close(wake_fd_);
+  if (epoll_fd_ >= 0) ::close(epoll_fd_);
+}
+
+bool GameServer::start(std::string* error) {
+  auto fail = [&](const std::string& what) {
+    if (error) *error = what + ": " + std::strerror(errno);
+    return false;
+  };
+  if (!options_.unix_path.empty()) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (options_.unix_path.size() >= sizeof(address.sun_path)) {
+      errno = ENAMETOOLONG;
+      return fail("socket path " + options_.unix_path);
+    }
+    std::memcpy(address.sun_path, options_.unix_path.c_str(), options_.unix_path.size() + 1);
+    listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) return fail("socket");
+    ::unlink(options_.unix_path.c_str());  // a stale socket from an earlier run
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+      return fail("bind " + options_.unix_path);
+    }
+  } else {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<uint16_t>(options_.tcp_port < 0 ? 0 : options_.tcp_port));
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) return fail("socket");
+    const int on = 1;
+    ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+      return fail("bind 127.0.0.1:" + std::to_string(options_.tcp_port));
+    }
+    socklen_t length = sizeof(address);
+    ::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &length);
+    port_ = ntohs(address.sin_port);
+  }
+  if (::listen(listen_fd_, SOMAXCONN) != 0) return fail("listen");
+
+  epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+  wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (epoll_fd_ < 0 || wake_fd_ < 0) return fail("epoll");
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.u64 = kListenerTag;
+  ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &event);
+  event.data.u64 = kWakeTag;
+  ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event);
+
+  workers_ = std::make_unique<ThreadPool>(options_.workers);
+  return true;
+}
+
+void GameServer::stop() {
+  stopping_.store(true);
+  const uint64_t one = 1;
+  [[maybe_unused]] ssize_t written = ::write(wake_fd_, &one, sizeof(one));
+}
+
+void GameServer::run() {
+  epoll_event events[256];
+  while (!stopping_.load()) {
+    const int count = ::epoll_wait(epoll_fd_, events, 256, -1);
+    if (count < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    for (int i = 0; i < count; ++i) {
+      const uint64_t tag = events[i].data.u64;
+      if (tag == kListenerTag) {
+        acceptConnections();
+        continue;
+      }
+      if (tag == kWakeTag) {
+        uint64_t value;
+        [[maybe_unused]] ssize_t got = ::read(wake_fd_, &value, sizeof(value));
+        drainCompletions();
+        continue;
+      }
+      auto found = connections_.find(tag);
+      if (found == connections_.end() || found->second->closed) continue;
+      Connection& connection = *found->second;
+      if (events[i].events & EPOLLIN) {
+        readFrom(connection);
+      } else if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+        close(connection);
+      }
+      if (!connection.closed && (events[i].events & EPOLLOUT)) {
+        flush(connection);
+      }
+    }
+    sweepClosed();
+  }
+}
+
+GameServer::Session* GameServer::acquireSession() {
+  Session* session;
+  if (!free_sessions_.empty()) {
+    session = free_sessions_.back();
+    free_sessions_.pop_back();
+  } else {
+    sessions_.push_back(std::make_unique<Session>(config_));
+    pooled_sessions_.store(sessions_.size(), std::memory_order_relaxed);
+    session = sessions_.back().get();
+  }
+  active_sessions_.fetch_add(1, std::memory_order_relaxed);
+  return session;
+}
+
+void GameServer::releaseSession(Session* session) {
+  free_sessions_.push_back(session);
+  active_sessions_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void GameServer::acceptConnections() {
+  while (true) {
+    const int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      return;  // EAGAIN, or out of descriptors until a connection closes
+    }
+    if (activeSessions() >= options_.max_sessions) {
+      static const char kFull[] = "error server full\n";
+      [[maybe_unused]] ssize_t written = ::write(fd, kFull, sizeof(kFull) - 1);
+      ::close(fd);
+      continue;
+    }
+    if (options_.unix_path.empty()) {
+      const int on = 1;
+      ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+    auto connection = std::make_unique<Connection>();
+    connection->id = next_connection_id_++;
+    connection->fd = fd;
+    connection->session = acquireSession();
+    connection->session->reset(config_, notation_, "", nullptr);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = connection->id;
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+    connections_.emplace(connection->id, std::move(connection));
+  }
+}
+
+void GameServer::readFrom(Connection& connection) {
+  char buffer[16 * 1024];
+  bool eof = false;
+  bool failed = false;
+  while (true) {
+    const ssize_t got = ::read(connection.fd, buffer, sizeof(buffer));
+    if (got > 0) {
+      connection.in.append(buffer, static_cast<size_t>(got));
+      if (static_cast<size_t>(got) < sizeof(buffer)) break;
+      continue;
+    }
+    if (got < 0 && errno == EINTR) continue;
+    eof = got == 0;
+    failed = got < 0 && errno != EAGAIN && errno != EWOULDBLOCK;
+    break;
+  }
+
+  size_t begin = 0;
+  for (size_t end; !connection.close_after_flush && (end = connection.in.find('\n', begin)) != std::string::npos;
+       begin = end + 1) {
+    size_t length = end - begin;
+    if (length > 0 && connection.in[end - 1] == '\r') --length;
+    handleLine(connection, connection.in.substr(begin, length));
+  }
+  connection.in.erase(0, begin);
+  if (connection.in.size() > kMaxLineBytes) failed = true;
+  if (failed) {
+    close(connection);
+    return;
+  }
+  if (eof) {
+    // A last line without its newline still counts
+    if (!connection.in.empty() && !connection.close_after_flush) handleLine(connection, connection.in);
+    connection.in.clear();
+    connection.read_closed = true;
+  }
+  flush(connection);
+}
+
+void GameServer::handleLine(Connection& connection, const std::string& line) {
+  try {
+    handleCommand(connection, line);
+  } catch (const std::exception& e) {
+    send(connection, std::string("error ") + e.what());
+  }
+}
+
+void GameServer::handleCommand(Connection& connection, const std::string& line) {
+  std::istringstream args(line);
+  std::string command;
+  args >> command;
+  Session& session = *connection.session;
+  if (command == "quit") {
+    send(connection, "bye");
+    connection.close_after_flush = true;
+    cancelSearch(connection);
+    return;
+  }
+  if (command == "isready") {
+    send(connection, "readyok");
+    return;
+  }
+  if (command == "stop") {
+    cancelSearch(connection);
+    return;
+  }
+  if (connection.busy) {
+    send(connection, "error busy");
+    return;
+  }
+
+  if (command == "new") {
+    std::string position, token;
+    while (args >> token) position += position.empty() ? token : " " + token;
+    const char* error = nullptr;
+    if (session.reset(config_, notation_, position, &error)) {
+      send(connection, "ok");
+    } else {
+      session.reset(config_, notation_, "", nullptr);
+      send(connection, std::string("error invalid position: ") + error);
+    }
+  } else if (command == "move") {
+    std::string text;
+    args >> text;
+    EncodedMove move;
+    if (!session.board.parseMove(text, move) || !session.game_manager.isLegalMove(move)) {
+      send(connection, "error illegal move " + text);
+      return;
+    }
+    session.game_manager.makeMove(move);
+    const bool white = session.board.isWhiteToMove();
+    if (!session.game_manager.hasLegalMove(white)) {
+      send(connection, session.game_manager.isInCheck(white) ? "ok checkmate" : "ok stalemate");
+    } else if (const char* reason = session.game_manager.getDrawReason()) {
+      send(connection, std::string("ok draw ") + reason);
+    } else {
+      send(connection, session.game_manager.isInCheck(white) ? "ok check" : "ok");
+    }
+  } else if (command == "undo") {
+    send(connection, session.game_manager.undoMove(false) ? "ok" : "error nothing to undo");
+  } else if (command == "position") {
+    const std::string text = notation_.toString(session.board, session.portal_system);
+    send(connection, text.empty() ? "error position has a piece type the notation cannot name" : "position " + text);
+  } else if (command == "legal") {
+    session.game_manager.generateLegalMoves(session.board.isWhiteToMove(), session.legal);
+    std::string reply = "legal";
+    for (EncodedMove move : session.legal) reply += " " + session.board.moveToNotation(move);
+    send(connection, reply);
+  } else if (command == "go") {
+    handleGo(connection, args);
+  } else if (!command.empty()) {
+    send(connection, "error unknown command " + command);
+  }
+}
+
+void GameServer::handleGo(Connection& connection, std::istream& args) {
+  Search::Limits limits;
+  std::string key;
+  int64_t value = 0;
+  while (args >> key >> value) {
+    if (key == "depth") limits.depth = static_cast<int>(value);
+    else if (key == "movetime") limits.movetime_ms = value;
+    else if (key == "nodes") limits.nodes = static_cast<size_t>(value);
+  }
+  if (limits.depth <= 0 && limits.movetime_ms <= 0 && limits.nodes == 0) limits.depth = kDefaultDepth;
+
+  connection.busy = true;
+  Session* session = connection.session;
+  // A stop while the go is still queued then holds when it starts
+  session->search.clearStop();
+  const uint64_t id = connection.id;
+  workers_->submit([this, session, id, limits] {
+    const Search::Result result = session->search.think(limits);
+    std::string reply = "bestmove 0000";
+    if (result.has_move) {
+      reply = "bestmove " + session->board.moveToNotation(result.move) + " score " + std::to_string(result.score) +
+              " depth " + std::to_string(result.depth) + " nodes " + std::to_string(session->search.nodes());
+    }
+    {
+      std::lock_guard<std::mutex> lock(completions_mutex_);
+      completions_.push_back(Completion{id, std::move(reply)});
+    }
+    const uint64_t one = 1;
+    [[maybe_unused]] ssize_t written = ::write(wake_fd_, &one, sizeof(one));
+  });
+}
+
+void GameServer::cancelSearch(Connection& connection) {
+  if (connection.busy) connection.session->search.stop();
+}
+
+void GameServer::drainCompletions() {
+  {
+    std::lock_guard<std::mutex> lock(completions_mutex_);
+    drained_.swap(completions_);
+  }
+  for (Completion& completion : drained_) {
+    auto found = connections_.find(completion.connection);
+    if (found == connections_.end()) continue;
+    Connection& connection = *found->second;
+    connection.busy = false;
+    if (connection.closed) {
+      closed_.push_back(connection.id);
+      continue;
+    }
+    send(connection, completion.reply);
+    flush(connection);
+  }
+  drained_.clear();
+}
+
+void GameServer::send(Connection& connection, const std::string& reply) {
+  connection.out += reply;
+  connection.out += '\n';
+}
+
+void GameServer::flush(Connection& connection) {
+  size_t sent = 0;
+  while (sent < connection.out.size()) {
+    const ssize_t written =
+        ::send(connection.fd, connection.out.data() + sent, connection.out.size() - sent, MSG_NOSIGNAL);
+    if (written > 0) {
+      sent += static_cast<size_t>(written);
+      continue;
+    }
+    if (written < 0 && errno == EINTR) continue;
+    if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+    close(connection);
+    return;
+  }
+  connection.out.erase(0, sent);
+  if (connection.out.empty() && (connection.close_after_flush || (connection.read_closed && !connection.busy))) {
+    close(connection);
+    return;
+  }
+  if (connection.out.size() > kMaxPendingOutput) {
+    close(connection);
+    return;
+  }
+  watch(connection, !connection.out.empty());
+}
+
+void GameServer::watch(Connection& connection, bool want_write) {
+  // Input stays readable at end of file, so a half-closed connection stops
+  // asking for it
+  const bool want_read = !connection.read_closed;
+  if (connection.writing == want_write && connection.reading == want_read) return;
+  connection.writing = want_write;
+  connection.reading = want_read;
+  epoll_event event{};
+  event.events = (want_read ? EPOLLIN : 0u) | (want_write ? EPOLLOUT : 0u);
+  event.data.u64 = connection.id;
+  ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, connection.fd, &event);
+}
+
+void GameServer::close(Connection& connection) {
+  if (connection.closed) return;
+  ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, connection.fd, nullptr);
+  ::close(connection.fd);
+  connection.fd = -1;
+  connection.closed = true;
+  if (connection.busy) {
+    cancelSearch(connection);  // dropped when its bestmove comes back
+  } else {
+    closed_.push_back(connection.id);
+  }
+}
+
+void GameServer::sweepClosed() {
+  for (uint64_t id : closed_) {
+    auto found = connections_.find(id);
+    if (found == connections_.end() || found->second->busy) continue;
+    releaseSession(found->second->session);
+    connections_.erase(found);
+  }
+  closed_.clear();
+}
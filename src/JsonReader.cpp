@@ -0,0 +1,290 @@
+// JsonReader.cpp
+#include "JsonReader.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <climits>
+#include <cstdlib>
+
+JsonReader::Error::Error(const std::string& message, size_t line, size_t column)
+    : std::runtime_error("line " + std::to_string(line) + ", column " + std::to_string(column) + ": " + message),
+      message(message),
+      line(line),
+      column(column) {}
+
+JsonReader::JsonReader(std::istream& in) : in_(&in), next_(buffer_), end_(buffer_) {}
+
+JsonReader::JsonReader(std::string_view text) : next_(text.data()), end_(text.data() + text.size()) {}
+
+int JsonReader::peekChar() {
+  if (next_ == end_) {
+    if (in_ == nullptr) return EOF;
+    in_->read(buffer_, kBufferSize);
+    const std::streamsize got = in_->gcount();
+    if (got <= 0) return EOF;
+    next_ = buffer_;
+    end_ = buffer_ + got;
+  }
+  return static_cast<unsigned char>(*next_);
+}
+
+int JsonReader::getChar() {
+  const int c = peekChar();
+  if (c == EOF) return EOF;
+  ++next_;
+  if (c == '\n') {
+    ++line_;
+    column_ = 1;
+  } else {
+    ++column_;
+  }
+  return c;
+}
+
+void JsonReader::skipWhitespace() {
+  for (int c = peekChar(); c == ' ' || c == '\t' || c == '\n' || c == '\r'; c = peekChar()) {
+    getChar();
+  }
+}
+
+void JsonReader::fail(const std::string& message) {
+  skipWhitespace();
+  throw Error(message, line_, column_);
+}
+
+std::string JsonReader::describe(int c) const {
+  if (c == EOF) return "end of input";
+  if (c == '"') return "a string";
+  if (c == '{') return "an object";
+  if (c == '[') return "an array";
+  if (c == 't' || c == 'f') return "a boolean";
+  if (c == 'n') return "null";
+  if (c == '-' || (c >= '0' && c <= '9')) return "a number";
+  return std::string("'") + static_cast<char>(c) + "'";
+}
+
+void JsonReader::expect(char c, const char* what) {
+  skipWhitespace();
+  const int found = peekChar();
+  if (found != c) {
+    fail(std::string("expected ") + what + ", found " + describe(found));
+  }
+  getChar();
+}
+
+JsonReader::Type JsonReader::peek() {
+  skipWhitespace();
+  switch (peekChar()) {
+    case '{': return Type::Object;
+    case '[': return Type::Array;
+    case '"': return Type::String;
+    case 't':
+    case 'f': return Type::Bool;
+    case 'n': return Type::Null;
+    case '-':
+    case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': case '8': case '9': return Type::Number;
+    default: fail("expected a value, found " + describe(peekChar()));
+  }
+}
+
+bool JsonReader::nextItem(char close) {
+  skipWhitespace();
+  if (open_.empty()) {
+    fail("no open object or array");
+  }
+  if (peekChar() == close) {
+    getChar();
+    open_.pop_back();
+    return false;
+  }
+  if (!open_.back()) {
+    expect(',', close == '}' ? "',' or '}'" : "',' or ']'");
+  }
+  open_.back() = false;
+  return true;
+}
+
+void JsonReader::beginObject() {
+  expect('{', "an object");
+  open_.push_back(true);
+}
+
+bool JsonReader::nextKey(std::string& key) {
+  if (!nextItem('}')) {
+    return false;
+  }
+  skipWhitespace();
+  if (peekChar() != '"') {
+    fail("expected a key, found " + describe(peekChar()));
+  }
+  readStringTo(key);
+  expect(':', "':'");
+  return true;
+}
+
+void JsonReader::beginArray() {
+  expect('[', "an array");
+  open_.push_back(true);
+}
+
+bool JsonReader::nextElement() { return nextItem(']'); }
+
+void JsonReader::readStringTo(std::string& out) {
+  out.clear();
+  getChar();  // opening quote
+  while (true) {
+    const int c = getChar();
+    if (c == EOF) fail("unterminated string");
+    if (c == '"') return;
+    if (c < 0x20) fail("control character in string");
+    if (c != '\\') {
+      out.push_back(static_cast<char>(c));
+      continue;
+    }
+    const int escape = getChar();
+    switch (escape) {
+      case '"': out.push_back('"'); break;
+      case '\\': out.push_back('\\'); break;
+      case '/': out.push_back('/'); break;
+      case 'b': out.push_back('\b'); break;
+      case 'f': out.push_back('\f'); break;
+      case 'n': out.push_back('\n'); break;
+      case 'r': out.push_back('\r'); break;
+      case 't': out.push_back('\t'); break;
+      case 'u': {
+        auto hex4 = [&] {
+          unsigned value = 0;
+          for (int i = 0; i < 4; ++i) {
+            const int h = getChar();
+            value <<= 4;
+            if (h >= '0' && h <= '9') value |= static_cast<unsigned>(h - '0');
+            else if (h >= 'a' && h <= 'f') value |= static_cast<unsigned>(h - 'a' + 10);
+            else if (h >= 'A' && h <= 'F') value |= static_cast<unsigned>(h - 'A' + 10);
+            else fail("invalid \\u escape");
+          }
+          return value;
+        };
+        unsigned code = hex4();
+        if (code >= 0xd800 && code < 0xdc00) {
+          if (getChar() != '\\' || getChar() != 'u') fail("unpaired surrogate in \\u escape");
+          const unsigned low = hex4();
+          if (low < 0xdc00 || low >= 0xe000) fail("unpaired surrogate in \\u escape");
+          code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+        }
+        // UTF-8
+        if (code < 0x80) {
+          out.push_back(static_cast<char>(code));
+        } else if (code < 0x800) {
+          out.push_back(static_cast<char>(0xc0 | code >> 6));
+          out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+        } else if (code < 0x10000) {
+          out.push_back(static_cast<char>(0xe0 | code >> 12));
+          out.push_back(static_cast<char>(0x80 | (code >> 6 & 0x3f)));
+          out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+        } else {
+          out.push_back(static_cast<char>(0xf0 | code >> 18));
+          out.push_back(static_cast<char>(0x80 | (code >> 12 & 0x3f)));
+          out.push_back(static_cast<char>(0x80 | (code >> 6 & 0x3f)));
+          out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+        }
+        break;
+      }
+      default: fail("invalid escape in string");
+    }
+  }
+}
+
+std::string JsonReader::readString() {
+  if (peek() != Type::String) {
+    fail("expected a string, found " + describe(peekChar()));
+  }
+  std::string text;
+  readStringTo(text);
+  return text;
+}
+
+// Number grammar: -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+void JsonReader::readNumberText() {
+  if (peek() != Type::Number) {
+    fail("expected a number, found " + describe(peekChar()));
+  }
+  scratch_.clear();
+  auto digits = [&] {
+    const size_t before = scratch_.size();
+    for (int c = peekChar(); c >= '0' && c <= '9'; c = peekChar()) {
+      scratch_.push_back(static_cast<char>(getChar()));
+    }
+    if (scratch_.size() == before) fail("malformed number");
+  };
+  if (peekChar() == '-') scratch_.push_back(static_cast<char>(getChar()));
+  if (peekChar() == '0') {
+    scratch_.push_back(static_cast<char>(getChar()));
+  } else {
+    digits();
+  }
+  if (peekChar() == '.') {
+    scratch_.push_back(static_cast<char>(getChar()));
+    digits();
+  }
+  if (peekChar() == 'e' || peekChar() == 'E') {
+    scratch_.push_back(static_cast<char>(getChar()));
+    if (peekChar() == '+' || peekChar() == '-') scratch_.push_back(static_cast<char>(getChar()));
+    digits();
+  }
+}
+
+double JsonReader::readNumber() {
+  readNumberText();
+  return std::strtod(scratch_.c_str(), nullptr);
+}
+
+int JsonReader::readInt() {
+  readNumberText();
+  const bool integral = scratch_.find_first_of(".eE") == std::string::npos;
+  errno = 0;
+  const long long value = integral ? std::strtoll(scratch_.c_str(), nullptr, 10)
+                                   : static_cast<long long>(std::strtod(scratch_.c_str(), nullptr));
+  if (errno == ERANGE || value < INT_MIN || value > INT_MAX) {
+    fail(scratch_ + " is out of range");
+  }
+  return static_cast<int>(value);
+}
+
+void JsonReader::readLiteral(const char* word) {
+  for (const char* c = word; *c; ++c) {
+    if (getChar() != *c) fail(std::string("invalid literal, expected ") + word);
+  }
+}
+
+bool JsonReader::readBool() {
+  if (peek() != Type::Bool) {
+    fail("expected a boolean, found " + describe(peekChar()));
+  }
+  const bool value = peekChar() == 't';
+  readLiteral(value ? "true" : "false");
+  return value;
+}
+
+void JsonReader::skipValue() {
+  switch (peek()) {
+    case Type::Object:
+      beginObject();
+      while (nextKey(scratch_)) skipValue();
+      break;
+    case Type::Array:
+      beginArray();
+      while (nextElement()) skipValue();
+      break;
+    case Type::String: readStringTo(scratch_); break;
+    case Type::Number: readNumberText(); break;
+    case Type::Bool: readBool(); break;
+    case Type::Null: readLiteral("null"); break;
+  }
+}
+
+void JsonReader::finish() {
+  skipWhitespace();
+  if (peekChar() != EOF) {
+    fail("unexpected " + describe(peekChar()) + " after the document");
+  }
+}
@@ -0,0 +1,200 @@
+// MateSolver.cpp
+#include "MateSolver.hpp"
+#include "ChessBoard.hpp"
+#include "GameManager.hpp"
+#include "PortalSystem.hpp"
+#include "Zobrist.hpp"
+#include <algorithm>
+
+MateSolver::MateSolver(ChessBoard& board, GameManager& game_manager, PortalSystem& portal_system, size_t table_mb)
+    : board_(board), game_manager_(game_manager), portal_system_(portal_system) {
+  size_t entries = 1;
+  while (entries * 2 * sizeof(Entry) <= std::max<size_t>(table_mb, 1) << 20) {
+    entries *= 2;
+  }
+  table_.resize(entries);
+}
+
+uint64_t MateSolver::nodeKey(int moves_left, bool attacker_to_move) const {
+  return board_.positionKey(portal_system_) ^
+         Zobrist::mix(0xdf9e'0000'0000'0000ull | (static_cast<uint64_t>(moves_left) << 1) | attacker_to_move);
+}
+
+MateSolver::Entry MateSolver::lookup(uint64_t key) const {
+  const Entry& entry = table_[key & (table_.size() - 1)];
+  return entry.key == key ? entry : Entry{key, 1, 1};
+}
+
+void MateSolver::store(uint64_t key, uint32_t phi, uint32_t delta) {
+  table_[key & (table_.size() - 1)] = {key, phi, delta};
+}
+
+// phi/delta are from the point of view of the side to move: phi = 0 means it
+// wins (attacker mates, or defender escapes), delta = 0 means it loses
+bool MateSolver::evaluateLeaf(int moves_left, bool attacker_to_move, std::vector<EncodedMove>& moves,
+                              uint32_t& phi, uint32_t& delta) {
+  const bool white = board_.isWhiteToMove();
+  bool side_wins;
+  if (moves_left == 0) {
+    // Out of attacker moves: only an already mated defender counts
+    side_wins = !attacker_to_move && (!game_manager_.isInCheck(white) || game_manager_.hasLegalMove(white));
+  } else {
+    game_manager_.generateLegalMoves(white, moves);
+    if (!moves.empty()) {
+      return false;
+    }
+    // Mated or stalemated: stalemate saves the defender and fails the attacker
+    side_wins = !attacker_to_move && !game_manager_.isInCheck(white);
+  }
+  phi = side_wins ? 0 : kInfinite;
+  delta = side_wins ? kInfinite : 0;
+  return true;
+}
+
+void MateSolver::search(int moves_left, bool attacker_to_move, uint32_t th_phi, uint32_t th_delta, int ply) {
+  ++nodes_;
+  const uint64_t key = nodeKey(moves_left, attacker_to_move);
+  std::vector<EncodedMove>& moves = moves_by_ply_[ply];
+  uint32_t phi, delta;
+  if (evaluateLeaf(moves_left, attacker_to_move, moves, phi, delta)) {
+    store(key, phi, delta);
+    return;
+  }
+
+  // Each attacker move uses up one of its moves; defender replies do not
+  const int child_moves_left = attacker_to_move ? moves_left - 1 : moves_left;
+  std::vector<uint64_t>& keys = keys_by_ply_[ply];
+  keys.clear();
+  for (EncodedMove move : moves) {
+    UndoRecord undo;
+    board_.applyMove(move, portal_system_, undo);
+    keys.push_back(nodeKey(child_moves_left, !attacker_to_move));
+    board_.undoMove(move, undo, portal_system_);
+  }
+
+  while (true) {
+    // phi = min over children of their delta, delta = sum of their phi
+    size_t best = 0;
+    uint32_t best_phi = 0;
+    uint32_t second_delta = kInfinite;
+    phi = kInfinite;
+    delta = 0;
+    for (size_t i = 0; i < moves.size(); ++i) {
+      const Entry child = lookup(keys[i]);
+      if (child.delta < phi) {
+        second_delta = phi;
+        phi = child.delta;
+        best = i;
+        best_phi = child.phi;
+      } else if (child.delta < second_delta) {
+        second_delta = child.delta;
+      }
+      delta = std::min(kInfinite, delta + child.phi);
+    }
+    if (phi >= th_phi || delta >= th_delta || nodes_ >= budget_) {
+      store(key, phi, delta);
+      return;
+    }
+
+    const uint64_t child_th_phi = static_cast<uint64_t>(th_delta) + best_phi - delta;
+    const uint32_t child_th_delta = std::min<uint32_t>(th_phi, second_delta == kInfinite ? kInfinite : second_delta + 1);
+    UndoRecord undo;
+    board_.applyMove(moves[best], portal_system_, undo);
+    search(child_moves_left, !attacker_to_move, static_cast<uint32_t>(std::min<uint64_t>(child_th_phi, kInfinite)),
+           child_th_delta, ply + 1);
+    board_.undoMove(moves[best], undo, portal_system_);
+  }
+}
+
+// Whether the attacker mates from the current position, from the attacker's side
+MateSolver::Status MateSolver::prove(int moves_left, bool attacker_to_move) {
+  search(moves_left, attacker_to_move, kInfinite, kInfinite, 0);
+  const Entry root = lookup(nodeKey(moves_left, attacker_to_move));
+  const uint32_t attacker_wins = attacker_to_move ? root.phi : root.delta;
+  const uint32_t defender_wins = attacker_to_move ? root.delta : root.phi;
+  if (attacker_wins == 0) return Status::Mate;
+  if (defender_wins == 0) return Status::NoMate;
+  return Status::Unknown;
+}
+
+// Shortest mate from an attacker-to-move position: its length, 0 if there is
+// none within max_moves, -1 if the budget ran out
+int MateSolver::mateDistance(int max_moves) {
+  for (int moves = 1; moves <= max_moves; ++moves) {
+    const Status status = prove(moves, true);
+    if (status == Status::Mate) return moves;
+    if (status == Status::Unknown) return -1;
+  }
+  return 0;
+}
+
+// Attacker moves that mate fastest, defender replies that hold out longest.
+// Called with the attacker to move and a proven mate in moves_left.
+bool MateSolver::extractLine(int moves_left, std::vector<EncodedMove>& line) {
+  std::vector<EncodedMove> attacks;
+  game_manager_.generateLegalMoves(board_.isWhiteToMove(), attacks);
+  for (EncodedMove attack : attacks) {
+    UndoRecord attack_undo;
+    board_.applyMove(attack, portal_system_, attack_undo);
+    if (prove(moves_left - 1, false) != Status::Mate) {
+      board_.undoMove(attack, attack_undo, portal_system_);
+      continue;
+    }
+    line.push_back(attack);
+
+    std::vector<EncodedMove> defences;
+    game_manager_.generateLegalMoves(board_.isWhiteToMove(), defences);
+    EncodedMove longest;
+    int longest_moves = 0;
+    for (EncodedMove defence : defences) {
+      UndoRecord undo;
+      board_.applyMove(defence, portal_system_, undo);
+      const int moves = mateDistance(moves_left - 1);
+      board_.undoMove(defence, undo, portal_system_);
+      if (moves < 0) {
+        longest_moves = -1;
+        break;
+      }
+      if (moves > longest_moves) {
+        longest = defence;
+        longest_moves = moves;
+      }
+    }
+    bool complete = defences.empty();
+    if (longest_moves > 0) {
+      UndoRecord undo;
+      board_.applyMove(longest, portal_system_, undo);
+      line.push_back(longest);
+      complete = extractLine(longest_moves, line);
+      board_.undoMove(longest, undo, portal_system_);
+    }
+    board_.undoMove(attack, attack_undo, portal_system_);
+    return complete;
+  }
+  return false;
+}
+
+MateSolver::Result MateSolver::solve(int max_moves, size_t node_budget) {
+  Result result;
+  max_moves = std::max(max_moves, 1);
+  moves_by_ply_.resize(std::max(moves_by_ply_.size(), static_cast<size_t>(2 * max_moves + 1)));
+  keys_by_ply_.resize(moves_by_ply_.size());
+  nodes_ = 0;
+  budget_ = node_budget;
+
+  const int moves = mateDistance(max_moves);
+  result.nodes = nodes_;
+  if (moves < 0) {
+    return result;
+  }
+  if (moves == 0) {
+    result.status = Status::NoMate;
+    return result;
+  }
+  result.status = Status::Mate;
+  result.mate_in = moves;
+  // Reading the line back re-proves subtrees, mostly from the table; it gets a budget of its own
+  nodes_ = 0;
+  result.line_complete = extractLine(moves, result.line);
+  return result;
+}
@@ -0,0 +1,409 @@
+// Mcts.cpp
+#include "Mcts.hpp"
+#include "ChessBoard.hpp"
+#include "GameManager.hpp"
+#include "MoveValidator.hpp"
+#include "PortalSystem.hpp"
+#include "RepetitionHistory.hpp"
+#include "Search.hpp"
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <new>
+#include <random>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace {
+// Value sums are fixed point so that threads can add them with one atomic op
+constexpr double kValueScale = 65536.0;
+
+enum NodeState : uint8_t { kUnexpanded, kExpanding, kExpanded, kTerminal };
+
+uint64_t workerSeed(uint64_t seed, unsigned index) {
+  uint64_t z = seed + 0x9e3779b97f4a7c15ull * (index + 1);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+} // namespace
+
+// Children of a node sit next to each other in the pool. `move`, `prior` and
+// `terminal_value` are written before the parent's (or the node's own) state
+// is published with a release store and never change afterwards.
+struct Mcts::Node {
+  EncodedMove move;
+  float prior = 0.0f;
+  float terminal_value = 0.5f;            // for the side to move, once kTerminal
+  std::atomic<uint32_t> visits{0};
+  std::atomic<uint32_t> virtual_loss{0};  // playouts currently below this node
+  std::atomic<int64_t> value{0};          // results for the side that played `move`
+  std::atomic<uint32_t> first_child{0};
+  std::atomic<uint32_t> child_count{0};
+  std::atomic<uint8_t> state{kUnexpanded};
+
+  Node(EncodedMove played, float move_prior) : move(played), prior(move_prior) {}
+};
+
+void Mcts::FreeNodes::operator()(Node* nodes) const {
+  static_assert(std::is_trivially_destructible_v<Node>, "pool nodes are reused without being destroyed");
+  ::operator delete(nodes);
+}
+
+// A thread's private copy of the position; moves along the tree path and the
+// rollout are played on it and undone after every playout
+struct Mcts::Worker {
+  ChessBoard board;
+  PortalSystem portal_system;
+  MoveValidator validator;
+  GameManager game_manager;
+  RepetitionHistory line;
+  std::mt19937_64 rng;
+  std::vector<EncodedMove> moves;
+  std::vector<double> weights;
+  std::vector<uint32_t> path;
+  std::vector<std::pair<EncodedMove, UndoRecord>> played;
+
+  Worker(const ChessBoard& source, const PortalSystem& portals, const RepetitionHistory& history, uint64_t seed)
+      : board(source), portal_system(portals), game_manager(board, validator, portal_system), line(history),
+        rng(seed) {
+    game_manager.setParallelStatusThreshold(ChessBoard::kMaxBoardSize + 1);
+  }
+
+  void play(EncodedMove move) {
+    played.emplace_back(move, UndoRecord{});
+    board.applyMove(move, portal_system, played.back().second);
+    line.push(board.positionKey(portal_system), game_manager.isIrreversible(move, played.back().second));
+  }
+
+  void unwind() {
+    while (!played.empty()) {
+      line.pop();
+      board.undoMove(played.back().first, played.back().second, portal_system);
+      played.pop_back();
+    }
+  }
+
+  bool drawnByRule() const {
+    return line.repetitionCount() > 0 || line.halfmoveClock() >= GameManager::kFiftyMoveRulePlies;
+  }
+};
+
+Mcts::Mcts(ChessBoard& board, GameManager& game_manager, PortalSystem& portal_system)
+    : Mcts(board, game_manager, portal_system, Config()) {}
+
+Mcts::Mcts(ChessBoard& board, GameManager& game_manager, PortalSystem& portal_system, const Config& config)
+    : board_(board), game_manager_(game_manager), portal_system_(portal_system), config_(config) {
+  config_.threads = std::max(config_.threads, 1u);
+}
+
+Mcts::~Mcts() = default;
+
+double Mcts::policyWeight(EncodedMove move, const ChessBoard& board, const PortalSystem& portal_system) {
+  const Position to = board.squarePosition(move.to());
+  double weight = 1.0 + Search::pieceValue(board.getSquare(to).kind) / 50.0;
+  if (move.kind() == MoveKind::EnPassant) weight += 2.0;
+  if (move.kind() == MoveKind::Promotion) weight += move.promotion() == PromotionPiece::Queen ? 16.0 : 1.0;
+  for (const auto& portal : portal_system.getPortals()) {
+    if (portal.positions.entry.x == to.x && portal.positions.entry.y == to.y) weight += 2.0;
+  }
+  return weight;
+}
+
+int Mcts::valueToCentipawns(double value) {
+  value = std::clamp(value, 0.001, 0.999);
+  return static_cast<int>(std::lround(400.0 * std::log10(value / (1.0 - value))));
+}
+
+void Mcts::stop() {
+  stop_requested_.store(true, std::memory_order_relaxed);
+}
+
+void Mcts::clearStop() {
+  stop_requested_.store(false, std::memory_order_relaxed);
+  ponderhit_.store(false, std::memory_order_relaxed);
+}
+
+void Mcts::ponderhit() {
+  ponderhit_at_.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+  ponderhit_.store(true, std::memory_order_release);
+}
+
+int64_t Mcts::limitedMs(const Limits& limits) const {
+  if (!limits.ponder) {
+    return elapsedMs();
+  }
+  if (!ponderhit_.load(std::memory_order_acquire)) {
+    return -1;
+  }
+  const std::chrono::steady_clock::duration since_hit(
+      std::chrono::steady_clock::now().time_since_epoch().count() - ponderhit_at_.load(std::memory_order_relaxed));
+  return std::chrono::duration_cast<std::chrono::milliseconds>(since_hit).count();
+}
+
+int64_t Mcts::elapsedMs() const {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started_).count();
+}
+
+Mcts::Result Mcts::think(const Limits& limits) {
+  Result result;
+  std::vector<EncodedMove> root_moves;
+  game_manager_.generateLegalMoves(board_.isWhiteToMove(), root_moves);
+  if (root_moves.empty()) {
+    return result;
+  }
+  result.move = root_moves.front();
+  result.has_move = true;
+  if (root_moves.size() == 1) {
+    return result;  // nothing to decide
+  }
+
+  // The pool is allocated once and reused; it must at least hold the root's children
+  size_t capacity = std::clamp(config_.node_capacity, root_moves.size() + 1,
+                               static_cast<size_t>(std::numeric_limits<uint32_t>::max()));
+  if (capacity != capacity_) {
+    nodes_.reset(static_cast<Node*>(::operator new(capacity * sizeof(Node))));
+    capacity_ = capacity;
+  }
+  new (&nodes_[0]) Node(EncodedMove(), 1.0f);
+  used_.store(1, std::memory_order_relaxed);
+  started_playouts_.store(0, std::memory_order_relaxed);
+  finished_playouts_.store(0, std::memory_order_relaxed);
+  started_ = std::chrono::steady_clock::now();
+
+  if (config_.threads == 1) {
+    runWorker(0, limits);
+  } else {
+    if (!pool_ || pool_->size() != config_.threads) {
+      pool_ = std::make_unique<ThreadPool>(config_.threads);
+    }
+    std::vector<std::future<void>> workers;
+    for (unsigned t = 0; t < config_.threads; ++t) {
+      workers.push_back(pool_->submit([this, t, &limits] { runWorker(t, limits); }));
+    }
+    for (auto& worker : workers) {
+      worker.get();
+    }
+  }
+
+  // The most visited move is the most trusted one
+  const Node& root = nodes_[0];
+  if (root.state.load(std::memory_order_acquire) == kExpanded) {
+    const uint32_t first = root.first_child.load(std::memory_order_relaxed);
+    const uint32_t count = root.child_count.load(std::memory_order_relaxed);
+    for (uint32_t i = first; i < first + count; ++i) {
+      const uint32_t visits = nodes_[i].visits.load(std::memory_order_relaxed);
+      if (visits > result.visits) {
+        result.move = nodes_[i].move;
+        result.visits = visits;
+        result.value = nodes_[i].value.load(std::memory_order_relaxed) / kValueScale / visits;
+      }
+    }
+  }
+  result.playouts = finished_playouts_.load(std::memory_order_relaxed);
+  result.nodes = std::min(used_.load(std::memory_order_relaxed), capacity_);
+  return result;
+}
+
+void Mcts::runWorker(unsigned index, const Limits& limits) {
+  Worker worker(board_, portal_system_, game_manager_.getRepetitionHistory(), workerSeed(config_.seed, index));
+  while (!stop_requested_.load(std::memory_order_relaxed)) {
+    const int64_t limited_ms = limitedMs(limits);
+    if (limited_ms < 0) {
+      playout(worker);  // pondering: no limits yet
+      finished_playouts_.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+    if (limits.playouts > 0 && started_playouts_.fetch_add(1, std::memory_order_relaxed) >= limits.playouts) {
+      break;
+    }
+    if (limits.movetime_ms > 0 && limited_ms >= limits.movetime_ms) {
+      break;
+    }
+    playout(worker);
+    finished_playouts_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void Mcts::playout(Worker& worker) {
+  worker.path.clear();
+  worker.path.push_back(0);
+  Node* node = &nodes_[0];
+  node->virtual_loss.fetch_add(1, std::memory_order_relaxed);
+
+  double result;  // for the side to move at the end of the path
+  while (true) {
+    uint8_t state = node->state.load(std::memory_order_acquire);
+    bool expanded_here = false;
+    if (state == kUnexpanded && node->state.compare_exchange_strong(state, kExpanding, std::memory_order_acq_rel)) {
+      expand(worker, *node);
+      state = node->state.load(std::memory_order_acquire);
+      expanded_here = true;
+    }
+    if (state == kTerminal) {
+      result = node->terminal_value;
+      break;
+    }
+    if (expanded_here || state != kExpanded) {
+      // A new leaf, one another thread is expanding, or the pool is full
+      result = rollout(worker, worker.board.isWhiteToMove());
+      break;
+    }
+    Node& child = select(*node);
+    child.virtual_loss.fetch_add(1, std::memory_order_relaxed);
+    worker.play(child.move);
+    worker.path.push_back(static_cast<uint32_t>(&child - nodes_.get()));
+    node = &child;
+  }
+
+  // A node's value belongs to the side that played its move, the opponent of
+  // the side to move there; the result flips at every level on the way up
+  for (auto it = worker.path.rbegin(); it != worker.path.rend(); ++it) {
+    Node& visited = nodes_[*it];
+    result = 1.0 - result;
+    visited.value.fetch_add(std::llround(result * kValueScale), std::memory_order_relaxed);
+    visited.visits.fetch_add(1, std::memory_order_relaxed);
+    visited.virtual_loss.fetch_sub(1, std::memory_order_relaxed);
+  }
+  worker.unwind();
+}
+
+// Called by the thread that moved `node` to kExpanding; leaves it kExpanded,
+// kTerminal, or kUnexpanded again when the pool has no room for its children
+// or a stop() cut its move generation short
+void Mcts::expand(Worker& worker, Node& node) {
+  const bool at_root = &node == &nodes_[0];
+  const bool white = worker.board.isWhiteToMove();
+  std::vector<EncodedMove>& moves = worker.moves;
+  // The root is the game position itself, which the game already checked for draws
+  if (!at_root && worker.drawnByRule()) {
+    node.terminal_value = 0.5f;
+    node.state.store(kTerminal, std::memory_order_release);
+    return;
+  }
+  if (!worker.game_manager.generateLegalMoves(white, moves, stop_requested_)) {
+    node.state.store(kUnexpanded, std::memory_order_release);
+    return;
+  }
+  if (moves.empty()) {
+    node.terminal_value = worker.game_manager.isInCheck(white) ? 0.0f : 0.5f;
+    node.state.store(kTerminal, std::memory_order_release);
+    return;
+  }
+
+  const size_t count = moves.size();
+  size_t first = used_.load(std::memory_order_relaxed);
+  if (first + count <= capacity_) {
+    first = used_.fetch_add(count, std::memory_order_relaxed);
+  }
+  if (first + count > capacity_) {
+    node.state.store(kUnexpanded, std::memory_order_release);
+    return;
+  }
+
+  double total = 0.0;
+  std::vector<double>& weights = worker.weights;
+  weights.clear();
+  if (config_.selection == Selection::Puct) {
+    for (EncodedMove move : moves) {
+      weights.push_back(policyWeight(move, worker.board, worker.portal_system));
+      total += weights.back();
+    }
+  }
+  for (size_t i = 0; i < count; ++i) {
+    new (&nodes_[first + i]) Node(moves[i], total > 0.0 ? static_cast<float>(weights[i] / total) : 0.0f);
+  }
+  node.first_child.store(static_cast<uint32_t>(first), std::memory_order_relaxed);
+  node.child_count.store(static_cast<uint32_t>(count), std::memory_order_relaxed);
+  node.state.store(kExpanded, std::memory_order_release);
+}
+
+// UCT: mean + c * sqrt(ln N / n), unvisited children first.
+// PUCT: mean + c * prior * sqrt(N) / (1 + n), unvisited children valued at
+// the parent's mean. Virtual losses count as visits that scored nothing.
+Mcts::Node& Mcts::select(const Node& node) const {
+  const uint32_t first = node.first_child.load(std::memory_order_relaxed);
+  const uint32_t count = node.child_count.load(std::memory_order_relaxed);
+  const uint32_t parent_visits = node.visits.load(std::memory_order_relaxed);
+  const double parent_n =
+      std::max<double>(1.0, parent_visits + node.virtual_loss.load(std::memory_order_relaxed));
+  // The parent's mean is for the side that moved into it; its children belong to the other side
+  const double unvisited_value =
+      parent_visits > 0 ? 1.0 - node.value.load(std::memory_order_relaxed) / kValueScale / parent_visits : 0.5;
+  const double log_n = std::log(parent_n);
+  const double sqrt_n = std::sqrt(parent_n);
+
+  uint32_t best = first;
+  double best_score = -std::numeric_limits<double>::infinity();
+  for (uint32_t i = first; i < first + count; ++i) {
+    const Node& child = nodes_[i];
+    const double n = child.visits.load(std::memory_order_relaxed) + child.virtual_loss.load(std::memory_order_relaxed);
+    double score;
+    if (config_.selection == Selection::Uct) {
+      if (n == 0) {
+        return nodes_[i];
+      }
+      score = child.value.load(std::memory_order_relaxed) / kValueScale / n + config_.exploration * std::sqrt(log_n / n);
+    } else {
+      const double mean = n > 0 ? child.value.load(std::memory_order_relaxed) / kValueScale / n : unvisited_value;
+      score = mean + config_.exploration * child.prior * sqrt_n / (1.0 + n);
+    }
+    if (score > best_score) {
+      best_score = score;
+      best = i;
+    }
+  }
+  return nodes_[best];
+}
+
+// Plays random (or policy-weighted) legal moves until the game ends or
+// rollout_plies pass, then scores the material balance on the Elo logistic
+double Mcts::rollout(Worker& worker, bool leaf_white) {
+  double white_score = 0.5;
+  for (int ply = 0;; ++ply) {
+    // A stop() scores the unfinished rollout as a draw rather than wait for it
+    if (worker.drawnByRule() || stop_requested_.load(std::memory_order_relaxed)) {
+      break;
+    }
+    const bool white = worker.board.isWhiteToMove();
+    if (!worker.game_manager.generateLegalMoves(white, worker.moves, stop_requested_)) {
+      break;
+    }
+    if (worker.moves.empty()) {
+      if (worker.game_manager.isInCheck(white)) {
+        white_score = white ? 0.0 : 1.0;
+      }
+      break;
+    }
+    if (ply >= config_.rollout_plies) {
+      int material = 0;
+      worker.board.forEachPiece([&](const Position&, const ChessBoard::Square& square) {
+        material += square.is_white ? Search::pieceValue(square.kind) : -Search::pieceValue(square.kind);
+        return false;
+      });
+      white_score = 1.0 / (1.0 + std::pow(10.0, -material / 400.0));
+      break;
+    }
+
+    const std::vector<EncodedMove>& moves = worker.moves;
+    size_t pick = 0;
+    if (config_.rollout == Rollout::Random) {
+      pick = std::uniform_int_distribution<size_t>(0, moves.size() - 1)(worker.rng);
+    } else {
+      double total = 0.0;
+      worker.weights.clear();
+      for (EncodedMove move : moves) {
+        total += policyWeight(move, worker.board, worker.portal_system);
+        worker.weights.push_back(total);
+      }
+      const double target = std::uniform_real_distribution<double>(0.0, total)(worker.rng);
+      pick = std::min<size_t>(std::upper_bound(worker.weights.begin(), worker.weights.end(), target) -
+                                  worker.weights.begin(),
+                              moves.size() - 1);
+    }
+    worker.play(moves[pick]);
+  }
+  return leaf_white ? white_score : 1.0 - white_score;
+}
@@ -1,5 +1,6 @@
 // MoveValidator.cpp
 #include "MoveValidator.hpp"
+#include "AttackMap.hpp"
 #include <algorithm>
 #include <cmath>
 #include <cctype>
@@ -13,15 +14,116 @@ std::string MoveValidator::toLowerCase(const std::string& str) const {
   return lower;
 }
 
-std::vector<Position> MoveValidator::getMoveEdges(const std::string& piece_lower, 
-                                                  const Position& pos, bool is_white, 
-                                                  const ChessBoard& board) const {
-    std::vector<Position> edges;
-    int forward = is_white ? 1 : -1;  // White moves up, black moves down
+namespace {
+
+// Direction tables shared by every call instead of being rebuilt per move
+constexpr Position kKnightSteps[] = {
+    {2, 1}, {2, -1}, {-2, 1}, {-2, -1}, {1, 2}, {1, -2}, {-1, 2}, {-1, -2}
+};
+constexpr Position kDiagonals[] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+constexpr Position kOrthogonals[] = {{0, 1}, {0, -1}, {1, 0}, {-1, 0}};
+constexpr Position kAllDirections[] = {
+    {0, 1}, {0, -1}, {1, 0}, {-1, 0},
+    {1, 1}, {1, -1}, {-1, 1}, {-1, -1}
+};
+
+template <size_t N>
+void addSlides(const Position (&directions)[N], const Position& pos, const ChessBoard& board,
+               std::pmr::vector<Position>& edges) {
+    for (const auto& dir : directions) {
+        const int reach = board.rayLength(pos, dir.x, dir.y);
+        for (int i = 1; i <= reach; ++i) {
+            edges.push_back({pos.x + i * dir.x, pos.y + i * dir.y});
+        }
+    }
+}
+
+template <size_t N>
+void addSteps(const Position (&steps)[N], const Position& pos, bool is_white, const ChessBoard& board,
+              std::pmr::vector<Position>& edges) {
+    for (const auto& step : steps) {
+        Position p = {pos.x + step.x, pos.y + step.y};
+        if (board.isInBounds(p)) {
+            const auto& target_square = board.getSquare(p);
+            if (target_square.is_empty() || target_square.is_white != is_white) {
+                edges.push_back(p);
+            }
+        }
+    }
+}
+
+// Push every set bit of a line mask as a square; `at` maps the bit index to a square
+template <typename At>
+void addMaskBits(uint32_t bits, At at, std::pmr::vector<Position>& edges) {
+    while (bits) {
+        edges.push_back(at(__builtin_ctz(bits)));
+        bits &= bits - 1;
+    }
+}
+
+// Same squares as addSlides, read off the board's occupancy masks
+void addMaskedSlides(bool straight, bool diagonal, const Position& pos, const ChessBoard& board,
+                     std::pmr::vector<Position>& edges) {
+    const int n = board.getBoardSize();
+    const uint32_t line = board.lineMask();
+    const int x = pos.x, y = pos.y;
+    if (straight) {
+        addMaskBits(AttackMap::lineAttacks(board.rankOccupancy(y), 1u << x, line),
+                    [y](int bx) { return Position{bx, y}; }, edges);
+        addMaskBits(AttackMap::lineAttacks(board.fileOccupancy(x), 1u << y, line),
+                    [x](int by) { return Position{x, by}; }, edges);
+    }
+    if (diagonal) {
+        // Diagonal squares keep x - y constant, anti-diagonal squares x + y
+        const int k = x - y;
+        const uint32_t diag_line = line & (line << std::max(0, k)) & (line >> std::max(0, -k));
+        addMaskBits(AttackMap::lineAttacks(board.diagonalOccupancy(k + n - 1), 1u << x, diag_line),
+                    [k](int bx) { return Position{bx, bx - k}; }, edges);
+        const int a = x + y;
+        const uint32_t anti_line = line & (line << std::max(0, a - (n - 1))) & (line >> std::max(0, n - 1 - a));
+        addMaskBits(AttackMap::lineAttacks(board.antiDiagonalOccupancy(a), 1u << x, anti_line),
+                    [a](int bx) { return Position{bx, a - bx}; }, edges);
+    }
+}
+
+// Whether a slider of `kind` reaches `end` from `start` along one open ray,
+// without listing the ray's squares
+bool slidesTo(PieceKind kind, const Position& start, const Position& end, const ChessBoard& board) {
+    const int dx = end.x - start.x;
+    const int dy = end.y - start.y;
+    const bool straight = dx == 0 || dy == 0;
+    const bool diagonal = std::abs(dx) == std::abs(dy);
+    if ((dx == 0 && dy == 0) || (!straight && !diagonal)) return false;
+    if (kind == PieceKind::Rook && !straight) return false;
+    if (kind == PieceKind::Bishop && !diagonal) return false;
+    const int distance = std::max(std::abs(dx), std::abs(dy));
+    return board.rayLength(start, (dx > 0) - (dx < 0), (dy > 0) - (dy < 0)) >= distance;
+}
 
-    std::string piece_type = toLowerCase(piece_lower);
+bool equalsIgnoreCase(const std::string& a, const std::string& b) {
+    return a.size() == b.size() &&
+           std::equal(a.begin(), a.end(), b.begin(), [](unsigned char l, unsigned char r) {
+               return std::tolower(l) == std::tolower(r);
+           });
+}
 
-    if (piece_type == "pawn") {
+bool containsPosition(const std::pmr::vector<Position>& positions, const Position& target) {
+    for (const auto& p : positions) {
+        if (p.x == target.x && p.y == target.y) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+void MoveValidator::getMoveEdges(PieceKind kind, const Position& pos, bool is_white,
+                                 const ChessBoard& board, std::pmr::vector<Position>& edges) const {
+    int forward = is_white ? 1 : -1;  // White moves up, black moves down
+
+    switch (kind) {
+    case PieceKind::Pawn: {
         // Normal forward movement
         Position forward_one = {pos.x, pos.y + forward};
         if (board.isInBounds(forward_one) && board.getSquare(forward_one).is_empty()) {
@@ -30,20 +132,15 @@ std::vector<Position> MoveValidator::getMoveEdges(const std::string& piece_lower
             // First move: 2 squares forward
             if ((is_white && pos.y == 1) || (!is_white && pos.y == 6)) {
                 Position forward_two = {pos.x, pos.y + 2 * forward};
-                if (board.isInBounds(forward_two) && board.getSquare(forward_two).is_empty() &&
-                    board.getSquare(forward_one).is_empty()) {
+                if (board.isInBounds(forward_two) && board.getSquare(forward_two).is_empty()) {
                     edges.push_back(forward_two);
                 }
             }
         }
 
         // Diagonal capture moves
-        std::vector<Position> captures = {
-            {pos.x - 1, pos.y + forward},
-            {pos.x + 1, pos.y + forward}
-        };
-
-        for (const auto& capture : captures) {
+        for (int side : {-1, 1}) {
+            Position capture = {pos.x + side, pos.y + forward};
             if (board.isInBounds(capture)) {
                 const auto& target = board.getSquare(capture);
                 if (!target.is_empty() && target.is_white != is_white) {
@@ -51,72 +148,29 @@ std::vector<Position> MoveValidator::getMoveEdges(const std::string& piece_lower
                 }
             }
         }
-    } else if (piece_type == "knight") {
-        std::vector<std::pair<int, int>> knight_moves = {
-            {2, 1}, {2, -1}, {-2, 1}, {-2, -1}, {1, 2}, {1, -2}, {-1, 2}, {-1, -2}
-        };
-        for (const auto& move : knight_moves) {
-            Position p = {pos.x + move.first, pos.y + move.second};
-            if (board.isInBounds(p)) {
-                const auto& target_square = board.getSquare(p);
-                if (target_square.is_empty() || target_square.is_white != is_white) {
-                    edges.push_back(p);
-                }
-            }
-        }
-    } else if (piece_type == "bishop") {
-        std::vector<std::pair<int, int>> directions = {{1,1}, {1,-1}, {-1,1}, {-1,-1}};
-        for (const auto& dir : directions) {
-            for (int i = 1; i < board.getBoardSize(); ++i) {
-                Position p = {pos.x + i * dir.first, pos.y + i * dir.second};
-                if (!board.isInBounds(p)) break;
-                const auto& target = board.getSquare(p);
-                edges.push_back(p);
-                if (!target.is_empty()) break;
-            }
-        }
-    } else if (piece_type == "rook") {
-        std::vector<std::pair<int, int>> directions = {{0,1}, {0,-1}, {1,0}, {-1,0}};
-        for (const auto& dir : directions) {
-            for (int i = 1; i < board.getBoardSize(); ++i) {
-                Position p = {pos.x + i * dir.first, pos.y + i * dir.second};
-                if (!board.isInBounds(p)) break;
-                const auto& target = board.getSquare(p);
-                edges.push_back(p);
-                if (!target.is_empty()) break;
-            }
-        }
-    } else if (piece_type == "queen") {
-        std::vector<std::pair<int, int>> directions = {
-            {0,1}, {0,-1}, {1,0}, {-1,0},
-            {1,1}, {1,-1}, {-1,1}, {-1,-1}
-        };
-        for (const auto& dir : directions) {
-            for (int i = 1; i < board.getBoardSize(); ++i) {
-                Position p = {pos.x + i * dir.first, pos.y + i * dir.second};
-                if (!board.isInBounds(p)) break;
-                const auto& target = board.getSquare(p);
-                edges.push_back(p);
-                if (!target.is_empty()) break;
-            }
-        }
-    } else if (piece_type == "king") {
-        std::vector<std::pair<int, int>> directions = {
-            {0,1}, {0,-1}, {1,0}, {-1,0},
-            {1,1}, {1,-1}, {-1,1}, {-1,-1}
-        };
-        for (const auto& dir : directions) {
-            Position p = {pos.x + dir.first, pos.y + dir.second};
-            if (board.isInBounds(p)) {
-                const auto& target_square = board.getSquare(p);
-                if (target_square.is_empty() || target_square.is_white != is_white) {
-                    edges.push_back(p);
-                }
-            }
-        }
+        break;
+    }
+    case PieceKind::Knight:
+        addSteps(kKnightSteps, pos, is_white, board, edges);
+        break;
+    case PieceKind::Bishop:
+        if (board.hasLineMasks()) addMaskedSlides(false, true, pos, board, edges);
+        else addSlides(kDiagonals, pos, board, edges);
+        break;
+    case PieceKind::Rook:
+        if (board.hasLineMasks()) addMaskedSlides(true, false, pos, board, edges);
+        else addSlides(kOrthogonals, pos, board, edges);
+        break;
+    case PieceKind::Queen:
+        if (board.hasLineMasks()) addMaskedSlides(true, true, pos, board, edges);
+        else addSlides(kAllDirections, pos, board, edges);
+        break;
+    case PieceKind::King:
+        addSteps(kAllDirections, pos, is_white, board, edges);
+        break;
+    default:
+        break;
     }
-
-    return edges;
 }
 
 bool MoveValidator::bfsValidateMove(const std::string& piece_lower, const Position& start, 
@@ -133,19 +187,21 @@ bool MoveValidator::bfsValidateMove(const std::string& piece_lower, const Positi
     return false;
   }
 
-  // BFS için kuyruk ve ziyaret edilen kareler
-  std::queue<Position> queue;
-  std::unordered_set<std::string> visited;
-  auto posToString = [](const Position& p) { 
-    return std::to_string(p.x) + "," + std::to_string(p.y); 
-  };
+  // BFS için kuyruk ve ziyaret edilen kareler (arena üzerinde)
+  ScratchArena& arena = ScratchArena::forThread();
+  ScratchArena::Scope scope(arena);
+  const PieceKind kind = board.getSquare(start).kind;
+  const int size = board.getBoardSize();
+  std::pmr::vector<Position> queue(&arena);
+  std::pmr::vector<uint8_t> visited(static_cast<size_t>(size) * size, 0, &arena);
+  std::pmr::vector<Position> edges(&arena);
+  edges.reserve(4 * size);
 
-  queue.push(start);
-  visited.insert(posToString(start));
+  queue.push_back(start);
+  visited[board.squareIndex(start)] = 1;
 
-  while (!queue.empty()) {
-    Position current = queue.front();
-    queue.pop();
+  for (size_t head = 0; head < queue.size(); ++head) {
+    Position current = queue[head];
 
     // Hedefe ulaşıldıysa
     if (current.x == end.x && current.y == end.y) {
@@ -153,25 +209,22 @@ bool MoveValidator::bfsValidateMove(const std::string& piece_lower, const Positi
     }
 
     // Taşın hareket kenarları
-    auto edges = getMoveEdges(piece_lower, current, is_white, board);
+    edges.clear();
+    getMoveEdges(kind, current, is_white, board, edges);
 
     // Portal bağlantıları
     if (piece_lower == "teleporter" && portal_system.isPortalMove(current, end)) {
       Position portal_exit = end; // Portal çıkış pozisyonu
-      if (board.isInBounds(portal_exit)) {
-        std::string exit_str = posToString(portal_exit);
-        if (visited.find(exit_str) == visited.end()) {
-          queue.push(portal_exit);
-          visited.insert(exit_str);
-        }
+      if (board.isInBounds(portal_exit) && !visited[board.squareIndex(portal_exit)]) {
+        queue.push_back(portal_exit);
+        visited[board.squareIndex(portal_exit)] = 1;
       }
     }
 
     // Normal hareket kenarları
     for (const auto& next : edges) {
       if (!board.isInBounds(next)) continue;
-      std::string next_str = posToString(next);
-      if (visited.find(next_str) != visited.end()) continue;
+      if (visited[board.squareIndex(next)]) continue;
 
       // Hedef kareye engel kontrolü
       if (!board.getSquare(next).is_empty() && 
@@ -179,8 +232,8 @@ bool MoveValidator::bfsValidateMove(const std::string& piece_lower, const Positi
         continue; // Engelle karşılaşılırsa bu yoldan devam etme
       }
 
-      queue.push(next);
-      visited.insert(next_str);
+      queue.push_back(next);
+      visited[board.squareIndex(next)] = 1;
     }
   }
 
@@ -190,7 +243,8 @@ bool MoveValidator::bfsValidateMove(const std::string& piece_lower, const Positi
 bool MoveValidator::isValidMove(const std::string& piece, const Position& start, 
                                const Position& end, bool is_white, 
                                const ChessBoard& board, 
-                               const PortalSystem& portal_system) const {
+                               const PortalSystem& portal_system,
+                               bool verbose) const {
     // Başlangıç pozisyonunu kontrol et
     if (!board.isInBounds(start)) {
         return false;
@@ -199,7 +253,7 @@ bool MoveValidator::isValidMove(const std::string& piece, const Position& start,
     // Başlangıç karesindeki taşı kontrol et
     const auto& start_square = board.getSquare(start);
     if (start_square.is_empty() || 
-        toLowerCase(start_square.piece) != toLowerCase(piece) || 
+        !equalsIgnoreCase(board.pieceName(start_square), piece) || 
         start_square.is_white != is_white) {
         return false;
     }
@@ -215,15 +269,19 @@ bool MoveValidator::isValidMove(const std::string& piece, const Position& start,
         return false;
     }
 
-    std::string piece_lower = toLowerCase(piece);
+    const PieceKind kind = start_square.kind;
+    ScratchArena& arena = ScratchArena::forThread();
+    ScratchArena::Scope scope(arena);
+    std::pmr::vector<Position> valid_moves(&arena);
+    valid_moves.reserve(8 * board.getBoardSize());
 
     // Rok kontrolü
-    if (piece_lower == "king" && abs(end.x - start.x) == 2 && end.y == start.y) {
+    if (kind == PieceKind::King && abs(end.x - start.x) == 2 && end.y == start.y) {
         return validateCastling(start, end, is_white, board);
     }
 
     // Piyon özel hareketleri
-    if (piece_lower == "pawn") {
+    if (kind == PieceKind::Pawn) {
         // En passant kontrolü
         if (isEnPassantMove(start, end, is_white, board)) {
             return true;
@@ -232,35 +290,32 @@ bool MoveValidator::isValidMove(const std::string& piece, const Position& start,
         // Terfi kontrolü - son sıraya ulaşma
         if ((is_white && end.y == 7) || (!is_white && end.y == 0)) {
             // Hareket geçerliyse terfi edilebilir
-            auto valid_moves = getMoveEdges(piece_lower, start, is_white, board);
-            for (const auto& move : valid_moves) {
-                if (move.x == end.x && move.y == end.y) {
-                    return true;
-                }
-            }
-            return false;
+            getMoveEdges(kind, start, is_white, board, valid_moves);
+            return containsPosition(valid_moves, end);
         }
     }
 
     // Portal move check
     if (portal_system.isPortalMove(start, end)) {
-        std::cout << "\nPortal move detected!" << std::endl;
-        bool valid = portal_system.validatePortalMove(piece, start, end, is_white, board);
-        if (!valid) {
+        if (verbose) {
+            std::cout << "\nPortal move detected!" << std::endl;
+        }
+        bool valid = portal_system.validatePortalMove(piece, start, end, is_white, board, verbose);
+        if (!valid && verbose) {
             std::cout << "Portal cannot be used - Cooldown or color restriction may apply." << std::endl;
         }
         return valid;
     }
 
-    // Normal hareket kontrolü
-    auto valid_moves = getMoveEdges(piece_lower, start, is_white, board);
-    for (const auto& move : valid_moves) {
-        if (move.x == end.x && move.y == end.y) {
-            return true;
-        }
+    // Sliders on sparse boards: one binary search per ray instead of listing it
+    if (board.isSparse() &&
+        (kind == PieceKind::Rook || kind == PieceKind::Bishop || kind == PieceKind::Queen)) {
+        return slidesTo(kind, start, end, board);
     }
 
-    return false;
+    // Normal hareket kontrolü
+    getMoveEdges(kind, start, is_white, board, valid_moves);
+    return containsPosition(valid_moves, end);
 }
 
 bool MoveValidator::validateCastling(const Position& start, const Position& end, 
@@ -272,12 +327,15 @@ bool MoveValidator::validateCastling(const Position& start, const Position& end,
 
     // Determine if kingside or queenside castling
     bool is_kingside = end.x > start.x;
+    if (!board.hasCastlingRight(is_white, is_kingside)) {
+        return false;
+    }
     int rook_x = is_kingside ? 7 : 0;
     
     // Check if rook is in place and hasn't moved
     Position rook_pos = {rook_x, start.y};
     const auto& rook_square = board.getSquare(rook_pos);
-    if (rook_square.is_empty() || toLowerCase(rook_square.piece) != "rook" || 
+    if (rook_square.is_empty() || rook_square.kind != PieceKind::Rook || 
         rook_square.is_white != is_white) {
         return false;
     }
@@ -295,13 +353,11 @@ bool MoveValidator::validateCastling(const Position& start, const Position& end,
 
 bool MoveValidator::isEnPassantMove(const Position& start, const Position& end,
                                   bool is_white, const ChessBoard& board) const {
-    // En passant can only occur on 5th rank (for white) or 4th rank (for black)
-    if ((is_white && start.y != 4) || (!is_white && start.y != 3)) {
+    // Must be diagonal movement onto the square the opponent pawn just skipped
+    if (abs(end.x - start.x) != 1 || end.y != start.y + (is_white ? 1 : -1)) {
         return false;
     }
-
-    // Must be diagonal movement
-    if (abs(end.x - start.x) != 1 || end.y != (is_white ? 5 : 2)) {
+    if (board.getEnPassantSquare() != board.squareIndex(end)) {
         return false;
     }
 
@@ -310,10 +366,10 @@ bool MoveValidator::isEnPassantMove(const Position& start, const Position& end,
         return false;
     }
 
-    // Captured pawn must have moved 2 squares in the last move
+    // Captured pawn is the one that moved 2 squares in the last move
     Position captured_pos = {end.x, start.y};
     const auto& captured_square = board.getSquare(captured_pos);
-    if (captured_square.is_empty() || toLowerCase(captured_square.piece) != "pawn" ||
+    if (captured_square.is_empty() || captured_square.kind != PieceKind::Pawn ||
         captured_square.is_white == is_white) {
         return false;
     }
@@ -0,0 +1,152 @@
+// OpeningBook.cpp
+#include "OpeningBook.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+constexpr char kMagic[8] = {'C', 'W', 'P', 'B', 'K', '0', '1', '\0'};
+
+struct FileHeader {
+  char magic[8];
+  uint64_t config_hash;
+  uint64_t entries;
+};
+static_assert(sizeof(FileHeader) == 24, "FileHeader layout is part of the file format");
+static_assert(sizeof(OpeningBook::Entry) == 16, "Entry layout is part of the file format");
+
+} // namespace
+
+bool OpeningBook::parseGameLine(const std::string& line, std::vector<std::string>& moves, GameResult& result) {
+  moves.clear();
+  result = GameResult::Unknown;
+  std::istringstream in(line);
+  std::string token;
+  while (in >> token) {
+    if (token[0] == '#') break;
+    if (!parseResult(token, result)) moves.push_back(token);
+  }
+  return !moves.empty();
+}
+
+OpeningBook::Builder::Builder(const GameConfig& config, int max_plies)
+    : config_(config), max_plies_(max_plies), board_(config.game_settings.board_size, "simple"),
+      portal_system_(config.portals), game_manager_(board_, validator_, portal_system_) {
+  game_manager_.setParallelStatusThreshold(ChessBoard::kMaxBoardSize + 1);
+}
+
+bool OpeningBook::Builder::addGame(const std::vector<std::string>& moves, GameResult result) {
+  board_.initializeBoard(config_.pieces);
+  portal_system_ = PortalSystem(config_.portals);
+  ++games_;
+  const int plies = std::min(static_cast<int>(moves.size()), max_plies_);
+  for (int ply = 0; ply < plies; ++ply) {
+    const bool white = board_.isWhiteToMove();
+    EncodedMove move;
+    game_manager_.generateLegalMoves(white, legal_);
+    if (!board_.parseMove(moves[ply], move) || std::find(legal_.begin(), legal_.end(), move) == legal_.end()) {
+      return false;
+    }
+    const bool won = result == (white ? GameResult::WhiteWin : GameResult::BlackWin);
+    const bool lost = result == (white ? GameResult::BlackWin : GameResult::WhiteWin);
+    Counts& counts = counts_[{board_.positionKey(portal_system_), move.bits}];
+    counts.weight = static_cast<uint32_t>(std::min<uint64_t>(UINT32_MAX, counts.weight + (won ? 2 : lost ? 0 : 1)));
+    counts.count = counts.count == UINT32_MAX ? counts.count : counts.count + 1;
+    UndoRecord undo;
+    board_.applyMove(move, portal_system_, undo);
+  }
+  return true;
+}
+
+size_t OpeningBook::Builder::write(const std::string& path, uint32_t min_count) const {
+  std::vector<Entry> entries;
+  for (const auto& [key, counts] : counts_) {
+    if (counts.count >= min_count && counts.weight > 0) {
+      entries.push_back({key.first, key.second, counts.weight});
+    }
+  }
+  std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+    if (a.key != b.key) return a.key < b.key;
+    if (a.weight != b.weight) return a.weight > b.weight;
+    return a.move < b.move;
+  });
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    throw std::runtime_error("cannot write " + path);
+  }
+  FileHeader header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.config_hash = configHash(config_);
+  header.entries = entries.size();
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(Entry)));
+  if (!out) {
+    throw std::runtime_error("cannot write " + path);
+  }
+  return entries.size();
+}
+
+bool OpeningBook::open(const std::string& path, const GameConfig& config) {
+  entries_ = nullptr;
+  count_ = 0;
+  if (!file_.open(path) || file_.size() < sizeof(FileHeader)) {
+    return false;
+  }
+  FileHeader header;
+  std::memcpy(&header, file_.data(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.config_hash != configHash(config) ||
+      file_.size() != sizeof(FileHeader) + header.entries * sizeof(Entry)) {
+    file_.close();
+    return false;
+  }
+  // The mapping is page aligned and the header is a multiple of 8 bytes, so
+  // entries are read in place
+  entries_ = reinterpret_cast<const Entry*>(file_.data() + sizeof(FileHeader));
+  count_ = header.entries;
+  return true;
+}
+
+std::pair<const OpeningBook::Entry*, const OpeningBook::Entry*> OpeningBook::range(uint64_t key) const {
+  if (entries_ == nullptr) {
+    return {nullptr, nullptr};
+  }
+  const Entry* first = std::lower_bound(entries_, entries_ + count_, key,
+                                        [](const Entry& entry, uint64_t k) { return entry.key < k; });
+  const Entry* last = first;
+  while (last != entries_ + count_ && last->key == key) {
+    ++last;
+  }
+  return {first, last};
+}
+
+void OpeningBook::lookup(uint64_t key, std::vector<Candidate>& out) const {
+  out.clear();
+  auto [first, last] = range(key);
+  for (const Entry* entry = first; entry != last; ++entry) {
+    out.push_back({EncodedMove{entry->move}, entry->weight});
+  }
+}
+
+bool OpeningBook::pick(uint64_t key, uint64_t random, EncodedMove& move) const {
+  auto [first, last] = range(key);
+  uint64_t total = 0;
+  for (const Entry* entry = first; entry != last; ++entry) {
+    total += entry->weight;
+  }
+  if (total == 0) {
+    return false;
+  }
+  uint64_t roll = random % total;
+  for (const Entry* entry = first; entry != last; ++entry) {
+    if (roll < entry->weight) {
+      move = EncodedMove{entry->move};
+      return true;
+    }
+    roll -= entry->weight;
+  }
+  return false;
+}
@@ -39,9 +39,8 @@ std::vector<std::shared_ptr<Piece>> createPiecesFromConfig(const ConfigReader& c
 
     // Standart taşlar
     for (const auto& pc : pieceConfigs) {
-        for (const auto& colorEntry : pc.positions) {
-            int color = (colorEntry.first == "white") ? 0 : 1;
-            for (const auto& pos : colorEntry.second) {
+        for (int color : {0, 1}) {
+            for (const auto& pos : pc.positions.of(color == 0)) {
                 int x = pos.x;
                 int y = pos.y;
                 bool hasMoved = false;
@@ -52,9 +51,8 @@ std::vector<std::shared_ptr<Piece>> createPiecesFromConfig(const ConfigReader& c
     }
     // Özel taşlar
     for (const auto& pc : customPieceConfigs) {
-        for (const auto& colorEntry : pc.positions) {
-            int color = (colorEntry.first == "white") ? 0 : 1;
-            for (const auto& pos : colorEntry.second) {
+        for (int color : {0, 1}) {
+            for (const auto& pos : pc.positions.of(color == 0)) {
                 int x = pos.x;
                 int y = pos.y;
                 bool hasMoved = false;
@@ -2,11 +2,8 @@
 #include <algorithm>
 #include <iostream>
 
-PortalSystem::PortalSystem(const std::vector<PortalConfig>& portals) : portals_(portals) {
-    for (const auto& portal : portals_) {
-        cooldowns_[portal.id] = 0;
-    }
-}
+PortalSystem::PortalSystem(const std::vector<PortalConfig>& portals)
+    : portals_(portals), ready_at_(portals.size(), 0) {}
 
 bool PortalSystem::isPortalMove(const Position& start, const Position& end) const {
     for (const auto& portal : portals_) {
@@ -20,9 +17,9 @@ bool PortalSystem::isPortalMove(const Position& start, const Position& end) cons
 
 bool PortalSystem::validatePortalMove(const std::string& piece, const Position& start, 
                                      const Position& end, bool is_white_turn, 
-                                     const ChessBoard& board) const {
+                                     const ChessBoard& board, bool verbose) const {
     const auto& square = board.getSquare(start);
-    if (square.is_empty() || square.piece != piece || square.is_white != is_white_turn) {
+    if (square.is_empty() || board.pieceName(square) != piece || square.is_white != is_white_turn) {
         return false;
     }
 
@@ -31,7 +28,7 @@ bool PortalSystem::validatePortalMove(const std::string& piece, const Position&
             end.x == portal.positions.exit.x && end.y == portal.positions.exit.y) {
             
             // First check cooldown
-            if (isPortalInCooldown(start, end)) {
+            if (isPortalInCooldown(start, end, verbose)) {
                 return false;
             }
             
@@ -40,7 +37,9 @@ bool PortalSystem::validatePortalMove(const std::string& piece, const Position&
             auto it = std::find(portal.properties.allowed_colors.begin(), 
                                portal.properties.allowed_colors.end(), color);
             if (it == portal.properties.allowed_colors.end()) {
-                std::cout << "\nPortal Error: This portal cannot be used by " << color << " pieces!" << std::endl;
+                if (verbose) {
+                    std::cout << "\nPortal Error: This portal cannot be used by " << color << " pieces!" << std::endl;
+                }
                 return false;
             }
             
@@ -50,37 +49,29 @@ bool PortalSystem::validatePortalMove(const std::string& piece, const Position&
     return false;
 }
 
-void PortalSystem::handlePortalMove(const Position& start, const Position& end, ChessBoard& board) {
-    for (const auto& portal : portals_) {
-        if (start.x == portal.positions.entry.x && start.y == portal.positions.entry.y &&
-            end.x == portal.positions.exit.x && end.y == portal.positions.exit.y) {
-            auto square = board.getSquare(start);
-            if (!square.is_empty()) {
-                board.placePiece(square.piece, square.is_white, end.x, end.y);
-                board.placePiece("", false, start.x, start.y);
-                
-                // Set cooldown count
-                cooldowns_[portal.id] = portal.properties.cooldown;
-                
-                // Add to queue
-                for (int i = 0; i < portal.properties.cooldown; i++) {
-                    cooldown_queue_.push(portal.id);
-                }
-            }
-            break;
-        }
-    }
+void PortalSystem::startCooldown(size_t portal_index) {
+    // The ply counter advances at the end of the same move, so the portal
+    // stays blocked for cooldown - 1 further turns.
+    ready_at_[portal_index] = ply_ + portals_[portal_index].properties.cooldown;
 }
 
-bool PortalSystem::isPortalInCooldown(const Position& start, const Position& end) const {
-    for (const auto& portal : portals_) {
+int PortalSystem::getRemainingCooldown(size_t portal_index) const {
+    return std::max(0, ready_at_[portal_index] - ply_);
+}
+
+bool PortalSystem::isPortalInCooldown(const Position& start, const Position& end,
+                                      bool verbose) const {
+    for (size_t i = 0; i < portals_.size(); ++i) {
+        const auto& portal = portals_[i];
         if (start.x == portal.positions.entry.x && start.y == portal.positions.entry.y &&
             end.x == portal.positions.exit.x && end.y == portal.positions.exit.y) {
-            auto cooldown_it = cooldowns_.find(portal.id);
-            if (cooldown_it != cooldowns_.end() && cooldown_it->second > 0) {
-                std::cout << "\nPortal " << portal.id << " is on cooldown! "
-                          << "Remaining turns: " << cooldown_it->second << std::endl;
-                std::cout << "This portal cannot be used by any piece right now." << std::endl;
+            int remaining = getRemainingCooldown(i);
+            if (remaining > 0) {
+                if (verbose) {
+                    std::cout << "\nPortal " << portal.id << " is on cooldown! "
+                              << "Remaining turns: " << remaining << std::endl;
+                    std::cout << "This portal cannot be used by any piece right now." << std::endl;
+                }
                 return true;
             }
             return false;
@@ -90,34 +81,35 @@ bool PortalSystem::isPortalInCooldown(const Position& start, const Position& end
 }
 
 void PortalSystem::updateCooldowns() {
-    if (cooldown_queue_.empty()) {
-        return;
+    ++ply_;
+}
+
+void PortalSystem::rewindCooldowns() {
+    if (ply_ > 0) {
+        --ply_;
     }
+}
 
-    // Decrease cooldown for one portal each turn
-    std::string portal_id = cooldown_queue_.front();
-    cooldown_queue_.pop();
-    
-    auto it = cooldowns_.find(portal_id);
-    if (it != cooldowns_.end() && it->second > 0) {
-        it->second--;
-        if (it->second == 0) {
-            std::cout << "\nPortal " << portal_id << " is now ready for use!" << std::endl;
+void PortalSystem::reportCooldowns() const {
+    for (size_t i = 0; i < portals_.size(); ++i) {
+        if (ready_at_[i] == ply_ && portals_[i].properties.cooldown > 0) {
+            std::cout << "\nPortal " << portals_[i].id << " is now ready for use!" << std::endl;
         }
     }
-    
+
     // Show cooldown statuses
     bool has_cooldowns = false;
-    for (const auto& pair : cooldowns_) {
-        if (pair.second > 0) {
+    for (size_t i = 0; i < portals_.size(); ++i) {
+        int remaining = getRemainingCooldown(i);
+        if (remaining > 0) {
             if (!has_cooldowns) {
                 std::cout << "\n--- PORTAL COOLDOWN STATUS ---";
                 has_cooldowns = true;
             }
-            std::cout << "\n" << pair.first << " -> Remaining cooldown: " << pair.second << " turns";
+            std::cout << "\n" << portals_[i].id << " -> Remaining cooldown: " << remaining << " turns";
         }
     }
     if (has_cooldowns) {
         std::cout << "\n!!" << std::endl;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,271 @@
+// PositionIndex.cpp
+#include "PositionIndex.hpp"
+#include "ChessBoard.hpp"
+#include "GameManager.hpp"
+#include "MoveValidator.hpp"
+#include "PortalSystem.hpp"
+#include "WorkStealingPool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+constexpr char kMagic[8] = {'C', 'W', 'P', 'P', 'X', '0', '1', '\0'};
+
+struct FileHeader {
+  char magic[8];
+  uint64_t config_hash;
+  uint64_t entries;
+  uint64_t games;
+  uint64_t archive_bytes;
+  uint32_t fence_stride;
+  uint32_t reserved;
+};
+static_assert(sizeof(FileHeader) == 48, "FileHeader layout is part of the file format");
+static_assert(sizeof(PositionIndex::Entry) == 16, "Entry layout is part of the file format");
+
+using Entry = PositionIndex::Entry;
+
+bool entryLess(const Entry& a, const Entry& b) {
+  if (a.key != b.key) return a.key < b.key;
+  if (a.game != b.game) return a.game < b.game;
+  return a.ply < b.ply;
+}
+
+// A run of consecutive games, indexed into one sorted run file
+struct Chunk {
+  size_t offset;       // archive offset of the first game
+  uint32_t first_game;
+  uint32_t games;
+};
+
+// Replay state owned by one worker
+struct Indexer {
+  explicit Indexer(const GameConfig& config)
+      : board(config.game_settings.board_size, "simple"),
+        portal_system(config.portals),
+        game_manager(board, validator, portal_system) {
+    game_manager.setParallelStatusThreshold(ChessBoard::kMaxBoardSize + 1);
+  }
+
+  GameRecordReader reader;
+  ChessBoard board;
+  MoveValidator validator;
+  PortalSystem portal_system;
+  GameManager game_manager;
+  std::vector<Entry> entries;
+};
+
+// Deletes the spilled runs however the build ends
+struct RunFiles {
+  std::vector<std::string> paths;
+  ~RunFiles() {
+    for (const std::string& path : paths) std::remove(path.c_str());
+  }
+};
+
+void writeRun(const std::string& path, const std::vector<Entry>& entries) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(Entry)));
+  if (!out) {
+    throw std::runtime_error("cannot write " + path);
+  }
+}
+
+} // namespace
+
+PositionIndex::Summary PositionIndex::build(const GameConfig& config, const std::string& archive,
+                                            const std::string& path, unsigned threads, size_t chunk_games) {
+  const auto started = std::chrono::steady_clock::now();
+  Summary summary;
+
+  // One sequential pass over the game headers: results, offsets and chunks
+  GameRecordReader reader;
+  if (!reader.open(archive, config)) {
+    throw std::runtime_error("cannot read " + archive + " as an archive for this config");
+  }
+  std::vector<uint64_t> offsets;
+  std::vector<uint8_t> results;
+  std::vector<Chunk> chunks;
+  GameRecordReader::Game game;
+  size_t offset = reader.tell();
+  while (reader.next(game)) {
+    if (offsets.size() % std::max<size_t>(chunk_games, 1) == 0) {
+      chunks.push_back(Chunk{offset, static_cast<uint32_t>(offsets.size()), 0});
+    }
+    ++chunks.back().games;
+    offsets.push_back(offset);
+    results.push_back(static_cast<uint8_t>(game.result));
+    offset = reader.tell();
+  }
+  if (reader.truncated()) {
+    throw std::runtime_error(archive + " is truncated after game " + std::to_string(offsets.size()));
+  }
+
+  // Every chunk becomes one sorted run on disk, so memory stays bounded by
+  // the chunk size times the number of workers
+  RunFiles runs;
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    runs.paths.push_back(path + ".run" + std::to_string(i));
+  }
+  WorkStealingPool pool(std::max(threads, 1u));
+  std::vector<std::unique_ptr<Indexer>> indexers;
+  for (unsigned i = 0; i < pool.size(); ++i) {
+    indexers.push_back(std::make_unique<Indexer>(config));
+  }
+  const int board_size = config.game_settings.board_size;
+  pool.run(chunks.size(), [&](size_t index, unsigned worker) {
+    Indexer& indexer = *indexers[worker];
+    if (!indexer.reader.isOpen() && !indexer.reader.open(archive, config)) {
+      throw std::runtime_error("cannot read " + archive);
+    }
+    const Chunk& chunk = chunks[index];
+    indexer.reader.seek(chunk.offset);
+    indexer.entries.clear();
+    GameRecordReader::Game game;
+    for (uint32_t i = 0; i < chunk.games && indexer.reader.next(game); ++i) {
+      const uint32_t number = chunk.first_game + i;
+      indexer.board.initializeBoard(config.pieces);
+      indexer.portal_system = PortalSystem(config.portals);
+      indexer.entries.push_back({indexer.board.positionKey(indexer.portal_system), number, 0});
+      GameRecordReader::MoveCursor cursor(game, board_size);
+      EncodedMove move;
+      uint32_t ply = 0;
+      // A damaged game is indexed up to its first illegal move
+      while (cursor.next(move) && indexer.game_manager.isLegalMove(move)) {
+        UndoRecord undo;
+        indexer.board.applyMove(move, indexer.portal_system, undo);
+        indexer.entries.push_back({indexer.board.positionKey(indexer.portal_system), number, ++ply});
+      }
+    }
+    std::sort(indexer.entries.begin(), indexer.entries.end(), entryLess);
+    // Keep only the first time a game reached each position
+    indexer.entries.erase(std::unique(indexer.entries.begin(), indexer.entries.end(),
+                                      [](const Entry& a, const Entry& b) { return a.key == b.key && a.game == b.game; }),
+                          indexer.entries.end());
+    writeRun(runs.paths[index], indexer.entries);
+  });
+  indexers.clear();
+
+  // K-way merge of the runs, streamed into the index with a fence every
+  // kFenceStride entries
+  std::vector<MappedFile> mapped(runs.paths.size());
+  struct Cursor {
+    const Entry* next;
+    const Entry* end;
+  };
+  std::vector<Cursor> cursors;
+  for (size_t i = 0; i < mapped.size(); ++i) {
+    if (!mapped[i].open(runs.paths[i])) {
+      throw std::runtime_error("cannot read " + runs.paths[i]);
+    }
+    const Entry* first = reinterpret_cast<const Entry*>(mapped[i].data());
+    cursors.push_back({first, first + mapped[i].size() / sizeof(Entry)});
+  }
+  auto later = [&](size_t a, size_t b) { return entryLess(*cursors[b].next, *cursors[a].next); };
+  std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heap(later);
+  for (size_t i = 0; i < cursors.size(); ++i) {
+    if (cursors[i].next != cursors[i].end) heap.push(i);
+  }
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  FileHeader header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.config_hash = configHash(config);
+  header.games = offsets.size();
+  header.archive_bytes = reader.bytes();
+  header.fence_stride = kFenceStride;
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  std::vector<Entry> buffer;
+  buffer.reserve(kFenceStride * 16);
+  std::vector<uint64_t> fences;
+  uint64_t count = 0;
+  while (!heap.empty()) {
+    const size_t run = heap.top();
+    heap.pop();
+    const Entry& entry = *cursors[run].next++;
+    if (count++ % kFenceStride == 0) fences.push_back(entry.key);
+    buffer.push_back(entry);
+    if (buffer.size() == buffer.capacity()) {
+      out.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size() * sizeof(Entry)));
+      buffer.clear();
+    }
+    if (cursors[run].next != cursors[run].end) heap.push(run);
+  }
+  out.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size() * sizeof(Entry)));
+  out.write(reinterpret_cast<const char*>(fences.data()), static_cast<std::streamsize>(fences.size() * sizeof(uint64_t)));
+  out.write(reinterpret_cast<const char*>(offsets.data()), static_cast<std::streamsize>(offsets.size() * sizeof(uint64_t)));
+  out.write(reinterpret_cast<const char*>(results.data()), static_cast<std::streamsize>(results.size()));
+  // The entry count goes in last; until then the file size does not match
+  // the header, so an interrupted build never opens
+  header.entries = count;
+  out.seekp(0);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  if (!out.flush()) {
+    throw std::runtime_error("cannot write " + path);
+  }
+
+  summary.games = offsets.size();
+  summary.entries = count;
+  summary.runs = chunks.size();
+  summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  return summary;
+}
+
+bool PositionIndex::open(const std::string& path, const GameConfig& config) {
+  entries_ = nullptr;
+  count_ = fence_count_ = games_ = 0;
+  if (!file_.open(path) || file_.size() < sizeof(FileHeader)) {
+    return false;
+  }
+  FileHeader header;
+  std::memcpy(&header, file_.data(), sizeof(header));
+  const uint64_t fences = header.fence_stride ? (header.entries + header.fence_stride - 1) / header.fence_stride : 0;
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.config_hash != configHash(config) ||
+      header.fence_stride != kFenceStride ||
+      file_.size() != sizeof(FileHeader) + header.entries * sizeof(Entry) + fences * sizeof(uint64_t) +
+                          header.games * (sizeof(uint64_t) + 1)) {
+    file_.close();
+    return false;
+  }
+  // Every section but the trailing results is a multiple of 8 bytes, so the
+  // arrays are read in place from the page-aligned mapping
+  const uint8_t* next = file_.data() + sizeof(FileHeader);
+  entries_ = reinterpret_cast<const Entry*>(next);
+  next += header.entries * sizeof(Entry);
+  fences_ = reinterpret_cast<const uint64_t*>(next);
+  next += fences * sizeof(uint64_t);
+  offsets_ = reinterpret_cast<const uint64_t*>(next);
+  next += header.games * sizeof(uint64_t);
+  results_ = next;
+  count_ = header.entries;
+  fence_count_ = fences;
+  games_ = header.games;
+  archive_bytes_ = header.archive_bytes;
+  return true;
+}
+
+std::pair<const PositionIndex::Entry*, const PositionIndex::Entry*> PositionIndex::find(uint64_t key) const {
+  if (entries_ == nullptr) {
+    return {nullptr, nullptr};
+  }
+  // Fence i is the key of entry i * kFenceStride. The first entry with `key`
+  // is in the block before the first fence >= key (or starts that fence's
+  // block); the last is before the first fence > key.
+  const uint64_t* fences_end = fences_ + fence_count_;
+  const size_t low = static_cast<size_t>(std::lower_bound(fences_, fences_end, key) - fences_);
+  const size_t high = static_cast<size_t>(std::upper_bound(fences_ + low, fences_end, key) - fences_);
+  const Entry* begin = entries_ + (low ? (low - 1) * kFenceStride : 0);
+  const Entry* end = entries_ + std::min(count_, high * kFenceStride);
+  auto key_less = [](const Entry& entry, uint64_t k) { return entry.key < k; };
+  const Entry* first = std::lower_bound(begin, end, key, key_less);
+  const Entry* last = std::upper_bound(first, end, key, [](uint64_t k, const Entry& entry) { return k < entry.key; });
+  return {first, last};
+}
@@ -0,0 +1,470 @@
+// PositionNotation.cpp
+#include "PositionNotation.hpp"
+#include "ChessBoard.hpp"
+#include "PortalSystem.hpp"
+#include "ScratchArena.hpp"
+#include <algorithm>
+#include <memory_resource>
+#include <vector>
+
+namespace {
+
+const char* const kStandardNames[] = {"King", "Queen", "Rook", "Bishop", "Knight", "Pawn"};
+const char kStandardLetters[] = {'k', 'q', 'r', 'b', 'n', 'p'};
+
+// The notation is ASCII, so case is folded without the locale
+char lowerAscii(char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c; }
+char upperAscii(char c) { return c >= 'a' && c <= 'z' ? static_cast<char>(c - ('a' - 'A')) : c; }
+bool isAlphaAscii(char c) { return lowerAscii(c) >= 'a' && lowerAscii(c) <= 'z'; }
+
+bool sameName(std::string_view a, std::string_view b) {
+  if (a.size() != b.size()) return false;
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (lowerAscii(a[i]) != lowerAscii(b[i])) return false;
+  }
+  return true;
+}
+
+// A name without a letter can be bracketed: it has a letter to carry the
+// colour, and nothing that ends a rank or the name early
+bool bracketable(std::string_view name) {
+  bool has_letter = false;
+  for (char c : name) {
+    if (c == ' ' || c == '/' || c == '[' || c == ']') return false;
+    has_letter |= isAlphaAscii(c);
+  }
+  return has_letter;
+}
+
+// Next space-separated field of `text` starting at `pos`; empty at the end
+std::string_view nextField(std::string_view text, size_t& pos) {
+  while (pos < text.size() && text[pos] == ' ') ++pos;
+  const size_t begin = pos;
+  while (pos < text.size() && text[pos] != ' ') ++pos;
+  return text.substr(begin, pos - begin);
+}
+
+bool parseNumber(std::string_view text, int& value) {
+  if (text.empty() || text.size() > 6) return false;
+  value = 0;
+  for (char c : text) {
+    if (c < '0' || c > '9') return false;
+    value = value * 10 + (c - '0');
+  }
+  return true;
+}
+
+// "e3", "ab12": bijective base-26 file letters, then the 1-based rank
+bool parseSquare(std::string_view text, int board_size, int& index) {
+  size_t i = 0;
+  int x = 0;
+  while (i < text.size() && i < 3 && text[i] >= 'a' && text[i] <= 'z') {
+    x = x * 26 + (text[i++] - 'a' + 1);
+  }
+  int y = 0;
+  if (i == 0 || !parseNumber(text.substr(i), y) || x > board_size || y < 1 || y > board_size) return false;
+  index = (y - 1) * board_size + (x - 1);
+  return true;
+}
+
+// Bounded output buffer; `ok` drops to false once something did not fit
+struct Writer {
+  char* out;
+  size_t capacity;
+  size_t length = 0;
+  bool ok = true;
+
+  void put(char c) {
+    if (length < capacity) out[length++] = c;
+    else ok = false;
+  }
+  void putNumber(int value) {
+    char digits[12];
+    int count = 0;
+    do {
+      digits[count++] = static_cast<char>('0' + value % 10);
+      value /= 10;
+    } while (value > 0);
+    while (count > 0) put(digits[--count]);
+  }
+  void putSquare(int index, int board_size) {
+    char letters[4];
+    int count = 0;
+    for (int n = index % board_size + 1; n > 0; n = (n - 1) / 26) {
+      letters[count++] = static_cast<char>('a' + (n - 1) % 26);
+    }
+    while (count > 0) put(letters[--count]);
+    putNumber(index / board_size + 1);
+  }
+};
+
+// Piece codes parsePlacement() leaves in Square::type until the text is
+// known to be good: a letter is 1 + its index, a bracketed name
+// kFirstBracketed + its index in the name list
+constexpr int kFirstBracketed = 27;
+constexpr size_t kMaxBracketed = 256 - kFirstBracketed;
+
+// Reads a placement field from its bottom rank up, so the pieces come out in
+// square index order, and checks its shape
+bool parsePlacement(std::string_view placement, const std::vector<std::string>& names, int size,
+                    std::pmr::vector<ChessBoard::Placement>& out, std::pmr::vector<std::string_view>& bracketed,
+                    const char** error) {
+  size_t end = placement.size();
+  for (int y = 0;; ++y) {
+    const size_t slash = end == 0 ? std::string_view::npos : placement.rfind('/', end - 1);
+    const size_t begin = slash == std::string_view::npos ? 0 : slash + 1;
+    if (y >= size) {
+      *error = "more ranks than the board size";
+      return false;
+    }
+    int x = 0;
+    for (size_t i = begin; i < end;) {
+      const char c = placement[i];
+      if (c >= '0' && c <= '9') {
+        size_t run_end = i;
+        while (run_end < end && placement[run_end] >= '0' && placement[run_end] <= '9') ++run_end;
+        int run = 0;
+        if (!parseNumber(placement.substr(i, run_end - i), run) || run == 0 || x + run > size) {
+          *error = "bad run of empty squares";
+          return false;
+        }
+        x += run;
+        i = run_end;
+        continue;
+      }
+      int code;
+      bool is_white;
+      if (c == '[') {
+        const size_t close = placement.find(']', i + 1);
+        const std::string_view name =
+            close < end ? placement.substr(i + 1, close - i - 1) : std::string_view();
+        if (!bracketable(name)) {
+          *error = "bad bracketed piece name";
+          return false;
+        }
+        // The case of the name's first letter gives the colour
+        const char first = *std::find_if(name.begin(), name.end(), isAlphaAscii);
+        is_white = first != lowerAscii(first);
+        size_t k = 0;
+        while (k < bracketed.size() && !sameName(bracketed[k], name)) ++k;
+        if (k == bracketed.size()) {
+          if (k == kMaxBracketed) {
+            *error = "too many bracketed piece names";
+            return false;
+          }
+          bracketed.push_back(name);
+        }
+        code = kFirstBracketed + static_cast<int>(k);
+        i = close + 1;
+      } else {
+        const int l = lowerAscii(c) - 'a';
+        if (l < 0 || l >= 26 || names[l].empty()) {
+          *error = "unknown piece letter";
+          return false;
+        }
+        code = 1 + l;
+        is_white = c != lowerAscii(c);
+        ++i;
+      }
+      if (x >= size) {
+        *error = "rank is longer than the board width";
+        return false;
+      }
+      out.push_back({y * size + x, ChessBoard::Square(static_cast<uint8_t>(code), PieceKind::None, is_white)});
+      ++x;
+    }
+    if (x != size) {
+      *error = "rank does not fill the board width";
+      return false;
+    }
+    if (slash == std::string_view::npos) {
+      if (y != size - 1) {
+        *error = "fewer ranks than the board size";
+        return false;
+      }
+      return true;
+    }
+    end = slash;
+  }
+}
+
+} // namespace
+
+PositionNotation::PositionNotation() : names_(26) {
+  for (size_t i = 0; i < 6; ++i) {
+    names_[kStandardLetters[i] - 'a'] = kStandardNames[i];
+  }
+}
+
+PositionNotation::PositionNotation(const std::vector<PieceConfig>& pieces) : PositionNotation() {
+  for (const auto& piece : pieces) {
+    addType(piece.type);
+  }
+}
+
+void PositionNotation::addType(const std::string& name) {
+  if (name.empty() || letter(name) != 0) {
+    return;
+  }
+  for (char c : name) {
+    const int l = lowerAscii(c) - 'a';
+    if (l >= 0 && l < 26 && names_[l].empty()) {
+      names_[l] = name;
+      return;
+    }
+  }
+  for (auto& slot : names_) {
+    if (slot.empty()) {
+      slot = name;
+      return;
+    }
+  }
+}
+
+char PositionNotation::letter(const std::string& type) const {
+  // addType() prefers the letters of the name itself, so try those first
+  for (char c : type) {
+    const int l = lowerAscii(c) - 'a';
+    if (l >= 0 && l < 26 && !names_[l].empty() && sameName(names_[l], type)) {
+      return static_cast<char>('a' + l);
+    }
+  }
+  for (size_t l = 0; l < names_.size(); ++l) {
+    if (!names_[l].empty() && sameName(names_[l], type)) {
+      return static_cast<char>('a' + l);
+    }
+  }
+  return 0;
+}
+
+bool PositionNotation::parse(std::string_view text, ChessBoard& board, PortalSystem& portal_system,
+                             const char** error) const {
+  const char* ignored = nullptr;
+  if (error == nullptr) error = &ignored;
+  size_t pos = 0;
+  const std::string_view placement = nextField(text, pos);
+  const std::string_view side = nextField(text, pos);
+  const std::string_view castling = nextField(text, pos);
+  const std::string_view en_passant = nextField(text, pos);
+  const std::string_view cooldowns = nextField(text, pos);
+  if (!nextField(text, pos).empty()) {
+    *error = "more than five fields";
+    return false;
+  }
+
+  // Check everything before touching the board
+  if (placement.empty()) {
+    *error = "missing piece placement";
+    return false;
+  }
+  const int size = board.getBoardSize();
+  ScratchArena& arena = ScratchArena::forThread();
+  ScratchArena::Scope scope(arena);
+  std::pmr::vector<ChessBoard::Placement> placements(&arena);
+  std::pmr::vector<std::string_view> bracketed(&arena);
+  placements.reserve(std::min(placement.size(), static_cast<size_t>(size) * size));
+  if (!parsePlacement(placement, names_, size, placements, bracketed, error)) {
+    return false;
+  }
+  if (!side.empty() && side != "w" && side != "b") {
+    *error = "side to move must be w or b";
+    return false;
+  }
+  uint8_t rights = 0;
+  if (!castling.empty() && castling != "-") {
+    for (char c : castling) {
+      const uint8_t right = c == 'K'   ? ChessBoard::kWhiteKingside
+                            : c == 'Q' ? ChessBoard::kWhiteQueenside
+                            : c == 'k' ? ChessBoard::kBlackKingside
+                            : c == 'q' ? ChessBoard::kBlackQueenside
+                                       : 0;
+      if (right == 0 || (rights & right) != 0) {
+        *error = "castling rights must be a subset of KQkq";
+        return false;
+      }
+      rights |= right;
+    }
+  }
+  int en_passant_square = -1;
+  if (!en_passant.empty() && en_passant != "-" && !parseSquare(en_passant, board.getBoardSize(), en_passant_square)) {
+    *error = "bad en passant square";
+    return false;
+  }
+  const auto& portals = portal_system.getPortals();
+  if (!cooldowns.empty() && cooldowns != "-") {
+    size_t portal = 0;
+    for (size_t begin = 0; begin <= cooldowns.size(); ++portal) {
+      size_t end = cooldowns.find(',', begin);
+      if (end == std::string_view::npos) end = cooldowns.size();
+      int remaining = 0;
+      if (portal >= portals.size() || !parseNumber(cooldowns.substr(begin, end - begin), remaining) ||
+          remaining > std::max(portals[portal].properties.cooldown, 0)) {
+        *error = "cooldowns must give each portal at most its cooldown";
+        return false;
+      }
+      begin = end + 1;
+    }
+    if (portal != portals.size()) {
+      *error = "one cooldown per portal is needed";
+      return false;
+    }
+  }
+
+  // Piece codes to board types. Names the board has not seen are counted
+  // before any is registered, so a text that would overflow the board's
+  // type table fails here instead of throwing
+  uint8_t ids[256] = {};
+  bool looked_up[256] = {};
+  size_t unseen = 0;
+  for (const ChessBoard::Placement& placed : placements) {
+    const int code = placed.square.type;
+    if (!looked_up[code]) {
+      looked_up[code] = true;
+      ids[code] = board.findPieceType(code < kFirstBracketed ? std::string_view(names_[code - 1])
+                                                             : bracketed[code - kFirstBracketed]);
+      unseen += ids[code] == 0;
+    }
+  }
+  if (board.pieceTypeCount() + unseen > ChessBoard::kMaxPieceTypes) {
+    *error = "too many piece types";
+    return false;
+  }
+  for (ChessBoard::Placement& placed : placements) {
+    const int code = placed.square.type;
+    if (ids[code] == 0) {
+      ids[code] = code < kFirstBracketed ? board.pieceTypeId(names_[code - 1])
+                                         : board.pieceTypeId(std::string(bracketed[code - kFirstBracketed]));
+    }
+    placed.square = ChessBoard::Square(ids[code], board.pieceKind(ids[code]), placed.square.is_white);
+  }
+  board.clearPieces();
+  board.placePieces(placements.data(), placements.size());
+  board.setWhiteToMove(side != "b");
+  board.setCastlingRights(rights);
+  board.setEnPassantSquare(en_passant_square);
+  size_t portal = 0;
+  if (!cooldowns.empty() && cooldowns != "-") {
+    for (size_t begin = 0; begin <= cooldowns.size(); ++portal) {
+      size_t end = cooldowns.find(',', begin);
+      if (end == std::string_view::npos) end = cooldowns.size();
+      int remaining = 0;
+      parseNumber(cooldowns.substr(begin, end - begin), remaining);
+      portal_system.setReadyAt(portal, portal_system.getPly() + remaining);
+      begin = end + 1;
+    }
+  }
+  for (; portal < portals.size(); ++portal) {
+    portal_system.setReadyAt(portal, portal_system.getPly());
+  }
+  return true;
+}
+
+size_t PositionNotation::write(const ChessBoard& board, const PortalSystem& portal_system, char* out,
+                               size_t capacity) const {
+  // Letters of the board's piece types, looked up once per call: '[' for
+  // a type written as its bracketed name, 0 for one that cannot be written
+  char letters[256] = {};
+  for (size_t type = 1; type < board.pieceTypeCount(); ++type) {
+    const std::string& name = board.pieceType(static_cast<uint8_t>(type)).name;
+    letters[type] = letter(name);
+    if (letters[type] == 0 && bracketable(name)) letters[type] = '[';
+  }
+
+  Writer writer{out, capacity};
+  auto putPiece = [&](const ChessBoard::Square& square) {
+    const char c = letters[square.type];
+    if (c == 0) {
+      writer.ok = false;
+    } else if (c != '[') {
+      writer.put(square.is_white ? upperAscii(c) : c);
+    } else {
+      writer.put('[');
+      for (char n : board.pieceType(square.type).name) {
+        writer.put(square.is_white ? upperAscii(n) : lowerAscii(n));
+      }
+      writer.put(']');
+    }
+  };
+  const int size = board.getBoardSize();
+  if (!board.isSparse()) {
+    for (int y = size - 1; y >= 0; --y) {
+      int empty = 0;
+      for (int x = 0; x < size; ++x) {
+        const ChessBoard::Square& square = board.getSquare({x, y});
+        if (square.is_empty()) {
+          ++empty;
+          continue;
+        }
+        if (empty > 0) writer.putNumber(empty);
+        empty = 0;
+        putPiece(square);
+      }
+      if (empty > 0) writer.putNumber(empty);
+      if (y > 0) writer.put('/');
+    }
+  } else {
+    // Sparse boards are walked by their piece list (in index order) rather
+    // than square by square
+    ScratchArena& arena = ScratchArena::forThread();
+    ScratchArena::Scope scope(arena);
+    std::pmr::vector<ChessBoard::Placement> placed(&arena);
+    size_t count = 0;
+    board.forEachPiece([&](const Position&, const ChessBoard::Square&) {
+      ++count;
+      return false;
+    });
+    placed.reserve(count);
+    board.forEachPiece([&](const Position& pos, const ChessBoard::Square& square) {
+      placed.push_back({board.squareIndex(pos), square});
+      return false;
+    });
+    size_t end = placed.size();
+    for (int y = size - 1; y >= 0; --y) {
+      size_t begin = end;
+      while (begin > 0 && placed[begin - 1].index >= y * size) --begin;
+      int x = 0;
+      for (size_t i = begin; i < end; ++i) {
+        const int file = placed[i].index - y * size;
+        if (file > x) writer.putNumber(file - x);
+        putPiece(placed[i].square);
+        x = file + 1;
+      }
+      if (x < size) writer.putNumber(size - x);
+      if (y > 0) writer.put('/');
+      end = begin;
+    }
+  }
+
+  writer.put(' ');
+  writer.put(board.isWhiteToMove() ? 'w' : 'b');
+  writer.put(' ');
+  const uint8_t rights = board.getCastlingRights();
+  if (rights & ChessBoard::kWhiteKingside) writer.put('K');
+  if (rights & ChessBoard::kWhiteQueenside) writer.put('Q');
+  if (rights & ChessBoard::kBlackKingside) writer.put('k');
+  if (rights & ChessBoard::kBlackQueenside) writer.put('q');
+  if (rights == 0) writer.put('-');
+  writer.put(' ');
+  if (board.getEnPassantSquare() >= 0) writer.putSquare(board.getEnPassantSquare(), size);
+  else writer.put('-');
+  writer.put(' ');
+  const size_t portals = portal_system.getPortals().size();
+  for (size_t i = 0; i < portals; ++i) {
+    if (i > 0) writer.put(',');
+    writer.putNumber(portal_system.getRemainingCooldown(i));
+  }
+  if (portals == 0) writer.put('-');
+  return writer.ok ? writer.length : 0;
+}
+
+std::string PositionNotation::toString(const ChessBoard& board, const PortalSystem& portal_system) const {
+  const size_t size = static_cast<size_t>(board.getBoardSize());
+  // Room for a bracketed name on every square
+  size_t widest = 1;
+  for (size_t type = 1; type < board.pieceTypeCount(); ++type) {
+    widest = std::max(widest, board.pieceType(static_cast<uint8_t>(type)).name.size() + 2);
+  }
+  std::string text(size * size * widest + size + 32 + 12 * portal_system.getPortals().size(), '\0');
+  text.resize(write(board, portal_system, text.data(), text.size()));
+  return text;
+}
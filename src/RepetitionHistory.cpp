@@ -0,0 +1,34 @@
+// RepetitionHistory.cpp
+#include "RepetitionHistory.hpp"
+#include <algorithm>
+
+void RepetitionHistory::reset(uint64_t key) {
+  ply_ = 0;
+  keys_[0] = key;
+  clocks_[0] = 0;
+}
+
+void RepetitionHistory::push(uint64_t key, bool irreversible) {
+  uint16_t clock = irreversible ? 0 : static_cast<uint16_t>(std::min<int>(clocks_[ply_ & kMask] + 1, 0xffff));
+  ++ply_;
+  keys_[ply_ & kMask] = key;
+  clocks_[ply_ & kMask] = clock;
+}
+
+void RepetitionHistory::pop() {
+  if (ply_ > 0) {
+    --ply_;
+  }
+}
+
+int RepetitionHistory::repetitionCount() const {
+  const uint64_t key = keys_[ply_ & kMask];
+  const size_t reach = std::min<size_t>({static_cast<size_t>(clocks_[ply_ & kMask]), ply_, kCapacity - 1});
+  int count = 0;
+  for (size_t back = 2; back <= reach; back += 2) {
+    if (keys_[(ply_ - back) & kMask] == key) {
+      ++count;
+    }
+  }
+  return count;
+}
@@ -0,0 +1,33 @@
+// ScratchArena.cpp
+#include "ScratchArena.hpp"
+#include <algorithm>
+
+ScratchArena::ScratchArena(size_t capacity)
+    : buffer_(new std::byte[capacity]), capacity_(capacity) {}
+
+ScratchArena& ScratchArena::forThread() {
+  thread_local ScratchArena arena;
+  return arena;
+}
+
+void* ScratchArena::do_allocate(size_t bytes, size_t alignment) {
+  size_t start = (used_ + alignment - 1) & ~(alignment - 1);
+  if (start + bytes > capacity_) {
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  used_ = start + bytes;
+  high_water_ = std::max(high_water_, used_);
+  return buffer_.get() + start;
+}
+
+void ScratchArena::do_deallocate(void* p, size_t bytes, size_t alignment) {
+  // Arena memory is reclaimed by rewind(); only overflow blocks are freed here
+  std::byte* ptr = static_cast<std::byte*>(p);
+  if (ptr < buffer_.get() || ptr >= buffer_.get() + capacity_) {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+}
+
+bool ScratchArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+  return this == &other;
+}
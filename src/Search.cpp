@@ -0,0 +1,299 @@
+// Search.cpp
+#include "Search.hpp"
+#include "ChessBoard.hpp"
+#include "GameManager.hpp"
+#include "PortalSystem.hpp"
+#include "Tablebase.hpp"
+#include "TranspositionTable.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+Search::Search(ChessBoard& board, GameManager& game_manager, PortalSystem& portal_system)
+    : board_(board), game_manager_(game_manager), portal_system_(portal_system) {}
+
+int Search::pieceValue(PieceKind kind) {
+  switch (kind) {
+    case PieceKind::Pawn: return 100;
+    case PieceKind::Knight: return 300;
+    case PieceKind::Bishop: return 320;
+    case PieceKind::Rook: return 500;
+    case PieceKind::Queen: return 900;
+    case PieceKind::Custom: return 300;
+    default: return 0;
+  }
+}
+
+int Search::evaluate() const {
+  int score = 0;
+  board_.forEachPiece([&](const Position&, const ChessBoard::Square& square) {
+    score += square.is_white ? pieceValue(square.kind) : -pieceValue(square.kind);
+    return false;
+  });
+  return board_.isWhiteToMove() ? score : -score;
+}
+
+// Captures of valuable pieces and promotions first, so alpha-beta cuts early
+int Search::moveOrderScore(EncodedMove move) const {
+  int score = pieceValue(board_.getSquare(board_.squarePosition(move.to())).kind);
+  if (move.kind() == MoveKind::EnPassant) {
+    score += pieceValue(PieceKind::Pawn);
+  }
+  if (move.kind() == MoveKind::Promotion && move.promotion() == PromotionPiece::Queen) {
+    score += pieceValue(PieceKind::Queen);
+  }
+  return score;
+}
+
+Search::Result Search::bestMove(int depth) {
+  Limits limits;
+  limits.depth = std::max(depth, 1);
+  limits.iterate = false;
+  return think(limits);
+}
+
+Search::Result Search::think(const Limits& limits) {
+  nodes_ = 0;
+  aborted_ = false;
+  limits_ = limits;
+  started_ = std::chrono::steady_clock::now();
+
+  const int max_depth = limits.depth > 0 ? std::min(limits.depth, kMaxDepth) : kMaxDepth;
+  // One move list per ply, sized up front so references stay valid during the search
+  if (moves_by_ply_.size() < static_cast<size_t>(max_depth)) {
+    moves_by_ply_.resize(max_depth);
+    pv_by_ply_.resize(max_depth + 1);
+  }
+  std::vector<EncodedMove>& moves = moves_by_ply_[0];
+  game_manager_.generateLegalMoves(board_.isWhiteToMove(), moves);
+  Result result;
+  if (moves.empty()) {
+    return result;
+  }
+  std::stable_sort(moves.begin(), moves.end(), [this](EncodedMove a, EncodedMove b) {
+    return moveOrderScore(a) > moveOrderScore(b);
+  });
+  // Something legal to answer with even if the first iteration is cut short
+  result = {moves.front(), 0, true, 0, {Line{moves.front(), 0, {moves.front()}}}};
+
+  for (int depth = limits.iterate ? 1 : max_depth; depth <= max_depth; ++depth) {
+    Result iteration = searchRoot(depth);
+    if (aborted_) {
+      break;  // a partial iteration may have missed the refutation of its best move
+    }
+    result = iteration;
+    if (info_) {
+      info_(result, nodes_, elapsedMs());
+    }
+    // The best moves lead the next iteration in order, so they set the window early
+    for (auto line = result.lines.rbegin(); line != result.lines.rend(); ++line) {
+      auto found = std::find(moves.begin(), moves.end(), line->move);
+      std::rotate(moves.begin(), found, found + 1);
+    }
+    if (std::abs(result.score) >= kMateScore - kMaxDepth) {
+      break;  // forced mate found; deeper iterations cannot change the result
+    }
+  }
+  return result;
+}
+
+Search::Result Search::searchRoot(int depth) {
+  line_ = game_manager_.getRepetitionHistory();
+  Result result;
+  const size_t wanted = static_cast<size_t>(std::max(limits_.multipv, 1));
+  for (EncodedMove move : moves_by_ply_[0]) {
+    // Only a move that beats the last of the lines can join them
+    const int alpha = result.lines.size() < wanted ? -kMateScore - 1 : result.lines.back().score;
+    UndoRecord undo;
+    board_.applyMove(move, portal_system_, undo);
+    line_.push(board_.positionKey(portal_system_), game_manager_.isIrreversible(move, undo));
+    int score = -negamax(depth - 1, -kMateScore - 1, -alpha, 1);
+    line_.pop();
+    board_.undoMove(move, undo, portal_system_);
+    if (aborted_) {
+      break;
+    }
+    if (result.lines.size() < wanted || score > alpha) {
+      Line line{move, score, {move}};
+      line.pv.insert(line.pv.end(), pv_by_ply_[1].begin(), pv_by_ply_[1].end());
+      // After every line with at least the same score, so ties keep move order
+      auto at = std::find_if(result.lines.begin(), result.lines.end(),
+                             [score](const Line& other) { return other.score < score; });
+      result.lines.insert(at, std::move(line));
+      if (result.lines.size() > wanted) {
+        result.lines.pop_back();
+      }
+    }
+  }
+  if (!result.lines.empty()) {
+    result.move = result.lines.front().move;
+    result.score = result.lines.front().score;
+    result.has_move = true;
+    result.depth = depth;
+  }
+  return result;
+}
+
+void Search::stop() {
+  stop_requested_.store(true, std::memory_order_relaxed);
+}
+
+void Search::clearStop() {
+  stop_requested_.store(false, std::memory_order_relaxed);
+  ponderhit_.store(false, std::memory_order_relaxed);
+}
+
+void Search::ponderhit() {
+  ponderhit_at_.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+  ponderhit_.store(true, std::memory_order_release);
+}
+
+int64_t Search::elapsedMs() const {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started_).count();
+}
+
+int64_t Search::limitedMs() const {
+  if (!limits_.ponder) {
+    return elapsedMs();
+  }
+  if (!ponderhit_.load(std::memory_order_acquire)) {
+    return -1;
+  }
+  const std::chrono::steady_clock::duration since_hit(
+      std::chrono::steady_clock::now().time_since_epoch().count() - ponderhit_at_.load(std::memory_order_relaxed));
+  return std::chrono::duration_cast<std::chrono::milliseconds>(since_hit).count();
+}
+
+// An external stop() is seen at the next node, or by the move generation
+// of the current one; the node budget and the clock are polled every
+// kCheckInterval nodes, once pondering is over
+bool Search::shouldAbort() {
+  if (aborted_) {
+    return true;
+  }
+  if (stop_requested_.load(std::memory_order_relaxed)) {
+    aborted_ = true;
+    return true;
+  }
+  if ((nodes_ & (kCheckInterval - 1)) != 0) {
+    return false;
+  }
+  const int64_t limited_ms = limitedMs();
+  if (limited_ms < 0) {
+    return false;
+  }
+  aborted_ = (limits_.nodes > 0 && nodes_ >= limits_.nodes) ||
+             (limits_.movetime_ms > 0 && limited_ms >= limits_.movetime_ms);
+  return aborted_;
+}
+
+namespace {
+// Scores beyond this are mates, stored in the table as distances from the
+// node rather than from the root so they stay right at any ply
+constexpr int kMateBound = Search::kMateScore / 2;
+
+int scoreToTable(int score, int ply) {
+  return score > kMateBound ? score + ply : score < -kMateBound ? score - ply : score;
+}
+
+int scoreFromTable(int score, int ply) {
+  return score > kMateBound ? score - ply : score < -kMateBound ? score + ply : score;
+}
+} // namespace
+
+// Mate distances count from the root, like the mates negamax finds itself
+bool Search::probeTablebases(int ply, int& score) const {
+  for (const Tablebase* table : tablebases_) {
+    Tablebase::Probe probe;
+    if (table->probe(board_, portal_system_, probe)) {
+      switch (probe.outcome) {
+        case Tablebase::Outcome::Win: score = kMateScore - (ply + probe.plies); break;
+        case Tablebase::Outcome::Loss: score = -kMateScore + ply + probe.plies; break;
+        case Tablebase::Outcome::Draw: score = 0; break;
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+int Search::negamax(int depth, int alpha, int beta, int ply) {
+  ++nodes_;
+  pv_by_ply_[ply].clear();
+  if (shouldAbort()) {
+    return 0;
+  }
+  if (line_.repetitionCount() > 0 || line_.halfmoveClock() >= GameManager::kFiftyMoveRulePlies) {
+    return 0;
+  }
+  int table_score;
+  if (ply > 0 && probeTablebases(ply, table_score)) {
+    return table_score;
+  }
+
+  if (depth <= 0) {
+    return evaluate();
+  }
+
+  const int alpha_before = alpha;
+  TranspositionTable::Entry entry;
+  const bool found = transposition_table_ && transposition_table_->probe(line_.currentKey(), entry);
+  if (found && entry.depth >= depth) {
+    // An exact score inside the window would join the principal variation,
+    // which the table does not keep, so that node is searched again (its
+    // move first) to leave the whole line in pv_by_ply_
+    const int score = scoreFromTable(entry.score, ply);
+    if ((entry.bound != TranspositionTable::Bound::Upper && score >= beta) ||
+        (entry.bound != TranspositionTable::Bound::Lower && score <= alpha)) {
+      return std::clamp(score, alpha, beta);
+    }
+  }
+
+  std::vector<EncodedMove>& moves = moves_by_ply_[ply];
+  const bool white = board_.isWhiteToMove();
+  if (!game_manager_.generateLegalMoves(white, moves, stop_requested_)) {
+    aborted_ = true;
+    return 0;
+  }
+  if (moves.empty()) {
+    return game_manager_.isInCheck(white) ? -kMateScore + ply : 0;
+  }
+  std::stable_sort(moves.begin(), moves.end(), [this](EncodedMove a, EncodedMove b) {
+    return moveOrderScore(a) > moveOrderScore(b);
+  });
+  if (found && entry.move.bits != 0) {
+    auto hinted = std::find(moves.begin(), moves.end(), entry.move);
+    if (hinted != moves.end()) {
+      std::rotate(moves.begin(), hinted, hinted + 1);
+    }
+  }
+
+  EncodedMove best_move;
+  for (EncodedMove move : moves) {
+    UndoRecord undo;
+    board_.applyMove(move, portal_system_, undo);
+    line_.push(board_.positionKey(portal_system_), game_manager_.isIrreversible(move, undo));
+    int score = -negamax(depth - 1, -beta, -alpha, ply + 1);
+    line_.pop();
+    board_.undoMove(move, undo, portal_system_);
+    if (aborted_) {
+      return 0;
+    }
+    if (score > alpha) {
+      alpha = score;
+      best_move = move;
+      if (alpha >= beta) {
+        break;
+      }
+      std::vector<EncodedMove>& pv = pv_by_ply_[ply];
+      pv.assign(1, move);
+      pv.insert(pv.end(), pv_by_ply_[ply + 1].begin(), pv_by_ply_[ply + 1].end());
+    }
+  }
+  if (transposition_table_) {
+    const TranspositionTable::Bound bound = alpha >= beta              ? TranspositionTable::Bound::Lower
+                                            : alpha > alpha_before ? TranspositionTable::Bound::Exact
+                                                                   : TranspositionTable::Bound::Upper;
+    transposition_table_->store(line_.currentKey(), best_move, scoreToTable(alpha, ply), depth, bound);
+  }
+  return alpha;
+}
@@ -0,0 +1,712 @@
+// Tablebase.cpp
+#include "Tablebase.hpp"
+#include "ChessBoard.hpp"
+#include "GameManager.hpp"
+#include "MoveValidator.hpp"
+#include "PortalSystem.hpp"
+#include "ThreadPool.hpp"
+#include "Zobrist.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+
+namespace {
+
+constexpr char kMagic[8] = {'C', 'W', 'P', 'T', 'B', '0', '1', '\0'};
+
+struct FileHeader {
+  char magic[8];
+  uint64_t layout_hash;
+  uint64_t entries;
+  uint32_t board_size;
+  uint32_t piece_count;
+  uint32_t symmetries;
+  uint32_t reserved;
+};
+static_assert(sizeof(FileHeader) == 40, "FileHeader layout is part of the file format");
+
+// Piece bytes follow the header, padded so the values start 8-byte aligned
+size_t valuesOffset(size_t piece_count) {
+  return (sizeof(FileHeader) + piece_count + 7) & ~size_t(7);
+}
+
+const char* kindName(PieceKind kind) {
+  switch (kind) {
+    case PieceKind::King: return "King";
+    case PieceKind::Queen: return "Queen";
+    case PieceKind::Rook: return "Rook";
+    case PieceKind::Bishop: return "Bishop";
+    case PieceKind::Knight: return "Knight";
+    default: return "";
+  }
+}
+
+char kindLetter(PieceKind kind) {
+  switch (kind) {
+    case PieceKind::King: return 'K';
+    case PieceKind::Queen: return 'Q';
+    case PieceKind::Rook: return 'R';
+    case PieceKind::Bishop: return 'B';
+    case PieceKind::Knight: return 'N';
+    default: return '?';
+  }
+}
+
+bool samePosition(const Position& a, const Position& b) {
+  return a.x == b.x && a.y == b.y;
+}
+
+// Table names list white then black pieces, each in K Q R B N order
+bool pieceOrder(const Tablebase::Piece& a, const Tablebase::Piece& b) {
+  if (a.is_white != b.is_white) return a.is_white;
+  return a.kind < b.kind;
+}
+
+// Places pieces on their squares after clearing the previous setup
+bool placePosition(const std::vector<Tablebase::Piece>& pieces, const Position* squares, bool white_to_move,
+                   const int* cooldowns, ChessBoard& board, PortalSystem& portal_system,
+                   std::vector<Position>& placed) {
+  for (const Position& pos : placed) {
+    board.setSquare(pos, ChessBoard::Square());
+  }
+  placed.clear();
+  bool overlap = false;
+  for (size_t i = 0; i < pieces.size(); ++i) {
+    if (!board.getSquare(squares[i]).is_empty()) {
+      overlap = true;
+      continue;
+    }
+    board.placePiece(kindName(pieces[i].kind), pieces[i].is_white, squares[i].x, squares[i].y);
+    placed.push_back(squares[i]);
+  }
+  board.setWhiteToMove(white_to_move);
+  for (size_t i = 0; i < portal_system.getPortals().size(); ++i) {
+    portal_system.setReadyAt(i, portal_system.getPly() + cooldowns[i]);
+  }
+  return !overlap;
+}
+
+} // namespace
+
+// The 8 symmetries of the square: identity, mirrors, rotations, transposes
+Position Tablebase::Layout::transform(int t, const Position& pos, int size) {
+  const int last = size - 1;
+  switch (t) {
+    case 1: return {last - pos.x, pos.y};
+    case 2: return {pos.x, last - pos.y};
+    case 3: return {last - pos.x, last - pos.y};
+    case 4: return {pos.y, pos.x};
+    case 5: return {last - pos.y, last - pos.x};
+    case 6: return {last - pos.y, pos.x};
+    case 7: return {pos.y, last - pos.x};
+    default: return pos;
+  }
+}
+
+void Tablebase::Layout::build(int side, const std::vector<Piece>& signature, const std::vector<PortalConfig>& portals,
+                              uint8_t symmetry_mask) {
+  board_size = side;
+  pieces = signature;
+  symmetries = symmetry_mask | 1;
+  const int squares = side * side;
+
+  // One square per orbit: the one with the lowest index
+  domain.clear();
+  domain_index.assign(squares, -1);
+  for (int s = 0; s < squares; ++s) {
+    const Position pos = {s % side, s / side};
+    bool lowest = true;
+    for (int t = 1; t < 8 && lowest; ++t) {
+      if (symmetries & (1u << t)) {
+        const Position image = transform(t, pos, side);
+        lowest = image.y * side + image.x >= s;
+      }
+    }
+    if (lowest) {
+      domain_index[s] = static_cast<int>(domain.size());
+      domain.push_back(s);
+    }
+  }
+
+  // Cooldowns start at the portal's cooldown and drop by one on the ply it is
+  // used, so cooldown values are 0 .. cooldown - 1
+  cooldown_radix.clear();
+  uint64_t cooldown_states = 1;
+  for (const auto& portal : portals) {
+    cooldown_radix.push_back(std::max(portal.properties.cooldown, 1));
+    cooldown_states *= cooldown_radix.back();
+  }
+  square_span = 1;
+  for (size_t i = 1; i < pieces.size(); ++i) {
+    square_span *= squares;
+  }
+  size = cooldown_states * 2 * (pieces.empty() ? 1 : domain.size()) * square_span;
+}
+
+uint64_t Tablebase::Layout::indexOf(const ChessBoard& board, const PortalSystem& portal_system) const {
+  if (board.getBoardSize() != board_size || board.getCastlingRights() != 0) {
+    return kNoIndex;
+  }
+  std::array<int, kMaxPieces> squares{};
+  std::array<bool, kMaxPieces> assigned{};
+  const bool extra = board.forEachPiece([&](const Position& pos, const ChessBoard::Square& square) {
+    for (size_t i = 0; i < pieces.size(); ++i) {
+      if (!assigned[i] && pieces[i].kind == square.kind && pieces[i].is_white == square.is_white) {
+        assigned[i] = true;
+        squares[i] = board.squareIndex(pos);
+        return false;
+      }
+    }
+    return true;  // a piece this table does not have
+  });
+  if (extra || std::count(assigned.begin(), assigned.begin() + pieces.size(), true) != static_cast<long>(pieces.size())) {
+    return kNoIndex;
+  }
+
+  uint64_t index = 0;
+  for (size_t i = 0; i < cooldown_radix.size(); ++i) {
+    const int remaining = portal_system.getRemainingCooldown(i);
+    if (remaining >= cooldown_radix[i]) {
+      return kNoIndex;
+    }
+    index = index * cooldown_radix[i] + remaining;
+  }
+  index = index * 2 + (board.isWhiteToMove() ? 0 : 1);
+  if (pieces.empty()) {
+    return index;
+  }
+
+  // The transform that brings the first piece into the domain applies to all pieces
+  const Position first = board.squarePosition(squares[0]);
+  int t = 0;
+  int first_index = -1;
+  for (; t < 8; ++t) {
+    if (symmetries & (1u << t)) {
+      const Position image = transform(t, first, board_size);
+      first_index = domain_index[image.y * board_size + image.x];
+      if (first_index >= 0) break;
+    }
+  }
+  index = index * domain.size() + first_index;
+  uint64_t rest = 0;
+  for (size_t i = 1; i < pieces.size(); ++i) {
+    const Position image = transform(t, board.squarePosition(squares[i]), board_size);
+    rest = rest * board_size * board_size + image.y * board_size + image.x;
+  }
+  return index * square_span + rest;
+}
+
+bool Tablebase::Layout::setUp(uint64_t index, ChessBoard& board, PortalSystem& portal_system,
+                              std::vector<Position>& placed) const {
+  std::array<Position, kMaxPieces> squares{};
+  const uint64_t board_squares = static_cast<uint64_t>(board_size) * board_size;
+  if (!pieces.empty()) {
+    uint64_t rest = index % square_span;
+    index /= square_span;
+    for (size_t i = pieces.size() - 1; i >= 1; --i) {
+      const int square = static_cast<int>(rest % board_squares);
+      rest /= board_squares;
+      squares[i] = {square % board_size, square / board_size};
+    }
+    const int first = domain[index % domain.size()];
+    index /= domain.size();
+    squares[0] = {first % board_size, first / board_size};
+  }
+  const bool white_to_move = index % 2 == 0;
+  index /= 2;
+  std::vector<int> remaining(cooldown_radix.size());
+  for (size_t i = cooldown_radix.size(); i-- > 0;) {
+    remaining[i] = static_cast<int>(index % cooldown_radix[i]);
+    index /= cooldown_radix[i];
+  }
+  return placePosition(pieces, squares.data(), white_to_move, remaining.data(), board, portal_system, placed);
+}
+
+bool Tablebase::parseSignature(const std::string& text, std::vector<Piece>& pieces) {
+  pieces.clear();
+  bool white = true;
+  for (char c : text) {
+    if (c == 'v' && white) {
+      white = false;
+      continue;
+    }
+    PieceKind kind;
+    switch (c) {
+      case 'K': kind = PieceKind::King; break;
+      case 'Q': kind = PieceKind::Queen; break;
+      case 'R': kind = PieceKind::Rook; break;
+      case 'B': kind = PieceKind::Bishop; break;
+      case 'N': kind = PieceKind::Knight; break;
+      default: return false;
+    }
+    pieces.push_back({kind, white});
+  }
+  std::stable_sort(pieces.begin(), pieces.end(), pieceOrder);
+  return !white && pieces.size() <= kMaxPieces;
+}
+
+std::string Tablebase::signatureName(const std::vector<Piece>& pieces) {
+  std::string white, black;
+  for (const Piece& piece : pieces) {
+    (piece.is_white ? white : black) += kindLetter(piece.kind);
+  }
+  return white + "v" + black;
+}
+
+uint64_t Tablebase::layoutHash(const GameConfig& config) {
+  uint64_t hash = Zobrist::mix(static_cast<uint64_t>(config.game_settings.board_size));
+  for (const auto& portal : config.portals) {
+    const auto& p = portal.positions;
+    uint64_t allowed = 0;
+    for (const auto& color : portal.properties.allowed_colors) {
+      allowed |= color == "white" ? 1 : color == "black" ? 2 : 4;
+    }
+    hash = Zobrist::mix(hash ^ (static_cast<uint64_t>(p.entry.x) | static_cast<uint64_t>(p.entry.y) << 16 |
+                                static_cast<uint64_t>(p.exit.x) << 32 | static_cast<uint64_t>(p.exit.y) << 48));
+    hash = Zobrist::mix(hash ^ (static_cast<uint64_t>(portal.properties.cooldown) << 8 | allowed << 2 |
+                                (portal.properties.preserve_direction ? 1u : 0u)));
+  }
+  return hash;
+}
+
+namespace {
+
+// A worker's private position for setting up and expanding table entries
+struct Context {
+  ChessBoard board;
+  MoveValidator validator;
+  PortalSystem portal_system;
+  GameManager game_manager;
+  std::vector<EncodedMove> moves;
+  std::vector<Position> placed;
+
+  explicit Context(const GameConfig& config)
+      : board(config.game_settings.board_size), portal_system(config.portals),
+        game_manager(board, validator, portal_system) {
+    game_manager.setParallelStatusThreshold(ChessBoard::kMaxBoardSize + 1);
+  }
+
+  // A position is reachable unless the side that just moved is in check
+  bool setUp(const Tablebase::Layout& layout, uint64_t index) {
+    return layout.setUp(index, board, portal_system, placed) &&
+           !GameManager::isKingAttacked(board, !board.isWhiteToMove(), validator, portal_system);
+  }
+};
+
+// Runs body(begin, end, slot) over [0, count) in chunks on every pool worker
+template <typename F>
+void parallelFor(ThreadPool& pool, size_t count, F&& body) {
+  const size_t chunk = std::max<size_t>(256, count / (pool.size() * 32 + 1));
+  std::atomic<size_t> next{0};
+  std::vector<std::future<void>> workers;
+  for (unsigned slot = 0; slot < pool.size(); ++slot) {
+    workers.push_back(pool.submit([&, slot] {
+      for (size_t begin = next.fetch_add(chunk); begin < count; begin = next.fetch_add(chunk)) {
+        body(begin, std::min(count, begin + chunk), slot);
+      }
+    }));
+  }
+  for (auto& worker : workers) {
+    worker.get();
+  }
+}
+
+struct Table {
+  Tablebase::Layout layout;
+  std::vector<uint8_t> values;
+};
+
+class Generator {
+public:
+  Generator(const GameConfig& config, const std::string& dir, unsigned threads)
+      : config_(config), dir_(dir), pool_(std::max(threads, 1u)) {}
+
+  const Table& solve(const std::vector<Tablebase::Piece>& pieces, std::vector<Tablebase::Summary>& summaries);
+
+private:
+  uint8_t detectSymmetries(const std::vector<Tablebase::Piece>& pieces);
+  void write(const Table& table, const std::string& name) const;
+
+  const GameConfig& config_;
+  std::string dir_;
+  ThreadPool pool_;
+  std::map<std::string, std::unique_ptr<Table>> tables_;
+};
+
+// The position after `move`, seen through transform t: sorted (square, piece)
+// codes followed by the portal cooldowns
+std::vector<int> successor(Context& context, EncodedMove move, int t) {
+  const int size = context.board.getBoardSize();
+  std::vector<int> result;
+  UndoRecord undo;
+  context.board.applyMove(move, context.portal_system, undo);
+  context.board.forEachPiece([&](const Position& pos, const ChessBoard::Square& square) {
+    const Position image = Tablebase::Layout::transform(t, pos, size);
+    result.push_back((context.board.squareIndex(image) * kPieceKindCount + static_cast<int>(square.kind)) * 2 +
+                     square.is_white);
+    return false;
+  });
+  std::sort(result.begin(), result.end());
+  for (size_t i = 0; i < context.portal_system.getPortals().size(); ++i) {
+    result.push_back(context.portal_system.getRemainingCooldown(i));
+  }
+  context.board.undoMove(move, undo, context.portal_system);
+  return result;
+}
+
+// The transforms the rules are invariant under, derived from how moves are
+// made rather than from the positions of this table:
+// - MoveValidator::getMoveEdges moves kings, queens, rooks, bishops and
+//   knights by their kind alone, the same in all 8 orientations (the config's
+//   movement fields do not enter into it); pawns keep their moves only under
+//   the left-right mirror, and any other kind gets no reduction at all.
+// - Table positions have no castling rights and no en passant square.
+// - Portals act by square, colour and cooldown only, so a transform has to
+//   fix every entry and exit square.
+// Sampled positions then confirm that move generation still agrees; a
+// transform that fails them means the derivation above is out of date, and
+// the table is not built rather than built wrong.
+uint8_t Generator::detectSymmetries(const std::vector<Tablebase::Piece>& pieces) {
+  const int size = config_.game_settings.board_size;
+  if (pieces.empty()) {
+    return 0xff;
+  }
+  uint8_t mask = 1;
+  for (int t = 1; t < 8; ++t) {
+    bool valid = true;
+    for (const auto& piece : pieces) {
+      switch (piece.kind) {
+        case PieceKind::King:
+        case PieceKind::Queen:
+        case PieceKind::Rook:
+        case PieceKind::Bishop:
+        case PieceKind::Knight: break;
+        case PieceKind::Pawn: valid = valid && t == 1; break;
+        default: valid = false; break;
+      }
+    }
+    for (const auto& portal : config_.portals) {
+      const auto& p = portal.positions;
+      valid = valid && samePosition(Tablebase::Layout::transform(t, p.entry, size), p.entry) &&
+              samePosition(Tablebase::Layout::transform(t, p.exit, size), p.exit);
+    }
+    if (valid) {
+      mask |= static_cast<uint8_t>(1u << t);
+    }
+  }
+
+  Tablebase::Layout plain;
+  plain.build(size, pieces, config_.portals, 1);
+  Context original(config_);
+  Context image(config_);
+  std::mt19937_64 rng(plain.size);
+  for (int t = 1; t < 8; ++t) {
+    if (!(mask & (1u << t))) continue;
+    for (int sample = 0, attempts = 0; sample < 200 && attempts < 20000; ++attempts) {
+      const uint64_t index = std::uniform_int_distribution<uint64_t>(0, plain.size - 1)(rng);
+      if (!original.setUp(plain, index)) continue;
+      ++sample;
+      std::array<Position, Tablebase::kMaxPieces> squares{};
+      std::vector<int> cooldowns;
+      for (size_t i = 0; i < original.placed.size(); ++i) {
+        squares[i] = Tablebase::Layout::transform(t, original.placed[i], size);
+      }
+      for (size_t i = 0; i < config_.portals.size(); ++i) {
+        cooldowns.push_back(original.portal_system.getRemainingCooldown(i));
+      }
+      placePosition(pieces, squares.data(), original.board.isWhiteToMove(), cooldowns.data(), image.board,
+                    image.portal_system, image.placed);
+
+      std::vector<std::vector<int>> expected, actual;
+      original.game_manager.generateLegalMoves(original.board.isWhiteToMove(), original.moves);
+      for (EncodedMove move : original.moves) {
+        expected.push_back(successor(original, move, t));
+      }
+      image.game_manager.generateLegalMoves(image.board.isWhiteToMove(), image.moves);
+      for (EncodedMove move : image.moves) {
+        actual.push_back(successor(image, move, 0));
+      }
+      std::sort(expected.begin(), expected.end());
+      std::sort(actual.begin(), actual.end());
+      if (expected != actual) {
+        throw std::logic_error("board transform " + std::to_string(t) + " changes the moves of " +
+                               Tablebase::signatureName(pieces) + "; the symmetry rules need updating");
+      }
+    }
+  }
+  return mask;
+}
+
+const Table& Generator::solve(const std::vector<Tablebase::Piece>& pieces,
+                              std::vector<Tablebase::Summary>& summaries) {
+  const std::string name = Tablebase::signatureName(pieces);
+  if (auto found = tables_.find(name); found != tables_.end()) {
+    return *found->second;
+  }
+  // Captures lead to tables with one piece fewer (two for a capture at a portal exit as well)
+  for (size_t i = 0; i < pieces.size(); ++i) {
+    std::vector<Tablebase::Piece> smaller = pieces;
+    smaller.erase(smaller.begin() + i);
+    solve(smaller, summaries);
+  }
+
+  const auto started = std::chrono::steady_clock::now();
+  auto table = std::make_unique<Table>();
+  Tablebase::Layout& layout = table->layout;
+  layout.build(config_.game_settings.board_size, pieces, config_.portals, detectSymmetries(pieces));
+  if (layout.size >= std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error(name + " has too many positions for this board");
+  }
+  const size_t count = layout.size;
+  std::vector<uint8_t>& values = table->values;
+  values.assign(count, Tablebase::kIllegal);
+  std::vector<uint16_t> remaining(count, 0);     // moves not yet known to lose
+  std::vector<uint64_t> resolved((count + 63) / 64, 0);
+  auto claim = [&resolved](uint32_t index) {
+    const uint64_t bit = 1ull << (index & 63);
+    return (std::atomic_ref<uint64_t>(resolved[index >> 6]).fetch_or(bit, std::memory_order_relaxed) & bit) == 0;
+  };
+  auto isResolved = [&resolved](uint32_t index) {
+    return (std::atomic_ref<uint64_t>(resolved[index >> 6]).load(std::memory_order_relaxed) >> (index & 63)) & 1;
+  };
+
+  // Pass 1: every legal position, its moves, and results of moves that leave the table
+  struct SlotOutput {
+    std::vector<std::pair<uint32_t, uint32_t>> edges;  // (position, successor) inside this table
+    std::vector<uint32_t> mated;
+    std::vector<std::pair<uint32_t, uint8_t>> exits;   // (position, value of the capture's result)
+  };
+  std::vector<SlotOutput> outputs(pool_.size());
+  parallelFor(pool_, count, [&](size_t begin, size_t end, unsigned slot) {
+    Context context(config_);
+    SlotOutput& out = outputs[slot];
+    for (size_t index = begin; index < end; ++index) {
+      if (!context.setUp(layout, index)) continue;
+      const bool white = context.board.isWhiteToMove();
+      context.game_manager.generateLegalMoves(white, context.moves);
+      values[index] = Tablebase::kDraw;
+      if (context.moves.empty()) {
+        claim(static_cast<uint32_t>(index));
+        if (context.game_manager.isInCheck(white)) {
+          values[index] = Tablebase::kLossBase;
+          out.mated.push_back(static_cast<uint32_t>(index));
+        }
+        continue;
+      }
+      remaining[index] = static_cast<uint16_t>(std::min<size_t>(context.moves.size(), UINT16_MAX));
+      for (EncodedMove move : context.moves) {
+        UndoRecord undo;
+        context.board.applyMove(move, context.portal_system, undo);
+        if (undo.captured == 0 && undo.exit_captured == 0) {
+          out.edges.emplace_back(static_cast<uint32_t>(index),
+                                 static_cast<uint32_t>(layout.indexOf(context.board, context.portal_system)));
+        } else {
+          std::vector<Tablebase::Piece> left;
+          context.board.forEachPiece([&](const Position&, const ChessBoard::Square& square) {
+            left.push_back({square.kind, square.is_white});
+            return false;
+          });
+          std::sort(left.begin(), left.end(), pieceOrder);
+          const Table& child = *tables_.at(Tablebase::signatureName(left));
+          out.exits.emplace_back(static_cast<uint32_t>(index),
+                                 child.values[child.layout.indexOf(context.board, context.portal_system)]);
+        }
+        context.board.undoMove(move, undo, context.portal_system);
+      }
+    }
+  });
+
+  // Predecessor lists, grouped by successor
+  std::vector<uint64_t> offsets(count + 1, 0);
+  for (const SlotOutput& out : outputs) {
+    for (const auto& edge : out.edges) ++offsets[edge.second + 1];
+  }
+  for (size_t i = 0; i < count; ++i) offsets[i + 1] += offsets[i];
+  std::vector<uint32_t> predecessors(offsets[count]);
+  {
+    std::vector<uint64_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (SlotOutput& out : outputs) {
+      for (const auto& edge : out.edges) predecessors[cursor[edge.second]++] = edge.first;
+      std::vector<std::pair<uint32_t, uint32_t>>().swap(out.edges);
+    }
+  }
+
+  // Results of captures join the layer of the position they lead to
+  std::vector<std::vector<uint32_t>> exit_losses(Tablebase::kMaxPlies + 2);  // opponent lost there
+  std::vector<std::vector<uint32_t>> exit_wins(Tablebase::kMaxPlies + 2);    // opponent won there
+  std::vector<uint32_t> frontier;
+  for (SlotOutput& out : outputs) {
+    frontier.insert(frontier.end(), out.mated.begin(), out.mated.end());
+    for (const auto& [index, value] : out.exits) {
+      if (value == Tablebase::kDraw || value == Tablebase::kIllegal) continue;
+      if (value >= Tablebase::kLossBase) {
+        exit_losses[value - Tablebase::kLossBase].push_back(index);
+      } else {
+        exit_wins[value].push_back(index);
+      }
+    }
+  }
+
+  // Layer k holds positions decided in k plies: losses on even k make their
+  // predecessors wins in k + 1; wins on odd k use up one of each predecessor's
+  // moves, and a predecessor with none left is a loss in k + 1
+  int longest = 0;
+  for (int k = 0; k <= Tablebase::kMaxPlies; ++k) {
+    std::vector<std::vector<uint32_t>> next(pool_.size());
+    const bool losses = k % 2 == 0;
+    auto reach = [&](uint32_t position, std::vector<uint32_t>& found) {
+      if (losses) {
+        if (claim(position)) {
+          values[position] = static_cast<uint8_t>(k + 1);
+          found.push_back(position);
+        }
+      } else if (!isResolved(position) &&
+                 std::atomic_ref<uint16_t>(remaining[position]).fetch_sub(1, std::memory_order_relaxed) == 1 &&
+                 claim(position)) {
+        values[position] = static_cast<uint8_t>(Tablebase::kLossBase + k + 1);
+        found.push_back(position);
+      }
+    };
+    parallelFor(pool_, frontier.size(), [&](size_t begin, size_t end, unsigned slot) {
+      for (size_t i = begin; i < end; ++i) {
+        const uint32_t position = frontier[i];
+        for (uint64_t p = offsets[position]; p < offsets[position + 1]; ++p) {
+          reach(predecessors[p], next[slot]);
+        }
+      }
+    });
+    for (uint32_t position : (losses ? exit_losses : exit_wins)[k]) {
+      reach(position, next[0]);
+    }
+
+    frontier.clear();
+    for (const auto& found : next) {
+      frontier.insert(frontier.end(), found.begin(), found.end());
+    }
+    if (!frontier.empty()) {
+      if (k + 1 > Tablebase::kMaxPlies) {
+        throw std::runtime_error(name + " has mates longer than " + std::to_string(Tablebase::kMaxPlies) + " plies");
+      }
+      longest = k + 1;
+    }
+    bool pending = !frontier.empty();
+    for (int later = k + 1; later <= Tablebase::kMaxPlies && !pending; ++later) {
+      pending = !exit_losses[later].empty() || !exit_wins[later].empty();
+    }
+    if (!pending) break;
+  }
+
+  Tablebase::Summary summary;
+  summary.name = name;
+  summary.positions = count;
+  summary.longest_plies = longest;
+  summary.symmetries = __builtin_popcount(layout.symmetries);
+  for (uint8_t value : values) {
+    if (value == Tablebase::kIllegal) ++summary.illegal;
+    else if (value == Tablebase::kDraw) ++summary.draws;
+    else if (value >= Tablebase::kLossBase) ++summary.losses;
+    else ++summary.wins;
+  }
+  write(*table, name);
+  summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  summaries.push_back(summary);
+  return *tables_.emplace(name, std::move(table)).first->second;
+}
+
+void Generator::write(const Table& table, const std::string& name) const {
+  const std::string path = dir_ + "/" + name + ".tb";
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    throw std::runtime_error("cannot write " + path);
+  }
+  FileHeader header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.layout_hash = Tablebase::layoutHash(config_);
+  header.entries = table.values.size();
+  header.board_size = static_cast<uint32_t>(table.layout.board_size);
+  header.piece_count = static_cast<uint32_t>(table.layout.pieces.size());
+  header.symmetries = table.layout.symmetries;
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  std::vector<char> pieces(valuesOffset(table.layout.pieces.size()) - sizeof(header), 0);
+  for (size_t i = 0; i < table.layout.pieces.size(); ++i) {
+    pieces[i] = static_cast<char>(static_cast<uint8_t>(table.layout.pieces[i].kind) |
+                                  (table.layout.pieces[i].is_white ? 0x80 : 0));
+  }
+  out.write(pieces.data(), static_cast<std::streamsize>(pieces.size()));
+  out.write(reinterpret_cast<const char*>(table.values.data()), static_cast<std::streamsize>(table.values.size()));
+  if (!out) {
+    throw std::runtime_error("cannot write " + path);
+  }
+}
+
+} // namespace
+
+std::vector<Tablebase::Summary> Tablebase::generate(const GameConfig& config, const std::string& signature,
+                                                    const std::string& dir, unsigned threads) {
+  std::vector<Piece> pieces;
+  if (!parseSignature(signature, pieces)) {
+    throw std::runtime_error("bad signature " + signature + " (expected e.g. KQvK, pieces K Q R B N)");
+  }
+  std::vector<Summary> summaries;
+  Generator generator(config, dir, threads);
+  generator.solve(pieces, summaries);
+  return summaries;
+}
+
+bool Tablebase::open(const std::string& path, const GameConfig& config) {
+  values_ = nullptr;
+  if (!file_.open(path) || file_.size() < sizeof(FileHeader)) {
+    return false;
+  }
+  FileHeader header;
+  std::memcpy(&header, file_.data(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.layout_hash != layoutHash(config) ||
+      header.piece_count > kMaxPieces ||
+      file_.size() != valuesOffset(header.piece_count) + header.entries) {
+    file_.close();
+    return false;
+  }
+  std::vector<Piece> pieces;
+  for (uint32_t i = 0; i < header.piece_count; ++i) {
+    const uint8_t byte = file_.data()[sizeof(header) + i];
+    pieces.push_back({static_cast<PieceKind>(byte & 0x7f), (byte & 0x80) != 0});
+  }
+  layout_.build(static_cast<int>(header.board_size), pieces, config.portals, static_cast<uint8_t>(header.symmetries));
+  if (layout_.size != header.entries) {
+    file_.close();
+    return false;
+  }
+  values_ = file_.data() + valuesOffset(header.piece_count);
+  name_ = signatureName(pieces);
+  return true;
+}
+
+bool Tablebase::probe(const ChessBoard& board, const PortalSystem& portal_system, Probe& result) const {
+  if (values_ == nullptr) {
+    return false;
+  }
+  const uint64_t index = layout_.indexOf(board, portal_system);
+  if (index == Layout::kNoIndex) {
+    return false;
+  }
+  const uint8_t value = values_[index];
+  if (value == kIllegal) {
+    return false;
+  }
+  if (value == kDraw) {
+    result = {Outcome::Draw, 0};
+  } else if (value >= kLossBase) {
+    result = {Outcome::Loss, value - kLossBase};
+  } else {
+    result = {Outcome::Win, value};
+  }
+  return true;
+}
@@ -0,0 +1,50 @@
+// TranspositionTable.cpp
+#include "TranspositionTable.hpp"
+#include <algorithm>
+
+TranspositionTable::TranspositionTable(size_t megabytes) {
+  const size_t wanted = std::max<size_t>(megabytes * (1 << 20) / sizeof(Slot), 1);
+  size_t capacity = 1;
+  while (capacity * 2 <= wanted) {
+    capacity *= 2;
+  }
+  slots_ = std::make_unique<Slot[]>(capacity);
+  mask_ = capacity - 1;
+}
+
+bool TranspositionTable::probe(uint64_t key, Entry& entry) const {
+  probes_.fetch_add(1, std::memory_order_relaxed);
+  const Slot& slot = slots_[key & mask_];
+  const uint64_t data = slot.data.load(std::memory_order_relaxed);
+  if ((slot.check.load(std::memory_order_relaxed) ^ data) != key || data == 0) {
+    return false;
+  }
+  entry.move = EncodedMove{static_cast<uint32_t>(data >> 32)};
+  entry.score = static_cast<int>((data >> 8) & 0xffffff) - kScoreBias;
+  entry.depth = static_cast<int>((data >> 2) & 0x3f);
+  entry.bound = static_cast<Bound>(data & 3);
+  hits_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void TranspositionTable::store(uint64_t key, EncodedMove move, int score, int depth, Bound bound) {
+  Slot& slot = slots_[key & mask_];
+  const uint64_t old = slot.data.load(std::memory_order_relaxed);
+  if ((slot.check.load(std::memory_order_relaxed) ^ old) == key && static_cast<int>((old >> 2) & 0x3f) > depth) {
+    return;
+  }
+  const uint64_t data = static_cast<uint64_t>(move.bits) << 32 |
+                        static_cast<uint64_t>(score + kScoreBias) << 8 |
+                        static_cast<uint64_t>(std::min(depth, 63)) << 2 | static_cast<uint64_t>(bound);
+  slot.data.store(data, std::memory_order_relaxed);
+  slot.check.store(key ^ data, std::memory_order_relaxed);
+}
+
+void TranspositionTable::clear() {
+  for (size_t i = 0; i <= mask_; ++i) {
+    slots_[i].check.store(0, std::memory_order_relaxed);
+    slots_[i].data.store(0, std::memory_order_relaxed);
+  }
+  hits_.store(0, std::memory_order_relaxed);
+  probes_.store(0, std::memory_order_relaxed);
+}
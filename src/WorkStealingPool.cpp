@@ -0,0 +1,102 @@
+// WorkStealingPool.cpp
+#include "WorkStealingPool.hpp"
+
+WorkStealingPool::WorkStealingPool(unsigned thread_count) {
+  if (thread_count == 0) {
+    thread_count = 1;
+  }
+  for (unsigned i = 0; i < thread_count; ++i) {
+    deques_.push_back(std::make_unique<Deque>());
+  }
+  workers_.reserve(thread_count);
+  for (unsigned i = 0; i < thread_count; ++i) {
+    workers_.emplace_back(&WorkStealingPool::workerLoop, this, i);
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  start_cv_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void WorkStealingPool::run(size_t count, const Task& task) {
+  const size_t workers = deques_.size();
+  for (size_t w = 0; w < workers; ++w) {
+    std::lock_guard<std::mutex> lock(deques_[w]->mutex);
+    // Reversed so the owner, taking from the back, walks its slice in order
+    for (size_t i = (w + 1) * count / workers; i > w * count / workers; --i) {
+      deques_[w]->tasks.push_back(i - 1);
+    }
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  task_ = &task;
+  error_ = nullptr;
+  steals_ = 0;
+  running_ = static_cast<unsigned>(workers);
+  ++generation_;
+  start_cv_.notify_all();
+  done_cv_.wait(lock, [this] { return running_ == 0; });
+  task_ = nullptr;
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+}
+
+bool WorkStealingPool::take(unsigned worker, size_t& index) {
+  {
+    Deque& own = *deques_[worker];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      index = own.tasks.back();
+      own.tasks.pop_back();
+      return true;
+    }
+  }
+  for (size_t offset = 1; offset < deques_.size(); ++offset) {
+    Deque& victim = *deques_[(worker + offset) % deques_.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      index = victim.tasks.front();
+      victim.tasks.pop_front();
+      steals_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingPool::workerLoop(unsigned worker) {
+  size_t seen = 0;
+  while (true) {
+    const Task* task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_cv_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+      if (stopping_) {
+        return;
+      }
+      seen = generation_;
+      task = task_;
+    }
+    // Tasks never add tasks, so once every deque is empty this worker is done
+    size_t index;
+    while (take(worker, index)) {
+      try {
+        (*task)(index, worker);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!error_) error_ = std::current_exception();
+      }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--running_ == 0) {
+      done_cv_.notify_all();
+    }
+  }
+}
@@ -1,37 +1,42 @@
 #include "ChessBoard.hpp"
+#include "ComputerPlayer.hpp"
 #include "ConfigReader.hpp"
 #include "MoveValidator.hpp"
 #include "PortalSystem.hpp"
 #include "GameManager.hpp"
+#include "GameJournal.hpp"
+#include "EngineProtocol.hpp"
+#include "GameServer.hpp"
+#include "GameRecord.hpp"
+#include "MateSolver.hpp"
+#include "OpeningBook.hpp"
+#include "PositionNotation.hpp"
+#include "Search.hpp"
+#include "TranspositionTable.hpp"
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <vector>
 #include <cctype>
+#include <cerrno>
+#include <algorithm>
+#include <cstdlib>
+#include <csignal>
+#include <iomanip>
+#include <memory>
+#include <poll.h>
+#include <unistd.h>
 
-// Parse position string (e.g., "a1" -> Position{0, 0})
+// Parse position string (e.g., "a1" -> Position{0, 0}, "ab10" -> Position{27, 9})
 bool parsePosition(const std::string& pos_str, Position& pos, int board_size) {
-  if (pos_str.length() < 2) {
-    std::cerr << "Invalid position\n";
-    return false;
-  }
-  char col = std::tolower(pos_str[0]);
-  std::string row_str = pos_str.substr(1);
-  if (col < 'a' || col >= 'a' + board_size) {
-    std::cerr << "Invalid position\n";
-    return false;
-  }
-  try {
-    int row = std::stoi(row_str) - 1; // User enters 1-8, program uses 0-7
-    if (row < 0 || row >= board_size) {
-      std::cerr << "Invalid position\n";
-      return false;
-    }
-    pos = {col - 'a', row};
-    return true;
-  } catch (...) {
+  Position parsed;
+  if (!ChessBoard::parseNotation(pos_str, parsed) || parsed.x >= board_size ||
+      parsed.y < 0 || parsed.y >= board_size) {
     std::cerr << "Invalid position\n";
     return false;
   }
+  pos = parsed;
+  return true;
 }
 
 // Process command line input
@@ -69,9 +74,9 @@ bool processMoveCommand(const std::string& command, ChessBoard& board,
 
   // Check if piece type matches input
   std::string piece_lower = validator.toLowerCase(piece);
-  std::string square_piece_lower = validator.toLowerCase(start_square.piece);
+  std::string square_piece_lower = validator.toLowerCase(board.pieceName(start_square));
   if (piece_lower != square_piece_lower) {
-    std::cout << "Piece at starting position (" << start_square.piece
+    std::cout << "Piece at starting position (" << board.pieceName(start_square)
               << ") does not match specified piece (" << piece << ").\n";
     return false;
   }
@@ -88,44 +93,440 @@ bool processMoveCommand(const std::string& command, ChessBoard& board,
   }
 }
 
+// Lines from std::cin, waited for with poll() so the game loop can wait on
+// the computer player's search at the same time. std::cin must not be
+// synced with stdio: its buffer then shows whether a line is already read
+// in. Everything else (the promotion prompt) keeps reading std::cin.
+class InputLines {
+public:
+  enum class Event { Line, Other, End };
+
+  // Waits for a line, or for `other_fd` (-1 for none) to become readable.
+  // End comes only once std::cin is exhausted and there is no other fd;
+  // with one, stdin just stops being watched. `want_line` false leaves
+  // typed lines unread.
+  Event wait(int other_fd, std::string& line, bool want_line = true) {
+    while (true) {
+      const bool watch_input = want_line && !eof_;
+      if (watch_input && std::cin.rdbuf()->in_avail() != 0) {
+        break;  // buffered input, or a known end of input
+      }
+      if (!watch_input && other_fd < 0) {
+        return Event::End;
+      }
+      pollfd fds[2] = {{watch_input ? STDIN_FILENO : -1, POLLIN, 0}, {other_fd, POLLIN, 0}};
+      if (::poll(fds, 2, -1) < 0) {
+        if (errno == EINTR) continue;
+        break;  // let the read below report the failure
+      }
+      if (fds[1].revents & POLLIN) {
+        return Event::Other;
+      }
+      if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+        break;
+      }
+    }
+    if (std::getline(std::cin, line)) {
+      return Event::Line;
+    }
+    eof_ = true;
+    return other_fd < 0 ? Event::End : wait(other_fd, line, want_line);
+  }
+
+private:
+  bool eof_ = false;
+};
+
+// Sets up `position` (PositionNotation text) unless it is empty
+bool setUpPosition(const GameConfig& config, const std::string& position, ChessBoard& board,
+                   PortalSystem& portal_system) {
+  if (position.empty()) {
+    return true;
+  }
+  const char* error = nullptr;
+  if (!PositionNotation(config.pieces).parse(position, board, portal_system, &error)) {
+    std::cerr << "Invalid position: " << error << "\n";
+    return false;
+  }
+  return true;
+}
+
+// Forced mate search from `position` (the config's start position if empty)
+// after `move_list` (coordinate moves such as "f2f3 e7e5 g2g4")
+int solveMate(const GameConfig& config, int max_moves, const std::string& position, const std::string& move_list,
+              size_t node_budget) {
+  ChessBoard board(config.game_settings.board_size);
+  board.initializeBoard(config.pieces);
+  MoveValidator validator;
+  PortalSystem portal_system(config.portals);
+  if (!setUpPosition(config, position, board, portal_system)) {
+    return 1;
+  }
+  GameManager game_manager(board, validator, portal_system);
+
+  std::istringstream moves_in(move_list);
+  std::string text;
+  std::vector<EncodedMove> legal;
+  while (moves_in >> text) {
+    EncodedMove move;
+    game_manager.generateLegalMoves(board.isWhiteToMove(), legal);
+    if (!board.parseMove(text, move) || std::find(legal.begin(), legal.end(), move) == legal.end()) {
+      std::cerr << "Illegal move: " << text << "\n";
+      return 1;
+    }
+    game_manager.makeMove(move);
+  }
+
+  MateSolver solver(board, game_manager, portal_system);
+  MateSolver::Result result = solver.solve(max_moves, node_budget);
+  switch (result.status) {
+    case MateSolver::Status::Mate:
+      // The mate is proven either way; a line the budget cut short is marked as such
+      std::cout << "mate in " << result.mate_in
+                << (result.line_complete ? ":" : " (partial line, node budget exhausted while reading it):");
+      for (EncodedMove move : result.line) {
+        std::cout << " " << board.moveToNotation(move);
+        UndoRecord undo;
+        board.applyMove(move, portal_system, undo);
+      }
+      std::cout << (result.line_complete ? "\n" : " ...\n");
+      break;
+    case MateSolver::Status::NoMate:
+      std::cout << "no mate in " << max_moves << "\n";
+      break;
+    case MateSolver::Status::Unknown:
+      std::cout << "unknown: node budget of " << node_budget << " exhausted\n";
+      break;
+  }
+  std::cout << "nodes: " << result.nodes << "\n";
+  return 0;
+}
+
+// Book moves for the current position with their share of the total weight
+void printBookMoves(const OpeningBook& book, const ChessBoard& board, const PortalSystem& portal_system) {
+  std::vector<OpeningBook::Candidate> candidates;
+  book.lookup(board.positionKey(portal_system), candidates);
+  if (candidates.empty()) {
+    std::cout << "No book moves for this position.\n";
+    return;
+  }
+  uint64_t total = 0;
+  for (const auto& candidate : candidates) {
+    total += candidate.weight;
+  }
+  for (const auto& candidate : candidates) {
+    std::cout << "  " << board.moveToNotation(candidate.move) << "  weight " << candidate.weight << "  ("
+              << candidate.weight * 100 / total << "%)\n";
+  }
+}
+
+// A search score as the player reads it: pawns, or moves to a forced mate
+std::string describeScore(int score) {
+  if (std::abs(score) >= Search::kMateScore - Search::kMaxDepth) {
+    const int moves = (Search::kMateScore - std::abs(score) + 1) / 2;
+    return (score > 0 ? "mate in " : "mated in ") + std::to_string(moves);
+  }
+  std::ostringstream text;
+  text << std::showpos << std::fixed << std::setprecision(2) << score / 100.0;
+  return text.str();
+}
+
+// Moves a bare `hint` lists
+constexpr int kDefaultHints = 3;
+
+// The best `count` moves for the side to move, each with its score and the
+// line expected after it, from one multi-PV search of `movetime_ms` on the
+// game itself (the search puts every move back). `table` outlives the call,
+// so repeated hints, and the computer's own searches, build on each other.
+void printHint(ChessBoard& board, GameManager& game_manager, PortalSystem& portal_system, int count,
+               int64_t movetime_ms, TranspositionTable& table) {
+  Search search(board, game_manager, portal_system);
+  search.setTranspositionTable(&table);
+  Search::Limits limits;
+  limits.movetime_ms = movetime_ms;
+  limits.multipv = count;
+  const Search::Result result = search.think(limits);
+  if (!result.has_move) {
+    std::cout << "No legal moves.\n";
+    return;
+  }
+  std::cout << "Best moves (depth " << result.depth << "):\n";
+  for (size_t i = 0; i < result.lines.size(); ++i) {
+    const Search::Line& line = result.lines[i];
+    std::cout << "  " << i + 1 << ". " << board.moveToNotation(line.move) << "  " << describeScore(line.score)
+              << "  " << board.lineToNotation(line.pv, portal_system) << "\n";
+  }
+}
+
+// Serves games over a socket (GameServer) until SIGINT or SIGTERM
+GameServer* g_server = nullptr;
+
+int serve(const GameConfig& config, const std::string& address, const GameServer::Options& base) {
+  GameServer::Options options = base;
+  if (address.rfind("unix:", 0) == 0 && address.size() > 5) {
+    options.unix_path = address.substr(5);
+  } else if (address.rfind("tcp:", 0) == 0 && address.size() > 4) {
+    options.tcp_port = std::atoi(address.c_str() + 4);
+  } else {
+    std::cerr << "Invalid address " << address << " (expected unix:PATH or tcp:PORT)\n";
+    return 1;
+  }
+  GameServer server(config, options);
+  std::string error;
+  if (!server.start(&error)) {
+    std::cerr << "Cannot serve: " << error << "\n";
+    return 1;
+  }
+  g_server = &server;
+  std::signal(SIGINT, [](int) { g_server->stop(); });
+  std::signal(SIGTERM, [](int) { g_server->stop(); });
+  if (options.unix_path.empty()) {
+    std::cout << "Serving on 127.0.0.1:" << server.port() << std::endl;
+  } else {
+    std::cout << "Serving on " << options.unix_path << std::endl;
+  }
+  server.run();
+  std::signal(SIGINT, SIG_DFL);
+  std::signal(SIGTERM, SIG_DFL);
+  g_server = nullptr;
+  return 0;
+}
+
 int main(int argc, char* argv[]) {
+  // Before any I/O; InputLines relies on it
+  std::ios::sync_with_stdio(false);
   if (!std::cin.good()) {
     std::cerr << "Input error\n";
     return 1;
   }
 
-  std::string config_file = (argc > 1) ? argv[1] : "data/chess_pieces.json";
+  // Usage: chess_game [config.json] [simple] [--engine] [--book FILE] [--record FILE] [--position XFEN]
+  //                   [--journal PATH]
+  //                   [--computer white|black [--no-ponder]] [--movetime MS (computer moves and hints)]
+  //        chess_game [config.json] --solve-mate N [--position XFEN] [--moves "e2e4 e7e5 ..."] [--nodes BUDGET]
+  //        chess_game [config.json] --serve unix:PATH|tcp:PORT [--workers N] [--max-sessions N]
+  std::vector<std::string> args;
+  bool engine_mode = false;
+  int solve_mate = 0;
+  std::string move_list;
+  size_t node_budget = 2000000;
+  std::string book_path;
+  std::string record_path;
+  std::string position;
+  std::string journal_path;
+  std::string serve_address;
+  GameServer::Options server_options;
+  std::string computer_side;
+  int64_t computer_movetime = 1000;
+  bool computer_ponders = true;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--engine") {
+      engine_mode = true;
+    } else if (arg == "--solve-mate" && i + 1 < argc) {
+      solve_mate = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--moves" && i + 1 < argc) {
+      move_list = argv[++i];
+    } else if (arg == "--nodes" && i + 1 < argc) {
+      node_budget = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--book" && i + 1 < argc) {
+      book_path = argv[++i];
+    } else if (arg == "--record" && i + 1 < argc) {
+      record_path = argv[++i];
+    } else if (arg == "--position" && i + 1 < argc) {
+      position = argv[++i];
+    } else if (arg == "--journal" && i + 1 < argc) {
+      journal_path = argv[++i];
+    } else if (arg == "--computer" && i + 1 < argc) {
+      computer_side = argv[++i];
+    } else if (arg == "--movetime" && i + 1 < argc) {
+      computer_movetime = std::max<int64_t>(1, std::atoll(argv[++i]));
+    } else if (arg == "--no-ponder") {
+      computer_ponders = false;
+    } else if (arg == "--serve" && i + 1 < argc) {
+      serve_address = argv[++i];
+    } else if (arg == "--workers" && i + 1 < argc) {
+      server_options.workers = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+    } else if (arg == "--max-sessions" && i + 1 < argc) {
+      server_options.max_sessions = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+    } else {
+      args.push_back(argv[i]);
+    }
+  }
+
+  std::string config_file = !args.empty() ? args[0] : "data/chess_pieces.json";
   ConfigReader config_reader;
   if (!config_reader.loadFromFile(config_file)) {
     std::cerr << "Failed to load configuration file\n";
     return 1;
   }
 
-  std::string display_format = (argc > 2 && std::string(argv[2]) == "simple") ? "simple" : "detailed";
+  std::string display_format = (args.size() > 1 && args[1] == "simple") ? "simple" : "detailed";
   int board_size = config_reader.getConfig().game_settings.board_size;
   
-  if (board_size <= 0 || board_size > 26) {
+  if (board_size <= 0 || board_size > ChessBoard::kMaxBoardSize) {
     std::cerr << "Invalid board size\n";
     return 1;
   }
 
+  if (engine_mode) {
+    EngineProtocol engine(config_reader.getConfig());
+    return engine.run(std::cin, std::cout);
+  }
+  if (!serve_address.empty()) {
+    return serve(config_reader.getConfig(), serve_address, server_options);
+  }
+  if (solve_mate > 0) {
+    return solveMate(config_reader.getConfig(), solve_mate, position, move_list, node_budget);
+  }
+  if (!position.empty() && !record_path.empty()) {
+    std::cerr << "Archives hold games from the start position; --record cannot be used with --position\n";
+    return 1;
+  }
+  const bool resume = !journal_path.empty() && GameJournal::exists(journal_path);
+  if (resume && !position.empty()) {
+    std::cerr << "A session is already journaled at " << journal_path << "; --position only starts new ones\n";
+    return 1;
+  }
+  if (!journal_path.empty() && !record_path.empty()) {
+    std::cerr << "--record cannot be used with --journal\n";
+    return 1;
+  }
+  if (!computer_side.empty() && computer_side != "white" && computer_side != "black") {
+    std::cerr << "--computer takes white or black\n";
+    return 1;
+  }
+
   ChessBoard board(board_size, display_format);
   board.initializeBoard(config_reader.getConfig().pieces);
   MoveValidator validator;
   PortalSystem portal_system(config_reader.getConfig().portals);
+  if (!setUpPosition(config_reader.getConfig(), position, board, portal_system)) {
+    return 1;
+  }
   GameManager game_manager(board, validator, portal_system);
+  game_manager.setTurnLimit(config_reader.getConfig().game_settings.turn_limit);
+  OpeningBook book;
+  if (!book_path.empty() && !book.open(book_path, config_reader.getConfig())) {
+    std::cerr << "Cannot use book " << book_path << " with this configuration\n";
+    return 1;
+  }
+  // Appends the game to a binary archive when it ends (or the player quits)
+  GameRecordWriter recorder;
+  if (!record_path.empty()) {
+    if (!recorder.open(record_path, config_reader.getConfig())) {
+      std::cerr << "Cannot record to " << record_path << " (unwritable or another configuration's archive)\n";
+      return 1;
+    }
+    game_manager.setRecorder(&recorder);
+  }
+  // Logs every move as it is made; a restarted game picks up where it stopped
+  GameJournal journal;
+  if (!journal_path.empty()) {
+    const char* error = nullptr;
+    if (resume) {
+      if (!journal.recover(journal_path, config_reader.getConfig(), board, portal_system, game_manager, &error)) {
+        std::cerr << "Cannot recover " << journal_path << ": " << error << "\n";
+        return 1;
+      }
+      std::cout << "Recovered session " << journal_path << " at move " << game_manager.getHistorySize() << " ("
+                << journal.replayedRecords() << " log records after the snapshot)\n";
+    } else if (!journal.create(journal_path, config_reader.getConfig(), board, portal_system, game_manager)) {
+      std::cerr << "Cannot write journal " << journal_path << "\n";
+      return 1;
+    }
+    game_manager.setJournal(&journal);
+  }
+  // Plays one side, pondering on the other side's time
+  std::unique_ptr<ComputerPlayer> computer;
+  const bool computer_white = computer_side == "white";
+  if (!computer_side.empty()) {
+    computer = std::make_unique<ComputerPlayer>(config_reader.getConfig(), computer_movetime);
+  }
+  // For hint: the computer's table when there is a computer, else its own
+  std::unique_ptr<TranspositionTable> hint_table;
+  bool computer_thinking = false;
+  auto startPondering = [&] {
+    if (computer && computer_ponders) {
+      computer->ponder(board, portal_system, game_manager);
+    }
+  };
+  GameResult result = GameResult::Unknown;
+  // After a move by `mover_white`: reports the end of the game, if it is over
+  auto gameOver = [&](bool mover_white) {
+    if (game_manager.isCheckmate(!mover_white)) {
+      std::cout << (mover_white ? "White" : "Black") << " checkmate! Game over.\n";
+      result = mover_white ? GameResult::WhiteWin : GameResult::BlackWin;
+      return true;
+    }
+    if (game_manager.isStalemate(!mover_white)) {
+      std::cout << "Game ended in stalemate.\n";
+      result = GameResult::Draw;
+      return true;
+    }
+    if (const char* reason = game_manager.getDrawReason()) {
+      std::cout << "Game drawn by " << reason << ".\n";
+      result = GameResult::Draw;
+      return true;
+    }
+    return false;
+  };
 
-  std::cout << "Initial board:\n";
+  std::cout << (resume ? "Board:\n" : "Initial board:\n");
   board.printBoard();
-  std::cout << "Commands: move <start> <end> <piece> (e.g., move a1 b2 king), undo, quit\n";
+  std::cout << "Commands: move <start> <end> <piece> (e.g., move a1 b2 king), undo, redo, "
+            << (book.isOpen() ? "book, " : "") << (journal.isOpen() ? "snapshot, " : "")
+            << "hint [K], " << (computer ? "stop (computer moves now), " : "") << "quit\n";
+  if (computer && board.isWhiteToMove() != computer_white) {
+    startPondering();
+  }
 
-  bool is_white_turn = true;
+  InputLines input;
   std::string command;
+  std::string pending;  // typed while the computer was thinking
   while (true) {
+    bool is_white_turn = board.isWhiteToMove();
+    if (computer && is_white_turn == computer_white) {
+      if (!computer_thinking) {
+        computer->think(board, portal_system, game_manager);
+        computer_thinking = true;
+      }
+      // Typing goes on while it thinks; only stop and quit act at once
+      InputLines::Event event = input.wait(computer->readyFd(), command, pending.empty());
+      if (event == InputLines::Event::Line) {
+        if (command == "quit") {
+          std::cout << "Game ended.\n";
+          break;
+        }
+        if (command == "stop") {
+          computer->moveNow();
+        } else {
+          pending = command;
+        }
+        continue;
+      }
+      computer_thinking = false;
+      EncodedMove move;
+      if (!computer->takeMove(move)) {
+        break;
+      }
+      std::cout << "Computer plays " << board.moveToNotation(move) << "\n";
+      game_manager.makeMove(move);
+      board.printBoard();
+      if (gameOver(is_white_turn)) {
+        break;
+      }
+      startPondering();
+      continue;
+    }
+
     std::cout << (is_white_turn ? "White" : "Black") << " player's turn > ";
     std::cout.flush();
     
-    if (!std::getline(std::cin, command)) {
+    if (!pending.empty()) {
+      command.swap(pending);
+      pending.clear();
+    } else if (input.wait(-1, command) == InputLines::Event::End) {
       break;
     }
 
@@ -134,29 +535,72 @@ int main(int argc, char* argv[]) {
       break;
     }
 
+    // Against the computer, undo and redo step over its move too, back to
+    // this side's turn
     if (command == "undo") {
+      if (computer) computer->cancel();
       game_manager.undoMove();
+      if (computer && board.isWhiteToMove() == computer_white) game_manager.undoMove();
       board.printBoard();
-      is_white_turn = !is_white_turn;
+      if (board.isWhiteToMove() != computer_white) startPondering();
+      continue;
+    }
+
+    if (command == "redo") {
+      if (computer) computer->cancel();
+      game_manager.redoMove();
+      if (computer && board.isWhiteToMove() == computer_white) game_manager.redoMove();
+      board.printBoard();
+      if (board.isWhiteToMove() != computer_white) startPondering();
+      continue;
+    }
+
+    if (command == "snapshot" && journal.isOpen()) {
+      if (journal.snapshot(board, portal_system, game_manager)) {
+        std::cout << "Snapshot written; the log starts over.\n";
+      } else {
+        std::cout << "Cannot write the snapshot.\n";
+      }
+      continue;
+    }
+
+    if (command == "book" && book.isOpen()) {
+      printBookMoves(book, board, portal_system);
+      continue;
+    }
+
+    if (command == "hint" || command.rfind("hint ", 0) == 0) {
+      const int count = command.size() > 5 ? std::atoi(command.c_str() + 5) : kDefaultHints;
+      if (!computer && !hint_table) {
+        hint_table = std::make_unique<TranspositionTable>(ComputerPlayer::kHashMb);
+      }
+      printHint(board, game_manager, portal_system, std::max(count, 1), computer_movetime,
+                computer ? computer->transpositionTable() : *hint_table);
       continue;
     }
 
     if (!command.empty()) {
       if (processMoveCommand(command, board, validator, portal_system, game_manager, is_white_turn)) {
-        if (game_manager.isCheckmate(!is_white_turn)) {
-          std::cout << (is_white_turn ? "White" : "Black") << " checkmate! Game over.\n";
+        if (gameOver(is_white_turn)) {
           break;
         }
-        if (game_manager.isStalemate(!is_white_turn)) {
-          std::cout << "Game ended in stalemate.\n";
-          break;
+        if (computer) {
+          computer->opponentMoved(game_manager.getMoveHistory()[game_manager.getHistorySize() - 1], board,
+                                  portal_system, game_manager);
+          computer_thinking = true;
         }
-        is_white_turn = !is_white_turn;
       }
     } else {
       std::cout << "Empty command. Example: move a1 b2 king\n";
     }
   }
 
+  if (computer && computer->ponderSearches() > 0) {
+    std::cout << "The computer guessed " << computer->ponderHits() << " of " << computer->ponderSearches()
+              << " replies while pondering.\n";
+  }
+  if (recorder.isOpen()) {
+    recorder.finishGame(result);
+  }
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,1118 @@
+// bench.cpp - micro benchmarks for engine hot paths
+//
+// Usage: bench status [min_size] [max_size] [repeats]
+//        bench alloc [iterations]
+//        bench sliders [min_size] [max_size] [repeats]
+//        bench sparse [size] [pieces] [repeats]
+//        bench mcts [max_threads] [milliseconds] [position]
+//        bench notation [positions]
+//        bench journal [sessions] [plies]
+//        bench config [megabytes]
+//        bench server [max_sessions]
+//        bench stop [trials]
+//        bench analysis [jobs] [depth] [threads]
+//        bench multipv [depth] [position]
+//
+// Positions are PositionNotation text with the standard piece letters.
+#include "AnalysisService.hpp"
+#include "AttackMap.hpp"
+#include "ChessBoard.hpp"
+#include "ConfigReader.hpp"
+#include "GameJournal.hpp"
+#include "GameManager.hpp"
+#include "GameServer.hpp"
+#include "Mcts.hpp"
+#include "MoveValidator.hpp"
+#include "PortalSystem.hpp"
+#include "PositionNotation.hpp"
+#include "ScratchArena.hpp"
+#include "Search.hpp"
+#include "TranspositionTable.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <random>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Count every global allocation so `bench alloc` can show the hot path makes none
+static std::atomic<size_t> g_allocations{0};
+
+void* operator new(std::size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Fill the board with white pawns on even files, each blocked by a black pawn
+// directly ahead. White then has no legal move, so hasLegalMove() has to scan
+// every piece against every square - the worst case for status detection.
+void setupBlockedPawns(ChessBoard& board) {
+  int size = board.getBoardSize();
+  for (int y = 1; y + 1 < size; y += 2) {
+    for (int x = 0; x < size; x += 2) {
+      board.placePiece("Pawn", true, x, y);
+      board.placePiece("Pawn", false, x, y + 1);
+    }
+  }
+}
+
+constexpr const char* kStandardStart = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -";
+
+// Sets up `position` (PositionNotation), exiting if it does not parse
+void setupPosition(ChessBoard& board, PortalSystem& portal_system, const char* position) {
+  const char* error = nullptr;
+  if (!PositionNotation().parse(position, board, portal_system, &error)) {
+    std::cerr << "invalid position: " << error << "\n";
+    std::exit(1);
+  }
+}
+
+void setupStandard(ChessBoard& board) {
+  PortalSystem portal_system({});
+  setupPosition(board, portal_system, kStandardStart);
+}
+
+double timeHasLegalMove(GameManager& manager, int repeats) {
+  auto begin = Clock::now();
+  for (int i = 0; i < repeats; ++i) {
+    if (manager.hasLegalMove(true)) {
+      std::cerr << "benchmark position unexpectedly has a legal move\n";
+      std::exit(1);
+    }
+  }
+  std::chrono::duration<double, std::milli> elapsed = Clock::now() - begin;
+  return elapsed.count() / repeats;
+}
+
+int benchStatus(int min_size, int max_size, int repeats) {
+  std::cout << "threads: " << std::thread::hardware_concurrency() << "\n";
+  std::cout << std::setw(6) << "size" << std::setw(14) << "serial ms" << std::setw(14) << "parallel ms"
+            << std::setw(10) << "speedup" << "\n";
+  for (int size = min_size; size <= max_size; size += 2) {
+    ChessBoard board(size);
+    setupBlockedPawns(board);
+    MoveValidator validator;
+    PortalSystem portal_system({});
+    GameManager manager(board, validator, portal_system);
+
+    manager.setParallelStatusThreshold(INT_MAX);
+    double serial = timeHasLegalMove(manager, repeats);
+    manager.setParallelStatusThreshold(0);
+    double parallel = timeHasLegalMove(manager, repeats);
+
+    std::cout << std::fixed << std::setprecision(3) << std::setw(6) << size << std::setw(14) << serial
+              << std::setw(14) << parallel << std::setw(10) << serial / parallel << "\n";
+  }
+  const int cut_over = GameManager::measuredParallelStatusMinBoardSize();
+  std::cout << "default cut-over (measured): ";
+  if (cut_over > ChessBoard::kMaxBoardSize) std::cout << "never\n";
+  else std::cout << cut_over << "\n";
+  return 0;
+}
+
+// Status evaluation plus apply/undo of every legal first move must not touch
+// the global heap once the thread's arena and scratch board are warm.
+int benchAlloc(int iterations) {
+  ChessBoard board(8);
+  setupStandard(board);
+  MoveValidator validator;
+  PortalSystem portal_system({});
+  GameManager manager(board, validator, portal_system);
+  manager.setParallelStatusThreshold(INT_MAX);
+
+  std::vector<EncodedMove> moves;
+  for (int y = 0; y < 2; ++y) {
+    for (int x = 0; x < 8; ++x) {
+      for (int ty = 0; ty < 8; ++ty) {
+        for (int tx = 0; tx < 8; ++tx) {
+          const auto& square = board.getSquare({x, y});
+          if (validator.isValidMove(board.pieceName(square), {x, y}, {tx, ty}, true, board, portal_system,
+                                    false)) {
+            moves.push_back(board.encodeMove({x, y}, {tx, ty}));
+          }
+        }
+      }
+    }
+  }
+
+  auto workload = [&] {
+    bool status = manager.isCheckmate(true) || manager.isStalemate(true) || !manager.hasLegalMove(true);
+    for (EncodedMove move : moves) {
+      UndoRecord undo;
+      board.applyMove(move, portal_system, undo);
+      status |= manager.hasLegalMove(false);
+      board.undoMove(move, undo, portal_system);
+    }
+    return status;
+  };
+
+  workload();  // warm up the arena and scratch board
+  size_t before = g_allocations.load();
+  auto begin = Clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    workload();
+  }
+  std::chrono::duration<double, std::milli> elapsed = Clock::now() - begin;
+  size_t allocations = g_allocations.load() - before;
+
+  std::cout << "moves per iteration: " << moves.size() << "\n"
+            << "iterations: " << iterations << "\n"
+            << "time per iteration: " << std::fixed << std::setprecision(3) << elapsed.count() / iterations
+            << " ms\n"
+            << "arena high water: " << ScratchArena::forThread().highWater() << " bytes\n"
+            << "operator new calls: " << allocations << "\n";
+  return allocations == 0 ? 0 : 1;
+}
+
+// Scatter pieces of every kind over about a quarter of the board
+void setupScattered(ChessBoard& board) {
+  const char* kinds[] = {"Pawn", "Knight", "Bishop", "Rook", "Queen"};
+  uint32_t state = 0x9e3779b9u;
+  auto next = [&state] {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  };
+  int size = board.getBoardSize();
+  for (int y = 1; y + 1 < size; ++y) {
+    for (int x = 0; x < size; ++x) {
+      if (next() % 4 == 0) {
+        board.placePiece(kinds[next() % 5], next() % 2 == 0, x, y);
+      }
+    }
+  }
+  board.placePiece("King", true, size / 2, 0);
+  board.placePiece("King", false, size / 2, size - 1);
+}
+
+// Square-by-square ray walk, the reference for the mask-based generator
+void walkSlides(const ChessBoard& board, const Position& pos, PieceKind kind, std::pmr::vector<Position>& out) {
+  for (int dx = -1; dx <= 1; ++dx) {
+    for (int dy = -1; dy <= 1; ++dy) {
+      if (dx == 0 && dy == 0) continue;
+      bool diagonal = dx != 0 && dy != 0;
+      if (kind == PieceKind::Rook && diagonal) continue;
+      if (kind == PieceKind::Bishop && !diagonal) continue;
+      for (Position p = {pos.x + dx, pos.y + dy}; board.isInBounds(p); p = {p.x + dx, p.y + dy}) {
+        out.push_back(p);
+        if (!board.getSquare(p).is_empty()) break;
+      }
+    }
+  }
+}
+
+bool sameSquares(std::pmr::vector<Position> a, std::pmr::vector<Position> b) {
+  auto less = [](const Position& l, const Position& r) { return l.y != r.y ? l.y < r.y : l.x < r.x; };
+  std::sort(a.begin(), a.end(), less);
+  std::sort(b.begin(), b.end(), less);
+  return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+                    [](const Position& l, const Position& r) { return l.x == r.x && l.y == r.y; });
+}
+
+// Compare mask-based slider generation and whole-side attack maps against
+// square-by-square references, and time both
+int benchSliders(int min_size, int max_size, int repeats) {
+  std::cout << "avx2: " << (AttackMap::avx2Enabled() ? "yes" : "no") << "\n";
+  std::cout << std::setw(6) << "size" << std::setw(10) << "sliders" << std::setw(14) << "walk us"
+            << std::setw(14) << "masks us" << std::setw(14) << "scan us" << std::setw(14) << "map us" << "\n";
+  for (int size = min_size; size <= max_size; size += 2) {
+    ChessBoard board(size);
+    setupScattered(board);
+    MoveValidator validator;
+    PortalSystem portal_system({});
+
+    std::vector<Position> sliders;
+    for (int y = 0; y < size; ++y) {
+      for (int x = 0; x < size; ++x) {
+        PieceKind kind = board.getSquare({x, y}).kind;
+        if (kind == PieceKind::Rook || kind == PieceKind::Bishop || kind == PieceKind::Queen) {
+          sliders.push_back({x, y});
+        }
+      }
+    }
+
+    std::pmr::vector<Position> expected, actual;
+    for (const auto& pos : sliders) {
+      const auto& square = board.getSquare(pos);
+      expected.clear();
+      actual.clear();
+      walkSlides(board, pos, square.kind, expected);
+      validator.getMoveEdges(square.kind, pos, square.is_white, board, actual);
+      if (!sameSquares(expected, actual)) {
+        std::cerr << "slider mismatch at " << pos.x << "," << pos.y << " on " << size << "x" << size << "\n";
+        return 1;
+      }
+    }
+
+    // Every black piece attacked by white, once through the validator and once from the map
+    AttackMap map;
+    map.build(board, true, portal_system, false);
+    auto scanAttacked = [&](const Position& target) {
+      for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+          const auto& square = board.getSquare({x, y});
+          if (square.is_empty() || !square.is_white || square.kind == PieceKind::King) continue;
+          if (validator.isValidMove(board.pieceName(square), {x, y}, target, true, board, portal_system, false)) {
+            return true;
+          }
+        }
+      }
+      return false;
+    };
+    std::vector<Position> targets;
+    for (int y = 0; y < size; ++y) {
+      for (int x = 0; x < size; ++x) {
+        const auto& square = board.getSquare({x, y});
+        if (!square.is_empty() && !square.is_white) targets.push_back({x, y});
+      }
+    }
+    for (const auto& target : targets) {
+      if (map.isAttacked(target) != scanAttacked(target)) {
+        std::cerr << "attack map mismatch at " << target.x << "," << target.y << " on " << size << "x" << size
+                  << "\n";
+        return 1;
+      }
+    }
+
+    auto timeUs = [repeats](auto&& body) {
+      auto begin = Clock::now();
+      for (int i = 0; i < repeats; ++i) body();
+      std::chrono::duration<double, std::micro> elapsed = Clock::now() - begin;
+      return elapsed.count() / repeats;
+    };
+    double walk = timeUs([&] {
+      for (const auto& pos : sliders) {
+        expected.clear();
+        walkSlides(board, pos, board.getSquare(pos).kind, expected);
+      }
+    });
+    double masks = timeUs([&] {
+      for (const auto& pos : sliders) {
+        actual.clear();
+        validator.getMoveEdges(board.getSquare(pos).kind, pos, true, board, actual);
+      }
+    });
+    double scan = timeUs([&] {
+      for (const auto& target : targets) scanAttacked(target);
+    });
+    double build = timeUs([&] { map.build(board, true, portal_system, false); });
+
+    std::cout << std::fixed << std::setprecision(2) << std::setw(6) << size << std::setw(10) << sliders.size()
+              << std::setw(14) << walk << std::setw(14) << masks << std::setw(14) << scan << std::setw(14)
+              << build << "\n";
+  }
+  return 0;
+}
+
+// Few pieces on a very large board: slider edges from the sparse line indexes
+// must match a square walk, and status checks must not cost board area
+int benchSparse(int size, int piece_count, int repeats) {
+  ChessBoard board(size);
+  const char* kinds[] = {"Pawn", "Knight", "Bishop", "Rook", "Queen"};
+  uint32_t state = 0x2545f491u;
+  auto next = [&state] {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  };
+  board.placePiece("King", true, 0, 0);
+  board.placePiece("King", false, size - 1, size - 1);
+  for (int i = 0; i < piece_count; ++i) {
+    int x = next() % size, y = 1 + next() % (size - 2);
+    if (board.getSquare({x, y}).is_empty()) {
+      board.placePiece(kinds[next() % 5], next() % 2 == 0, x, y);
+    }
+  }
+  MoveValidator validator;
+  PortalSystem portal_system({});
+  GameManager manager(board, validator, portal_system);
+  manager.setParallelStatusThreshold(INT_MAX);
+
+  size_t sliders = 0;
+  bool mismatch = false;
+  board.forEachPiece([&](const Position& pos, const ChessBoard::Square& square) {
+    if (square.kind != PieceKind::Rook && square.kind != PieceKind::Bishop && square.kind != PieceKind::Queen) {
+      return false;
+    }
+    ++sliders;
+    std::pmr::vector<Position> expected, actual;
+    walkSlides(board, pos, square.kind, expected);
+    validator.getMoveEdges(square.kind, pos, square.is_white, board, actual);
+    mismatch = !sameSquares(expected, actual);
+    for (const auto& target : expected) {
+      const auto& at = board.getSquare(target);
+      bool reachable = at.is_empty() || at.is_white != square.is_white;
+      if (validator.isValidMove(board.pieceName(square), pos, target, square.is_white, board, portal_system,
+                                false) != reachable) {
+        mismatch = true;
+      }
+    }
+    if (mismatch) {
+      std::cerr << "sparse slider mismatch at " << pos.x << "," << pos.y << "\n";
+    }
+    return mismatch;
+  });
+  if (mismatch) {
+    return 1;
+  }
+
+  // Walk the white king over empty squares; the check test must agree with
+  // asking the validator about every black piece
+  size_t king_squares = 0;
+  Position king = {0, 0};
+  for (int i = 0; i < 200; ++i) {
+    Position to = {static_cast<int>(next() % size), static_cast<int>(next() % size)};
+    if (!board.getSquare(to).is_empty()) continue;
+    board.setSquare(to, board.getSquare(king));
+    board.setSquare(king, ChessBoard::Square());
+    king = to;
+    ++king_squares;
+    bool expected = board.forEachPiece([&](const Position& pos, const ChessBoard::Square& square) {
+      return !square.is_white && square.kind != PieceKind::King &&
+             validator.isValidMove(board.pieceName(square), pos, king, false, board, portal_system, false);
+    });
+    if (GameManager::isKingAttacked(board, true, validator, portal_system) != expected) {
+      std::cerr << "sparse check mismatch with king at " << king.x << "," << king.y << "\n";
+      return 1;
+    }
+  }
+
+  auto begin = Clock::now();
+  size_t legal = 0;
+  for (int i = 0; i < repeats; ++i) {
+    legal += manager.isInCheck(true) + manager.hasLegalMove(true) + manager.hasLegalMove(false);
+  }
+  std::chrono::duration<double, std::micro> elapsed = Clock::now() - begin;
+
+  std::cout << "board: " << size << "x" << size << (board.isSparse() ? " (sparse)" : " (dense)") << "\n"
+            << "sliders checked: " << sliders << "\n"
+            << "king squares checked: " << king_squares << "\n"
+            << "check + both legal-move scans: " << std::fixed << std::setprecision(2)
+            << elapsed.count() / repeats << " us\n";
+  return legal > 0 ? 0 : 1;
+}
+
+// MCTS playouts per second from a position (the standard start by default)
+// with 1, 2, 4, ... threads sharing one tree
+int benchMcts(unsigned max_threads, int milliseconds, const char* position) {
+  ChessBoard board(8);
+  MoveValidator validator;
+  PortalSystem portal_system({});
+  setupPosition(board, portal_system, position);
+  GameManager manager(board, validator, portal_system);
+  manager.setParallelStatusThreshold(INT_MAX);
+  Mcts mcts(board, manager, portal_system);
+  Mcts::Limits limits;
+  limits.movetime_ms = milliseconds;
+
+  std::cout << "cores: " << std::thread::hardware_concurrency() << "\n";
+  std::cout << std::setw(8) << "threads" << std::setw(14) << "playouts/s" << std::setw(10) << "speedup"
+            << std::setw(10) << "nodes" << "\n";
+  double single = 0.0;
+  for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+    mcts.setThreads(threads);
+    auto begin = Clock::now();
+    Mcts::Result result = mcts.think(limits);
+    std::chrono::duration<double> elapsed = Clock::now() - begin;
+    if (!result.has_move || result.visits == 0) {
+      std::cerr << "search returned no move\n";
+      return 1;
+    }
+    double rate = result.playouts / elapsed.count();
+    if (threads == 1) single = rate;
+    std::cout << std::fixed << std::setprecision(0) << std::setw(8) << threads << std::setw(14) << rate
+              << std::setprecision(2) << std::setw(10) << rate / single << std::setw(10) << result.nodes << "\n";
+  }
+  return 0;
+}
+
+// Parse and write back positions from random games on 8x8 and scattered
+// boards up to the largest size: every round trip must reproduce the text,
+// and once the board is warm neither direction may allocate
+int benchNotation(int count) {
+  const PositionNotation notation;
+  std::vector<std::vector<std::string>> sets;  // per board size
+  std::vector<int> sizes;
+
+  ChessBoard board(8);
+  PortalSystem portal_system({});
+  MoveValidator validator;
+  GameManager manager(board, validator, portal_system);
+  manager.setParallelStatusThreshold(INT_MAX);
+  std::mt19937_64 rng(7);
+  std::vector<EncodedMove> moves;
+  sizes.push_back(8);
+  sets.emplace_back();
+  for (int game = 0; game < 50; ++game) {
+    setupPosition(board, portal_system, kStandardStart);
+    for (int ply = 0; ply < 120; ++ply) {
+      sets.back().push_back(notation.toString(board, portal_system));
+      manager.generateLegalMoves(board.isWhiteToMove(), moves);
+      if (moves.empty()) break;
+      UndoRecord undo;
+      board.applyMove(moves[std::uniform_int_distribution<size_t>(0, moves.size() - 1)(rng)], portal_system, undo);
+    }
+  }
+  for (int size : {16, 32, ChessBoard::kMaxBoardSize}) {
+    ChessBoard scattered(size);
+    setupScattered(scattered);
+    sizes.push_back(size);
+    sets.push_back({notation.toString(scattered, portal_system)});
+  }
+
+  std::cout << std::setw(6) << "size" << std::setw(12) << "positions" << std::setw(12) << "avg bytes"
+            << std::setw(14) << "parse+write/s" << std::setw(10) << "MB/s" << std::setw(10) << "allocs" << "\n";
+  bool failed = false;
+  for (size_t s = 0; s < sets.size(); ++s) {
+    ChessBoard target(sizes[s]);
+    PortalSystem target_portals({});
+    const auto& texts = sets[s];
+    std::string buffer(texts[0].size() * 4 + 64, '\0');
+    notation.parse(texts[0], target, target_portals);  // registers the piece types
+    size_t bytes = 0;
+    for (const auto& text : texts) bytes += text.size();
+    const int rounds = std::max(1, static_cast<int>(count / texts.size() / (s == 0 ? 1 : sizes[s] * sizes[s] / 64)));
+    size_t mismatches = 0;
+    const size_t before = g_allocations.load();
+    auto begin = Clock::now();
+    for (int round = 0; round < rounds; ++round) {
+      for (const auto& text : texts) {
+        const size_t length = notation.parse(text, target, target_portals)
+                                  ? notation.write(target, target_portals, buffer.data(), buffer.size())
+                                  : 0;
+        if (length != text.size() || text.compare(0, length, buffer.data(), length) != 0) ++mismatches;
+      }
+    }
+    std::chrono::duration<double> elapsed = Clock::now() - begin;
+    const size_t allocations = g_allocations.load() - before;
+    const double done = static_cast<double>(rounds) * texts.size();
+    std::cout << std::setw(6) << sizes[s] << std::setw(12) << texts.size() << std::setw(12) << bytes / texts.size()
+              << std::fixed << std::setprecision(0) << std::setw(14) << done / elapsed.count() << std::setprecision(1)
+              << std::setw(10) << rounds * static_cast<double>(bytes) / elapsed.count() / 1e6 << std::setw(10)
+              << allocations << "\n";
+    if (mismatches > 0) std::cerr << "size " << sizes[s] << ": " << mismatches << " round trips differ\n";
+    failed |= mismatches > 0 || allocations > 0;
+  }
+  return failed ? 1 : 0;
+}
+
+// Journals `sessions` random games of up to `plies` plies (with the odd undo
+// and redo) in a temporary directory, snapshotting each halfway, then
+// recovers them all as a restarted process would. Every recovered session
+// must be back in the position and history it was left in.
+int benchJournal(int sessions, int plies) {
+  const GameConfig config{};  // the standard pieces, no portals
+  std::string dir = (std::filesystem::temp_directory_path() / "cwp-journal-XXXXXX").string();
+  if (!mkdtemp(dir.data())) {
+    std::cerr << "cannot create a directory for the journals\n";
+    return 1;
+  }
+  auto sessionPath = [&](int session) { return dir + "/session" + std::to_string(session); };
+
+  ChessBoard board(8);
+  PortalSystem portal_system({});
+  MoveValidator validator;
+  GameManager manager(board, validator, portal_system);
+  manager.setParallelStatusThreshold(INT_MAX);
+  GameJournal journal;
+  std::mt19937_64 rng(11);
+  std::vector<EncodedMove> moves;
+  std::vector<uint64_t> keys(sessions);
+  std::vector<size_t> lengths(sessions);
+  bool failed = false;
+  auto begin = Clock::now();
+  for (int session = 0; session < sessions && !failed; ++session) {
+    setupPosition(board, portal_system, kStandardStart);
+    manager.resetHistory();
+    failed = !journal.create(sessionPath(session), config, board, portal_system, manager);
+    manager.setJournal(&journal);
+    for (int ply = 0; ply < plies && !failed; ++ply) {
+      if (ply == plies / 2) failed = !journal.snapshot(board, portal_system, manager);
+      if (manager.getHistorySize() > 0 && rng() % 10 == 0) {
+        manager.undoMove(false);
+        if (rng() % 2) manager.redoMove(false);
+        continue;
+      }
+      manager.generateLegalMoves(board.isWhiteToMove(), moves);
+      if (moves.empty()) break;
+      manager.makeMove(moves[std::uniform_int_distribution<size_t>(0, moves.size() - 1)(rng)]);
+    }
+    keys[session] = board.positionKey(portal_system);
+    lengths[session] = manager.getHistorySize();
+    // The process dies here: no final snapshot
+    manager.setJournal(nullptr);
+    journal.close();
+  }
+  std::chrono::duration<double> written = Clock::now() - begin;
+
+  size_t replayed = 0;
+  size_t mismatches = 0;
+  begin = Clock::now();
+  for (int session = 0; session < sessions && !failed; ++session) {
+    const char* error = nullptr;
+    if (!journal.recover(sessionPath(session), config, board, portal_system, manager, &error)) {
+      std::cerr << "session " << session << ": " << error << "\n";
+      ++mismatches;
+      continue;
+    }
+    replayed += journal.replayedRecords();
+    if (board.positionKey(portal_system) != keys[session] || manager.getHistorySize() != lengths[session]) {
+      ++mismatches;
+    }
+  }
+  std::chrono::duration<double> recovered = Clock::now() - begin;
+  journal.close();
+  std::filesystem::remove_all(dir);
+  if (failed) {
+    std::cerr << "cannot write the journals\n";
+    return 1;
+  }
+
+  std::cout << sessions << " sessions, " << std::fixed << std::setprecision(1)
+            << static_cast<double>(replayed) / sessions << " log records replayed per session\n"
+            << "journaling: " << std::setprecision(2) << written.count() * 1e6 / sessions << " us per session\n"
+            << "recovery:   " << recovered.count() * 1e3 << " ms total, " << std::setprecision(0)
+            << sessions / recovered.count() << " sessions/s\n";
+  if (mismatches > 0) std::cerr << mismatches << " sessions did not recover their position\n";
+  return mismatches > 0 ? 1 : 0;
+}
+
+// Peak resident set size of the process so far, in MB
+double peakRssMb() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024.0;
+}
+
+// Generates a config of about `megabytes` MB (the standard pieces plus a
+// catalog of random custom pieces) and loads it with ConfigReader's
+// streaming parser, then parses it into a JSON DOM for comparison. Peak
+// memory only ever grows, so the streaming load is measured first; each
+// figure is the growth over the process before the load.
+int benchConfig(int megabytes) {
+  std::string dir = (std::filesystem::temp_directory_path() / "cwp-config-XXXXXX").string();
+  if (!mkdtemp(dir.data())) {
+    std::cerr << "cannot create a directory for the config\n";
+    return 1;
+  }
+  const std::string path = dir + "/catalog.json";
+  size_t custom_pieces = 0;
+  {
+    std::ofstream out(path);
+    out << "{\n  \"game_settings\": {\"name\": \"Catalog\", \"board_size\": 8, \"turn_limit\": 200},\n"
+        << "  \"pieces\": [\n"
+        << "    {\"type\": \"King\", \"positions\": {\"white\": [{\"x\": 4, \"y\": 0}], "
+           "\"black\": [{\"x\": 4, \"y\": 7}]},\n"
+        << "     \"movement\": {\"forward\": 1, \"sideways\": 1, \"diagonal\": 1},\n"
+        << "     \"special_abilities\": {\"royal\": true, \"castling\": true}}\n"
+        << "  ],\n  \"custom_pieces\": [";
+    std::mt19937 rng(5);
+    const auto target = static_cast<std::streamoff>(megabytes) << 20;
+    while (out.tellp() < target) {
+      out << (custom_pieces > 0 ? ",\n" : "\n") << "    {\"type\": \"Piece" << custom_pieces
+          << "\", \"count\": 2, \"positions\": {\"white\": [{\"x\": " << rng() % 8 << ", \"y\": " << rng() % 2
+          << "}], \"black\": [{\"x\": " << rng() % 8 << ", \"y\": " << 6 + rng() % 2 << "}]},\n"
+          << "     \"movement\": {\"forward\": " << rng() % 8 << ", \"sideways\": " << rng() % 8
+          << ", \"diagonal\": " << rng() % 8 << ", \"l_shape\": " << (rng() % 2 ? "true" : "false")
+          << ", \"diagonal_capture\": 0, \"first_move_forward\": 0},\n"
+          << "     \"special_abilities\": {\"jump_over\": " << (rng() % 2 ? "true" : "false")
+          << ", \"promotion\": false, \"phase_" << rng() % 16 << "\": true}}";
+      ++custom_pieces;
+    }
+    out << "\n  ]\n}\n";
+  }
+  const double file_mb = static_cast<double>(std::filesystem::file_size(path)) / (1 << 20);
+
+  double before = peakRssMb();
+  auto begin = Clock::now();
+  ConfigReader reader;
+  const bool loaded = reader.loadFromJsonFile(path);
+  std::chrono::duration<double> streamed = Clock::now() - begin;
+  const double streamed_mb = peakRssMb() - before;
+  const bool complete = loaded && reader.getConfig().custom_pieces.size() == custom_pieces;
+  reader = ConfigReader();
+
+  before = peakRssMb();
+  begin = Clock::now();
+  {
+    std::ifstream in(path);
+    nlohmann::json document = nlohmann::json::parse(in);
+  }
+  std::chrono::duration<double> dom = Clock::now() - begin;
+  const double dom_mb = peakRssMb() - before;
+  std::filesystem::remove_all(dir);
+  if (!complete) {
+    std::cerr << "the generated config did not load\n";
+    return 1;
+  }
+
+  std::cout << std::fixed << std::setprecision(1) << file_mb << " MB config, " << custom_pieces
+            << " custom pieces\n"
+            << "streaming load: " << std::setprecision(0) << std::setw(6) << streamed.count() * 1e3 << " ms, peak +"
+            << std::setprecision(1) << streamed_mb << " MB (the loaded config included)\n"
+            << "JSON DOM parse: " << std::setprecision(0) << std::setw(6) << dom.count() * 1e3 << " ms, peak +"
+            << std::setprecision(1) << dom_mb << " MB (the document alone)\n";
+  return 0;
+}
+
+// Resident set size of the process now, in MB
+double currentRssMb() {
+  std::ifstream statm("/proc/self/statm");
+  size_t pages = 0;
+  size_t resident = 0;
+  statm >> pages >> resident;
+  return static_cast<double>(resident) * static_cast<double>(sysconf(_SC_PAGESIZE)) / (1 << 20);
+}
+
+// A blocking client of the bench server: one request, one reply line
+class ServerClient {
+public:
+  explicit ServerClient(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd_ >= 0 && ::connect(fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+  ~ServerClient() {
+    if (fd_ >= 0) ::close(fd_);
+  }
+  ServerClient(const ServerClient&) = delete;
+  ServerClient& operator=(const ServerClient&) = delete;
+
+  bool ok() const { return fd_ >= 0; }
+  bool send(const std::string& request) {
+    const std::string line = request + "\n";
+    return ::write(fd_, line.data(), line.size()) == static_cast<ssize_t>(line.size());
+  }
+  bool reply(std::string& line) {
+    size_t end;
+    while ((end = buffer_.find('\n')) == std::string::npos) {
+      char chunk[4096];
+      const ssize_t got = ::read(fd_, chunk, sizeof(chunk));
+      if (got <= 0) return false;
+      buffer_.append(chunk, static_cast<size_t>(got));
+    }
+    line = buffer_.substr(0, end);
+    buffer_.erase(0, end + 1);
+    return true;
+  }
+  bool request(const std::string& request, std::string& line) { return send(request) && reply(line); }
+
+private:
+  int fd_ = -1;
+  std::string buffer_;
+};
+
+// Runs a GameServer on a temporary Unix socket and grows it to 100, 1000
+// and so on up to `max_sessions` connected games. At each size it times
+// move and undo requests on random games, then one "go depth 2" on up to
+// 256 games at once. Flat per-session memory and latency across the sizes
+// are the point: no game pays for the others.
+int benchServer(int max_sessions) {
+  rlimit files{};
+  getrlimit(RLIMIT_NOFILE, &files);
+  files.rlim_cur = files.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &files);
+  // Two descriptors per game (client and server end), plus some slack
+  const int fit = static_cast<int>(std::min<rlim_t>(files.rlim_cur, INT_MAX) / 2) - 32;
+  if (max_sessions > fit) {
+    std::cerr << "descriptor limit allows " << fit << " sessions\n";
+    max_sessions = fit;
+  }
+  std::string dir = (std::filesystem::temp_directory_path() / "cwp-server-XXXXXX").string();
+  if (!mkdtemp(dir.data())) {
+    std::cerr << "cannot create a directory for the socket\n";
+    return 1;
+  }
+  GameConfig config{};  // games start from kStandardStart; no portals
+  config.game_settings.board_size = 8;
+  GameServer::Options options;
+  options.unix_path = dir + "/server.sock";
+  options.max_sessions = static_cast<size_t>(max_sessions);
+  GameServer server(config, options);
+  std::string error;
+  if (!server.start(&error)) {
+    std::cerr << "cannot start the server: " << error << "\n";
+    std::filesystem::remove_all(dir);
+    return 1;
+  }
+  const double base_mb = currentRssMb();
+  std::thread loop([&] { server.run(); });
+
+  std::vector<std::unique_ptr<ServerClient>> clients;
+  std::vector<bool> moved;
+  std::mt19937 rng(3);
+  std::string line;
+  bool failed = false;
+  std::cout << std::setw(9) << "sessions" << std::setw(14) << "KB/session" << std::setw(12) << "avg us"
+            << std::setw(12) << "p99 us" << std::setw(16) << "go depth 2 ms" << "\n";
+  for (int sessions = std::min(100, max_sessions); !failed; sessions = std::min(sessions * 10, max_sessions)) {
+    while (static_cast<int>(clients.size()) < sessions && !failed) {
+      clients.push_back(std::make_unique<ServerClient>(options.unix_path));
+      moved.push_back(false);
+      failed = !clients.back()->ok() || !clients.back()->request(std::string("new ") + kStandardStart, line) ||
+               line != "ok";
+    }
+    if (failed) break;
+
+    const int requests = 20000;
+    std::vector<double> latencies(requests);
+    for (int i = 0; i < requests && !failed; ++i) {
+      const size_t c = std::uniform_int_distribution<size_t>(0, clients.size() - 1)(rng);
+      const auto begin = Clock::now();
+      failed = !clients[c]->request(moved[c] ? "undo" : "move e2e4", line) || line != "ok";
+      latencies[i] = std::chrono::duration<double, std::micro>(Clock::now() - begin).count();
+      moved[c] = !moved[c];
+    }
+    if (failed) break;
+    std::sort(latencies.begin(), latencies.end());
+    double total = 0;
+    for (double latency : latencies) total += latency;
+
+    const size_t searching = std::min<size_t>(clients.size(), 256);
+    const auto begin = Clock::now();
+    for (size_t c = 0; c < searching; ++c) failed |= !clients[c]->send("go depth 2");
+    for (size_t c = 0; c < searching && !failed; ++c) {
+      failed = !clients[c]->reply(line) || line.rfind("bestmove ", 0) != 0;
+    }
+    const std::chrono::duration<double, std::milli> searched = Clock::now() - begin;
+    if (failed) break;
+
+    std::cout << std::setw(9) << sessions << std::fixed << std::setprecision(1) << std::setw(14)
+              << (currentRssMb() - base_mb) * 1024 / sessions << std::setw(12) << total / requests
+              << std::setw(12) << latencies[requests * 99 / 100] << std::setw(16) << searched.count() << "\n";
+    if (sessions >= max_sessions) break;
+  }
+  if (failed) std::cerr << "session " << clients.size() << ": unexpected reply \"" << line << "\"\n";
+  clients.clear();
+  server.stop();
+  loop.join();
+  std::filesystem::remove_all(dir);
+  return failed ? 1 : 0;
+}
+
+// How long an unlimited search takes to return after stop(), from another
+// thread at a random moment, with alpha-beta on the standard start and on a
+// scattered 26x26 board (where one node costs the most) and with MCTS
+int benchStop(int trials) {
+  std::mt19937 rng(9);
+  std::cout << std::setw(24) << "search" << std::setw(12) << "avg us" << std::setw(12) << "max us" << "\n";
+  auto measure = [&](const char* name, auto&& start, auto&& stop) {
+    double total = 0.0;
+    double worst = 0.0;
+    for (int i = 0; i < trials; ++i) {
+      std::atomic<bool> returned{false};
+      Clock::time_point returned_at;
+      std::thread searcher([&] {
+        start();
+        returned_at = Clock::now();
+        returned.store(true);
+      });
+      std::this_thread::sleep_for(std::chrono::milliseconds(20 + rng() % 30));
+      const auto stopped_at = Clock::now();
+      stop();
+      searcher.join();
+      const double latency = std::chrono::duration<double, std::micro>(returned_at - stopped_at).count();
+      total += latency;
+      worst = std::max(worst, latency);
+    }
+    std::cout << std::setw(24) << name << std::fixed << std::setprecision(1) << std::setw(12) << total / trials
+              << std::setw(12) << worst << "\n";
+  };
+
+  for (int size : {8, 26}) {
+    ChessBoard board(size);
+    MoveValidator validator;
+    PortalSystem portal_system({});
+    if (size == 8) {
+      setupPosition(board, portal_system, kStandardStart);
+    } else {
+      setupScattered(board);
+    }
+    GameManager manager(board, validator, portal_system);
+    manager.setParallelStatusThreshold(INT_MAX);
+    Search search(board, manager, portal_system);
+    const std::string name = "alpha-beta " + std::to_string(size) + "x" + std::to_string(size);
+    measure(
+        name.c_str(),
+        [&] {
+          search.clearStop();
+          search.think(Search::Limits());
+        },
+        [&] { search.stop(); });
+  }
+
+  ChessBoard board(8);
+  MoveValidator validator;
+  PortalSystem portal_system({});
+  setupPosition(board, portal_system, kStandardStart);
+  GameManager manager(board, validator, portal_system);
+  manager.setParallelStatusThreshold(INT_MAX);
+  Mcts mcts(board, manager, portal_system);
+  measure(
+      "mcts 8x8",
+      [&] {
+        mcts.clearStop();
+        mcts.think(Mcts::Limits());
+      },
+      [&] { mcts.stop(); });
+  return 0;
+}
+
+// Submits `jobs` analyses at once, positions from short random games that
+// share their openings, with three priorities and every 50th job cancelled
+// right away; once without and once with the shared transposition table.
+int benchAnalysis(int jobs, int depth, unsigned threads) {
+  GameConfig config{};
+  config.game_settings.board_size = 8;
+  std::vector<AnalysisService::Request> requests;
+  {
+    ChessBoard board(8);
+    MoveValidator validator;
+    PortalSystem portal_system({});
+    GameManager manager(board, validator, portal_system);
+    manager.setParallelStatusThreshold(INT_MAX);
+    std::mt19937_64 rng(11);
+    std::vector<EncodedMove> moves;
+    while (static_cast<int>(requests.size()) < jobs) {
+      setupPosition(board, portal_system, kStandardStart);
+      manager.resetHistory();
+      AnalysisService::Request request;
+      request.position = kStandardStart;
+      request.depth = depth;
+      for (int ply = 0; ply < 12 && static_cast<int>(requests.size()) < jobs; ++ply) {
+        request.priority = static_cast<int>(requests.size() % 3);
+        requests.push_back(request);
+        manager.generateLegalMoves(board.isWhiteToMove(), moves);
+        if (moves.empty()) break;
+        // Few choices early on, so games transpose into each other
+        const size_t choices = std::min<size_t>(moves.size(), ply < 4 ? 3 : moves.size());
+        const EncodedMove move = moves[std::uniform_int_distribution<size_t>(0, choices - 1)(rng)];
+        request.moves.push_back(board.moveToNotation(move));
+        manager.makeMove(move);
+      }
+    }
+  }
+
+  std::cout << std::setw(8) << "hash MB" << std::setw(10) << "jobs/s" << std::setw(12) << "knodes/s"
+            << std::setw(12) << "nodes/job" << std::setw(10) << "hit %" << std::setw(11) << "cancelled"
+            << std::setw(30) << "avg latency ms (prio 2/1/0)" << "\n";
+  bool failed = false;
+  for (size_t hash_mb : {size_t{0}, size_t{16}}) {
+    AnalysisService::Options options;
+    options.threads = threads;
+    options.hash_mb = hash_mb;
+    AnalysisService service(config, options);
+    std::atomic<int> callbacks{0};
+    std::vector<AnalysisService::Ticket> tickets;
+    tickets.reserve(requests.size());
+    const auto begin = Clock::now();
+    for (const auto& request : requests) {
+      tickets.push_back(service.submit(request, [&](uint64_t, const AnalysisService::Analysis&) { ++callbacks; }));
+      if (tickets.size() % 50 == 0) service.cancel(tickets.back().id);
+    }
+    double latency[3] = {0, 0, 0};
+    int counted[3] = {0, 0, 0};
+    size_t cancelled = 0;
+    for (size_t i = 0; i < tickets.size(); ++i) {
+      const AnalysisService::Analysis analysis = tickets[i].result.get();
+      if (analysis.status == AnalysisService::Status::Cancelled) {
+        ++cancelled;
+        continue;
+      }
+      if (analysis.status != AnalysisService::Status::Done || !analysis.has_move) {
+        std::cerr << "job " << tickets[i].id << " failed: " << analysis.error << "\n";
+        failed = true;
+      }
+      latency[requests[i].priority] += static_cast<double>(analysis.queued_ms + analysis.elapsed_ms);
+      ++counted[requests[i].priority];
+    }
+    std::chrono::duration<double> elapsed = Clock::now() - begin;
+    const size_t done = tickets.size() - cancelled;
+    const TranspositionTable* table = service.transpositionTable();
+    const double hit_rate = table && table->probes() > 0 ? 100.0 * table->hits() / table->probes() : 0.0;
+    std::cout << std::setw(8) << hash_mb << std::fixed << std::setprecision(0) << std::setw(10)
+              << done / elapsed.count() << std::setw(12) << service.totalNodes() / elapsed.count() / 1000.0
+              << std::setw(12) << service.totalNodes() / std::max<size_t>(done, 1) << std::setprecision(1)
+              << std::setw(10) << hit_rate << std::setw(11) << cancelled;
+    for (int priority = 2; priority >= 0; --priority) {
+      std::cout << std::setw(priority == 2 ? 14 : 8) << latency[priority] / std::max(counted[priority], 1);
+    }
+    std::cout << "\n";
+    if (callbacks.load() != static_cast<int>(tickets.size()) || service.pending() != 0) {
+      std::cerr << "callbacks " << callbacks.load() << " of " << tickets.size() << ", pending " << service.pending()
+                << "\n";
+      failed = true;
+    }
+  }
+  return failed ? 1 : 0;
+}
+
+// Multi-PV root search for K = 1, 2, 4, 8 against scoring every root move
+// exactly (what K separate searches would cost at least); the K lines must
+// have the K best exact scores.
+int benchMultiPv(int depth, const char* position) {
+  ChessBoard board(8);
+  MoveValidator validator;
+  PortalSystem portal_system({});
+  setupPosition(board, portal_system, position);
+  GameManager manager(board, validator, portal_system);
+  manager.setParallelStatusThreshold(INT_MAX);
+  Search search(board, manager, portal_system);
+  std::vector<EncodedMove> moves;
+  manager.generateLegalMoves(board.isWhiteToMove(), moves);
+  if (moves.empty()) {
+    std::cerr << "the side to move has no legal move\n";
+    return 1;
+  }
+
+  auto run = [&](int multipv, Search::Result& result) {
+    Search::Limits limits;
+    limits.depth = depth;
+    limits.multipv = multipv;
+    const auto begin = Clock::now();
+    result = search.think(limits);
+    return std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+  };
+  Search::Result exact;
+  const double exact_ms = run(static_cast<int>(moves.size()), exact);
+  std::cout << std::setw(10) << "lines" << std::setw(12) << "nodes" << std::setw(10) << "ms" << "  best line\n";
+  std::cout << std::setw(10) << "all " + std::to_string(moves.size()) << std::setw(12) << search.nodes()
+            << std::fixed << std::setprecision(1) << std::setw(10) << exact_ms << "  "
+            << board.lineToNotation(exact.lines.front().pv, portal_system) << "\n";
+  bool failed = false;
+  for (int multipv : {1, 2, 4, 8}) {
+    Search::Result result;
+    const double ms = run(multipv, result);
+    std::cout << std::setw(10) << multipv << std::setw(12) << search.nodes() << std::setw(10) << ms << "  "
+              << board.lineToNotation(result.lines.front().pv, portal_system) << "\n";
+    const size_t expected = std::min<size_t>(multipv, moves.size());
+    if (result.lines.size() != expected) {
+      std::cerr << "K=" << multipv << ": " << result.lines.size() << " lines\n";
+      failed = true;
+      continue;
+    }
+    for (size_t i = 0; i < expected; ++i) {
+      if (result.lines[i].score != exact.lines[i].score) {
+        std::cerr << "K=" << multipv << " line " << i + 1 << ": score " << result.lines[i].score << ", exact "
+                  << exact.lines[i].score << "\n";
+        failed = true;
+      }
+    }
+  }
+  return failed ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  std::string mode = argc > 1 ? argv[1] : "";
+  if (mode == "status") {
+    int min_size = argc > 2 ? std::atoi(argv[2]) : 8;
+    int max_size = argc > 3 ? std::atoi(argv[3]) : 26;
+    int repeats = argc > 4 ? std::atoi(argv[4]) : 3;
+    return benchStatus(min_size, max_size, repeats > 0 ? repeats : 1);
+  }
+  if (mode == "alloc") {
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 20;
+    return benchAlloc(iterations > 0 ? iterations : 1);
+  }
+  if (mode == "sliders") {
+    int min_size = argc > 2 ? std::atoi(argv[2]) : 8;
+    int max_size = argc > 3 ? std::atoi(argv[3]) : 26;
+    int repeats = argc > 4 ? std::atoi(argv[4]) : 200;
+    return benchSliders(min_size, max_size, repeats > 0 ? repeats : 1);
+  }
+  if (mode == "sparse") {
+    int size = argc > 2 ? std::atoi(argv[2]) : ChessBoard::kMaxBoardSize;
+    int pieces = argc > 3 ? std::atoi(argv[3]) : 32;
+    int repeats = argc > 4 ? std::atoi(argv[4]) : 100;
+    if (size < 3 || size > ChessBoard::kMaxBoardSize) {
+      std::cerr << "size must be between 3 and " << ChessBoard::kMaxBoardSize << "\n";
+      return 1;
+    }
+    return benchSparse(size, pieces, repeats > 0 ? repeats : 1);
+  }
+  if (mode == "mcts") {
+    int max_threads = argc > 2 ? std::atoi(argv[2]) : static_cast<int>(std::thread::hardware_concurrency());
+    int milliseconds = argc > 3 ? std::atoi(argv[3]) : 2000;
+    const char* position = argc > 4 ? argv[4] : kStandardStart;
+    return benchMcts(static_cast<unsigned>(std::max(max_threads, 1)), milliseconds > 0 ? milliseconds : 1, position);
+  }
+  if (mode == "notation") {
+    int positions = argc > 2 ? std::atoi(argv[2]) : 1000000;
+    return benchNotation(positions > 0 ? positions : 1);
+  }
+  if (mode == "journal") {
+    int sessions = argc > 2 ? std::atoi(argv[2]) : 10000;
+    int plies = argc > 3 ? std::atoi(argv[3]) : 80;
+    return benchJournal(sessions > 0 ? sessions : 1, plies > 0 ? plies : 1);
+  }
+  if (mode == "config") {
+    int megabytes = argc > 2 ? std::atoi(argv[2]) : 50;
+    return benchConfig(megabytes > 0 ? megabytes : 1);
+  }
+  if (mode == "server") {
+    int max_sessions = argc > 2 ? std::atoi(argv[2]) : 4000;
+    return benchServer(max_sessions > 0 ? max_sessions : 1);
+  }
+  if (mode == "stop") {
+    int trials = argc > 2 ? std::atoi(argv[2]) : 50;
+    return benchStop(trials > 0 ? trials : 1);
+  }
+  if (mode == "analysis") {
+    int jobs = argc > 2 ? std::atoi(argv[2]) : 1000;
+    int depth = argc > 3 ? std::atoi(argv[3]) : 3;
+    int threads = argc > 4 ? std::atoi(argv[4]) : static_cast<int>(std::thread::hardware_concurrency());
+    return benchAnalysis(jobs > 0 ? jobs : 1, depth > 0 ? depth : 1, static_cast<unsigned>(std::max(threads, 1)));
+  }
+  if (mode == "multipv") {
+    int depth = argc > 2 ? std::atoi(argv[2]) : 4;
+    const char* position = argc > 3 ? argv[3] : kStandardStart;
+    return benchMultiPv(depth > 0 ? depth : 1, position);
+  }
+  std::cerr << "Usage: bench status [min_size] [max_size] [repeats]\n"
+            << "       bench alloc [iterations]\n"
+            << "       bench sliders [min_size] [max_size] [repeats]\n"
+            << "       bench sparse [size] [pieces] [repeats]\n"
+            << "       bench mcts [max_threads] [milliseconds] [position]\n"
+            << "       bench notation [positions]\n"
+            << "       bench journal [sessions] [plies]\n"
+            << "       bench config [megabytes]\n"
+            << "       bench server [max_sessions]\n"
+            << "       bench stop [trials]\n"
+            << "       bench analysis [jobs] [depth] [threads]\n"
+            << "       bench multipv [depth] [position]\n";
+  return 1;
+}
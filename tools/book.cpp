@@ -0,0 +1,157 @@
+// book.cpp - build opening books from game logs and look positions up
+//
+// Usage: book <config.json> build OUT.book LOG... [--max-plies N] [--min-count C]
+//        book <config.json> probe BOOK.book [--moves "e2e4 e7e5 ..."]
+//
+// Logs hold one game per line: moves as the engine writes them, then the
+// result (1-0, 0-1, 1/2-1/2 or *), e.g. selfplay --games-out. The book keeps
+// the first N plies of every game (default 20) and drops moves seen fewer
+// than C times (default 1). Probing lists the book moves after --moves.
+#include "ChessBoard.hpp"
+#include "ConfigReader.hpp"
+#include "GameManager.hpp"
+#include "MoveValidator.hpp"
+#include "OpeningBook.hpp"
+#include "PortalSystem.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+void printUsage() {
+  std::cerr << "Usage: book <config.json> build OUT.book LOG... [--max-plies N] [--min-count C]\n"
+            << "       book <config.json> probe BOOK.book [--moves \"e2e4 e7e5 ...\"]\n";
+}
+
+int build(const GameConfig& config, int argc, char* argv[]) {
+  if (argc < 5) return -1;
+  const std::string out_path = argv[3];
+  int max_plies = 20;
+  uint32_t min_count = 1;
+  std::vector<std::string> logs;
+  for (int i = 4; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--max-plies" && i + 1 < argc) max_plies = std::max(1, std::atoi(argv[++i]));
+    else if (arg == "--min-count" && i + 1 < argc) min_count = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+    else logs.push_back(arg);
+  }
+  if (logs.empty()) return -1;
+
+  const auto started = std::chrono::steady_clock::now();
+  OpeningBook::Builder builder(config, max_plies);
+  std::vector<std::string> moves;
+  size_t rejected = 0;
+  for (const std::string& path : logs) {
+    std::ifstream in(path);
+    if (!in) {
+      std::cerr << "Cannot read " << path << "\n";
+      return 1;
+    }
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(in, line)) {
+      ++line_number;
+      GameResult result;
+      if (!OpeningBook::parseGameLine(line, moves, result)) continue;
+      if (!builder.addGame(moves, result)) {
+        if (rejected++ < 5) std::cerr << path << ":" << line_number << ": illegal move, rest of game skipped\n";
+      }
+    }
+  }
+
+  try {
+    const size_t entries = builder.write(out_path, min_count);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::cout << builder.games() << " games (" << rejected << " with illegal moves), " << entries << " entries in "
+              << out_path << ", " << seconds << "s\n";
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
+
+int probe(const GameConfig& config, int argc, char* argv[]) {
+  if (argc < 4) return -1;
+  std::string move_list;
+  for (int i = 4; i < argc; ++i) {
+    if (std::string(argv[i]) == "--moves" && i + 1 < argc) move_list = argv[++i];
+    else return -1;
+  }
+  OpeningBook book;
+  if (!book.open(argv[3], config)) {
+    std::cerr << "Cannot use " << argv[3] << " with this config\n";
+    return 1;
+  }
+
+  ChessBoard board(config.game_settings.board_size, "simple");
+  board.initializeBoard(config.pieces);
+  MoveValidator validator;
+  PortalSystem portal_system(config.portals);
+  GameManager game_manager(board, validator, portal_system);
+  std::istringstream moves_in(move_list);
+  std::string text;
+  std::vector<EncodedMove> legal;
+  while (moves_in >> text) {
+    EncodedMove move;
+    game_manager.generateLegalMoves(board.isWhiteToMove(), legal);
+    if (!board.parseMove(text, move) || std::find(legal.begin(), legal.end(), move) == legal.end()) {
+      std::cerr << "Illegal move: " << text << "\n";
+      return 1;
+    }
+    game_manager.makeMove(move);
+  }
+
+  std::vector<OpeningBook::Candidate> candidates;
+  book.lookup(board.positionKey(portal_system), candidates);
+  if (candidates.empty()) {
+    std::cout << "not in book\n";
+    return 0;
+  }
+  uint64_t total = 0;
+  for (const auto& candidate : candidates) total += candidate.weight;
+  for (const auto& candidate : candidates) {
+    std::cout << board.moveToNotation(candidate.move) << "  weight " << candidate.weight << "  "
+              << candidate.weight * 100 / total << "%\n";
+  }
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    printUsage();
+    return 1;
+  }
+  ConfigReader config_reader;
+  if (!config_reader.loadFromFile(argv[1])) {
+    std::cerr << "Failed to load configuration file\n";
+    return 1;
+  }
+  const GameConfig& config = config_reader.getConfig();
+  if (config.game_settings.board_size <= 0 || config.game_settings.board_size > ChessBoard::kMaxBoardSize) {
+    std::cerr << "Invalid board size\n";
+    return 1;
+  }
+
+  const std::string mode = argv[2];
+  int status = -1;
+  if (mode == "build") {
+    status = build(config, argc, argv);
+  } else if (mode == "probe") {
+    status = probe(config, argc, argv);
+  }
+  if (status < 0) {
+    printUsage();
+    return 1;
+  }
+  return status;
+}
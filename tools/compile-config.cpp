@@ -0,0 +1,87 @@
+// compile-config.cpp - validate JSON configs once and write their compiled images
+//
+// Usage: compile-config CONFIG.json... [--check] [--loads N]
+//
+// Every config is parsed and validated from its JSON and written next to it
+// as CONFIG.json.compiled, which ConfigReader::loadFromFile maps instead of
+// parsing the JSON until the source changes. --check writes nothing and only
+// reports whether each image is fresh. Both print how long a load takes from
+// the JSON and from the image, averaged over N loads (default 20).
+#include "ChessBoard.hpp"
+#include "ConfigReader.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+void printUsage() {
+  std::cerr << "Usage: compile-config CONFIG.json... [--check] [--loads N]\n";
+}
+
+// Average microseconds per load, or a negative value if a load fails
+template <typename Load>
+double timeLoads(int loads, Load&& load) {
+  const auto started = std::chrono::steady_clock::now();
+  for (int i = 0; i < loads; ++i) {
+    if (!load()) return -1.0;
+  }
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - started).count() / loads;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  std::vector<std::string> paths;
+  bool check = false;
+  int loads = 20;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--check") check = true;
+    else if (arg == "--loads" && i + 1 < argc) loads = std::max(1, std::atoi(argv[++i]));
+    else paths.push_back(arg);
+  }
+  if (paths.empty()) {
+    printUsage();
+    return 1;
+  }
+
+  int failures = 0;
+  for (const std::string& path : paths) {
+    ConfigReader config_reader;
+    if (!config_reader.loadFromJsonFile(path)) {
+      std::cerr << path << ": invalid configuration\n";
+      ++failures;
+      continue;
+    }
+    const int board_size = config_reader.getConfig().game_settings.board_size;
+    if (board_size > ChessBoard::kMaxBoardSize) {
+      std::cerr << path << ": board size " << board_size << " is larger than " << ChessBoard::kMaxBoardSize << "\n";
+      ++failures;
+      continue;
+    }
+    if (!check && !config_reader.writeCompiled(path)) {
+      std::cerr << path << ": cannot write " << ConfigReader::compiledPath(path) << "\n";
+      ++failures;
+      continue;
+    }
+
+    const double json_us = timeLoads(loads, [&] { return ConfigReader().loadFromJsonFile(path); });
+    bool fresh = true;
+    const double image_us = timeLoads(loads, [&] {
+      ConfigReader reader;
+      fresh = reader.loadFromFile(path) && reader.loadedFromCompiled() &&
+              configHash(reader.getConfig()) == configHash(config_reader.getConfig());
+      return fresh;
+    });
+    std::cout << path << ": " << (fresh ? (check ? "fresh" : "compiled") : "stale") << "  json " << json_us
+              << " us";
+    if (fresh) std::cout << "  image " << image_us << " us  (" << json_us / image_us << "x)";
+    std::cout << "\n";
+    if (!fresh) ++failures;
+  }
+  return failures > 0 ? 1 : 0;
+}
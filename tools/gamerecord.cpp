@@ -0,0 +1,204 @@
+// gamerecord.cpp - convert binary game archives to and from text, and summarize them
+//
+// Usage: gamerecord <config.json> to-text ARCHIVE [--out FILE]
+//        gamerecord <config.json> from-text TEXT ARCHIVE
+//        gamerecord <config.json> info ARCHIVE
+//
+// The text form is PGN-like: tag lines such as [Result "1-0"], then the moves
+// in engine notation ("e2e4 e7e5 ...") ending with the result. from-text reads
+// that form and selfplay --games-out logs (one game per line), checks every
+// move against the rules, and appends the games to ARCHIVE.
+#include "ChessBoard.hpp"
+#include "ConfigReader.hpp"
+#include "GameManager.hpp"
+#include "GameRecord.hpp"
+#include "MoveValidator.hpp"
+#include "PortalSystem.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr size_t kLineWidth = 80;
+
+void printUsage() {
+  std::cerr << "Usage: gamerecord <config.json> to-text ARCHIVE [--out FILE]\n"
+            << "       gamerecord <config.json> from-text TEXT ARCHIVE\n"
+            << "       gamerecord <config.json> info ARCHIVE\n";
+}
+
+int toText(const GameConfig& config, int argc, char* argv[]) {
+  if (argc != 4 && !(argc == 6 && std::string(argv[4]) == "--out")) return -1;
+  GameRecordReader reader;
+  if (!reader.open(argv[3], config)) {
+    std::cerr << "Cannot read " << argv[3] << " as an archive for this config\n";
+    return 1;
+  }
+  std::ofstream file;
+  if (argc == 6) {
+    file.open(argv[5]);
+    if (!file) {
+      std::cerr << "Cannot write " << argv[5] << "\n";
+      return 1;
+    }
+  }
+  std::ostream& out = argc == 6 ? file : std::cout;
+
+  char hash[17];
+  std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(configHash(config)));
+  ChessBoard board(reader.boardSize(), "simple");  // only formats moves
+  GameRecordReader::Game game;
+  size_t number = 0;
+  std::string line;
+  while (reader.next(game)) {
+    out << "[Game \"" << ++number << "\"]\n[Config \"" << hash << "\"]\n[Plies \"" << game.plies
+        << "\"]\n[Result \"" << resultText(game.result) << "\"]\n";
+    GameRecordReader::MoveCursor cursor(game, reader.boardSize());
+    EncodedMove move;
+    line.clear();
+    while (cursor.next(move)) {
+      const std::string text = board.moveToNotation(move);
+      if (!line.empty() && line.size() + 1 + text.size() > kLineWidth) {
+        out << line << "\n";
+        line.clear();
+      }
+      line += line.empty() ? text : " " + text;
+    }
+    if (!line.empty()) out << line << "\n";
+    out << resultText(game.result) << "\n\n";
+  }
+  if (reader.truncated()) {
+    std::cerr << "Archive ends in a truncated game after game " << number << "\n";
+    return 1;
+  }
+  return 0;
+}
+
+int fromText(const GameConfig& config, int argc, char* argv[]) {
+  if (argc != 5) return -1;
+  std::ifstream in(argv[3]);
+  if (!in) {
+    std::cerr << "Cannot read " << argv[3] << "\n";
+    return 1;
+  }
+  GameRecordWriter writer;
+  if (!writer.open(argv[4], config)) {
+    std::cerr << "Cannot write " << argv[4] << " (unwritable or another config's archive)\n";
+    return 1;
+  }
+
+  ChessBoard board(config.game_settings.board_size, "simple");
+  MoveValidator validator;
+  PortalSystem portal_system(config.portals);
+  GameManager game_manager(board, validator, portal_system);
+  game_manager.setParallelStatusThreshold(ChessBoard::kMaxBoardSize + 1);
+  std::vector<EncodedMove> legal, moves;
+  bool in_game = false;
+  bool skipping = false;  // after an illegal move, until the game's result
+  size_t rejected = 0;
+  size_t line_number = 0;
+  std::string line, token;
+  while (std::getline(in, line)) {
+    ++line_number;
+    if (line.empty() || line[0] == '[' || line[0] == '#') continue;
+    std::istringstream tokens(line);
+    while (tokens >> token) {
+      if (!in_game) {
+        board.initializeBoard(config.pieces);
+        portal_system = PortalSystem(config.portals);
+        moves.clear();
+        in_game = true;
+      }
+      GameResult result;
+      if (parseResult(token, result)) {
+        if (!skipping) writer.writeGame(moves, result);
+        in_game = skipping = false;
+        continue;
+      }
+      if (skipping) continue;
+      EncodedMove move;
+      game_manager.generateLegalMoves(board.isWhiteToMove(), legal);
+      if (!board.parseMove(token, move) || std::find(legal.begin(), legal.end(), move) == legal.end()) {
+        std::cerr << argv[3] << ":" << line_number << ": illegal move " << token << ", game skipped\n";
+        ++rejected;
+        skipping = true;
+        continue;
+      }
+      UndoRecord undo;
+      board.applyMove(move, portal_system, undo);
+      moves.push_back(move);
+    }
+  }
+  if (in_game && !skipping && !moves.empty()) {
+    writer.writeGame(moves, GameResult::Unknown);  // movetext without a result
+  }
+  writer.flush();
+  std::cout << writer.games() << " games written to " << argv[4] << ", " << rejected << " skipped\n";
+  return 0;
+}
+
+int info(const GameConfig& config, int argc, char* argv[]) {
+  if (argc != 4) return -1;
+  GameRecordReader reader;
+  if (!reader.open(argv[3], config)) {
+    std::cerr << "Cannot read " << argv[3] << " as an archive for this config\n";
+    return 1;
+  }
+  GameRecordReader::Game game;
+  size_t games = 0, plies = 0, results[4] = {};
+  uint32_t longest = 0;
+  while (reader.next(game)) {
+    ++games;
+    plies += game.plies;
+    ++results[static_cast<int>(game.result)];
+    longest = std::max(longest, game.plies);
+  }
+  std::cout << "games " << games << "  plies " << plies << "  longest " << longest << "  bytes " << reader.bytes()
+            << "  bytes/ply " << (plies ? static_cast<double>(reader.bytes()) / plies : 0.0) << "\n"
+            << "1-0 " << results[0] << "  0-1 " << results[1] << "  1/2-1/2 " << results[2] << "  * " << results[3]
+            << "\n";
+  if (reader.truncated()) {
+    std::cout << "truncated after game " << games << "\n";
+    return 1;
+  }
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 4) {
+    printUsage();
+    return 1;
+  }
+  ConfigReader config_reader;
+  if (!config_reader.loadFromFile(argv[1])) {
+    std::cerr << "Failed to load configuration file\n";
+    return 1;
+  }
+  const GameConfig& config = config_reader.getConfig();
+  if (config.game_settings.board_size <= 0 || config.game_settings.board_size > ChessBoard::kMaxBoardSize) {
+    std::cerr << "Invalid board size\n";
+    return 1;
+  }
+
+  const std::string mode = argv[2];
+  int status = -1;
+  if (mode == "to-text") {
+    status = toText(config, argc, argv);
+  } else if (mode == "from-text") {
+    status = fromText(config, argc, argv);
+  } else if (mode == "info") {
+    status = info(config, argc, argv);
+  }
+  if (status < 0) {
+    printUsage();
+    return 1;
+  }
+  return status;
+}
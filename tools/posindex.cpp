@@ -0,0 +1,203 @@
+// posindex.cpp - index the positions of a game archive and query them
+//
+// Usage: posindex <config.json> build ARCHIVE OUT.idx [--threads T] [--chunk N]
+//        posindex <config.json> query INDEX [--position XFEN] [--moves "e2e4 e7e5 ..."]
+//                                   [--archive ARCHIVE] [--limit N]
+//        posindex <config.json> bench INDEX [--lookups N]
+//
+// build replays every game on T workers (default: all cores), N games per
+// sorted run (default 20000). query lists the games that reached the
+// position after --moves (played from --position, else the setup), with the
+// score from white's view; with --archive it also shows the move each game
+// played next. bench times lookups of keys taken from the index.
+#include "ChessBoard.hpp"
+#include "ConfigReader.hpp"
+#include "GameManager.hpp"
+#include "GameRecord.hpp"
+#include "MoveValidator.hpp"
+#include "PortalSystem.hpp"
+#include "PositionIndex.hpp"
+#include "PositionNotation.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void printUsage() {
+  std::cerr << "Usage: posindex <config.json> build ARCHIVE OUT.idx [--threads T] [--chunk N]\n"
+            << "       posindex <config.json> query INDEX [--position XFEN] [--moves \"e2e4 e7e5 ...\"]\n"
+            << "                                  [--archive ARCHIVE] [--limit N]\n"
+            << "       posindex <config.json> bench INDEX [--lookups N]\n";
+}
+
+int build(const GameConfig& config, int argc, char* argv[]) {
+  if (argc < 5) return -1;
+  unsigned threads = std::thread::hardware_concurrency();
+  size_t chunk = 20000;
+  for (int i = 5; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--threads" && i + 1 < argc) threads = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+    else if (arg == "--chunk" && i + 1 < argc) chunk = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+    else return -1;
+  }
+  try {
+    const PositionIndex::Summary summary = PositionIndex::build(config, argv[3], argv[4], threads, chunk);
+    std::cout << summary.games << " games, " << summary.entries << " positions in " << argv[4] << " ("
+              << summary.runs << " runs merged), " << summary.seconds << "s\n";
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
+
+int query(const GameConfig& config, int argc, char* argv[]) {
+  if (argc < 4) return -1;
+  std::string position, move_list, archive;
+  size_t limit = 20;
+  for (int i = 4; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--position" && i + 1 < argc) position = argv[++i];
+    else if (arg == "--moves" && i + 1 < argc) move_list = argv[++i];
+    else if (arg == "--archive" && i + 1 < argc) archive = argv[++i];
+    else if (arg == "--limit" && i + 1 < argc) limit = static_cast<size_t>(std::max(0, std::atoi(argv[++i])));
+    else return -1;
+  }
+  PositionIndex index;
+  if (!index.open(argv[3], config)) {
+    std::cerr << "Cannot use " << argv[3] << " with this config\n";
+    return 1;
+  }
+  GameRecordReader reader;
+  if (!archive.empty()) {
+    if (!reader.open(archive, config) || reader.bytes() != index.archiveBytes()) {
+      std::cerr << archive << " is not the archive " << argv[3] << " was built from\n";
+      return 1;
+    }
+  }
+
+  ChessBoard board(config.game_settings.board_size, "simple");
+  board.initializeBoard(config.pieces);
+  MoveValidator validator;
+  PortalSystem portal_system(config.portals);
+  const char* error = nullptr;
+  if (!position.empty() && !PositionNotation(config.pieces).parse(position, board, portal_system, &error)) {
+    std::cerr << "Invalid position: " << error << "\n";
+    return 1;
+  }
+  GameManager game_manager(board, validator, portal_system);
+  std::istringstream moves_in(move_list);
+  std::string text;
+  while (moves_in >> text) {
+    EncodedMove move;
+    if (!board.parseMove(text, move) || !game_manager.isLegalMove(move)) {
+      std::cerr << "Illegal move: " << text << "\n";
+      return 1;
+    }
+    game_manager.makeMove(move);
+  }
+
+  const auto started = std::chrono::steady_clock::now();
+  const auto [first, last] = index.find(board.positionKey(portal_system));
+  const double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - started).count();
+  size_t results[4] = {};
+  for (const auto* entry = first; entry != last; ++entry) {
+    ++results[static_cast<int>(index.result(entry->game))];
+  }
+  const size_t games = static_cast<size_t>(last - first);
+  const size_t decided = results[0] + results[1] + results[2];
+  std::cout << games << " games (lookup " << micros << " us)  1-0 " << results[0] << "  0-1 " << results[1]
+            << "  1/2-1/2 " << results[2] << "  * " << results[3];
+  if (decided) std::cout << "  white scores " << (results[0] * 2 + results[2]) * 50.0 / decided << "%";
+  std::cout << "\n";
+
+  GameRecordReader::Game game;
+  for (const auto* entry = first; entry != last && entry - first < static_cast<std::ptrdiff_t>(limit); ++entry) {
+    std::cout << "game " << entry->game + 1 << "  ply " << entry->ply << "  " << resultText(index.result(entry->game));
+    if (reader.isOpen()) {
+      reader.seek(index.gameOffset(entry->game));
+      if (reader.next(game)) {
+        GameRecordReader::MoveCursor cursor(game, reader.boardSize());
+        EncodedMove move;
+        bool more = true;
+        for (uint32_t ply = 0; ply <= entry->ply && more; ++ply) more = cursor.next(move);
+        std::cout << "  next " << (more ? board.moveToNotation(move) : "-");
+      }
+    }
+    std::cout << "\n";
+  }
+  if (games > limit) std::cout << "... " << games - limit << " more\n";
+  return 0;
+}
+
+int bench(const GameConfig& config, int argc, char* argv[]) {
+  if (argc < 4) return -1;
+  size_t lookups = 100000;
+  for (int i = 4; i < argc; ++i) {
+    if (std::string(argv[i]) == "--lookups" && i + 1 < argc) lookups = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+    else return -1;
+  }
+  PositionIndex index;
+  if (!index.open(argv[3], config) || index.size() == 0) {
+    std::cerr << "Cannot use " << argv[3] << " with this config\n";
+    return 1;
+  }
+  // Half the keys are in the index, half are random misses
+  std::mt19937_64 rng(1);
+  std::vector<uint64_t> keys(lookups);
+  for (size_t i = 0; i < lookups; ++i) {
+    keys[i] = i % 2 ? rng() : index.entry(rng() % index.size()).key;
+  }
+  const auto started = std::chrono::steady_clock::now();
+  size_t hits = 0;
+  for (uint64_t key : keys) {
+    const auto [first, last] = index.find(key);
+    hits += static_cast<size_t>(last - first);
+  }
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  std::cout << lookups << " lookups, " << hits << " hits, " << seconds * 1e6 / lookups << " us per lookup ("
+            << index.size() << " entries, " << index.games() << " games)\n";
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 4) {
+    printUsage();
+    return 1;
+  }
+  ConfigReader config_reader;
+  if (!config_reader.loadFromFile(argv[1])) {
+    std::cerr << "Failed to load configuration file\n";
+    return 1;
+  }
+  const GameConfig& config = config_reader.getConfig();
+  if (config.game_settings.board_size <= 0 || config.game_settings.board_size > ChessBoard::kMaxBoardSize) {
+    std::cerr << "Invalid board size\n";
+    return 1;
+  }
+
+  const std::string mode = argv[2];
+  int status = -1;
+  if (mode == "build") {
+    status = build(config, argc, argv);
+  } else if (mode == "query") {
+    status = query(config, argc, argv);
+  } else if (mode == "bench") {
+    status = bench(config, argc, argv);
+  }
+  if (status < 0) {
+    printUsage();
+    return 1;
+  }
+  return status;
+}
@@ -0,0 +1,261 @@
+// replay.cpp - replay archived games in parallel and check every move
+//
+// Usage: replay <config.json> ARCHIVE... [--threads T] [--chunk N] [--max-errors K]
+//
+// Every game is played again from the config's start position: each stored
+// move must be one of the legal moves in its position, and the recorded
+// result must fit the final one (1-0/0-1 only on checkmate, no win recorded
+// for a stalemate, no draw recorded for a mate). Draws and unfinished games
+// on other positions are accepted, as selfplay adjudicates those. Archives are
+// cut into chunks of N games (default 2000) that run on a work-stealing pool
+// of T workers (default: all cores); the first K problems (default 20) are
+// listed. Exits with 1 if any game fails or an archive is truncated.
+#include "ChessBoard.hpp"
+#include "ConfigReader.hpp"
+#include "GameManager.hpp"
+#include "GameRecord.hpp"
+#include "MoveValidator.hpp"
+#include "PortalSystem.hpp"
+#include "WorkStealingPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Options {
+  std::vector<std::string> archives;
+  unsigned threads = std::thread::hardware_concurrency();
+  size_t chunk = 2000;
+  size_t max_errors = 20;
+};
+
+// A run of consecutive games in one archive
+struct Chunk {
+  size_t file;
+  size_t offset;      // of the first game
+  size_t first_game;  // its 1-based number in the file
+  size_t games;
+};
+
+struct Problem {
+  size_t file;
+  size_t game;
+  uint32_t ply;  // 1-based; 0 for a problem with the result
+  std::string text;
+};
+
+// What one worker needs to replay games: its own readers and board
+struct Replayer {
+  Replayer(const GameConfig& config, size_t files)
+      : readers(files),
+        board(config.game_settings.board_size, "simple"),
+        portal_system(config.portals),
+        game_manager(board, validator, portal_system) {
+    game_manager.setParallelStatusThreshold(ChessBoard::kMaxBoardSize + 1);
+  }
+
+  std::vector<std::unique_ptr<GameRecordReader>> readers;  // opened on first use
+  ChessBoard board;
+  MoveValidator validator;
+  PortalSystem portal_system;
+  GameManager game_manager;
+  size_t games = 0;
+  size_t moves = 0;
+};
+
+void printUsage() {
+  std::cerr << "Usage: replay <config.json> ARCHIVE... [--threads T] [--chunk N] [--max-errors K]\n";
+}
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+  for (int i = 2; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--threads" && i + 1 < argc) {
+      options.threads = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+    } else if (arg == "--chunk" && i + 1 < argc) {
+      options.chunk = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+    } else if (arg == "--max-errors" && i + 1 < argc) {
+      options.max_errors = static_cast<size_t>(std::max(0, std::atoi(argv[++i])));
+    } else if (arg.rfind("--", 0) == 0) {
+      return false;
+    } else {
+      options.archives.push_back(arg);
+    }
+  }
+  return !options.archives.empty();
+}
+
+// Checks the recorded result against the final position; null if it fits
+const char* resultProblem(GameResult result, Replayer& replayer) {
+  const bool white = replayer.board.isWhiteToMove();
+  if (replayer.game_manager.hasLegalMove(white)) {
+    return result == GameResult::WhiteWin || result == GameResult::BlackWin ? "decisive result without checkmate"
+                                                                            : nullptr;
+  }
+  if (replayer.game_manager.isInCheck(white)) {
+    const GameResult expected = white ? GameResult::BlackWin : GameResult::WhiteWin;
+    return result == expected ? nullptr : "checkmate recorded with another result";
+  }
+  return result == GameResult::WhiteWin || result == GameResult::BlackWin ? "stalemate recorded as a win" : nullptr;
+}
+
+// Replays one game; false (with `problem` filled) at the first failure
+bool replayGame(const GameConfig& config, const GameRecordReader::Game& game, int board_size, Replayer& replayer,
+                Problem& problem) {
+  replayer.board.initializeBoard(config.pieces);
+  replayer.portal_system = PortalSystem(config.portals);
+  replayer.game_manager.resetHistory();
+
+  GameRecordReader::MoveCursor cursor(game, board_size);
+  EncodedMove move;
+  uint32_t ply = 0;
+  while (cursor.next(move)) {
+    ++ply;
+    if (!replayer.game_manager.isLegalMove(move)) {
+      problem.ply = ply;
+      problem.text = "illegal move " + replayer.board.moveToNotation(move);
+      return false;
+    }
+    replayer.game_manager.makeMove(move);
+    ++replayer.moves;
+  }
+  if (ply != game.plies) {
+    problem.ply = ply + 1;
+    problem.text = "corrupt move data";
+    return false;
+  }
+  if (const char* text = resultProblem(game.result, replayer)) {
+    problem.ply = 0;
+    problem.text = std::string(text) + " (" + resultText(game.result) + ")";
+    return false;
+  }
+  return true;
+}
+
+// Splits the archives into chunks of up to `chunk` games; false if one cannot
+// be read. Truncated archives are reported and replayed up to the damage.
+bool planChunks(const GameConfig& config, const Options& options, std::vector<Chunk>& chunks, size_t& bytes,
+                size_t& truncated) {
+  GameRecordReader reader;
+  GameRecordReader::Game game;
+  for (size_t file = 0; file < options.archives.size(); ++file) {
+    if (!reader.open(options.archives[file], config)) {
+      std::cerr << "Cannot read " << options.archives[file] << " as an archive for this config\n";
+      return false;
+    }
+    bytes += reader.bytes();
+    size_t number = 0;
+    size_t offset = reader.tell();
+    while (reader.next(game)) {
+      if (number % options.chunk == 0) chunks.push_back(Chunk{file, offset, number + 1, 0});
+      ++chunks.back().games;
+      ++number;
+      offset = reader.tell();
+    }
+    if (reader.truncated()) {
+      std::cerr << options.archives[file] << ": truncated after game " << number << "\n";
+      ++truncated;
+    }
+  }
+  return true;
+}
+
+int replay(const GameConfig& config, const Options& options) {
+  const auto started = std::chrono::steady_clock::now();
+  std::vector<Chunk> chunks;
+  size_t bytes = 0, truncated = 0;
+  if (!planChunks(config, options, chunks, bytes, truncated)) return 1;
+
+  WorkStealingPool pool(options.threads);
+  std::vector<std::unique_ptr<Replayer>> replayers;
+  for (unsigned i = 0; i < pool.size(); ++i) {
+    replayers.push_back(std::make_unique<Replayer>(config, options.archives.size()));
+  }
+  std::mutex problems_mutex;
+  std::vector<Problem> problems;
+  std::atomic<size_t> failed{0};
+
+  pool.run(chunks.size(), [&](size_t index, unsigned worker) {
+    const Chunk& chunk = chunks[index];
+    Replayer& replayer = *replayers[worker];
+    auto& reader = replayer.readers[chunk.file];
+    if (!reader) {
+      reader = std::make_unique<GameRecordReader>();
+      if (!reader->open(options.archives[chunk.file], config)) {
+        throw std::runtime_error("Cannot reopen " + options.archives[chunk.file]);
+      }
+    }
+    reader->seek(chunk.offset);
+    GameRecordReader::Game game;
+    Problem problem;
+    for (size_t i = 0; i < chunk.games && reader->next(game); ++i) {
+      ++replayer.games;
+      if (replayGame(config, game, reader->boardSize(), replayer, problem)) continue;
+      failed.fetch_add(1, std::memory_order_relaxed);
+      problem.file = chunk.file;
+      problem.game = chunk.first_game + i;
+      std::lock_guard<std::mutex> lock(problems_mutex);
+      problems.push_back(problem);
+    }
+  });
+
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  size_t games = 0, moves = 0;
+  for (const auto& replayer : replayers) {
+    games += replayer->games;
+    moves += replayer->moves;
+  }
+  std::sort(problems.begin(), problems.end(), [](const Problem& a, const Problem& b) {
+    return a.file != b.file ? a.file < b.file : a.game < b.game;
+  });
+  for (size_t i = 0; i < problems.size() && i < options.max_errors; ++i) {
+    const Problem& problem = problems[i];
+    std::cout << options.archives[problem.file] << ": game " << problem.game;
+    if (problem.ply) std::cout << ", ply " << problem.ply;
+    std::cout << ": " << problem.text << "\n";
+  }
+  if (problems.size() > options.max_errors) {
+    std::cout << "... " << problems.size() - options.max_errors << " more\n";
+  }
+  std::cout << games << " games, " << moves << " moves, " << failed.load() << " failed, " << seconds << "s ("
+            << static_cast<size_t>(seconds > 0 ? moves / seconds : 0) << " moves/s, "
+            << static_cast<size_t>(seconds > 0 ? games / seconds : 0) << " games/s)\n"
+            << pool.size() << " threads, " << chunks.size() << " chunks, " << pool.steals() << " stolen\n";
+  return failed.load() || truncated ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (argc < 3 || !parseOptions(argc, argv, options)) {
+    printUsage();
+    return 1;
+  }
+  ConfigReader config_reader;
+  if (!config_reader.loadFromFile(argv[1])) {
+    std::cerr << "Failed to load configuration file\n";
+    return 1;
+  }
+  const GameConfig& config = config_reader.getConfig();
+  if (config.game_settings.board_size <= 0 || config.game_settings.board_size > ChessBoard::kMaxBoardSize) {
+    std::cerr << "Invalid board size\n";
+    return 1;
+  }
+
+  try {
+    return replay(config, options);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+}
@@ -0,0 +1,475 @@
+// selfplay.cpp - play many games from one config and report balance statistics
+//
+// Usage: selfplay <config.json> [--games N] [--threads T] [--white PLAYER] [--black PLAYER]
+//                 [--seed S] [--random-plies K] [--max-plies P] [--report FILE] [--games-out FILE]
+//                 [--record FILE] [--position XFEN]
+//
+// PLAYER is random, weighted, search[:depth] (default depth 2) or
+// mcts[:playouts] (default 400, one thread per game). The first K
+// plies of every game are random so that deterministic players still see
+// varied positions. The JSON report goes to FILE, or stdout without --report.
+// --games-out writes every game as a line of moves and its result, the log
+// format tools/book builds opening books from; --record appends every game to
+// a binary archive (GameRecord.hpp). Both list games in finishing order.
+// --position starts every game from an extended FEN (PositionNotation.hpp)
+// instead of the config's setup; game logs replay from the setup, so it
+// cannot be combined with --games-out or --record.
+#include "ChessBoard.hpp"
+#include "ConfigReader.hpp"
+#include "GameManager.hpp"
+#include "GameRecord.hpp"
+#include "Mcts.hpp"
+#include "MoveValidator.hpp"
+#include "OpeningBook.hpp"
+#include "PortalSystem.hpp"
+#include "PositionNotation.hpp"
+#include "Search.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+enum class PlayerKind { Random, Weighted, Search, Mcts };
+
+struct PlayerSpec {
+  PlayerKind kind = PlayerKind::Random;
+  int depth = 2;
+  int playouts = 400;
+
+  std::string name() const {
+    switch (kind) {
+      case PlayerKind::Weighted: return "weighted";
+      case PlayerKind::Search: return "search:" + std::to_string(depth);
+      case PlayerKind::Mcts: return "mcts:" + std::to_string(playouts);
+      default: return "random";
+    }
+  }
+};
+
+bool parsePlayer(const std::string& text, PlayerSpec& spec) {
+  if (text == "random") {
+    spec.kind = PlayerKind::Random;
+  } else if (text == "weighted") {
+    spec.kind = PlayerKind::Weighted;
+  } else if (text.rfind("search", 0) == 0) {
+    spec.kind = PlayerKind::Search;
+    if (text.size() > 6) {
+      if (text[6] != ':') return false;
+      spec.depth = std::atoi(text.c_str() + 7);
+      if (spec.depth < 1) return false;
+    }
+  } else if (text.rfind("mcts", 0) == 0) {
+    spec.kind = PlayerKind::Mcts;
+    if (text.size() > 4) {
+      if (text[4] != ':') return false;
+      spec.playouts = std::atoi(text.c_str() + 5);
+      if (spec.playouts < 1) return false;
+    }
+  } else {
+    return false;
+  }
+  return true;
+}
+
+struct Options {
+  std::string config_path;
+  int games = 1000;
+  unsigned threads = std::thread::hardware_concurrency();
+  PlayerSpec white;
+  PlayerSpec black;
+  uint64_t seed = 1;
+  int random_plies = 4;
+  int max_plies = 400;
+  std::string report_path;
+  std::string games_path;
+  std::string record_path;
+  std::string position;
+};
+
+// A finished game, kept only when it is written out
+struct GameLog {
+  std::string text;  // moves and result on one line
+  std::vector<EncodedMove> moves;
+  GameResult result = GameResult::Unknown;
+};
+
+// Per-thread totals, merged once at the end
+struct Stats {
+  int white_wins = 0;
+  int black_wins = 0;
+  int draws = 0;
+  int checkmates = 0;
+  int stalemates = 0;
+  int repetitions = 0;
+  int fifty_moves = 0;
+  int turn_limits = 0;
+  int ply_limits = 0;  // stopped by --max-plies
+  long long total_plies = 0;
+  int min_plies = -1;
+  int max_plies = 0;
+  std::vector<long long> portal_uses;      // teleports plus direct entry -> exit moves
+  std::vector<long long> portal_landings;  // moves ending on the entry square
+  std::vector<long long> cooldown_blocked;  // landings that did not teleport because of the cooldown
+  std::vector<long long> colour_refused;    // landings by a colour the portal does not take
+
+  explicit Stats(size_t portals)
+      : portal_uses(portals), portal_landings(portals), cooldown_blocked(portals), colour_refused(portals) {}
+
+  void merge(const Stats& other) {
+    white_wins += other.white_wins;
+    black_wins += other.black_wins;
+    draws += other.draws;
+    checkmates += other.checkmates;
+    stalemates += other.stalemates;
+    repetitions += other.repetitions;
+    fifty_moves += other.fifty_moves;
+    turn_limits += other.turn_limits;
+    ply_limits += other.ply_limits;
+    total_plies += other.total_plies;
+    if (other.min_plies >= 0 && (min_plies < 0 || other.min_plies < min_plies)) min_plies = other.min_plies;
+    max_plies = std::max(max_plies, other.max_plies);
+    for (size_t i = 0; i < portal_uses.size(); ++i) {
+      portal_uses[i] += other.portal_uses[i];
+      portal_landings[i] += other.portal_landings[i];
+      cooldown_blocked[i] += other.cooldown_blocked[i];
+      colour_refused[i] += other.colour_refused[i];
+    }
+  }
+};
+
+uint64_t gameSeed(uint64_t seed, int game) {
+  uint64_t z = seed + 0x9e3779b97f4a7c15ull * static_cast<uint64_t>(game + 1);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+// The MCTS light policy: captures, promotions and portal entries are likelier
+EncodedMove pickWeighted(const std::vector<EncodedMove>& moves, const ChessBoard& board,
+                         const PortalSystem& portal_system, std::mt19937_64& rng) {
+  std::vector<double> weights;
+  weights.reserve(moves.size());
+  for (EncodedMove move : moves) {
+    weights.push_back(Mcts::policyWeight(move, board, portal_system));
+  }
+  std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+  return moves[pick(rng)];
+}
+
+// Fills `log` with the game's moves and result when it is not null
+void playGame(const GameConfig& config, const Options& options, int game, Stats& stats, GameLog* log) {
+  ChessBoard board(config.game_settings.board_size);
+  board.initializeBoard(config.pieces);
+  MoveValidator validator;
+  PortalSystem portal_system(config.portals);
+  if (!options.position.empty()) {
+    PositionNotation(config.pieces).parse(options.position, board, portal_system);
+  }
+  GameManager game_manager(board, validator, portal_system);
+  game_manager.setTurnLimit(config.game_settings.turn_limit);
+  // Games already run one per worker; status checks stay on the calling thread
+  game_manager.setParallelStatusThreshold(ChessBoard::kMaxBoardSize + 1);
+  Search search(board, game_manager, portal_system);
+  // Expansions are bounded by playouts, so the pool never needs more than a
+  // few dozen nodes per playout
+  Mcts::Config mcts_config;
+  mcts_config.seed = gameSeed(options.seed, game);
+  mcts_config.node_capacity = static_cast<size_t>(std::max(options.white.playouts, options.black.playouts)) * 64;
+  Mcts mcts(board, game_manager, portal_system, mcts_config);
+  std::mt19937_64 rng(gameSeed(options.seed, game));
+  std::vector<EncodedMove> moves;
+  const auto& portals = portal_system.getPortals();
+  std::vector<char> landing_refused(portals.size());
+  std::vector<char> landing_cooling(portals.size());
+
+  int plies = 0;
+  GameResult result = GameResult::Draw;
+  while (true) {
+    const bool white = board.isWhiteToMove();
+    game_manager.generateLegalMoves(white, moves);
+    if (moves.empty()) {
+      if (game_manager.isInCheck(white)) {
+        ++stats.checkmates;
+        ++(white ? stats.black_wins : stats.white_wins);
+        result = white ? GameResult::BlackWin : GameResult::WhiteWin;
+      } else {
+        ++stats.stalemates;
+        ++stats.draws;
+      }
+      break;
+    }
+    if (const char* reason = game_manager.getDrawReason()) {
+      std::string why = reason;
+      ++(why == "threefold repetition" ? stats.repetitions
+         : why == "fifty-move rule"    ? stats.fifty_moves
+                                       : stats.turn_limits);
+      ++stats.draws;
+      break;
+    }
+    if (plies >= options.max_plies) {
+      ++stats.ply_limits;
+      ++stats.draws;
+      break;
+    }
+
+    const PlayerSpec& player = white ? options.white : options.black;
+    EncodedMove move;
+    if (plies < options.random_plies || player.kind == PlayerKind::Random) {
+      move = moves[std::uniform_int_distribution<size_t>(0, moves.size() - 1)(rng)];
+    } else if (player.kind == PlayerKind::Weighted) {
+      move = pickWeighted(moves, board, portal_system, rng);
+    } else if (player.kind == PlayerKind::Search) {
+      move = search.bestMove(player.depth).move;
+    } else {
+      Mcts::Limits limits;
+      limits.playouts = static_cast<size_t>(player.playouts);
+      move = mcts.think(limits).move;
+    }
+
+    const Position from = board.squarePosition(move.from());
+    const Position to = board.squarePosition(move.to());
+    // Why a landing on an entry square might not teleport, read before the
+    // move starts or clears any cooldown
+    const char* const colour = white ? "white" : "black";
+    for (size_t i = 0; i < portals.size(); ++i) {
+      const auto& entry = portals[i].positions.entry;
+      if (entry.x != to.x || entry.y != to.y) continue;
+      landing_refused[i] = std::find(portals[i].properties.allowed_colors.begin(),
+                                     portals[i].properties.allowed_colors.end(),
+                                     colour) == portals[i].properties.allowed_colors.end();
+      landing_cooling[i] = portal_system.getRemainingCooldown(i) > 0;
+    }
+    if (log) {
+      log->text += board.moveToNotation(move);
+      log->text += ' ';
+      log->moves.push_back(move);
+    }
+    game_manager.makeMove(move);
+    const UndoRecord& undo = game_manager.lastUndoRecord();
+    for (size_t i = 0; i < portals.size(); ++i) {
+      const auto& entry = portals[i].positions.entry;
+      const auto& exit = portals[i].positions.exit;
+      if (entry.x == to.x && entry.y == to.y) {
+        ++stats.portal_landings[i];
+        if (undo.portal != static_cast<int16_t>(i)) {
+          if (landing_refused[i]) {
+            ++stats.colour_refused[i];
+          } else if (landing_cooling[i]) {
+            ++stats.cooldown_blocked[i];
+          }
+        }
+      }
+      if (undo.portal == static_cast<int16_t>(i) ||
+          (entry.x == from.x && entry.y == from.y && exit.x == to.x && exit.y == to.y)) {
+        ++stats.portal_uses[i];
+      }
+    }
+    ++plies;
+  }
+
+  if (log) {
+    log->text += resultText(result);
+    log->text += '\n';
+    log->result = result;
+  }
+  stats.total_plies += plies;
+  if (stats.min_plies < 0 || plies < stats.min_plies) stats.min_plies = plies;
+  stats.max_plies = std::max(stats.max_plies, plies);
+}
+
+nlohmann::json buildReport(const Options& options, const GameConfig& config, const Stats& stats, double seconds) {
+  nlohmann::json report;
+  report["config"] = options.config_path;
+  report["games"] = options.games;
+  report["threads"] = options.threads;
+  report["seed"] = options.seed;
+  report["white_player"] = options.white.name();
+  report["black_player"] = options.black.name();
+  report["results"] = {
+      {"white_wins", stats.white_wins},
+      {"black_wins", stats.black_wins},
+      {"draws", stats.draws},
+      {"white_score", options.games ? (stats.white_wins + 0.5 * stats.draws) / options.games : 0.0},
+  };
+  report["end_reasons"] = {
+      {"checkmate", stats.checkmates},
+      {"stalemate", stats.stalemates},
+      {"threefold_repetition", stats.repetitions},
+      {"fifty_move_rule", stats.fifty_moves},
+      {"turn_limit", stats.turn_limits},
+      {"max_plies", stats.ply_limits},
+  };
+  report["game_length_plies"] = {
+      {"mean", options.games ? static_cast<double>(stats.total_plies) / options.games : 0.0},
+      {"min", std::max(stats.min_plies, 0)},
+      {"max", stats.max_plies},
+  };
+  nlohmann::json portals = nlohmann::json::array();
+  for (size_t i = 0; i < config.portals.size(); ++i) {
+    long long landings = stats.portal_landings[i];
+    portals.push_back({
+        {"id", config.portals[i].id},
+        {"uses", stats.portal_uses[i]},
+        {"entry_landings", landings},
+        {"cooldown_blocked", stats.cooldown_blocked[i]},
+        {"cooldown_block_rate", landings ? static_cast<double>(stats.cooldown_blocked[i]) / landings : 0.0},
+        {"colour_refused", stats.colour_refused[i]},
+        {"colour_refusal_rate", landings ? static_cast<double>(stats.colour_refused[i]) / landings : 0.0},
+    });
+  }
+  report["portals"] = portals;
+  report["elapsed_seconds"] = seconds;
+  report["games_per_minute"] = seconds > 0 ? options.games * 60.0 / seconds : 0.0;
+  return report;
+}
+
+void printUsage() {
+  std::cerr << "Usage: selfplay <config.json> [--games N] [--threads T] [--white PLAYER] [--black PLAYER]\n"
+            << "                [--seed S] [--random-plies K] [--max-plies P] [--report FILE] [--games-out FILE]\n"
+            << "                [--record FILE] [--position XFEN]\n"
+            << "PLAYER: random, weighted, search[:depth], mcts[:playouts]\n";
+}
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+  if (argc < 2) return false;
+  options.config_path = argv[1];
+  for (int i = 2; i < argc; ++i) {
+    std::string flag = argv[i];
+    if (i + 1 >= argc) return false;
+    std::string value = argv[++i];
+    if (flag == "--games") {
+      options.games = std::atoi(value.c_str());
+    } else if (flag == "--threads") {
+      options.threads = static_cast<unsigned>(std::max(1, std::atoi(value.c_str())));
+    } else if (flag == "--white") {
+      if (!parsePlayer(value, options.white)) return false;
+    } else if (flag == "--black") {
+      if (!parsePlayer(value, options.black)) return false;
+    } else if (flag == "--seed") {
+      options.seed = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (flag == "--random-plies") {
+      options.random_plies = std::max(0, std::atoi(value.c_str()));
+    } else if (flag == "--max-plies") {
+      options.max_plies = std::max(1, std::atoi(value.c_str()));
+    } else if (flag == "--report") {
+      options.report_path = value;
+    } else if (flag == "--games-out") {
+      options.games_path = value;
+    } else if (flag == "--record") {
+      options.record_path = value;
+    } else if (flag == "--position") {
+      options.position = value;
+    } else {
+      return false;
+    }
+  }
+  return options.games > 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage();
+    return 1;
+  }
+
+  ConfigReader config_reader;
+  if (!config_reader.loadFromFile(options.config_path)) {
+    std::cerr << "Failed to load configuration file\n";
+    return 1;
+  }
+  const GameConfig& config = config_reader.getConfig();
+  if (config.game_settings.board_size <= 0 || config.game_settings.board_size > ChessBoard::kMaxBoardSize) {
+    std::cerr << "Invalid board size\n";
+    return 1;
+  }
+
+  if (!options.position.empty()) {
+    if (!options.games_path.empty() || !options.record_path.empty()) {
+      std::cerr << "--position cannot be combined with --games-out or --record\n";
+      return 1;
+    }
+    ChessBoard board(config.game_settings.board_size);
+    board.initializeBoard(config.pieces);
+    PortalSystem portal_system(config.portals);
+    const char* error = nullptr;
+    if (!PositionNotation(config.pieces).parse(options.position, board, portal_system, &error)) {
+      std::cerr << "Invalid position: " << error << "\n";
+      return 1;
+    }
+  }
+
+  // Workers claim game numbers from a shared counter; each game is seeded by
+  // its number, so results do not depend on the thread count
+  std::ofstream games_out;
+  if (!options.games_path.empty()) {
+    games_out.open(options.games_path);
+    if (!games_out) {
+      std::cerr << "Cannot write " << options.games_path << "\n";
+      return 1;
+    }
+  }
+  GameRecordWriter recorder;
+  if (!options.record_path.empty() && !recorder.open(options.record_path, config)) {
+    std::cerr << "Cannot record to " << options.record_path << " (unwritable or another config's archive)\n";
+    return 1;
+  }
+  const bool keep_games = games_out.is_open() || recorder.isOpen();
+
+  Stats totals(config.portals.size());
+  std::mutex totals_mutex;
+  std::atomic<int> next_game{0};
+  auto begin = std::chrono::steady_clock::now();
+  {
+    ThreadPool pool(options.threads);
+    std::vector<std::future<void>> workers;
+    for (unsigned t = 0; t < pool.size(); ++t) {
+      workers.push_back(pool.submit([&] {
+        Stats local(config.portals.size());
+        GameLog log;
+        for (int game = next_game++; game < options.games; game = next_game++) {
+          log.text.clear();
+          log.moves.clear();
+          playGame(config, options, game, local, keep_games ? &log : nullptr);
+          if (keep_games) {
+            std::lock_guard<std::mutex> lock(totals_mutex);
+            if (games_out.is_open()) games_out << log.text;
+            if (recorder.isOpen()) recorder.writeGame(log.moves, log.result);
+          }
+        }
+        std::lock_guard<std::mutex> lock(totals_mutex);
+        totals.merge(local);
+      }));
+    }
+    for (auto& worker : workers) {
+      worker.get();
+    }
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+  nlohmann::json report = buildReport(options, config, totals, elapsed.count());
+  if (options.report_path.empty()) {
+    std::cout << report.dump(2) << "\n";
+  } else {
+    std::ofstream out(options.report_path);
+    if (!out) {
+      std::cerr << "Cannot write " << options.report_path << "\n";
+      return 1;
+    }
+    out << report.dump(2) << "\n";
+    std::cerr << "Report written to " << options.report_path << "\n";
+  }
+  return 0;
+}
@@ -0,0 +1,204 @@
+// tablebase.cpp - generate and probe endgame tablebases for one config
+//
+// Usage: tablebase <config.json> generate SIGNATURE [--threads T] [--out DIR]
+//        tablebase <config.json> probe PLACEMENT [--black] TABLE.tb...
+//
+// SIGNATURE names the material, white first: KQvK, KRvK, KBNvK. Every table
+// a capture leads to is generated too. PLACEMENT lists pieces as letter and
+// square, uppercase for white: "Kc6 Qb5 kc8". Probing prints the result for
+// the side to move (white unless --black) and the line the tables give.
+#include "ChessBoard.hpp"
+#include "ConfigReader.hpp"
+#include "GameManager.hpp"
+#include "MoveValidator.hpp"
+#include "PortalSystem.hpp"
+#include "Tablebase.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void printUsage() {
+  std::cerr << "Usage: tablebase <config.json> generate SIGNATURE [--threads T] [--out DIR]\n"
+            << "       tablebase <config.json> probe PLACEMENT [--black] TABLE.tb...\n";
+}
+
+int generate(const GameConfig& config, int argc, char* argv[]) {
+  if (argc < 4) return -1;
+  const std::string signature = argv[3];
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  std::string dir = ".";
+  for (int i = 4; i < argc; i += 2) {
+    const std::string flag = argv[i];
+    if (i + 1 >= argc) return -1;
+    if (flag == "--threads") threads = static_cast<unsigned>(std::max(1, std::atoi(argv[i + 1])));
+    else if (flag == "--out") dir = argv[i + 1];
+    else return -1;
+  }
+
+  try {
+    for (const Tablebase::Summary& summary : Tablebase::generate(config, signature, dir, threads)) {
+      std::cout << std::left << std::setw(8) << summary.name << std::right << " positions " << summary.positions
+                << "  wins " << summary.wins << "  losses " << summary.losses << "  draws " << summary.draws
+                << "  illegal " << summary.illegal << "  longest " << summary.longest_plies << " plies"
+                << "  symmetries " << summary.symmetries << "  " << std::fixed << std::setprecision(2)
+                << summary.seconds << "s\n";
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
+
+bool setUpPlacement(const std::string& placement, ChessBoard& board) {
+  std::istringstream in(placement);
+  std::string token;
+  while (in >> token) {
+    const char* name = nullptr;
+    switch (std::toupper(static_cast<unsigned char>(token[0]))) {
+      case 'K': name = "King"; break;
+      case 'Q': name = "Queen"; break;
+      case 'R': name = "Rook"; break;
+      case 'B': name = "Bishop"; break;
+      case 'N': name = "Knight"; break;
+      default: return false;
+    }
+    Position pos;
+    if (!ChessBoard::parseNotation(token.substr(1), pos) || !board.isInBounds(pos) ||
+        !board.getSquare(pos).is_empty()) {
+      return false;
+    }
+    board.placePiece(name, std::isupper(static_cast<unsigned char>(token[0])) != 0, pos.x, pos.y);
+  }
+  return true;
+}
+
+bool probeAny(const std::vector<std::unique_ptr<Tablebase>>& tables, const ChessBoard& board,
+              const PortalSystem& portal_system, Tablebase::Probe& result) {
+  for (const auto& table : tables) {
+    if (table->probe(board, portal_system, result)) return true;
+  }
+  return false;
+}
+
+std::string describe(const Tablebase::Probe& probe) {
+  switch (probe.outcome) {
+    case Tablebase::Outcome::Win: return "win in " + std::to_string(probe.plies) + " plies";
+    case Tablebase::Outcome::Loss: return "loss in " + std::to_string(probe.plies) + " plies";
+    default: return "draw";
+  }
+}
+
+int probe(const GameConfig& config, int argc, char* argv[]) {
+  if (argc < 5) return -1;
+  bool white_to_move = true;
+  std::vector<std::unique_ptr<Tablebase>> tables;
+  for (int i = 4; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--black") {
+      white_to_move = false;
+      continue;
+    }
+    auto table = std::make_unique<Tablebase>();
+    if (!table->open(arg, config)) {
+      std::cerr << "Cannot use " << arg << " with this config\n";
+      return 1;
+    }
+    tables.push_back(std::move(table));
+  }
+
+  ChessBoard board(config.game_settings.board_size, "simple");
+  MoveValidator validator;
+  PortalSystem portal_system(config.portals);
+  GameManager game_manager(board, validator, portal_system);
+  if (!setUpPlacement(argv[3], board)) {
+    std::cerr << "Bad placement " << argv[3] << "\n";
+    return 1;
+  }
+  board.setWhiteToMove(white_to_move);
+
+  Tablebase::Probe result;
+  if (!probeAny(tables, board, portal_system, result)) {
+    std::cout << "not in the given tables\n";
+    return 1;
+  }
+  std::cout << (white_to_move ? "white" : "black") << " to move: " << describe(result) << "\n";
+
+  // Follow the tables: the winner shortens the mate, the loser delays it
+  std::vector<EncodedMove> moves;
+  std::string line;
+  while (result.outcome != Tablebase::Outcome::Draw && result.plies > 0) {
+    game_manager.generateLegalMoves(board.isWhiteToMove(), moves);
+    EncodedMove best;
+    bool found = false;
+    for (EncodedMove move : moves) {
+      UndoRecord undo;
+      board.applyMove(move, portal_system, undo);
+      Tablebase::Probe child;
+      const bool known = probeAny(tables, board, portal_system, child);
+      board.undoMove(move, undo, portal_system);
+      const Tablebase::Outcome wanted =
+          result.outcome == Tablebase::Outcome::Win ? Tablebase::Outcome::Loss : Tablebase::Outcome::Win;
+      if (known && child.outcome == wanted && child.plies == result.plies - 1) {
+        best = move;
+        found = true;
+        break;
+      }
+    }
+    if (!found) {
+      line += " ...";  // continues in a table that was not given
+      break;
+    }
+    line += " " + board.moveToNotation(best);
+    UndoRecord undo;
+    board.applyMove(best, portal_system, undo);
+    result = {result.outcome == Tablebase::Outcome::Win ? Tablebase::Outcome::Loss : Tablebase::Outcome::Win,
+              result.plies - 1};
+  }
+  if (!line.empty()) {
+    std::cout << "line:" << line << "\n";
+  }
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    printUsage();
+    return 1;
+  }
+  ConfigReader config_reader;
+  if (!config_reader.loadFromFile(argv[1])) {
+    std::cerr << "Failed to load configuration file\n";
+    return 1;
+  }
+  const GameConfig& config = config_reader.getConfig();
+  if (config.game_settings.board_size <= 0 || config.game_settings.board_size > ChessBoard::kMaxBoardSize) {
+    std::cerr << "Invalid board size\n";
+    return 1;
+  }
+
+  const std::string mode = argv[2];
+  int status = -1;
+  if (mode == "generate") {
+    status = generate(config, argc, argv);
+  } else if (mode == "probe") {
+    status = probe(config, argc, argv);
+  }
+  if (status < 0) {
+    printUsage();
+    return 1;
+  }
+  return status;
+}
@@ -0,0 +1,507 @@
+// tournament.cpp - play two engine builds against each other and run an SPRT
+//
+// Usage: tournament <config.json> --engine1 CMD --engine2 CMD [--tc BASE+INC | --movetime MS]
+//                   [--pairs N] [--concurrency C] [--elo0 E0] [--elo1 E1] [--alpha A] [--beta B]
+//                   [--opening-plies K] [--max-plies P] [--seed S]
+//
+// Each engine is a command run through /bin/sh that speaks the --engine line
+// protocol of chess_game, e.g. "./bin/chess_game data/chess_pieces.json --engine".
+// Openings are K random plies; every opening is played twice with colours
+// swapped, and the SPRT is computed on those pairs (pentanomial model). The
+// run stops as soon as the test accepts H0 (engine1 is not stronger by ELO1)
+// or H1 (engine1 is at least ELO1 stronger than ELO0), or after N pairs.
+#include "ChessBoard.hpp"
+#include "ConfigReader.hpp"
+#include "GameManager.hpp"
+#include "MoveValidator.hpp"
+#include "PortalSystem.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <fcntl.h>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <random>
+#include <sstream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  std::string config_path;
+  std::string engine_commands[2];
+  int64_t base_ms = 2000;
+  int64_t increment_ms = 50;
+  int64_t movetime_ms = 0;  // fixed time per move instead of a clock
+  int pairs = 500;
+  unsigned concurrency = std::thread::hardware_concurrency();
+  double elo0 = 0.0;
+  double elo1 = 5.0;
+  double alpha = 0.05;
+  double beta = 0.05;
+  int opening_plies = 6;
+  int max_plies = 400;
+  uint64_t seed = 1;
+};
+
+// A child process speaking the engine protocol over two pipes
+class EngineProcess {
+public:
+  explicit EngineProcess(const std::string& command) : command_(command) { start(); }
+  ~EngineProcess() { shutdown(); }
+
+  EngineProcess(const EngineProcess&) = delete;
+  EngineProcess& operator=(const EngineProcess&) = delete;
+
+  bool alive() const { return pid_ > 0; }
+
+  bool send(const std::string& line) {
+    if (!alive()) return false;
+    std::string data = line + "\n";
+    const char* p = data.data();
+    size_t left = data.size();
+    while (left > 0) {
+      ssize_t written = ::write(to_engine_, p, left);
+      if (written <= 0) {
+        shutdown();
+        return false;
+      }
+      p += written;
+      left -= static_cast<size_t>(written);
+    }
+    return true;
+  }
+
+  // Next line from the engine, waiting at most timeout_ms. False on timeout or exit.
+  bool readLine(std::string& line, int64_t timeout_ms) {
+    const auto deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (alive()) {
+      size_t newline = buffer_.find('\n');
+      if (newline != std::string::npos) {
+        line = buffer_.substr(0, newline);
+        buffer_.erase(0, newline + 1);
+        return true;
+      }
+      int64_t left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+      if (left <= 0) return false;
+      pollfd fd{from_engine_, POLLIN, 0};
+      if (::poll(&fd, 1, static_cast<int>(std::min<int64_t>(left, 1000))) <= 0) continue;
+      char chunk[4096];
+      ssize_t got = ::read(from_engine_, chunk, sizeof(chunk));
+      if (got <= 0) {
+        shutdown();
+        return false;
+      }
+      buffer_.append(chunk, static_cast<size_t>(got));
+    }
+    return false;
+  }
+
+  // Wait for a line starting with `prefix`, skipping info output
+  bool expect(const std::string& prefix, std::string& line, int64_t timeout_ms) {
+    const auto deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (true) {
+      int64_t left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+      if (left <= 0 || !readLine(line, left)) return false;
+      if (line.rfind(prefix, 0) == 0) return true;
+    }
+  }
+
+  void restart() {
+    shutdown();
+    start();
+  }
+
+private:
+  // The pipes are close-on-exec: games run on several threads at once, and
+  // an engine that inherited another game's pipe ends would keep that pipe
+  // open after its own engine died, so the crash would never read as EOF
+  void start() {
+    int in_pipe[2], out_pipe[2];
+    if (::pipe2(in_pipe, O_CLOEXEC) != 0) {
+      return;
+    }
+    if (::pipe2(out_pipe, O_CLOEXEC) != 0) {
+      ::close(in_pipe[0]);
+      ::close(in_pipe[1]);
+      return;
+    }
+    pid_t pid = ::fork();
+    if (pid < 0) {
+      for (int fd : {in_pipe[0], in_pipe[1], out_pipe[0], out_pipe[1]}) ::close(fd);
+      return;
+    }
+    if (pid == 0) {
+      // dup2 clears close-on-exec on the copies the engine keeps
+      ::dup2(in_pipe[0], STDIN_FILENO);
+      ::dup2(out_pipe[1], STDOUT_FILENO);
+      ::execl("/bin/sh", "sh", "-c", command_.c_str(), static_cast<char*>(nullptr));
+      ::_exit(127);
+    }
+    ::close(in_pipe[0]);
+    ::close(out_pipe[1]);
+    to_engine_ = in_pipe[1];
+    from_engine_ = out_pipe[0];
+    pid_ = pid;
+    buffer_.clear();
+  }
+
+  void shutdown() {
+    if (pid_ <= 0) return;
+    const char quit[] = "quit\n";
+    (void)!::write(to_engine_, quit, sizeof(quit) - 1);
+    ::close(to_engine_);
+    ::close(from_engine_);
+    // Give the engine a moment to exit on its own before killing it
+    for (int i = 0; i < 50; ++i) {
+      if (::waitpid(pid_, nullptr, WNOHANG) == pid_) {
+        pid_ = -1;
+        return;
+      }
+      ::usleep(2000);
+    }
+    ::kill(pid_, SIGKILL);
+    ::waitpid(pid_, nullptr, 0);
+    pid_ = -1;
+  }
+
+  std::string command_;
+  pid_t pid_ = -1;
+  int to_engine_ = -1;
+  int from_engine_ = -1;
+  std::string buffer_;
+};
+
+enum class Outcome { WhiteWins, BlackWins, Draw };
+
+struct GameResult {
+  Outcome outcome = Outcome::Draw;
+  std::string reason;
+  int plies = 0;
+};
+
+uint64_t openingSeed(uint64_t seed, int pair) {
+  uint64_t z = seed + 0x9e3779b97f4a7c15ull * static_cast<uint64_t>(pair + 1);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+// Random legal plies from the start position that leave the game undecided
+std::vector<std::string> makeOpening(const GameConfig& config, int plies, uint64_t seed) {
+  std::mt19937_64 rng(seed);
+  for (int attempt = 0; attempt < 100; ++attempt) {
+    ChessBoard board(config.game_settings.board_size);
+    board.initializeBoard(config.pieces);
+    MoveValidator validator;
+    PortalSystem portal_system(config.portals);
+    GameManager game_manager(board, validator, portal_system);
+    std::vector<EncodedMove> moves;
+    std::vector<std::string> opening;
+    for (int ply = 0; ply <= plies; ++ply) {
+      game_manager.generateLegalMoves(board.isWhiteToMove(), moves);
+      if (moves.empty()) break;
+      if (ply == plies) return opening;
+      EncodedMove move = moves[std::uniform_int_distribution<size_t>(0, moves.size() - 1)(rng)];
+      opening.push_back(board.moveToNotation(move));
+      game_manager.makeMove(move);
+    }
+  }
+  return {};
+}
+
+// One game; engines[0] plays white. Clocks follow the time control and a side
+// that runs out of time, sends an illegal move or dies loses.
+GameResult playGame(const GameConfig& config, const Options& options, const std::vector<std::string>& opening,
+                    EngineProcess* engines[2]) {
+  ChessBoard board(config.game_settings.board_size);
+  board.initializeBoard(config.pieces);
+  MoveValidator validator;
+  PortalSystem portal_system(config.portals);
+  GameManager game_manager(board, validator, portal_system);
+  game_manager.setTurnLimit(config.game_settings.turn_limit);
+  game_manager.setParallelStatusThreshold(ChessBoard::kMaxBoardSize + 1);
+
+  std::string moves_text;
+  std::vector<EncodedMove> legal;
+  for (const std::string& text : opening) {
+    EncodedMove move;
+    board.parseMove(text, move);
+    game_manager.makeMove(move);
+    moves_text += " " + text;
+  }
+
+  std::string line;
+  for (int side = 0; side < 2; ++side) {
+    if (!engines[side]->alive()) engines[side]->restart();
+    engines[side]->send("ucinewgame");
+    engines[side]->send("isready");
+    if (!engines[side]->expect("readyok", line, 10000)) {
+      return {side == 0 ? Outcome::BlackWins : Outcome::WhiteWins, "engine not ready", 0};
+    }
+  }
+
+  int64_t clocks[2] = {options.base_ms, options.base_ms};
+  GameResult result;
+  while (true) {
+    const bool white = board.isWhiteToMove();
+    const int side = white ? 0 : 1;
+    result.plies = static_cast<int>(game_manager.getHistorySize());
+    game_manager.generateLegalMoves(white, legal);
+    if (legal.empty()) {
+      if (game_manager.isInCheck(white)) {
+        return {white ? Outcome::BlackWins : Outcome::WhiteWins, "checkmate", result.plies};
+      }
+      return {Outcome::Draw, "stalemate", result.plies};
+    }
+    if (const char* reason = game_manager.getDrawReason()) {
+      return {Outcome::Draw, reason, result.plies};
+    }
+    if (result.plies >= options.max_plies) {
+      return {Outcome::Draw, "adjudicated at max plies", result.plies};
+    }
+
+    const Outcome loss = white ? Outcome::BlackWins : Outcome::WhiteWins;
+    std::ostringstream go;
+    int64_t timeout_ms;
+    if (options.movetime_ms > 0) {
+      go << "go movetime " << options.movetime_ms;
+      timeout_ms = options.movetime_ms * 2 + 1000;
+    } else {
+      go << "go wtime " << clocks[0] << " btime " << clocks[1] << " winc " << options.increment_ms << " binc "
+         << options.increment_ms;
+      timeout_ms = clocks[side];
+    }
+    EngineProcess& engine = *engines[side];
+    auto begin = Clock::now();
+    engine.send("position startpos" + (moves_text.empty() ? std::string() : " moves" + moves_text));
+    engine.send(go.str());
+    if (!engine.expect("bestmove", line, timeout_ms)) {
+      return {loss, engine.alive() ? "time forfeit" : "engine crashed", result.plies};
+    }
+    if (options.movetime_ms == 0) {
+      clocks[side] -= std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - begin).count();
+      if (clocks[side] < 0) {
+        return {loss, "time forfeit", result.plies};
+      }
+      clocks[side] += options.increment_ms;
+    }
+
+    std::istringstream reply(line);
+    std::string word, text;
+    reply >> word >> text;
+    EncodedMove move;
+    if (!board.parseMove(text, move) || std::find(legal.begin(), legal.end(), move) == legal.end()) {
+      return {loss, "illegal move " + text, result.plies};
+    }
+    game_manager.makeMove(move);
+    moves_text += " " + text;
+  }
+}
+
+// Pentanomial counts: index = engine1's points over a pair, in half points (0..4)
+struct PairStats {
+  std::array<int, 5> pentanomial{};
+  int wins = 0;
+  int losses = 0;
+  int draws = 0;
+
+  int pairs() const {
+    int n = 0;
+    for (int count : pentanomial) n += count;
+    return n;
+  }
+
+  // Mean and per-pair variance of engine1's score, normalised to [0, 1]
+  void scoreMoments(double& mean, double& variance) const {
+    int n = pairs();
+    mean = 0.0;
+    variance = 0.0;
+    if (n == 0) return;
+    for (int i = 0; i < 5; ++i) mean += pentanomial[i] * (i / 4.0);
+    mean /= n;
+    for (int i = 0; i < 5; ++i) variance += pentanomial[i] * std::pow(i / 4.0 - mean, 2);
+    variance /= n;
+  }
+};
+
+double expectedScore(double elo) {
+  return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+}
+
+double eloFromScore(double score) {
+  score = std::clamp(score, 1e-6, 1.0 - 1e-6);
+  return 400.0 * std::log10(score / (1.0 - score));
+}
+
+// Generalised SPRT log-likelihood ratio for H1: elo1 vs H0: elo0, using the
+// normal approximation of the pair-score distribution
+double logLikelihoodRatio(const PairStats& stats, double elo0, double elo1) {
+  double mean, variance;
+  stats.scoreMoments(mean, variance);
+  int n = stats.pairs();
+  if (n < 2 || variance <= 0.0) return 0.0;
+  // Pair scores are averages of two games, so their Elo model uses the per-game expectation
+  double s0 = expectedScore(elo0);
+  double s1 = expectedScore(elo1);
+  return (s1 - s0) * (2.0 * mean - s0 - s1) / (2.0 * variance / n);
+}
+
+bool parseTimeControl(const std::string& text, Options& options) {
+  size_t plus = text.find('+');
+  try {
+    options.base_ms = static_cast<int64_t>(std::stod(text.substr(0, plus)) * 1000);
+    options.increment_ms = plus == std::string::npos ? 0 : static_cast<int64_t>(std::stod(text.substr(plus + 1)) * 1000);
+  } catch (...) {
+    return false;
+  }
+  return options.base_ms > 0;
+}
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+  if (argc < 2) return false;
+  options.config_path = argv[1];
+  for (int i = 2; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    std::string value = argv[i + 1];
+    if (flag == "--engine1") options.engine_commands[0] = value;
+    else if (flag == "--engine2") options.engine_commands[1] = value;
+    else if (flag == "--tc") { if (!parseTimeControl(value, options)) return false; }
+    else if (flag == "--movetime") options.movetime_ms = std::atoll(value.c_str());
+    else if (flag == "--pairs") options.pairs = std::atoi(value.c_str());
+    else if (flag == "--concurrency") options.concurrency = static_cast<unsigned>(std::max(1, std::atoi(value.c_str())));
+    else if (flag == "--elo0") options.elo0 = std::atof(value.c_str());
+    else if (flag == "--elo1") options.elo1 = std::atof(value.c_str());
+    else if (flag == "--alpha") options.alpha = std::atof(value.c_str());
+    else if (flag == "--beta") options.beta = std::atof(value.c_str());
+    else if (flag == "--opening-plies") options.opening_plies = std::max(0, std::atoi(value.c_str()));
+    else if (flag == "--max-plies") options.max_plies = std::max(1, std::atoi(value.c_str()));
+    else if (flag == "--seed") options.seed = std::strtoull(value.c_str(), nullptr, 10);
+    else return false;
+  }
+  return (argc % 2) == 0 && !options.engine_commands[0].empty() && !options.engine_commands[1].empty() &&
+         options.pairs > 0 && options.alpha > 0 && options.beta > 0 && options.elo1 > options.elo0;
+}
+
+void printUsage() {
+  std::cerr << "Usage: tournament <config.json> --engine1 CMD --engine2 CMD [--tc BASE+INC | --movetime MS]\n"
+            << "                  [--pairs N] [--concurrency C] [--elo0 E0] [--elo1 E1] [--alpha A] [--beta B]\n"
+            << "                  [--opening-plies K] [--max-plies P] [--seed S]\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage();
+    return 1;
+  }
+  std::signal(SIGPIPE, SIG_IGN);  // a crashed engine must not take the runner down
+
+  ConfigReader config_reader;
+  if (!config_reader.loadFromFile(options.config_path)) {
+    std::cerr << "Failed to load configuration file\n";
+    return 1;
+  }
+  const GameConfig& config = config_reader.getConfig();
+
+  const double lower = std::log(options.beta / (1.0 - options.alpha));
+  const double upper = std::log((1.0 - options.beta) / options.alpha);
+  PairStats stats;
+  std::mutex stats_mutex;
+  std::atomic<int> next_pair{0};
+  std::atomic<bool> finished{false};
+  std::string verdict = "inconclusive";
+
+  {
+    ThreadPool pool(options.concurrency);
+    std::vector<std::future<void>> workers;
+    for (unsigned t = 0; t < pool.size(); ++t) {
+      workers.push_back(pool.submit([&] {
+        // Each worker owns one process of each engine and reuses it between games
+        EngineProcess first(options.engine_commands[0]);
+        EngineProcess second(options.engine_commands[1]);
+        for (int pair = next_pair++; pair < options.pairs && !finished; pair = next_pair++) {
+          std::vector<std::string> opening = makeOpening(config, options.opening_plies, openingSeed(options.seed, pair));
+          EngineProcess* as_white[2] = {&first, &second};
+          EngineProcess* as_black[2] = {&second, &first};
+          GameResult games[2] = {playGame(config, options, opening, as_white),
+                                 playGame(config, options, opening, as_black)};
+
+          // engine1 points in half points: white in game 0, black in game 1
+          int half_points = 0;
+          int wins = 0, losses = 0, draws = 0;
+          for (int g = 0; g < 2; ++g) {
+            Outcome engine1_wins = g == 0 ? Outcome::WhiteWins : Outcome::BlackWins;
+            if (games[g].outcome == Outcome::Draw) {
+              half_points += 1;
+              ++draws;
+            } else if (games[g].outcome == engine1_wins) {
+              half_points += 2;
+              ++wins;
+            } else {
+              ++losses;
+            }
+          }
+
+          std::lock_guard<std::mutex> lock(stats_mutex);
+          if (finished) break;
+          ++stats.pentanomial[half_points];
+          stats.wins += wins;
+          stats.losses += losses;
+          stats.draws += draws;
+          double llr = logLikelihoodRatio(stats, options.elo0, options.elo1);
+          std::cerr << "pair " << stats.pairs() << ": " << games[0].reason << " / " << games[1].reason
+                    << "  W-L-D " << stats.wins << "-" << stats.losses << "-" << stats.draws << "  LLR "
+                    << std::fixed << std::setprecision(2) << llr << "\n";
+          if (llr >= upper) {
+            verdict = "H1 accepted (engine1 stronger)";
+            finished = true;
+          } else if (llr <= lower) {
+            verdict = "H0 accepted (no gain of elo1)";
+            finished = true;
+          }
+        }
+      }));
+    }
+    for (auto& worker : workers) {
+      worker.get();
+    }
+  }
+
+  double mean, variance;
+  stats.scoreMoments(mean, variance);
+  int pairs = stats.pairs();
+  double error = pairs > 1 ? 1.96 * std::sqrt(variance / pairs) : 0.0;
+  double elo = eloFromScore(mean);
+  double elo_low = eloFromScore(mean - error);
+  double elo_high = eloFromScore(mean + error);
+
+  std::cout << std::fixed << std::setprecision(2)
+            << "Games: " << 2 * pairs << " (" << pairs << " pairs)\n"
+            << "Score of engine1 vs engine2: " << stats.wins << " - " << stats.losses << " - " << stats.draws
+            << "  [" << std::setprecision(3) << mean << "]\n"
+            << std::setprecision(1) << "Elo difference: " << elo << " (95% " << elo_low << " .. " << elo_high
+            << ")\n"
+            << "Pentanomial [0, 0.5, 1, 1.5, 2]: " << stats.pentanomial[0] << ", " << stats.pentanomial[1] << ", "
+            << stats.pentanomial[2] << ", " << stats.pentanomial[3] << ", " << stats.pentanomial[4] << "\n"
+            << std::setprecision(2) << "SPRT: elo0=" << options.elo0 << " elo1=" << options.elo1
+            << " alpha=" << options.alpha << " beta=" << options.beta << "\n"
+            << "LLR: " << logLikelihoodRatio(stats, options.elo0, options.elo1) << " (" << lower << ", " << upper
+            << ") " << verdict << "\n";
+  return 0;
+}
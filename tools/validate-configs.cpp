@@ -0,0 +1,449 @@
+// validate-configs.cpp - vet many variant configs in parallel
+//
+// Usage: validate-configs CONFIG.json... [--threads T] [--json]
+//
+// Every config is loaded as the game would load it (ConfigReader's own
+// checks) and then checked against the board it sets up:
+//   overlapping-start    two pieces start on the same square
+//   start-off-board      a start square outside the board (the game drops it)
+// (both for "pieces", which the board is set up with; "custom_pieces" is a
+// catalog that is never placed and only gets the immobile-piece check)
+//   portal-on-start      a portal entry or exit on an occupied start square
+//   unusable-portal      a portal no color is allowed to use
+//   unreachable-portal   no piece allowed through a portal can ever reach its
+//                        entry, even on an otherwise empty board
+//   unreachable-portal-cycle
+//                        portals whose exits lead into each other in a loop
+//                        that no piece can ever enter
+//   immobile-piece       a piece type the move generator gives no move from
+//                        any of its start squares (custom types with no
+//                        movement rules in the generator end up here)
+//   no-moves-at-start    a side has no legal move in the start position
+//   check-at-start       a side starts in check
+// plus load-error and board-too-large when a config cannot be checked at all.
+// Configs run on a work-stealing pool of T workers (default: all cores).
+//
+// Diagnostics go to stdout, one per line, in input order:
+//   FILE[:LINE:COLUMN]: SEVERITY: MESSAGE [CODE] (at JSON-POINTER)
+// or with --json as JSON Lines with the fields file, severity, code,
+// message, pointer, line and column. A summary goes to stderr. Exits with 1
+// if any config has an error; warnings alone pass.
+#include "ChessBoard.hpp"
+#include "ConfigReader.hpp"
+#include "GameManager.hpp"
+#include "MoveValidator.hpp"
+#include "PortalSystem.hpp"
+#include "ScratchArena.hpp"
+#include "WorkStealingPool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Options {
+  std::vector<std::string> paths;
+  unsigned threads = std::thread::hardware_concurrency();
+  bool json = false;
+};
+
+struct Diagnostic {
+  bool error;
+  std::string code;
+  std::string message;
+  std::string pointer;  // JSON pointer to the offending value, if known
+  size_t line = 0;      // set for errors in the JSON text
+  size_t column = 0;
+};
+
+// A start square and where in the config it came from
+struct Start {
+  const PieceConfig* piece;
+  bool is_white;
+  std::string pointer;
+};
+
+void printUsage() {
+  std::cerr << "Usage: validate-configs CONFIG.json... [--threads T] [--json]\n";
+}
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--threads" && i + 1 < argc) {
+      options.threads = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+    } else if (arg == "--json") {
+      options.json = true;
+    } else if (arg.rfind("--", 0) == 0) {
+      return false;
+    } else {
+      options.paths.push_back(arg);
+    }
+  }
+  return !options.paths.empty();
+}
+
+class Validator {
+public:
+  Validator(const GameConfig& config, std::vector<Diagnostic>& out)
+      : config_(config),
+        size_(config.game_settings.board_size),
+        board_(size_, "simple"),
+        portal_system_(config.portals),
+        game_manager_(board_, move_validator_, portal_system_),
+        out_(out) {
+    game_manager_.setParallelStatusThreshold(ChessBoard::kMaxBoardSize + 1);
+  }
+
+  void run() {
+    checkStartSquares();
+    checkPortalSquares();
+    checkMobility();
+    checkPortalReachability();
+    checkStartPosition();
+  }
+
+private:
+  void report(bool error, const char* code, const std::string& message, const std::string& pointer = "") {
+    out_.push_back(Diagnostic{error, code, message, pointer});
+  }
+
+  std::string describe(const Start& start) const {
+    return std::string(start.is_white ? "white " : "black ") + start.piece->type;
+  }
+
+  // The pieces the board is set up with (custom pieces are a catalog and
+  // never placed), keyed by square index
+  void checkStartSquares() {
+    occupants_.assign(static_cast<size_t>(size_) * size_, -1);
+    for (size_t i = 0; i < config_.pieces.size(); ++i) {
+      const PieceConfig& piece = config_.pieces[i];
+      for (bool is_white : {true, false}) {
+        const auto& positions = piece.positions.of(is_white);
+        for (size_t j = 0; j < positions.size(); ++j) {
+          Start start{&piece, is_white,
+                      "/pieces/" + std::to_string(i) + (is_white ? "/positions/white/" : "/positions/black/") +
+                          std::to_string(j)};
+          const Position& pos = positions[j];
+          if (!board_.isInBounds(pos)) {
+            report(true, "start-off-board",
+                   describe(start) + " starts at (" + std::to_string(pos.x) + ", " + std::to_string(pos.y) +
+                       "), outside the " + std::to_string(size_) + "x" + std::to_string(size_) + " board",
+                   start.pointer);
+            continue;
+          }
+          int& occupant = occupants_[board_.squareIndex(pos)];
+          if (occupant >= 0) {
+            report(true, "overlapping-start",
+                   describe(start) + " and " + describe(starts_[occupant]) + " both start on " +
+                       board_.positionToNotation(pos),
+                   start.pointer);
+            continue;
+          }
+          occupant = static_cast<int>(starts_.size());
+          starts_.push_back(std::move(start));
+        }
+      }
+    }
+  }
+
+  void checkPortalSquares() {
+    for (size_t i = 0; i < config_.portals.size(); ++i) {
+      const PortalConfig& portal = config_.portals[i];
+      const std::string pointer = "/portals/" + std::to_string(i);
+      for (bool entry : {true, false}) {
+        const Position& pos = entry ? portal.positions.entry : portal.positions.exit;
+        const int occupant = occupants_[board_.squareIndex(pos)];
+        if (occupant >= 0) {
+          report(false, "portal-on-start",
+                 "portal " + portal.id + (entry ? " entry " : " exit ") + board_.positionToNotation(pos) +
+                     " is the start square of " + describe(starts_[occupant]),
+                 pointer + (entry ? "/positions/entry" : "/positions/exit"));
+        }
+      }
+      if (portal.properties.allowed_colors.empty()) {
+        report(false, "unusable-portal", "portal " + portal.id + " allows no color", pointer + "/properties");
+      }
+    }
+  }
+
+  bool portalAllows(const PortalConfig& portal, bool is_white) const {
+    const auto& colors = portal.properties.allowed_colors;
+    return std::find(colors.begin(), colors.end(), is_white ? "white" : "black") != colors.end();
+  }
+
+  // Squares a piece of one type and color can ever stand on, starting from
+  // `from`: breadth-first over the move generator on an otherwise empty
+  // board (nothing blocks, so this is an upper bound), through portals it
+  // may use, and on as a queen once a pawn reaches the last rank.
+  // Returns the number of squares reached beyond the start squares.
+  size_t explore(PieceKind kind, bool is_white, const std::vector<Position>& from) {
+    const size_t squares = static_cast<size_t>(size_) * size_;
+    // Only the kind matters to the generator, so every type borrows the
+    // queen's type id (catalogs may hold more types than a board can)
+    const uint8_t queen_id = board_.pieceTypeId("Queen");
+    const ChessBoard::Square queen(queen_id, PieceKind::Queen, is_white);
+    const ChessBoard::Square piece(queen_id, kind, is_white);
+    const int last_rank = is_white ? size_ - 1 : 0;
+    // Entries are square + squares * promoted
+    std::vector<bool> seen(2 * squares, false);
+    std::vector<size_t> queue;
+    for (const Position& pos : from) {
+      if (!board_.isInBounds(pos)) continue;
+      const size_t index = static_cast<size_t>(board_.squareIndex(pos));
+      if (!seen[index]) {
+        seen[index] = true;
+        queue.push_back(index);
+      }
+    }
+    const size_t starts = queue.size();
+
+    ScratchArena& arena = ScratchArena::forThread();
+    ScratchArena::Scope scope(arena);
+    std::pmr::vector<Position> edges(&arena);
+    for (size_t next = 0; next < queue.size(); ++next) {
+      const bool promoted = queue[next] >= squares;
+      const Position pos = board_.squarePosition(static_cast<int>(queue[next] % squares));
+      const ChessBoard::Square& moving = promoted ? queen : piece;
+      edges.clear();
+      board_.setSquare(pos, moving);
+      move_validator_.getMoveEdges(moving.kind, pos, is_white, board_, edges);
+      board_.setSquare(pos, ChessBoard::Square());
+      for (const PortalConfig& portal : config_.portals) {
+        if (portal.positions.entry.x == pos.x && portal.positions.entry.y == pos.y && portalAllows(portal, is_white)) {
+          edges.push_back(portal.positions.exit);
+        }
+      }
+      for (const Position& to : edges) {
+        const bool promotes = promoted || (moving.kind == PieceKind::Pawn && to.y == last_rank);
+        const size_t index = static_cast<size_t>(board_.squareIndex(to)) + (promotes ? squares : 0);
+        if (!seen[index]) {
+          seen[index] = true;
+          queue.push_back(index);
+          reached_[is_white][index % squares] = true;
+        }
+      }
+    }
+    return queue.size() - starts;
+  }
+
+  void checkMobility() {
+    const size_t squares = static_cast<size_t>(size_) * size_;
+    for (bool is_white : {false, true}) {
+      reached_[is_white].assign(squares, false);
+    }
+    const std::pair<const std::vector<PieceConfig>*, const char*> lists[] = {{&config_.pieces, "/pieces/"},
+                                                                            {&config_.custom_pieces, "/custom_pieces/"}};
+    for (const auto& [pieces, prefix] : lists) {
+      // Custom pieces are not set up on the board, so they reach no portal
+      const bool on_board = pieces == &config_.pieces;
+      for (size_t i = 0; i < pieces->size(); ++i) {
+        const PieceConfig& piece = (*pieces)[i];
+        for (bool is_white : {true, false}) {
+          const auto& positions = piece.positions.of(is_white);
+          if (positions.empty()) continue;
+          std::vector<bool> saved;
+          if (!on_board) saved = reached_[is_white];
+          const PieceKind kind = ChessBoard::kindOfName(piece.type);
+          const size_t moves = explore(kind, is_white, positions);
+          if (!on_board) reached_[is_white] = std::move(saved);
+          for (const Position& pos : positions) {
+            if (on_board && board_.isInBounds(pos)) reached_[is_white][board_.squareIndex(pos)] = true;
+          }
+          if (moves > 0) continue;
+          std::string message = std::string(is_white ? "white " : "black ") + piece.type +
+                                " has no legal move from any of its start squares";
+          if (kind == PieceKind::Custom) {
+            message += " (the move generator has no rules for this type, so its movement settings are unused)";
+          }
+          report(false, "immobile-piece", message,
+                 prefix + std::to_string(i) + (is_white ? "/positions/white" : "/positions/black"));
+        }
+      }
+    }
+  }
+
+  bool reachable(const PortalConfig& portal) const {
+    const size_t index = static_cast<size_t>(board_.squareIndex(portal.positions.entry));
+    for (bool is_white : {true, false}) {
+      if (portalAllows(portal, is_white) && reached_[is_white][index]) return true;
+    }
+    return false;
+  }
+
+  // Portal i leads into portal j when i's exit is j's entry. Strongly
+  // connected groups of that graph (Tarjan) are the portal cycles.
+  void checkPortalReachability() {
+    const auto& portals = config_.portals;
+    const size_t count = portals.size();
+    std::vector<std::vector<size_t>> next(count);
+    for (size_t i = 0; i < count; ++i) {
+      for (size_t j = 0; j < count; ++j) {
+        if (portals[i].positions.exit.x == portals[j].positions.entry.x &&
+            portals[i].positions.exit.y == portals[j].positions.entry.y) {
+          next[i].push_back(j);
+        }
+      }
+    }
+    std::vector<int> order(count, -1), low(count, 0), group(count, -1);
+    std::vector<size_t> stack;
+    std::vector<bool> on_stack(count, false);
+    int visited = 0, groups = 0;
+    std::function<void(size_t)> connect = [&](size_t i) {
+      order[i] = low[i] = visited++;
+      stack.push_back(i);
+      on_stack[i] = true;
+      for (size_t j : next[i]) {
+        if (order[j] < 0) {
+          connect(j);
+          low[i] = std::min(low[i], low[j]);
+        } else if (on_stack[j]) {
+          low[i] = std::min(low[i], order[j]);
+        }
+      }
+      if (low[i] != order[i]) return;
+      size_t member;
+      do {
+        member = stack.back();
+        stack.pop_back();
+        on_stack[member] = false;
+        group[member] = groups;
+      } while (member != i);
+      ++groups;
+    };
+    for (size_t i = 0; i < count; ++i) {
+      if (order[i] < 0) connect(i);
+    }
+
+    std::vector<std::vector<size_t>> members(static_cast<size_t>(groups));
+    for (size_t i = 0; i < count; ++i) members[static_cast<size_t>(group[i])].push_back(i);
+    for (const auto& cycle : members) {
+      const size_t first = cycle.front();
+      const bool is_cycle = cycle.size() > 1 ||
+                            std::find(next[first].begin(), next[first].end(), first) != next[first].end();
+      const bool entered = std::any_of(cycle.begin(), cycle.end(), [&](size_t i) { return reachable(portals[i]); });
+      if (entered) continue;
+      if (!is_cycle) {
+        if (portals[first].properties.allowed_colors.empty()) continue;  // already unusable-portal
+        report(false, "unreachable-portal",
+               "no piece allowed through portal " + portals[first].id + " can reach its entry " +
+                   board_.positionToNotation(portals[first].positions.entry),
+               "/portals/" + std::to_string(first));
+        continue;
+      }
+      std::string ids;
+      for (size_t i : cycle) ids += (ids.empty() ? "" : ", ") + portals[i].id;
+      report(false, "unreachable-portal-cycle", "portal cycle " + ids + " can never be entered",
+             "/portals/" + std::to_string(first));
+    }
+  }
+
+  void checkStartPosition() {
+    board_.initializeBoard(config_.pieces);
+    portal_system_ = PortalSystem(config_.portals);
+    game_manager_.resetHistory();
+    std::vector<EncodedMove> moves;
+    for (bool is_white : {true, false}) {
+      board_.setWhiteToMove(is_white);
+      const std::string side = is_white ? "white" : "black";
+      if (game_manager_.isInCheck(is_white)) {
+        report(false, "check-at-start", side + " starts in check");
+      }
+      game_manager_.generateLegalMoves(is_white, moves);
+      if (moves.empty()) {
+        report(true, "no-moves-at-start", side + " has no legal move in the start position");
+      }
+    }
+  }
+
+  const GameConfig& config_;
+  const int size_;
+  ChessBoard board_;
+  MoveValidator move_validator_;
+  PortalSystem portal_system_;
+  GameManager game_manager_;
+  std::vector<Diagnostic>& out_;
+  std::vector<int> occupants_;    // index into starts_ per square, -1 if free
+  std::vector<Start> starts_;
+  std::vector<bool> reached_[2];  // per color: squares some board piece can reach
+};
+
+void validate(const std::string& path, std::vector<Diagnostic>& out) {
+  ConfigReader config_reader;
+  config_reader.setQuiet(true);
+  if (!config_reader.loadFromJsonFile(path)) {
+    const ConfigReader::LoadError& error = config_reader.getLastError();
+    out.push_back(Diagnostic{true, "load-error", error.message, "", error.line, error.column});
+    return;
+  }
+  const GameConfig& config = config_reader.getConfig();
+  if (config.game_settings.board_size > ChessBoard::kMaxBoardSize) {
+    out.push_back(Diagnostic{true, "board-too-large",
+                             "board size " + std::to_string(config.game_settings.board_size) + " is larger than " +
+                                 std::to_string(ChessBoard::kMaxBoardSize),
+                             "/game_settings/board_size"});
+    return;
+  }
+  Validator(config, out).run();
+}
+
+void print(const std::string& path, const Diagnostic& diagnostic, bool json) {
+  if (json) {
+    nlohmann::json line = {{"file", path},
+                           {"severity", diagnostic.error ? "error" : "warning"},
+                           {"code", diagnostic.code},
+                           {"message", diagnostic.message},
+                           {"pointer", diagnostic.pointer},
+                           {"line", diagnostic.line},
+                           {"column", diagnostic.column}};
+    std::cout << line.dump() << "\n";
+    return;
+  }
+  std::cout << path;
+  if (diagnostic.line > 0) std::cout << ":" << diagnostic.line << ":" << diagnostic.column;
+  std::cout << ": " << (diagnostic.error ? "error" : "warning") << ": " << diagnostic.message << " ["
+            << diagnostic.code << "]";
+  if (!diagnostic.pointer.empty()) std::cout << " (at " << diagnostic.pointer << ")";
+  std::cout << "\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage();
+    return 1;
+  }
+
+  const auto started = std::chrono::steady_clock::now();
+  std::vector<std::vector<Diagnostic>> results(options.paths.size());
+  try {
+    WorkStealingPool pool(options.threads);
+    pool.run(options.paths.size(), [&](size_t index, unsigned) { validate(options.paths[index], results[index]); });
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+  size_t errors = 0, warnings = 0, failed = 0;
+  for (size_t i = 0; i < options.paths.size(); ++i) {
+    bool has_error = false;
+    for (const Diagnostic& diagnostic : results[i]) {
+      print(options.paths[i], diagnostic, options.json);
+      has_error = has_error || diagnostic.error;
+      ++(diagnostic.error ? errors : warnings);
+    }
+    if (has_error) ++failed;
+  }
+  std::cerr << options.paths.size() << " configs, " << failed << " with errors, " << errors << " errors, "
+            << warnings << " warnings, " << seconds << "s\n";
+  return failed > 0 ? 1 : 0;
+}